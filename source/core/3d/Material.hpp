@@ -10,6 +10,9 @@
 namespace librii::glhelper {
 class DelegatedUBOBuilder;
 }
+namespace librii::gfx {
+class CommandList;
+}
 
 namespace riistudio::lib3d {
 
@@ -45,8 +48,9 @@ struct Material : public virtual kpi::IObject {
                                 const std::map<std::string, u32>& texIdMap,
                                 const Polygon& poly,
                                 const Scene& scene) const = 0;
+  // Record the texture bindings of the material
   virtual void
-  genSamplUniforms(u32 shaderId,
+  genSamplUniforms(librii::gfx::CommandList& commands,
                    const std::map<std::string, u32>& texIdMap) const = 0;
   virtual void onSplice(librii::glhelper::DelegatedUBOBuilder& builder,
                         const Model& model, const Polygon& poly, u32 id) const {
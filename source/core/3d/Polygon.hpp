@@ -36,6 +36,10 @@ struct Polygon : public virtual kpi::IObject {
   virtual bool hasAttrib(SimpleAttrib attrib) const = 0;
   virtual void setAttrib(SimpleAttrib attrib, bool v) = 0;
 
+  // Called for every mesh before any is propagated: declare the attributes
+  // propagate writes and reserve its space.
+  virtual void declare(const Model& mdl, u32 mp_id,
+                       librii::glhelper::VBOBuilder& out) const {}
   // For now... (slow api)
   virtual void propagate(const Model& mdl, u32 mp_id,
                          librii::glhelper::VBOBuilder& out) const = 0;
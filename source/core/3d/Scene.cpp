@@ -3,14 +3,19 @@
 #endif
 #include "i3dmodel.hpp"
 #include <algorithm>                       // std::min
-#include <core/3d/gl.hpp>                  // glClearColor
 #include <core/3d/renderer/SceneState.hpp> // SceneState
 #include <core/3d/renderer/SceneTree.hpp>
 #include <core/util/gui.hpp>           // ImGui::GetStyle()
 #include <librii/gl/Compiler.hpp>      // PacketParams
-#include <librii/gl/EnumConverter.hpp> // setGlState
 #include <plugins/gc/Export/IndexedPolygon.hpp>
+#include <plugins/gc/Export/Scene.hpp>
+#include <plugins/gc/Export/Texture.hpp>
+#include <optional>
+#include <set>
+#include <span>
+#include <tuple> // std::forward_as_tuple
 #include <unordered_map>
+#include <unordered_set>
 
 namespace riistudio::lib3d {
 
@@ -22,20 +27,33 @@ glm::mat4 Bone::calcSrtMtx(const lib3d::Model* mdl) const {
 }
 
 struct VertexBufferTenant {
-  VertexBufferTenant(librii::glhelper::VBOBuilder& vbo_builder,
-                     const lib3d::Model& mdl,
-                     const libcube::IndexedPolygon& poly, u32 mp_id) {
-    idx_ofs = static_cast<u32>(vbo_builder.mIndices.size());
-    poly.propagate(mdl, mp_id, vbo_builder);
-    idx_size = static_cast<u32>(vbo_builder.mIndices.size()) - idx_ofs;
-  }
-  u32 idx_ofs;
-  u32 idx_size;
+  librii::glhelper::VBOBuilder::Range range;
+  // Of the mesh data the range was built from
+  u64 fingerprint = 0;
 };
 
+using ShaderSources = std::pair<std::string, std::string>;
+
+// Without a context, programs are not compiled: they only reflect the uniform
+// blocks of the shaders librii::gl generates.
+static librii::glhelper::ShaderProgram
+compileProgram(const ShaderSources& sources, bool headless) {
+  if (headless) {
+    librii::glhelper::ProgramReflection reflection;
+    reflection.blockSizes = {sizeof(librii::gl::UniformSceneParams),
+                             sizeof(librii::gl::UniformMaterialParams),
+                             sizeof(librii::gl::PacketParams)};
+    return librii::glhelper::ShaderProgram::makeHeadless(reflection);
+  }
+  return librii::glhelper::ShaderProgram{sources.first, sources.second};
+}
+
+// Materials edited since the draw nodes last read them
+using MaterialSet = std::unordered_set<const lib3d::Material*>;
+
 struct ShaderUser {
-  ShaderUser(librii::glhelper::ShaderProgram&& shader) {
-    mImpl = std::make_unique<Impl>(std::move(shader));
+  ShaderUser(const lib3d::Material& mat, MaterialSet& changed, bool headless) {
+    mImpl = std::make_unique<Impl>(mat, changed, headless);
   }
 
   auto& getProgram() { return mImpl->mProgram; }
@@ -46,23 +64,40 @@ struct ShaderUser {
 private:
   // IObservers should be heap allocated
   struct Impl : public IObserver {
-    Impl(librii::glhelper::ShaderProgram&& program)
-        : mProgram(std::move(program)) {}
+    Impl(const lib3d::Material& mat, MaterialSet& changed, bool headless)
+        : mSources(headless ? ShaderSources{} : mat.generateShaders()),
+          mProgram(compileProgram(mSources, headless)), mChanged(changed),
+          mHeadless(headless) {}
 
+    // Of mProgram
+    ShaderSources mSources;
     librii::glhelper::ShaderProgram mProgram;
+    // Draw nodes hold the program ID and render state of the material: they
+    // read them again on the next update
+    MaterialSet& mChanged;
+    bool mHeadless;
 
     void update(lib3d::Material* _mat) final {
+      mChanged.insert(_mat);
+      if (mHeadless)
+        return;
+      auto sources = _mat->generateShaders();
+      if (_mat->applyCacheAgain)
+        sources.second = _mat->cachedPixelShader;
+      // Most edits (e.g. dragging a color) only change uniforms
+      if (sources == mSources) {
+        _mat->isShaderError = false;
+        return;
+      }
       DebugReport("Recompiling shader for %s..\n", _mat->getName().c_str());
-      const auto shader_sources = _mat->generateShaders();
-      librii::glhelper::ShaderProgram new_shader(
-          shader_sources.first, _mat->applyCacheAgain ? _mat->cachedPixelShader
-                                                      : shader_sources.second);
+      librii::glhelper::ShaderProgram new_shader(sources.first, sources.second);
       if (new_shader.getError()) {
         _mat->isShaderError = true;
         _mat->shaderError = new_shader.getErrorDesc();
         return;
       }
       mProgram = std::move(new_shader);
+      mSources = std::move(sources);
       _mat->isShaderError = false;
     }
   };
@@ -83,41 +118,198 @@ public:
   }
 };
 struct SceneImpl::Internal {
+  explicit Internal(bool headless)
+      : mHeadless(headless), mVboBuilder(headless) {}
+
+  // No GL objects are created; see SceneState::setHeadless
+  bool mHeadless;
+
   librii::glhelper::VBOBuilder mVboBuilder;
   // Maps mesh names -> slots of mVboBuilder
   std::unordered_map<MeshName, VertexBufferTenant, MeshHash> mTenants;
 
-  std::vector<GlTexture> mTextures;
-  // Maps texture names -> slots of mTextures
+  struct TextureSlot {
+    // Empty if headless
+    std::optional<GlTexture> texture;
+    // Of the image uploaded
+    librii::image::ImageKey key;
+  };
+  // Maps texture names -> GL textures
+  std::map<std::string, TextureSlot> mTextures;
+  // Maps texture names -> GL ids
   std::map<std::string, u32> mTexIdMap;
+  // Placeholder IDs of headless textures
+  u32 mNextTextureId = 1;
+
+  // Patched into the draw nodes by update; only compared, never dereferenced
+  MaterialSet mChangedMaterials;
+  // Pose version the bounds of the draw nodes of each model were computed at
+  std::unordered_map<const Model*, u32> mPoseVersions;
 
   // Maps material name -> Shader
   // Each entry is heap allocated so we shouldnt have to worry about dangling
   // references.
   std::map<std::string, ShaderUser> mMatToShader;
 
-  void buildVertexBuffer(const Model& model) {
-    for (auto& mesh : model.getMeshes()) {
-      auto& gc_mesh = reinterpret_cast<const libcube::IndexedPolygon&>(mesh);
-
-      for (u32 i = 0; i < gc_mesh.getMeshData().mMatrixPrimitives.size(); ++i) {
-        const MeshName mesh_name{.string = mesh.getName(), .mprim_index = i};
+  struct MeshSource {
+    MeshName name;
+    const Model* model;
+    const libcube::IndexedPolygon* mesh;
+    u64 fingerprint;
+  };
 
-        if (mTenants.contains(mesh_name))
-          continue;
+  // Of the vertex data propagate builds from a mesh: its indices, and the
+  // entries of the buffers it references. Shared buffers are hashed once.
+  static u64 fingerprintMesh(const libcube::Model& model,
+                             const libcube::IndexedPolygon& mesh,
+                             std::unordered_map<const void*, u64>& buffers) {
+    u64 hash = librii::mesh::HashMeshIndices(mesh.getMeshData());
+    const auto combine = [&](u64 value) {
+      hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    };
+    combine(mesh.getVcd().mBitfield);
+    for (u32 i = 0; i < (u32)librii::gx::VertexAttribute::Max; ++i) {
+      const auto attr = static_cast<librii::gx::VertexAttribute>(i);
+      if (!mesh.getVcd()[attr])
+        continue;
+      const void* key = mesh.getVertexBuffer(model, attr).key;
+      if (key == nullptr)
+        continue;
+      auto [it, inserted] = buffers.try_emplace(key, 0);
+      if (inserted)
+        it->second = mesh.hashVertexBuffer(model, attr);
+      combine(it->second);
+    }
+    return hash;
+  }
 
-        VertexBufferTenant tenant{mVboBuilder, model, gc_mesh, i};
-        mTenants.emplace(mesh_name, tenant);
+  // Rebuild the vertex data of the meshes that changed since the last call, in
+  // place where it fits. Everything is rebuilt if meshes were added or removed,
+  // a changed mesh no longer fits the vertex layout, or most of the data is
+  // left unused by meshes that grew.
+  void syncVertexBuffer(const Scene& host) {
+    std::vector<MeshSource> sources;
+    std::unordered_map<const void*, u64> buffers;
+    std::unordered_set<MeshName, MeshHash> seen;
+    for (auto& model : host.getModels()) {
+      const auto* gc_model = dynamic_cast<const libcube::Model*>(&model);
+      assert(gc_model != nullptr);
+      for (auto& mesh : model.getMeshes()) {
+        auto& gc_mesh = reinterpret_cast<const libcube::IndexedPolygon&>(mesh);
+        const u64 fingerprint = fingerprintMesh(*gc_model, gc_mesh, buffers);
+        for (u32 i = 0; i < gc_mesh.getMeshData().mMatrixPrimitives.size();
+             ++i) {
+          MeshName name{.string = mesh.getName(), .mprim_index = i};
+          if (!seen.insert(name).second)
+            continue;
+          sources.push_back({std::move(name), &model, &gc_mesh, fingerprint});
+        }
       }
     }
+
+    bool rebuild = sources.size() != mTenants.size();
+    std::vector<const MeshSource*> changed;
+    for (const auto& source : sources) {
+      if (rebuild)
+        break;
+      const auto it = mTenants.find(source.name);
+      if (it == mTenants.end())
+        rebuild = true;
+      else if (it->second.fingerprint != source.fingerprint)
+        changed.push_back(&source);
+    }
+    if (!rebuild) {
+      for (const auto* source : changed)
+        source->mesh->declare(*source->model, source->name.mprim_index,
+                              mVboBuilder);
+      rebuild = !mVboBuilder.isLayoutCompatible();
+    }
+    if (rebuild) {
+      buildVertexBuffer(sources);
+      return;
+    }
+
+    for (const auto* source : changed) {
+      source->mesh->propagate(*source->model, source->name.mprim_index,
+                              mVboBuilder);
+      auto& tenant = mTenants.at(source->name);
+      mVboBuilder.replaceRange(tenant.range, mVboBuilder.endRange());
+      tenant.fingerprint = source->fingerprint;
+    }
+    // Meshes that outgrew their place left it unused
+    if (mVboBuilder.isFragmented()) {
+      buildVertexBuffer(sources);
+      return;
+    }
+    mVboBuilder.upload();
+  }
+
+  void buildVertexBuffer(std::span<const MeshSource> sources) {
+    mVboBuilder.clear();
+    mTenants.clear();
+
+    // Every mesh declares its attributes before any vertex is written
+    for (const auto& source : sources)
+      source.mesh->declare(*source.model, source.name.mprim_index,
+                           mVboBuilder);
+    for (const auto& source : sources) {
+      source.mesh->propagate(*source.model, source.name.mprim_index,
+                             mVboBuilder);
+      mTenants.emplace(source.name,
+                       VertexBufferTenant{.range = mVboBuilder.endRange(),
+                                          .fingerprint = source.fingerprint});
+    }
+    mVboBuilder.build();
+  }
+
+  static librii::image::ImageKey fingerprintTexture(const Texture& tex) {
+    const auto* gc_tex = dynamic_cast<const libcube::Texture*>(&tex);
+    if (gc_tex == nullptr)
+      return {.width = tex.getWidth(),
+              .height = tex.getHeight(),
+              .mipMapCount = tex.getMipmapCount()};
+    return librii::image::computeImageKey(
+        {gc_tex->getData(), gc_tex->getEncodedSize(true)},
+        static_cast<librii::gx::TextureFormat>(gc_tex->getTextureFormat()),
+        tex.getWidth(), tex.getHeight(), tex.getMipmapCount());
   }
 
-  void buildTextures(const Scene& host) {
+  // Upload new and changed textures; GL ids of kept textures do not change.
+  void syncTextures(const Scene& host) {
+    std::set<std::string> present;
     for (auto& tex : host.getTextures()) {
-      if (mTexIdMap.contains(tex.getName()))
+      const auto name = tex.getName();
+      if (!present.insert(name).second)
         continue;
 
-      mTexIdMap[tex.getName()] = mTextures.emplace_back(tex).getGlId();
+      const auto key = fingerprintTexture(tex);
+      const auto it = mTextures.find(name);
+      if (it == mTextures.end()) {
+        if (mHeadless) {
+          mTextures.emplace(name, TextureSlot{std::nullopt, key});
+          mTexIdMap[name] = mNextTextureId++;
+          continue;
+        }
+        auto& slot =
+            mTextures.emplace(name, TextureSlot{GlTexture(tex), key})
+                .first->second;
+        mTexIdMap[name] = slot.texture->getGlId();
+        continue;
+      }
+      if (it->second.key == key)
+        continue;
+      if (it->second.texture.has_value())
+        it->second.texture->update(tex);
+      it->second.key = key;
+    }
+
+    for (auto it = mTextures.begin(); it != mTextures.end();) {
+      if (present.contains(it->first)) {
+        ++it;
+        continue;
+      }
+      mTexIdMap.erase(it->first);
+      it = mTextures.erase(it);
     }
   }
 };
@@ -128,15 +320,18 @@ SceneImpl::~SceneImpl() = default;
 void SceneImpl::prepare(SceneState& state, const kpi::INode& _host) {
   auto& host = *dynamic_cast<const Scene*>(&_host);
 
-  if (mImpl == nullptr) {
-    mImpl = std::make_unique<Internal>();
+  if (mImpl == nullptr || mImpl->mHeadless != state.isHeadless())
+    mImpl = std::make_unique<Internal>(state.isHeadless());
 
-    for (auto& model : host.getModels())
-      mImpl->buildVertexBuffer(model);
+  // Prepared again after every commit, undo and redo: only what changed is
+  // uploaded
+  mImpl->syncVertexBuffer(host);
+  mImpl->syncTextures(host);
 
-    mImpl->mVboBuilder.build();
-    mImpl->buildTextures(host);
-  }
+  // The nodes gathered read the current pose and materials
+  mImpl->mPoseVersions.clear();
+  update(state, _host);
+  mImpl->mChangedMaterials.clear();
 
   for (auto& model : host.getModels())
     gather(state.getBuffers(), model, host);
@@ -148,27 +343,66 @@ struct GCSceneNode : public SceneNode {
               const std::map<std::string, u32>& tm, const lib3d::Material& m,
               const lib3d::Polygon& p, const lib3d::Bone& b,
               const lib3d::Scene& _scn, const lib3d::Model& _mdl,
-              librii::glhelper::ShaderProgram& prog, u32 mi)
+              librii::glhelper::ShaderProgram& prog, u32 mi,
+              const librii::mesh::BoundingVolume& bound, u64 bone_id,
+              const SkeletonPose& pose)
       : mVertexBufferTenant(tenant), mp_id(mi), tex_id_map(tm),
-        mVaoId(v.getGlId()), mat(m), poly(p), bone(b), scn(_scn), mdl(_mdl) {
-    // Calc the bound
-    {
-      auto mdl_mtx = bone.calcSrtMtx(&mdl);
-
-      auto nmax = mdl_mtx * glm::vec4(poly.getBounds().max, 0.0f);
-      auto nmin = mdl_mtx * glm::vec4(poly.getBounds().min, 0.0f);
+        mVaoId(v.getGlId()), mat(m), poly(p), bone(b), scn(_scn), mdl(_mdl),
+        mProgram(prog), mBoneId(bone_id), mTranslucent(m.isXluPass()) {
+    // Without positions, fall back to the stored bounds.
+    mLocalBound = bound.empty() ? poly.getBounds() : AABB{bound.min, bound.max};
+    updateBound(pose);
+    updateState();
+  }
 
-      mBound = {nmin, nmax};
+  const lib3d::Material& getMaterial() const { return mat; }
+  const lib3d::Model& getModel() const { return mdl; }
+
+  // The bones of the node may have moved. Its vertices are placed by the draw
+  // matrices of the matrix primitive: bone space for rigid weights, already
+  // world space for envelopes. The bound holds the mesh under each of them.
+  void updateBound(const SkeletonPose& pose) {
+    const auto* gc_poly = dynamic_cast<const libcube::IndexedPolygon*>(&poly);
+    const auto* gc_mdl = dynamic_cast<const libcube::Model*>(&mdl);
+    std::vector<glm::mat4> mtx;
+    if (gc_poly != nullptr && gc_mdl != nullptr)
+      mtx = gc_poly->getPosMtx(*gc_mdl, mp_id);
+    if (mtx.empty()) {
+      mBound = TransformBound(pose.getWorld(mBoneId), mLocalBound);
+      return;
     }
-
-    //
+    mBound = TransformBound(mtx[0], mLocalBound);
+    for (std::size_t i = 1; i < mtx.size(); ++i)
+      mBound.expandBound(TransformBound(mtx[i], mLocalBound));
+  }
+  // Read again what the material binds, after it was edited. False if the
+  // node now belongs to the other pass: the draw list must be gathered again.
+  bool updateState() {
     mat.setMegaState(mState);
-    mShaderId = prog.getId();
+    mShaderId = mProgram.getId();
+    mSamplersId = hashSamplers(mat, tex_id_map);
+    mPlacementDependent = readsModelMatrix(mat);
+    return mat.isXluPass() == mTranslucent;
   }
 
-  void draw(librii::glhelper::DelegatedUBOBuilder& ubo_builder,
-            u32 mtx_id) final;
+  void bind(librii::gfx::CommandList& commands,
+            librii::glhelper::DelegatedUBOBuilder& ubo_builder, u32 mtx_id,
+            DrawStateCache& cache) final;
+  librii::gfx::DrawCmd getDraw() const final {
+    const auto& range = mVertexBufferTenant.range;
+    return {.count = range.idx_size, .firstIndex = range.idx_ofs};
+  }
   void expandBound(AABB& bound) final { bound.expandBound(mBound); }
+  bool isPlacementDependent() const final { return mPlacementDependent; }
+
+  StateKey getStateKey() const final {
+    return {.program = mShaderId,
+            .material = reinterpret_cast<u64>(&mat),
+            .samplers = mSamplersId};
+  }
+  glm::vec3 getBoundCenter() const final {
+    return (mBound.min + mBound.max) * 0.5f;
+  }
 
   void buildUniformBuffer(librii::glhelper::DelegatedUBOBuilder& ubo_builder,
                           const glm::mat4& model_matrix,
@@ -189,21 +423,89 @@ private:
   const lib3d::Scene& scn;
   const lib3d::Model& mdl;
 
+  // Recompiled in place when the material changes
+  librii::glhelper::ShaderProgram& mProgram;
+  u64 mBoneId;
+  bool mTranslucent;
+
+  // Of the mesh, before the bone transform
+  lib3d::AABB mLocalBound;
   lib3d::AABB mBound;
   librii::gfx::MegaState mState;
   u32 mShaderId = 0;
+  // Materials binding the same textures with the same parameters share this
+  u64 mSamplersId = 0;
+  bool mPlacementDependent = false;
+
+  // Texture matrices other than the standard one read the model matrix
+  static bool readsModelMatrix(const lib3d::Material& mat);
+
+  static u64 hashSamplers(const lib3d::Material& mat,
+                          const std::map<std::string, u32>& tex_id_map);
 };
 
-void GCSceneNode::draw(librii::glhelper::DelegatedUBOBuilder& ubo_builder,
-                       u32 mtx_id) {
-  librii::gl::setGlState(mState);
-  glUseProgram(mShaderId);
-  glBindVertexArray(mVaoId);
-  ubo_builder.use(mtx_id);
-  mat.genSamplUniforms(mShaderId, tex_id_map);
+u64 GCSceneNode::hashSamplers(const lib3d::Material& mat,
+                              const std::map<std::string, u32>& tex_id_map) {
+  const auto* gc_mat = dynamic_cast<const libcube::IGCMaterial*>(&mat);
+  if (gc_mat == nullptr)
+    return reinterpret_cast<u64>(&mat);
+
+  // genSamplUniforms binds a texture per sampler and sets its filter and wrap
+  // modes; nothing else
+  u64 hash = 0;
+  const auto combine = [&](u64 value) {
+    hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+  };
+  const auto& samplers = gc_mat->getMaterialData().samplers;
+  combine(samplers.size());
+  for (const auto& sampler : samplers) {
+    const auto found = tex_id_map.find(sampler->mTexture);
+    combine(found != tex_id_map.end() ? found->second : ~0u);
+    combine(static_cast<u64>(sampler->mMinFilter));
+    combine(static_cast<u64>(sampler->mMagFilter));
+    combine(static_cast<u64>(sampler->mWrapU));
+    combine(static_cast<u64>(sampler->mWrapV));
+  }
+  return hash;
+}
 
-  glDrawElements(GL_TRIANGLES, mVertexBufferTenant.idx_size, GL_UNSIGNED_INT,
-                 reinterpret_cast<void*>(mVertexBufferTenant.idx_ofs * 4));
+bool GCSceneNode::readsModelMatrix(const lib3d::Material& mat) {
+  const auto* gc_mat = dynamic_cast<const libcube::IGCMaterial*>(&mat);
+  if (gc_mat == nullptr)
+    return false;
+  const auto& data = gc_mat->getMaterialData();
+  for (u32 i = 0; i < data.texMatrices.size(); ++i) {
+    if (data.texMatrices[i].method !=
+        libcube::GCMaterialData::CommonMappingMethod::Standard)
+      return true;
+  }
+  return false;
+}
+
+void GCSceneNode::bind(librii::gfx::CommandList& commands,
+                       librii::glhelper::DelegatedUBOBuilder& ubo_builder,
+                       u32 mtx_id, DrawStateCache& cache) {
+  if (!cache.hasMegaState || !(cache.megaState == mState)) {
+    commands.push(librii::gfx::SetMegaStateCmd{mState});
+    cache.megaState = mState;
+    cache.hasMegaState = true;
+    ++cache.stats.stateSwitches;
+  }
+  if (cache.program != mShaderId) {
+    commands.push(librii::gfx::UseProgramCmd{mShaderId});
+    cache.program = mShaderId;
+    ++cache.stats.programSwitches;
+  }
+  if (cache.vertexArray != mVaoId) {
+    commands.push(librii::gfx::BindVertexArrayCmd{mVaoId});
+    cache.vertexArray = mVaoId;
+  }
+  ubo_builder.use(mtx_id, commands);
+  if (cache.samplers != mSamplersId) {
+    mat.genSamplUniforms(commands, tex_id_map);
+    cache.samplers = mSamplersId;
+    ++cache.stats.textureSwitches;
+  }
 }
 
 void GCSceneNode::buildUniformBuffer(
@@ -221,11 +523,14 @@ void pushDisplay(
     const riistudio::lib3d::Bone& pBone, const riistudio::lib3d::Scene& scene,
     const riistudio::lib3d::Model& root, riistudio::lib3d::SceneBuffers& output,
     u32 mp_id, const std::map<std::string, u32>& tex_id_map,
-    librii::glhelper::ShaderProgram& shader) {
+    librii::glhelper::ShaderProgram& shader,
+    const librii::mesh::BoundingVolume& bound, u64 bone_id,
+    const SkeletonPose& pose) {
 
-  auto node =
-      std::make_unique<GCSceneNode>(tenant, vbo_builder, tex_id_map, mat, poly,
-                                    pBone, scene, root, shader, mp_id);
+  auto node = std::make_unique<GCSceneNode>(tenant, vbo_builder, tex_id_map,
+                                            mat, poly, pBone, scene, root,
+                                            shader, mp_id, bound, bone_id,
+                                            pose);
 
   auto& nodebuf = mat.isXluPass() ? output.translucent : output.opaque;
 
@@ -251,14 +556,19 @@ void SceneImpl::gatherBoneRecursive(SceneBuffers& output, u64 boneId,
         reinterpret_cast<const libcube::IndexedPolygon&>(polys[display.polyId]);
 
     if (!mImpl->mMatToShader.contains(mat.getName())) {
-      const auto shader_sources = mat.generateShaders();
-
       mImpl->mMatToShader.emplace(
-          mat.getName(), librii::glhelper::ShaderProgram{
-                             shader_sources.first, shader_sources.second});
+          std::piecewise_construct, std::forward_as_tuple(mat.getName()),
+          std::forward_as_tuple(mat, mImpl->mChangedMaterials,
+                                mImpl->mHeadless));
       mImpl->mMatToShader.at(mat.getName()).attachToMaterial(mat);
     }
 
+    // Cached by the polygon; recomputed only after an edit
+    const auto* gc_model = dynamic_cast<const libcube::Model*>(&root);
+    assert(gc_model != nullptr);
+    const auto& bounds = poly.getMeshBounds(*gc_model);
+    const auto& pose = libcube::GetSkeletonPose(*gc_model);
+
     for (u32 i = 0; i < poly.getMeshData().mMatrixPrimitives.size(); ++i) {
       if (!poly.isVisible())
         continue;
@@ -266,7 +576,8 @@ void SceneImpl::gatherBoneRecursive(SceneBuffers& output, u64 boneId,
       MeshName mesh_name{.string = poly.getName(), .mprim_index = i};
       pushDisplay(mImpl->mTenants.at(mesh_name), mImpl->mVboBuilder, mat, poly,
                   pBone, scene, root, output, i, mImpl->mTexIdMap,
-                  mImpl->mMatToShader.at(mat.getName()).getProgram());
+                  mImpl->mMatToShader.at(mat.getName()).getProgram(),
+                  bounds.matrixPrimitives[i], boneId, pose);
     }
   }
 
@@ -274,6 +585,54 @@ void SceneImpl::gatherBoneRecursive(SceneBuffers& output, u64 boneId,
     gatherBoneRecursive(output, pBone.getChild(i), root, scene);
 }
 
+void SceneImpl::update(SceneState& state, const kpi::INode& _host) {
+  auto& host = *dynamic_cast<const Scene*>(&_host);
+
+  // Draw nodes read bone matrices from the pose; compute them once here
+  std::unordered_map<const Model*, const SkeletonPose*> moved;
+  for (auto& model : host.getModels()) {
+    const auto* gc_model = dynamic_cast<const libcube::Model*>(&model);
+    if (gc_model == nullptr)
+      continue;
+    libcube::UpdateSkeletonPose(*gc_model);
+    const auto& pose = libcube::GetSkeletonPose(*gc_model);
+    auto [it, inserted] =
+        mImpl->mPoseVersions.try_emplace(&model, pose.getVersion());
+    if (!inserted && it->second != pose.getVersion()) {
+      it->second = pose.getVersion();
+      moved.emplace(&model, &pose);
+    }
+  }
+  if (moved.empty() && mImpl->mChangedMaterials.empty())
+    return;
+
+  // Edits in progress, such as a bone or material being dragged, are not
+  // committed until they end. They change neither meshes nor textures, so the
+  // nodes they affect are patched in place.
+  bool bounds_changed = false;
+  bool states_changed = false;
+  state.getBuffers().forEachNode([&](SceneNode& node) {
+    auto* gc_node = dynamic_cast<GCSceneNode*>(&node);
+    if (gc_node == nullptr)
+      return;
+    if (const auto it = moved.find(&gc_node->getModel()); it != moved.end()) {
+      gc_node->updateBound(*it->second);
+      bounds_changed = true;
+    }
+    if (mImpl->mChangedMaterials.contains(&gc_node->getMaterial())) {
+      if (!gc_node->updateState())
+        dirty = true;
+      states_changed = true;
+    }
+  });
+  mImpl->mChangedMaterials.clear();
+
+  if (bounds_changed)
+    state.updateBounds();
+  if (states_changed)
+    state.invalidateRanks();
+}
+
 void SceneImpl::gather(SceneBuffers& output, const lib3d::Model& root,
                        const lib3d::Scene& scene) {
   if (root.getMaterials().empty() || root.getMeshes().empty() ||
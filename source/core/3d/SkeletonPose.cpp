@@ -0,0 +1,143 @@
+#include "SkeletonPose.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIB3D_SSE2
+#endif
+
+namespace riistudio::lib3d {
+
+static_assert(sizeof(glm::mat4) == 64, "Columns are read as packed floats");
+
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b) {
+  glm::mat4 result;
+#ifdef LIB3D_SSE2
+  const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+  const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+  const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+  const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+  for (int i = 0; i < 4; ++i) {
+    // Column i of the result is a's columns weighted by column i of b
+    __m128 col = _mm_mul_ps(a0, _mm_set1_ps(b[i][0]));
+    col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[i][1])));
+    col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[i][2])));
+    col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b[i][3])));
+    _mm_storeu_ps(&result[i][0], col);
+  }
+#else
+  result = a * b;
+#endif
+  return result;
+}
+
+void SkeletonPose::update(kpi::ConstCollectionRange<Bone> bones) {
+  mNumRecomputed = 0;
+
+  bool hierarchy_changed = bones.size() != mBones.size();
+  if (hierarchy_changed)
+    mBones.resize(bones.size());
+
+  for (std::size_t i = 0; i < mBones.size(); ++i) {
+    auto& entry = mBones[i];
+    const auto& bone = bones[i];
+
+    const s64 parent = bone.getBoneParent();
+    if (parent != entry.parent) {
+      entry.parent = parent;
+      entry.dirty = true;
+      hierarchy_changed = true;
+    }
+    const SRT3 srt = bone.getSRT();
+    if (entry.dirty || srt != entry.srt) {
+      entry.srt = srt;
+      entry.local = bone.calcSrtMtx(srt);
+      entry.dirty = true;
+    }
+  }
+
+  if (hierarchy_changed)
+    buildOrder();
+
+  for (const u32 i : mOrder) {
+    auto& entry = mBones[i];
+    if (entry.worldParent >= 0) {
+      const auto& parent = mBones[entry.worldParent];
+      // The parent was visited first: its flag is still set if it moved
+      if (!entry.dirty && !parent.dirty)
+        continue;
+      entry.world = MultiplyMatrices(parent.world, entry.local);
+    } else {
+      if (!entry.dirty)
+        continue;
+      entry.world = entry.local;
+    }
+    entry.dirty = true;
+    ++mNumRecomputed;
+  }
+
+  for (auto& entry : mBones)
+    entry.dirty = false;
+  if (mNumRecomputed != 0)
+    ++mVersion;
+}
+
+void SkeletonPose::buildOrder() {
+  const std::size_t n = mBones.size();
+
+  // Children by parent, as an adjacency list in one array
+  std::vector<u32> first(n + 1, 0);
+  std::vector<u32> children(n);
+  const auto parent_of = [&](std::size_t i) -> s64 {
+    const s64 parent = mBones[i].parent;
+    return parent >= 0 && parent < static_cast<s64>(n) &&
+                   parent != static_cast<s64>(i)
+               ? parent
+               : -1;
+  };
+  for (std::size_t i = 0; i < n; ++i) {
+    if (const s64 parent = parent_of(i); parent >= 0)
+      ++first[parent + 1];
+  }
+  for (std::size_t i = 0; i < n; ++i)
+    first[i + 1] += first[i];
+  {
+    std::vector<u32> cursor(first.begin(), first.end() - 1);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (const s64 parent = parent_of(i); parent >= 0)
+        children[cursor[parent]++] = static_cast<u32>(i);
+    }
+  }
+
+  mOrder.clear();
+  mOrder.reserve(n);
+  std::vector<bool> visited(n, false);
+  const auto visit_from = [&](u32 root) {
+    std::size_t head = mOrder.size();
+    visited[root] = true;
+    mOrder.push_back(root);
+    for (; head < mOrder.size(); ++head) {
+      const u32 bone = mOrder[head];
+      for (u32 c = first[bone]; c < first[bone + 1]; ++c) {
+        if (visited[children[c]])
+          continue;
+        visited[children[c]] = true;
+        mOrder.push_back(children[c]);
+      }
+    }
+  };
+  for (std::size_t i = 0; i < n; ++i) {
+    mBones[i].worldParent = parent_of(i);
+    if (mBones[i].worldParent < 0)
+      visit_from(static_cast<u32>(i));
+  }
+  // Bones in a parent cycle are unreachable from any root. Bone::calcSrtMtx
+  // would not terminate on them; here the cycle is cut at its first bone.
+  for (std::size_t i = 0; i < n; ++i) {
+    if (!visited[i]) {
+      mBones[i].worldParent = -1;
+      visit_from(static_cast<u32>(i));
+    }
+  }
+}
+
+} // namespace riistudio::lib3d
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Bone.hpp"
+#include <core/common.h>
+#include <core/kpi/Node2.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+namespace riistudio::lib3d {
+
+//! @brief `a * b`, one column of the result per four SIMD multiply-adds.
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b);
+
+//! @brief World matrices of every bone of a skeleton.
+//!
+//! Equivalent to calling Bone::calcSrtMtx on each bone, but the whole
+//! hierarchy is computed in one pass, parents before children, so each local
+//! matrix is built once and each world matrix is one multiply.
+//!
+//! `update` compares every bone against the SRT and parent it last saw and
+//! marks changed bones dirty. Only dirty bones and their descendants are
+//! recomputed; an unchanged skeleton costs a comparison per bone. As edits
+//! reach bones through setters and history rollback alike, the comparison is
+//! what catches them all.
+//!
+class SkeletonPose {
+public:
+  //! Bring the pose up to date with `bones`.
+  void update(kpi::ConstCollectionRange<Bone> bones);
+
+  //! The world matrix of a bone; identity if out of range.
+  const glm::mat4& getWorld(std::size_t bone) const {
+    static const glm::mat4 identity{1.0f};
+    return bone < mBones.size() ? mBones[bone].world : identity;
+  }
+
+  std::size_t size() const { return mBones.size(); }
+
+  //! World matrices recomputed by the last update.
+  u32 getNumRecomputed() const { return mNumRecomputed; }
+
+  //! Changes whenever an update recomputes a world matrix, so that users of
+  //! the pose can tell it moved, whoever updated it.
+  u32 getVersion() const { return mVersion; }
+
+  // A cache: copies of a model compare equal regardless
+  bool operator==(const SkeletonPose&) const { return true; }
+
+private:
+  struct Entry {
+    SRT3 srt{};
+    s64 parent = -1;
+    //! Parent the world matrix is relative to: `parent` if valid.
+    s64 worldParent = -1;
+    glm::mat4 local{1.0f};
+    glm::mat4 world{1.0f};
+    bool dirty = true;
+  };
+  std::vector<Entry> mBones;
+  //! Topological order: each bone after its parent.
+  std::vector<u32> mOrder;
+  u32 mNumRecomputed = 0;
+  u32 mVersion = 0;
+
+  void buildOrder();
+};
+
+} // namespace riistudio::lib3d
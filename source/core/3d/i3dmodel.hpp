@@ -22,8 +22,18 @@ struct IDrawable {
   //! Prepare a scene based on the resource data.
   virtual void prepare(SceneState& state, const kpi::INode& root) = 0;
 
+  //! Bring state derived from the resource data, such as bone matrices, up to
+  //! date, and patch the prepared scene with edits that are not committed yet
+  //! (e.g. a bone or material being dragged). Called every frame before
+  //! uniforms are built. Sets `dirty` if an edit cannot be patched in.
+  virtual void update(SceneState& state, const kpi::INode& root) {}
+
   bool poisoned = false;
   bool reinit = false;
+  //! The scene state prepared from the resource is out of date. Renderers
+  //! retain their draw list between frames and only prepare it again once this
+  //! is set: on commit, undo and redo, and by update.
+  bool dirty = true;
 };
 
 struct SceneNode;
@@ -34,6 +44,7 @@ struct SceneImpl : public IDrawable {
   SceneImpl();
 
   void prepare(SceneState& state, const kpi::INode& host) override;
+  void update(SceneState& state, const kpi::INode& host) override;
 
   void gatherBoneRecursive(SceneBuffers& output, u64 boneId,
                            const lib3d::Model& root, const lib3d::Scene& scn);
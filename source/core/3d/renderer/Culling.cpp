@@ -0,0 +1,194 @@
+#include "Culling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIB3D_SSE2
+#endif
+
+namespace riistudio::lib3d {
+
+Frustum Frustum::fromMatrix(const glm::mat4& clip) {
+  const auto row = [&](int i) {
+    return glm::vec4{clip[0][i], clip[1][i], clip[2][i], clip[3][i]};
+  };
+  const std::array<glm::vec4, 6> planes{
+      row(3) + row(0), row(3) - row(0), // Left, right
+      row(3) + row(1), row(3) - row(1), // Bottom, top
+      row(3) + row(2), row(3) - row(2), // Near, far
+  };
+
+  Frustum result;
+  for (std::size_t i = 0; i < 8; ++i) {
+    const glm::vec4 p = i < planes.size() ? planes[i] : glm::vec4{0, 0, 0, 1};
+    result.nx[i] = p.x;
+    result.ny[i] = p.y;
+    result.nz[i] = p.z;
+    result.d[i] = p.w;
+    result.ax[i] = std::abs(p.x);
+    result.ay[i] = std::abs(p.y);
+    result.az[i] = std::abs(p.z);
+  }
+  return result;
+}
+
+Frustum::Containment Frustum::classify(const AABB& box) const {
+  const glm::vec3 c = (box.min + box.max) * 0.5f;
+  const glm::vec3 e = (box.max - box.min) * 0.5f;
+
+  // Per plane: the signed distance of the center, and the extent of the box
+  // along the normal. Outside if the box is entirely behind any plane.
+#ifdef LIB3D_SSE2
+  const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y),
+               cz = _mm_set1_ps(c.z);
+  const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y),
+               ez = _mm_set1_ps(e.z);
+  int straddling = 0;
+  for (std::size_t i = 0; i < 8; i += 4) {
+    __m128 dist = _mm_load_ps(&d[i]);
+    dist = _mm_add_ps(dist, _mm_mul_ps(_mm_load_ps(&nx[i]), cx));
+    dist = _mm_add_ps(dist, _mm_mul_ps(_mm_load_ps(&ny[i]), cy));
+    dist = _mm_add_ps(dist, _mm_mul_ps(_mm_load_ps(&nz[i]), cz));
+    __m128 radius = _mm_mul_ps(_mm_load_ps(&ax[i]), ex);
+    radius = _mm_add_ps(radius, _mm_mul_ps(_mm_load_ps(&ay[i]), ey));
+    radius = _mm_add_ps(radius, _mm_mul_ps(_mm_load_ps(&az[i]), ez));
+
+    const __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), radius);
+    if (_mm_movemask_ps(_mm_cmplt_ps(dist, neg_radius)) != 0)
+      return Containment::Outside;
+    straddling |= _mm_movemask_ps(_mm_cmplt_ps(dist, radius));
+  }
+#else
+  bool straddling = false;
+  for (std::size_t i = 0; i < 8; ++i) {
+    const f32 dist = nx[i] * c.x + ny[i] * c.y + nz[i] * c.z + d[i];
+    const f32 radius = ax[i] * e.x + ay[i] * e.y + az[i] * e.z;
+    if (dist < -radius)
+      return Containment::Outside;
+    straddling |= dist < radius;
+  }
+#endif
+  return straddling ? Containment::Intersects : Containment::Inside;
+}
+
+AABB TransformBound(const glm::mat4& mtx, const AABB& box) {
+  const glm::vec3 center = (box.min + box.max) * 0.5f;
+  const glm::vec3 extent = (box.max - box.min) * 0.5f;
+  const glm::vec3 new_center = mtx * glm::vec4(center, 1.0f);
+  const glm::mat3 abs_mtx{glm::abs(glm::vec3(mtx[0])),
+                          glm::abs(glm::vec3(mtx[1])),
+                          glm::abs(glm::vec3(mtx[2]))};
+  const glm::vec3 new_extent = abs_mtx * extent;
+  return {new_center - new_extent, new_center + new_extent};
+}
+
+static constexpr u32 MaxLeafSize = 4;
+
+void Bvh::build(std::span<const AABB> boxes) {
+  mNodes.clear();
+  mItems.resize(boxes.size());
+  for (u32 i = 0; i < mItems.size(); ++i)
+    mItems[i] = i;
+  mItemBoxes.clear();
+  if (boxes.empty())
+    return;
+
+  mNodes.reserve(2 * boxes.size() / MaxLeafSize + 1);
+  buildRecursive(boxes, 0, static_cast<u32>(boxes.size()));
+
+  mItemBoxes.reserve(mItems.size());
+  for (const u32 item : mItems)
+    mItemBoxes.push_back(boxes[item]);
+}
+
+void Bvh::refit(std::span<const AABB> boxes) {
+  assert(boxes.size() == mItems.size());
+  for (u32 i = 0; i < mItems.size(); ++i)
+    mItemBoxes[i] = boxes[mItems[i]];
+
+  // Children follow their parent: walking backwards visits them first
+  for (u32 index = static_cast<u32>(mNodes.size()); index-- > 0;) {
+    auto& node = mNodes[index];
+    if (node.right != 0) {
+      node.box = mNodes[index + 1].box;
+      node.box.expandBound(mNodes[node.right].box);
+      continue;
+    }
+    node.box = {glm::vec3{std::numeric_limits<f32>::max()},
+                glm::vec3{std::numeric_limits<f32>::lowest()}};
+    for (u32 i = node.begin; i < node.end; ++i)
+      node.box.expandBound(mItemBoxes[i]);
+  }
+}
+
+u32 Bvh::buildRecursive(std::span<const AABB> boxes, u32 begin, u32 end) {
+  const u32 index = static_cast<u32>(mNodes.size());
+  mNodes.push_back({.begin = begin, .end = end});
+
+  AABB box{glm::vec3{std::numeric_limits<f32>::max()},
+           glm::vec3{std::numeric_limits<f32>::lowest()}};
+  AABB centers = box;
+  for (u32 i = begin; i < end; ++i) {
+    const auto& item = boxes[mItems[i]];
+    box.expandBound(item);
+    const glm::vec3 center = (item.min + item.max) * 0.5f;
+    centers.expandBound({center, center});
+  }
+  mNodes[index].box = box;
+
+  if (end - begin <= MaxLeafSize)
+    return index;
+
+  const glm::vec3 spread = centers.max - centers.min;
+  const int axis = spread.x >= spread.y && spread.x >= spread.z ? 0
+                   : spread.y >= spread.z                       ? 1
+                                                                : 2;
+  // Partitioning keeps the items of every subtree contiguous
+  const u32 mid = begin + (end - begin) / 2;
+  std::nth_element(mItems.begin() + begin, mItems.begin() + mid,
+                   mItems.begin() + end, [&](u32 lhs, u32 rhs) {
+                     return boxes[lhs].min[axis] + boxes[lhs].max[axis] <
+                            boxes[rhs].min[axis] + boxes[rhs].max[axis];
+                   });
+
+  buildRecursive(boxes, begin, mid);
+  mNodes[index].right = buildRecursive(boxes, mid, end);
+  return index;
+}
+
+void Bvh::query(const Frustum& frustum, std::vector<u32>& out) const {
+  if (mNodes.empty())
+    return;
+
+  // Median splits bound the depth by log2 of the item count
+  std::array<u32, 64> stack;
+  std::size_t top = 0;
+  stack[top++] = 0;
+  while (top != 0) {
+    const u32 index = stack[--top];
+    const auto& node = mNodes[index];
+    const auto containment = frustum.classify(node.box);
+    if (containment == Frustum::Containment::Outside)
+      continue;
+    if (containment == Frustum::Containment::Inside) {
+      out.insert(out.end(), mItems.begin() + node.begin,
+                 mItems.begin() + node.end);
+      continue;
+    }
+    if (node.right == 0) {
+      for (u32 i = node.begin; i < node.end; ++i) {
+        if (frustum.classify(mItemBoxes[i]) != Frustum::Containment::Outside)
+          out.push_back(mItems[i]);
+      }
+      continue;
+    }
+    stack[top++] = node.right;
+    stack[top++] = index + 1;
+  }
+}
+
+} // namespace riistudio::lib3d
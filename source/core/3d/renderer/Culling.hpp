@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <core/3d/aabb.hpp>
+#include <core/common.h>
+#include <glm/mat4x4.hpp>
+#include <span>
+#include <vector>
+
+namespace riistudio::lib3d {
+
+// Planes of a view frustum, facing inward
+struct Frustum {
+  // Extract the planes of a clip matrix (projection * view), OpenGL depth
+  // range (Gribb-Hartmann)
+  static Frustum fromMatrix(const glm::mat4& clip);
+
+  enum class Containment { Outside, Intersects, Inside };
+
+  // Classify a box against every plane at once: four planes per SIMD batch.
+  //
+  // Conservative: a box outside the frustum near an edge may be reported as
+  // intersecting it.
+  Containment classify(const AABB& box) const;
+
+  // Six planes padded to eight with a plane everything is in front of.
+  // Structure of arrays: one batch of four planes is a register per component.
+  alignas(16) std::array<f32, 8> nx, ny, nz, d;
+  // |nx|, |ny|, |nz|, for the projected radius of a box
+  alignas(16) std::array<f32, 8> ax, ay, az;
+};
+
+// Box enclosing `box` transformed by `mtx` (Arvo)
+AABB TransformBound(const glm::mat4& mtx, const AABB& box);
+
+// Bounding volume hierarchy over a set of boxes
+class Bvh {
+public:
+  // Build over `boxes`, median split on the widest axis of the box centers.
+  // Items are indices into `boxes`.
+  void build(std::span<const AABB> boxes);
+
+  // Update the boxes of the items of the last build, keeping the hierarchy.
+  // Much cheaper than building again, for items that move a little (e.g. as a
+  // bone is dragged), but the tree gets looser the further they move.
+  void refit(std::span<const AABB> boxes);
+
+  // Append the items whose boxes may intersect the frustum. Subtrees entirely
+  // inside are accepted without testing their items.
+  void query(const Frustum& frustum, std::vector<u32>& out) const;
+
+  bool empty() const { return mNodes.empty(); }
+  // Box enclosing every item
+  const AABB& getBound() const { return mNodes.front().box; }
+
+private:
+  struct Node {
+    AABB box;
+    // The items of the subtree: [begin, end) of mItems
+    u32 begin = 0;
+    u32 end = 0;
+    // Interior nodes: the left child is the next node, the right child is
+    // here. Zero for leaves.
+    u32 right = 0;
+  };
+  std::vector<Node> mNodes;
+  std::vector<u32> mItems;
+  // Box of each item, in the order of mItems
+  std::vector<AABB> mItemBoxes;
+
+  u32 buildRecursive(std::span<const AABB> boxes, u32 begin, u32 end);
+};
+
+} // namespace riistudio::lib3d
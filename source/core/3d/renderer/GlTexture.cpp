@@ -1,21 +1,38 @@
 #include "GlTexture.hpp"
 #include <array>
 #include <core/3d/gl.hpp>
+#include <librii/glhelper/TextureState.hpp>
 #include <vector>
 
 namespace riistudio::lib3d {
 
 GlTexture::~GlTexture() {
-  if (mGlId != ~0)
+  if (mGlId != ~0) {
     glDeleteTextures(1, &mGlId);
+    librii::glhelper::TextureState::forget(mGlId);
+  }
 }
 
 std::optional<GlTexture> GlTexture::makeTexture(const lib3d::Texture& tex) {
-  static std::vector<u8> data(1024 * 1024 * 4 * 2);
-
   u32 gl_id;
   glGenTextures(1, &gl_id);
+  upload(gl_id, tex);
+
+  return GlTexture{gl_id};
+}
+
+void GlTexture::update(const lib3d::Texture& tex) {
+  assert(mGlId != ~0);
+  upload(mGlId, tex);
+}
+
+void GlTexture::upload(u32 gl_id, const lib3d::Texture& tex) {
+  static std::vector<u8> data(1024 * 1024 * 4 * 2);
+
   glBindTexture(GL_TEXTURE_2D, gl_id);
+  // Bound to whichever unit is active, with fresh parameters
+  librii::glhelper::TextureState::invalidateBindings();
+  librii::glhelper::TextureState::forget(gl_id);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                   GL_NEAREST_MIPMAP_NEAREST);
@@ -33,8 +50,6 @@ std::optional<GlTexture> GlTexture::makeTexture(const lib3d::Texture& tex) {
                  data.data() + slide);
     slide += (tex.getWidth() >> i) * (tex.getHeight() >> i) * 4;
   }
-
-  return GlTexture{gl_id};
 }
 
 } // namespace riistudio::lib3d
@@ -20,11 +20,17 @@ public:
 
   u32 getGlId() const { return mGlId; }
 
+  // Upload the image of `tex` again, keeping the texture object
+  void update(const lib3d::Texture& tex);
+
 private:
   u32 mGlId;
 
   GlTexture(u32 gl_id) : mGlId(gl_id) {}
 
+  // Bind `gl_id` and upload `tex` to it, with fresh parameters
+  static void upload(u32 gl_id, const lib3d::Texture& tex);
+
 public:
   static std::optional<GlTexture> makeTexture(const lib3d::Texture& tex);
 };
@@ -2,42 +2,265 @@
 #define NOMINMAX
 #endif
 #include "SceneState.hpp"
-#include <core/3d/gl.hpp>
+#include <algorithm>
+#include <cstring>
+#include <librii/gl/Compiler.hpp> // InstanceParams
+#include <limits>
 #include <plugins/j3d/Shape.hpp> // Hack
+#include <unordered_map>
 #include <vendor/glm/matrix.hpp>
 
 namespace riistudio::lib3d {
 
+void SceneState::setInstances(std::span<const glm::mat4> matrices) {
+  mInstances.assign(matrices.begin(), matrices.end());
+  mBvhItems.clear();
+}
+
 AABB SceneState::computeBounds() {
   AABB bound;
   // TODO
   bound.min = {0.0f, 0.0f, 0.0f};
   bound.max = {0.0f, 0.0f, 0.0f};
 
-  mTree.forEachNode([&](SceneNode& node) { node.expandBound(bound); });
+  // The root of the hierarchy encloses every node
+  buildBvh();
+  if (!mBvh.empty())
+    bound.expandBound(mBvh.getBound());
 
   return bound;
 }
 
-void SceneState::buildUniformBuffers(const glm::mat4& view,
-                                     const glm::mat4& proj) {
+AABB SceneState::getItemBound(const BvhItem& item) const {
+  AABB box{glm::vec3{std::numeric_limits<f32>::max()},
+           glm::vec3{std::numeric_limits<f32>::lowest()}};
+  item.node->expandBound(box);
+  return mInstances.empty() ? box
+                            : TransformBound(mInstances[item.instance], box);
+}
+
+void SceneState::buildBvh() {
+  if (!mBvhItems.empty())
+    return;
+
+  mTree.forEachNode([&](SceneNode& node) {
+    if (mInstances.empty()) {
+      mBvhItems.push_back({&node, 0});
+      return;
+    }
+    for (u32 i = 0; i < mInstances.size(); ++i)
+      mBvhItems.push_back({&node, i});
+  });
+  std::vector<AABB> boxes;
+  boxes.reserve(mBvhItems.size());
+  for (const auto& item : mBvhItems)
+    boxes.push_back(getItemBound(item));
+  mBvh.build(boxes);
+}
+
+void SceneState::updateBounds() {
+  // Otherwise built from the current bounds on first use
+  if (mBvhItems.empty())
+    return;
+
+  std::vector<AABB> boxes;
+  boxes.reserve(mBvhItems.size());
+  for (const auto& item : mBvhItems)
+    boxes.push_back(getItemBound(item));
+  mBvh.refit(boxes);
+}
+
+void SceneState::cullNodes(const glm::mat4& proj, const glm::mat4& view) {
+  buildBvh();
+
+  mVisible.clear();
+  mBvh.query(Frustum::fromMatrix(proj * view), mVisible);
+
+  for (const auto& item : mBvhItems) {
+    item.node->culled = true;
+    item.node->visibleInstances.clear();
+  }
+  for (const u32 index : mVisible) {
+    const auto& item = mBvhItems[index];
+    item.node->culled = false;
+    item.node->visibleInstances.push_back(item.instance);
+  }
+  mNumCulled = static_cast<u32>(mBvhItems.size() - mVisible.size());
+}
+
+void SceneState::rankNodes() {
+  std::unordered_map<u32, u32> programs;
+  std::unordered_map<u64, u32> materials;
+  std::unordered_map<u64, u32> samplers;
+  const auto rank = [](auto& ranks, auto id) {
+    return ranks.emplace(id, static_cast<u32>(ranks.size())).first->second;
+  };
+
+  const auto rank_buffer = [&](DrawBuffer& buffer, bool translucent) {
+    for (auto& node : buffer) {
+      const auto key = node->getStateKey();
+      node->sortKey =
+          MakeSortKey(translucent, rank(programs, key.program),
+                      rank(materials, key.material),
+                      rank(samplers, key.samplers), 0);
+    }
+  };
+  rank_buffer(mTree.opaque, false);
+  rank_buffer(mTree.translucent, true);
+
+  mRanked = true;
+}
+
+void SceneState::sortNodes(const glm::mat4& view) {
+  if (!mRanked)
+    rankNodes();
+
+  mTree.forEachNode([&](SceneNode& node) {
+    // The camera looks down -Z
+    const glm::vec4 center{node.getBoundCenter(), 1.0f};
+    if (mInstances.empty()) {
+      node.depth = -(view * center).z;
+    } else {
+      // The nearest placement
+      node.depth = std::numeric_limits<f32>::max();
+      for (const u32 i : node.visibleInstances)
+        node.depth = std::min(node.depth, -(view * (mInstances[i] * center)).z);
+      if (node.visibleInstances.empty())
+        node.depth = 0.0f;
+    }
+    node.sortKey = (node.sortKey & ~static_cast<u64>(0xFFFF)) |
+                   QuantizeSortDepth(node.depth);
+  });
+
+  mTree.opaque.keySort();
+  mTree.translucent.zSort();
+}
+
+void SceneState::buildUniformBuffers(const glm::mat4& proj,
+                                     const glm::mat4& view) {
+  cullNodes(proj, view);
+  // Uniforms are indexed by draw order
+  sortNodes(view);
+
   mUboBuilder.clear();
 
   const glm::mat4 mdl{1.0f};
 
   mTree.forEachNode([&](SceneNode& node) {
-    node.buildUniformBuffer(mUboBuilder, mdl, view, proj);
+    if (node.culled)
+      return;
+    if (mInstances.empty() || !node.isPlacementDependent()) {
+      node.buildUniformBuffer(mUboBuilder, mdl, proj, view);
+      return;
+    }
+    for (const u32 i : node.visibleInstances)
+      node.buildUniformBuffer(mUboBuilder, mInstances[i], proj, view);
   });
 }
 
-void SceneState::draw() {
-  mUboBuilder.submit();
+void SceneState::buildInstances() {
+  using librii::gl::InstanceParams;
+
+  mInstanceData.clear();
+  mInstanceBatches.clear();
+  mNodeBatches.clear();
+
+  const auto push_batch = [&](std::span<const u32> instances) {
+    // Each batch is bound at its own range
+    const u32 offset = mUboBuilder.roundUniformUp(mInstanceData.size());
+    mInstanceData.resize(offset + instances.size() * sizeof(glm::mat3x4));
+    auto* out = reinterpret_cast<glm::mat3x4*>(mInstanceData.data() + offset);
+    for (const u32 i : instances)
+      *out++ = glm::mat3x4(glm::transpose(mInstances[i]));
+    mInstanceBatches.push_back(
+        {.offset = offset, .count = static_cast<u32>(instances.size())});
+  };
 
+  if (mInstances.empty()) {
+    // Every node binds the one identity
+    const auto identity = glm::mat3x4(1.0f);
+    mInstanceData.resize(sizeof(identity));
+    memcpy(mInstanceData.data(), &identity, sizeof(identity));
+  }
+  mTree.forEachNode([&](SceneNode& node) {
+    if (node.culled)
+      return;
+    mNodeBatches.push_back(static_cast<u32>(mInstanceBatches.size()));
+    if (mInstances.empty()) {
+      mInstanceBatches.push_back({.offset = 0, .count = 1});
+      return;
+    }
+    std::span<const u32> instances = node.visibleInstances;
+    const std::size_t max_count =
+        node.isPlacementDependent() ? 1 : librii::gl::MaxInstances;
+    while (!instances.empty()) {
+      const auto count = std::min(instances.size(), max_count);
+      push_batch(instances.first(count));
+      instances = instances.subspan(count);
+    }
+  });
+  mNodeBatches.push_back(static_cast<u32>(mInstanceBatches.size()));
+
+  // A batch binds a whole block, whatever its count
+  const u32 size = static_cast<u32>(mInstanceData.size());
+  const u32 required = size + sizeof(InstanceParams);
+  if (required > mInstanceCapacity) {
+    mInstanceCapacity = mUboBuilder.roundUniformUp(required + required / 2);
+    mCommands.push(librii::gfx::ReserveUniformsCmd{
+        .size = mInstanceCapacity,
+        .buffer = librii::gfx::UniformBuffer::Instance});
+    mInstanceUploaded.clear();
+  }
+  // Placements rarely change, and culling changes slowly
+  if (mInstanceUploaded != mInstanceData) {
+    mCommands.uploadUniforms(0, mInstanceData,
+                             librii::gfx::UniformBuffer::Instance);
+    mInstanceUploaded = mInstanceData;
+  }
+}
+
+void SceneState::draw(librii::gfx::CommandExecutor& executor) {
+  mCommands.clear();
+  mUboBuilder.submit(mCommands);
+  buildInstances();
+
+  DrawStateCache cache;
   u32 i = 0;
-  mTree.forEachNode([&](SceneNode& node) { node.draw(mUboBuilder, i++); });
+  // Uniforms are built per draw of a node placed separately
+  u32 uniforms = 0;
+  mTree.forEachNode([&](SceneNode& node) {
+    if (node.culled)
+      return;
+    const bool per_placement =
+        !mInstances.empty() && node.isPlacementDependent();
+    if (!per_placement)
+      node.bind(mCommands, mUboBuilder, uniforms++, cache);
+
+    auto draw = node.getDraw();
+    for (u32 b = mNodeBatches[i]; b < mNodeBatches[i + 1]; ++b) {
+      if (per_placement)
+        node.bind(mCommands, mUboBuilder, uniforms++, cache);
+      const auto& batch = mInstanceBatches[b];
+      if (cache.instanceOffset != batch.offset) {
+        mCommands.push(librii::gfx::BindUniformsCmd{
+            .binding = 3,
+            .offset = batch.offset,
+            .size = sizeof(librii::gl::InstanceParams),
+            .buffer = librii::gfx::UniformBuffer::Instance});
+        cache.instanceOffset = batch.offset;
+      }
+      draw.instances = batch.count;
+      mCommands.push(draw);
+      ++cache.stats.draws;
+      cache.stats.instances += batch.count;
+    }
+    ++i;
+  });
+  mStats = cache.stats;
+  mStats.culled = mNumCulled;
 
-  glBindVertexArray(0);
-  glUseProgram(0);
+  mCommands.push(librii::gfx::UnbindCmd{});
+  executor.execute(mCommands);
 }
 
 } // namespace riistudio::lib3d
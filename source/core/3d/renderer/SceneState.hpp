@@ -1,10 +1,13 @@
 #pragma once
 
 #include <core/3d/aabb.hpp>               // AABB
+#include <core/3d/renderer/Culling.hpp>   // Bvh
 #include <core/3d/renderer/GlTexture.hpp> // GlTexture
 #include <core/3d/renderer/SceneTree.hpp> // SceneBuffers
+#include <librii/gfx/Commands.hpp>        // CommandList
 #include <librii/glhelper/UBOBuilder.hpp> // DelegatedUBOBuilder
 #include <librii/glhelper/VBOBuilder.hpp> // VBOBuilder
+#include <span>                           // std::span
 
 namespace riistudio::lib3d {
 
@@ -13,14 +16,32 @@ public:
   SceneState() = default;
   ~SceneState() = default;
 
-  // Compute the composite bounding box (in model space)
+  // Prepare no GPU resources: drawables keep their data on the CPU and use
+  // placeholder IDs. For recording frames without a context, to be executed by
+  // a null executor. Set before the first prepare.
+  void setHeadless(bool headless) { mHeadless = headless; }
+  bool isHeadless() const { return mHeadless; }
+
+  // Draw the scene at each of these placements (model matrices): e.g. an object
+  // at every course position using it. A node is drawn at all its visible
+  // placements at once: one instanced draw per librii::gl::MaxInstances.
+  // Nodes whose uniforms depend on the placement are drawn once per placement
+  // (see SceneNode::isPlacementDependent). Empty: once, untransformed.
+  void setInstances(std::span<const glm::mat4> matrices);
+
+  // Compute the composite bounding box (in model space, enclosing every
+  // placement)
   AABB computeBounds();
 
-  // Build the UBO. Typically called every frame.
-  void buildUniformBuffers(const glm::mat4& view, const glm::mat4& proj);
+  // Cull and sort the draws and build the UBO. Typically called every frame.
+  void buildUniformBuffers(const glm::mat4& proj, const glm::mat4& view);
 
-  // Draw the model to the screen. You'll want to clear it first.
-  void draw();
+  // Record the draws of the visible nodes and execute them. With a GL
+  // executor, you'll want to clear the screen first.
+  void draw(librii::gfx::CommandExecutor& executor);
+
+  // Recorded by the last draw
+  const librii::gfx::CommandList& getCommands() const { return mCommands; }
 
   // Direct access to attached renderables.
   SceneBuffers& getBuffers() { return mTree; }
@@ -28,12 +49,71 @@ public:
   void invalidate() {
     mTree.opaque.nodes.clear();
     mTree.translucent.nodes.clear();
+    mRanked = false;
+    mBvhItems.clear();
+  }
+  // The bounds of attached nodes moved (e.g. with the pose): refit the BVH to
+  // them, rather than build it again
+  void updateBounds();
+  // What attached nodes bind changed: group them again before the next sort
+  void invalidateRanks() { mRanked = false; }
+
+  // State changes made by the last draw
+  const DrawStats& getStats() const { return mStats; }
+  // Uniform traffic of the last buildUniformBuffers
+  const librii::glhelper::DelegatedUBOBuilder::Stats& getUniformStats() const {
+    return mUboBuilder.getStats();
   }
 
 private:
+  // Build the BVH over the node bounds, if the nodes changed since
+  void buildBvh();
+  // Flag the nodes outside the view frustum
+  void cullNodes(const glm::mat4& proj, const glm::mat4& view);
+  // Assign the state bits of the sort keys
+  void rankNodes();
+  // Opaque draws are grouped by state, then front to back; translucent draws
+  // are back to front.
+  void sortNodes(const glm::mat4& view);
+  // Pack the visible placements of the nodes to draw, and record their upload
+  // if they changed
+  void buildInstances();
+
   SceneBuffers mTree;
+  bool mRanked = false;
+  DrawStats mStats;
+
+  Bvh mBvh;
+  // A node at a placement
+  struct BvhItem {
+    SceneNode* node;
+    u32 instance;
+  };
+  AABB getItemBound(const BvhItem& item) const;
+  // Empty if the BVH is out of date
+  std::vector<BvhItem> mBvhItems;
+  std::vector<u32> mVisible;
+  u32 mNumCulled = 0;
+
+  std::vector<glm::mat4> mInstances;
+  // Placements drawn at once: `count` matrices at `offset` of the buffer
+  struct InstanceBatch {
+    u32 offset;
+    u32 count;
+  };
+  std::vector<InstanceBatch> mInstanceBatches;
+  // Batches of each node drawn, in draw order: [mNodeBatches[i],
+  // mNodeBatches[i + 1]) of mInstanceBatches
+  std::vector<u32> mNodeBatches;
+  // The instance buffer contents: this frame's, and as last uploaded
+  std::vector<u8> mInstanceData;
+  std::vector<u8> mInstanceUploaded;
+  u32 mInstanceCapacity = 0;
 
   librii::glhelper::DelegatedUBOBuilder mUboBuilder;
+  // Kept across frames, to reuse the storage
+  librii::gfx::CommandList mCommands;
+  bool mHeadless = false;
 };
 
 } // namespace riistudio::lib3d
@@ -1,6 +1,8 @@
 #include "SceneTree.hpp"
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <core/3d/gl.hpp>
 #include <glm/glm.hpp>
 #include <librii/gl/Compiler.hpp>
@@ -11,6 +13,39 @@
 
 namespace riistudio::lib3d {
 
-	
+u16 QuantizeSortDepth(f32 depth) {
+  // The bits of a non-negative float order as the float does
+  return static_cast<u16>(std::bit_cast<u32>(std::max(depth, 0.0f)) >> 16);
+}
+
+void DrawBuffer::keySort() {
+  const std::size_t n = nodes.size();
+  if (n < 2)
+    return;
+
+  std::vector<std::unique_ptr<SceneNode>> scratch(n);
+  std::array<u32, 257> offsets;
+  for (u32 shift = 0; shift < 64; shift += 8) {
+    offsets.fill(0);
+    for (const auto& node : nodes)
+      ++offsets[((node->sortKey >> shift) & 0xFF) + 1];
+    // Most keys share most digits; skip passes that would not move anything
+    if (std::ranges::find(offsets, static_cast<u32>(n)) != offsets.end())
+      continue;
+    for (std::size_t i = 1; i < offsets.size(); ++i)
+      offsets[i] += offsets[i - 1];
+    for (auto& node : nodes) {
+      const u32 digit = (node->sortKey >> shift) & 0xFF;
+      scratch[offsets[digit]++] = std::move(node);
+    }
+    std::swap(nodes, scratch);
+  }
+}
+
+void DrawBuffer::zSort() {
+  std::ranges::stable_sort(nodes, [](const auto& lhs, const auto& rhs) {
+    return lhs->depth > rhs->depth;
+  });
+}
 
 } // namespace riistudio::lib3d
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <core/3d/i3dmodel.hpp>
+#include <librii/gfx/Commands.hpp>
+#include <librii/gfx/MegaState.hpp>
 #include <librii/glhelper/ShaderCache.hpp>
 #include <map>
 
@@ -12,12 +14,75 @@ enum class RenderPass {
   ID // For selection
 };
 
+// Render state changes made in a frame
+struct DrawStats {
+  // Submitted draws
+  u32 draws = 0;
+  // Instances of the submitted draws
+  u32 instances = 0;
+  // Nodes (at a placement) outside the view, not drawn
+  u32 culled = 0;
+  u32 programSwitches = 0;
+  u32 textureSwitches = 0;
+  u32 stateSwitches = 0;
+};
+
+// The state left bound by the previous draw of a frame. Nodes do not record
+// changes that would not change anything and count those they record.
+struct DrawStateCache {
+  static constexpr u32 Unknown = ~0u;
+
+  u32 program = Unknown;
+  u32 vertexArray = Unknown;
+  // Of the instance placements bound
+  u32 instanceOffset = Unknown;
+  // Sampler configuration; the samplers of a material are bound together
+  u64 samplers = ~0ull;
+  bool hasMegaState = false;
+  librii::gfx::MegaState megaState;
+
+  DrawStats stats;
+};
+
 struct SceneNode {
   virtual ~SceneNode() = default;
 
-  // Draw the node to the screen
-  virtual void draw(librii::glhelper::DelegatedUBOBuilder& ubo_builder,
-                    u32 draw_index) = 0;
+  // Record the commands binding what the node is drawn with. Its instances are
+  // bound and drawn by the SceneState.
+  virtual void bind(librii::gfx::CommandList& commands,
+                    librii::glhelper::DelegatedUBOBuilder& ubo_builder,
+                    u32 draw_index, DrawStateCache& cache) = 0;
+  // Triangles of the node, in the vertex array it binds; one instance
+  virtual librii::gfx::DrawCmd getDraw() const = 0;
+
+  // What the node binds, to group draws with the same state
+  struct StateKey {
+    u32 program = 0;
+    // Opaque identities; only compared for equality
+    u64 material = 0;
+    u64 samplers = 0;
+  };
+  virtual StateKey getStateKey() const { return {}; }
+
+  // The uniforms depend on the placement beyond the instance matrix, as with
+  // environment and projection mapping. Such a node is not instanced: it is
+  // drawn once per placement, each with its own uniforms.
+  virtual bool isPlacementDependent() const { return false; }
+
+  // Center of the bound, for depth sorting
+  //
+  // Note: Model-space
+  virtual glm::vec3 getBoundCenter() const { return glm::vec3{0.0f}; }
+
+  // See MakeSortKey. Maintained by the SceneState.
+  u64 sortKey = 0;
+  // View-space distance of the bound center. Maintained by the SceneState.
+  f32 depth = 0.0f;
+  // Outside the view this frame. Maintained by the SceneState.
+  bool culled = false;
+  // Placements at which the node is visible this frame. Maintained by the
+  // SceneState.
+  std::vector<u32> visibleInstances;
 
   // Expand an AABB with the current bounding box
   //
@@ -34,6 +99,27 @@ struct SceneNode {
                      const glm::mat4& proj_matrix) = 0;
 };
 
+// Sort key of a draw, most significant first:
+//
+// [63]    Pass: opaque before translucent
+// [48:62] Shader program rank
+// [32:47] Material rank
+// [16:31] Sampler configuration rank
+// [0:15]  Depth: the sign, exponent and top mantissa bits of a positive float
+//
+// Ranks are dense IDs of the distinct states in the draw list, so that draws
+// sharing a state sort next to one another.
+constexpr u64 MakeSortKey(bool translucent, u32 program, u32 material,
+                          u32 samplers, u16 depth) {
+  return (static_cast<u64>(translucent) << 63) |
+         (static_cast<u64>(program & 0x7FFF) << 48) |
+         (static_cast<u64>(material & 0xFFFF) << 32) |
+         (static_cast<u64>(samplers & 0xFFFF) << 16) | depth;
+}
+
+// Quantize a view-space distance to the depth bits of a sort key
+u16 QuantizeSortDepth(f32 depth);
+
 struct DrawBuffer {
   std::vector<std::unique_ptr<SceneNode>> nodes;
 
@@ -42,9 +128,11 @@ struct DrawBuffer {
   auto end() { return nodes.end(); }
   auto end() const { return nodes.end(); }
 
-  void zSort() {
-    // FIXME: Implement
-  }
+  // Order by sort key (LSD radix sort; stable)
+  void keySort();
+
+  // Order back to front (stable)
+  void zSort();
 };
 
 struct SceneBuffers {
@@ -6,6 +6,7 @@
 #include <core/common.h>          // u32
 #include <cstddef>                // std::size_t
 #include <llvm/ADT/SmallVector.h> // llvm::SmallVector
+#include <span>                   // std::span
 #include <string_view>            // std::string_view
 #include <type_traits>            // std::is_same_v
 #include <vector>                 // std::vector
@@ -43,6 +44,10 @@ struct ICollection {
   virtual IObject* atObject(std::size_t) = 0;
   virtual const IObject* atObject(std::size_t) const = 0;
   virtual void add() = 0;
+  // Remove the elements at the given (ascending) indices, preserving the order
+  // of the remaining elements. Clears the selection.
+  virtual void erase(std::span<const std::size_t> indices) = 0;
+  void erase(std::size_t index) { erase({&index, 1}); }
 
   std::size_t indexOf(const std::string_view name) const {
     const auto _size = size();
@@ -279,6 +284,8 @@ public:
     return low != nullptr ? reinterpret_cast<T*>(low->at(i)) : nullptr;
   }
   void resize(std::size_t sz) { low->resize(sz); }
+  void erase(std::span<const std::size_t> indices) { low->erase(indices); }
+  void erase(std::size_t index) { low->erase(index); }
   T& add() {
     assert(low != nullptr);
     const auto i = low->size();
@@ -372,6 +379,23 @@ template <typename T> struct CollectionImpl final : public ICollection {
       elem.childOf = parent;
     }
   }
+  void erase(std::span<const std::size_t> indices) override {
+    if (indices.empty())
+      return;
+    // Single compaction pass: each survivor is moved at most once.
+    std::size_t out = indices[0];
+    auto next = indices.begin();
+    for (std::size_t i = indices[0]; i < data.size(); ++i) {
+      if (next != indices.end() && *next == i) {
+        ++next;
+        continue;
+      }
+      data[out++] = std::move(data[i]);
+    }
+    data.erase(data.begin() + out, data.end());
+    state.selectedChildren.clear();
+    state.activeSelectChild = 0;
+  }
   CollectionImpl(INode* _parent) : parent(_parent) {}
   CollectionImpl(const CollectionImpl& rhs)
       : data(rhs.data), parent(rhs.parent) {
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+
+namespace riistudio::util {
+
+//! Hashes with an ADL-visible `hash_value(const T&)` if one exists, otherwise
+//! with std::hash.
+struct DedupHash {
+  template <typename T> std::size_t operator()(const T& x) const {
+    if constexpr (requires { hash_value(x); })
+      return hash_value(x);
+    else
+      return std::hash<T>{}(x);
+  }
+};
+
+//! @brief Hash index over an append-only sequence of entries.
+//!
+//! The entries stay owned by the caller (usually a std::vector that is
+//! serialized as-is); the index only maps hashes to positions. Entries appended
+//! without going through the index are picked up on the next lookup, so it may
+//! be created lazily over an existing buffer.
+//!
+//! `Hash` and `Eq` must agree: entries that compare equal must hash equally.
+//!
+template <typename T, typename Hash = DedupHash,
+          typename Eq = std::equal_to<T>>
+class DedupIndex {
+public:
+  explicit DedupIndex(Hash hash = {}, Eq eq = {})
+      : mHash(std::move(hash)), mEq(std::move(eq)) {}
+
+  //! @brief Position of the first entry equal to `entry`, if any.
+  template <typename Range>
+  std::optional<std::size_t> find(const Range& entries, const T& entry) {
+    sync(entries);
+    std::optional<std::size_t> first;
+    auto [it, end] = mBuckets.equal_range(mHash(entry));
+    for (; it != end; ++it) {
+      if ((!first || it->second < *first) && mEq(entries[it->second], entry))
+        first = it->second;
+    }
+    return first;
+  }
+
+  //! @brief Position of the first entry equal to `entry`, appending it if
+  //! absent.
+  template <typename Range> std::size_t insert(Range& entries, const T& entry) {
+    if (auto found = find(entries, entry))
+      return *found;
+    entries.push_back(entry);
+    sync(entries);
+    return entries.size() - 1;
+  }
+
+  //! @brief Index all entries appended since the last call.
+  template <typename Range> void sync(const Range& entries) {
+    // Entries were removed: start over
+    if (entries.size() < mIndexed)
+      clear();
+    for (; mIndexed < entries.size(); ++mIndexed)
+      mBuckets.emplace(mHash(entries[mIndexed]), mIndexed);
+  }
+
+  void clear() {
+    mBuckets.clear();
+    mIndexed = 0;
+  }
+
+private:
+  Hash mHash;
+  Eq mEq;
+  std::unordered_multimap<std::size_t, std::size_t> mBuckets;
+  std::size_t mIndexed = 0;
+};
+
+} // namespace riistudio::util
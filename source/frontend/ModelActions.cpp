@@ -1,6 +1,8 @@
 #include <core/kpi/ActionMenu.hpp>
 #include <core/util/gui.hpp>
 #include <plugins/gc/Export/Scene.hpp>
+#include <plugins/gc/Export/Simplify.hpp>
+#include <plugins/gc/Export/TextureDedup.hpp>
 
 #include <filesystem>
 
@@ -114,9 +116,61 @@ private:
   std::unique_ptr<frontend::ImporterWindow> mImporter = nullptr;
 };
 
+class SceneTextureActions final
+    : public kpi::ActionMenu<libcube::Model, SceneTextureActions> {
+public:
+  bool _context(libcube::Model& model) {
+    auto* scene = dynamic_cast<libcube::Scene*>(model.childOf);
+    if (scene == nullptr || !ImGui::MenuItem("Deduplicate textures"))
+      return false;
+
+    const auto result = libcube::DeduplicateTextures(*scene);
+    printf("Deduplicate textures: removed %u, remapped %u samplers, saved %u "
+           "bytes\n",
+           result.numRemoved, result.numRemapped,
+           static_cast<u32>(result.bytesSaved));
+    if (result.numRemoved == 0)
+      return false;
+
+    if (auto* drawable = dynamic_cast<lib3d::IDrawable*>(model.childOf);
+        drawable != nullptr) {
+      drawable->reinit = true;
+    }
+    return true;
+  }
+  bool _modal(libcube::Model& model) { return false; }
+};
+
+class PolygonActions final
+    : public kpi::ActionMenu<libcube::IndexedPolygon, PolygonActions> {
+public:
+  bool _context(libcube::IndexedPolygon& poly) {
+    auto* model = dynamic_cast<libcube::Model*>(poly.childOf);
+    if (model == nullptr || !ImGui::MenuItem("Simplify (50%)"))
+      return false;
+
+    const auto result = libcube::SimplifyPolygon(poly, *model);
+    printf("Simplify: %u -> %u triangles\n", result.trianglesBefore,
+           result.trianglesAfter);
+    if (result.trianglesAfter == result.trianglesBefore)
+      return false;
+
+    if (auto* drawable = dynamic_cast<lib3d::IDrawable*>(model->childOf);
+        drawable != nullptr) {
+      drawable->reinit = true;
+    }
+    return true;
+  }
+  bool _modal(libcube::IndexedPolygon& poly) { return false; }
+};
+
 kpi::DecentralizedInstaller
     ModelActionsInstaller([](kpi::ApplicationPlugins& installer) {
       kpi::ActionMenuManager::get().addMenu(std::make_unique<ModelActions>());
+      kpi::ActionMenuManager::get().addMenu(
+          std::make_unique<SceneTextureActions>());
+      kpi::ActionMenuManager::get().addMenu(
+          std::make_unique<PolygonActions>());
     });
 
 } // namespace riistudio::ass
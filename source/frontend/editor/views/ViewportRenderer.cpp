@@ -15,7 +15,7 @@ extern bool gPointerLock;
 namespace riistudio::frontend {
 
 struct RenderTest : public StudioWindow {
-  RenderTest(const kpi::INode& host);
+  RenderTest(const kpi::INode& host, kpi::History& history);
 
 private:
   void draw_() override;
@@ -25,9 +25,11 @@ private:
   Renderer mRenderer;
 };
 
-RenderTest::RenderTest(const kpi::INode& host)
-    : StudioWindow("Viewport"), mRenderer(dynamic_cast<lib3d::IDrawable*>(
-                                    const_cast<kpi::INode*>(&host))) {
+RenderTest::RenderTest(const kpi::INode& host, kpi::History& history)
+    : StudioWindow("Viewport"),
+      mRenderer(
+          dynamic_cast<lib3d::IDrawable*>(const_cast<kpi::INode*>(&host)),
+          history) {
   setWindowFlag(ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_MenuBar);
   setClosable(false);
   mRenderer.prepare(host);
@@ -46,8 +48,9 @@ void RenderTest::draw_() {
   }
 }
 
-std::unique_ptr<StudioWindow> MakeViewportRenderer(const kpi::INode& host) {
-  return std::make_unique<RenderTest>(host);
+std::unique_ptr<StudioWindow> MakeViewportRenderer(const kpi::INode& host,
+                                                   kpi::History& history) {
+  return std::make_unique<RenderTest>(host, history);
 }
 
 } // namespace riistudio::frontend
@@ -17,7 +17,7 @@ auto PolyDataSurface =
           auto draw_p = [&](int i, int j) {
             auto prim = poly.getMeshData().mMatrixPrimitives[i].mPrimitives[j];
             u32 k = 0;
-            for (auto& v : prim.mVertices) {
+            for (const auto& v : prim.mVertices) {
               ImGui::TableNextRow();
 
               riistudio::util::IDScope v_s(k);
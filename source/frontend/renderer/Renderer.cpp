@@ -8,8 +8,11 @@
 
 namespace riistudio::frontend {
 
-Renderer::Renderer(lib3d::IDrawable* root) : mRoot(root) {}
-Renderer::~Renderer() {}
+Renderer::Renderer(lib3d::IDrawable* root, kpi::History& history)
+    : mRoot(root), mHistory(history), mHistoryObserver(*root) {
+  mHistory.addObserver(&mHistoryObserver);
+}
+Renderer::~Renderer() { mHistory.removeObserver(&mHistoryObserver); }
 
 void Renderer::render(u32 width, u32 height, bool& showCursor) {
   // The root may set a flag to signal it is undergoing a mutation and is unsafe
@@ -21,11 +24,16 @@ void Renderer::render(u32 width, u32 height, bool& showCursor) {
   // cache of it.
   if (mRoot->reinit) {
     mRoot->reinit = false;
-    // TODO: Regen VBOs and such
+    // Preparing again uploads the meshes and textures that changed
+    mRoot->dirty = true;
   }
 
-  mSceneState.invalidate();
-  mRoot->prepare(mSceneState, *dynamic_cast<kpi::INode*>(mRoot));
+  // The draw list is retained: an idle frame neither walks the scene nor
+  // allocates nodes. Edits in progress are patched into it.
+  if (!mRoot->dirty)
+    mRoot->update(mSceneState, *dynamic_cast<kpi::INode*>(mRoot));
+  if (mRoot->dirty)
+    prepare(*dynamic_cast<kpi::INode*>(mRoot));
 
   drawMenuBar();
 
@@ -57,7 +65,7 @@ void Renderer::render(u32 width, u32 height, bool& showCursor) {
   mSceneState.buildUniformBuffers(projMtx, viewMtx);
 
   clearGlScreen();
-  mSceneState.draw();
+  mSceneState.draw(mExecutor);
 }
 
 void Renderer::drawMenuBar() {
@@ -72,6 +80,16 @@ void Renderer::drawMenuBar() {
 #ifdef RII_NATIVE_GL_WIREFRAME
       ImGui::Checkbox("Wireframe", &wireframe);
 #endif
+      ImGui::Separator();
+      const auto& stats = mSceneState.getStats();
+      ImGui::Text("Draws: %u (%u culled)", stats.draws, stats.culled);
+      ImGui::Text("Program switches: %u", stats.programSwitches);
+      ImGui::Text("Texture switches: %u", stats.textureSwitches);
+      ImGui::Text("State switches: %u", stats.stateSwitches);
+      const auto& uniforms = mSceneState.getUniformStats();
+      ImGui::Text("Uniforms: %u / %u bytes sent (%u uploads)",
+                  uniforms.bytesUploaded, uniforms.bytesTotal,
+                  uniforms.uploads);
       ImGui::EndMenu();
     }
     // static int combo_choice = 0;
@@ -3,9 +3,11 @@
 #include <core/3d/i3dmodel.hpp>
 #include <core/3d/renderer/SceneState.hpp>
 #include <core/common.h>
+#include <core/kpi/History.hpp>
 #include <core/kpi/Node.hpp>
 #include <frontend/renderer/CameraController.hpp>
 #include <glm/mat4x4.hpp>
+#include <librii/glhelper/GlCommandExecutor.hpp>
 #include <memory>
 
 namespace riistudio::frontend {
@@ -14,11 +16,14 @@ struct SceneState;
 
 class Renderer {
 public:
-  Renderer(lib3d::IDrawable* root);
+  Renderer(lib3d::IDrawable* root, kpi::History& history);
   ~Renderer();
   void render(u32 width, u32 height, bool& hideCursor);
+  //! Rebuild the retained draw list. Frames in between reuse it.
   void prepare(const kpi::INode& host) {
+    mSceneState.invalidate();
     mRoot->prepare(mSceneState, host);
+    mRoot->dirty = false;
   }
 
   Camera& getCamera() { return mCameraController.mCamera; }
@@ -29,10 +34,28 @@ public:
   void clearGlScreen() const;
 
 private:
+  // Marks the root dirty when the document changes. During a rollback, the
+  // nodes of the draw list may reference freed resources.
+  struct HistoryObserver : public kpi::History::Observer {
+    HistoryObserver(lib3d::IDrawable& root) : mRoot(root) {}
+
+    void onCommit() override { mRoot.dirty = true; }
+    void beforeRollback() override { mRoot.poisoned = true; }
+    void afterRollback() override {
+      mRoot.poisoned = false;
+      mRoot.dirty = true;
+    }
+
+    lib3d::IDrawable& mRoot;
+  };
+
   // Scene state
   lib3d::SceneState mSceneState;
+  librii::glhelper::GlCommandExecutor mExecutor;
 
   lib3d::IDrawable* mRoot = nullptr;
+  kpi::History& mHistory;
+  HistoryObserver mHistoryObserver;
   CameraController mCameraController;
   CameraController::ControllerType combo_choice_cam =
       CameraController::ControllerType::WASD_Minecraft;
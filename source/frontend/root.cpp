@@ -14,6 +14,7 @@
 #include <pfd/portable-file-dialogs.h>
 // Experimental conversion
 #include <plugins/g3d/collection.hpp>
+#include <plugins/gc/Export/ExportSettings.hpp>
 #include <plugins/j3d/Scene.hpp>
 
 #include <vendor/stb_image.h>
@@ -143,6 +144,12 @@ void RootWindow::draw() {
           vsync = _vsync;
         }
 
+        ImGui::Checkbox("Optimize vertex cache on save",
+                        &libcube::GetExportSettings().optimizeVertexCache);
+        ImGui::Checkbox(
+            "Send small meshes' vertex data directly on save",
+            &libcube::GetExportSettings().chooseDirectVertexData);
+
         mThemeUpdated |= DrawThemeEditor(mCurTheme, mFontGlobalScale, nullptr);
 
 #ifdef BUILD_DEBUG
@@ -239,7 +246,7 @@ void RootWindow::draw() {
                                         .mPrimitives) {
                     auto& p = bmd_mp.mPrimitives.emplace_back(prim);
                     // Remap vtx indices
-                    for (auto& v : p.mVertices) {
+                    for (auto&& v : p.mVertices) {
                       for (u32 x = 0; x < (u32)librii::gx::VertexAttribute::Max;
                            ++x) {
                         if (!(vcd.mBitfield & (1 << x)))
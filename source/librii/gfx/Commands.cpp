@@ -0,0 +1,92 @@
+#include "Commands.hpp"
+#include <optional>
+#include <type_traits>
+
+namespace librii::gfx {
+
+void CommandList::uploadUniforms(u32 offset, std::span<const u8> data,
+                                 UniformBuffer buffer) {
+  const u32 payload = static_cast<u32>(mPayload.size());
+  mPayload.insert(mPayload.end(), data.begin(), data.end());
+  push(UploadUniformsCmd{.offset = offset,
+                         .size = static_cast<u32>(data.size()),
+                         .payload = payload,
+                         .buffer = buffer});
+}
+
+void NullCommandExecutor::execute(const CommandList& list) {
+  ++mStats.lists;
+  mStats.commands += static_cast<u32>(list.size());
+
+  // What the list has bound so far
+  std::optional<MegaState> state;
+  std::optional<u32> program;
+  std::optional<u32> vertex_array;
+  std::vector<std::optional<BindTextureCmd>> textures;
+  std::vector<std::optional<BindUniformsCmd>> uniforms;
+
+  // Count a binding, and whether it changed nothing
+  const auto rebind = [](auto& bound, const auto& value, u32& changes,
+                         u32& redundant) {
+    ++changes;
+    if (bound.has_value() && *bound == value) {
+      ++redundant;
+      return;
+    }
+    bound = value;
+  };
+  const auto slot = [](auto& slots, u32 index) -> auto& {
+    if (index >= slots.size())
+      slots.resize(index + 1);
+    return slots[index];
+  };
+
+  for (const auto& command : list.getCommands()) {
+    std::visit(
+        [&](const auto& cmd) {
+          using T = std::decay_t<decltype(cmd)>;
+          if constexpr (std::is_same_v<T, SetMegaStateCmd>) {
+            rebind(state, cmd.state, mStats.stateChanges,
+                   mStats.redundantStates);
+          } else if constexpr (std::is_same_v<T, UseProgramCmd>) {
+            rebind(program, cmd.program, mStats.programChanges,
+                   mStats.redundantPrograms);
+          } else if constexpr (std::is_same_v<T, BindVertexArrayCmd>) {
+            rebind(vertex_array, cmd.vertexArray, mStats.vertexArrayChanges,
+                   mStats.redundantVertexArrays);
+          } else if constexpr (std::is_same_v<T, BindTextureCmd>) {
+            auto& bound = slot(textures, cmd.unit);
+            ++mStats.textureBinds;
+            if (bound.has_value() && bound->texture == cmd.texture &&
+                bound->minFilter == cmd.minFilter &&
+                bound->magFilter == cmd.magFilter &&
+                bound->wrapS == cmd.wrapS && bound->wrapT == cmd.wrapT) {
+              ++mStats.redundantTextures;
+              return;
+            }
+            bound = cmd;
+          } else if constexpr (std::is_same_v<T, BindUniformsCmd>) {
+            auto& bound = slot(uniforms, cmd.binding);
+            ++mStats.uniformBinds;
+            if (bound.has_value() && bound->buffer == cmd.buffer &&
+                bound->offset == cmd.offset && bound->size == cmd.size) {
+              ++mStats.redundantUniformBinds;
+              return;
+            }
+            bound = cmd;
+          } else if constexpr (std::is_same_v<T, UploadUniformsCmd>) {
+            mStats.uniformBytes += cmd.size;
+          } else if constexpr (std::is_same_v<T, DrawCmd>) {
+            ++mStats.draws;
+            mStats.instances += cmd.instances;
+            mStats.indices += cmd.count * cmd.instances;
+          } else if constexpr (std::is_same_v<T, UnbindCmd>) {
+            program.reset();
+            vertex_array.reset();
+          }
+        },
+        command);
+  }
+}
+
+} // namespace librii::gfx
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gfx/MegaState.hpp>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace librii::gfx {
+
+//----------------------------------
+// Render commands
+//
+// The scene renderer records a frame as a list of commands rather than calling
+// the graphics API, and an executor plays the list back: on the GPU, or on the
+// CPU alone to measure and test the renderer without one.
+//
+// Resources are referred to by their backend IDs. Enumerations (filters, wrap
+// modes, render state) take their OpenGL values.
+
+struct SetMegaStateCmd {
+  MegaState state;
+};
+struct UseProgramCmd {
+  u32 program;
+};
+struct BindVertexArrayCmd {
+  u32 vertexArray;
+};
+// Bind a texture to a unit and set how it is sampled
+struct BindTextureCmd {
+  u32 unit;
+  u32 texture;
+  u32 minFilter;
+  u32 magFilter;
+  u32 wrapS;
+  u32 wrapT;
+};
+
+// Uniform buffers are owned by the executor: one of each per command stream.
+enum class UniformBuffer : u8 {
+  // Per-draw blocks
+  Draw,
+  // Per-instance placements, rewritten only when they change
+  Instance,
+};
+
+// Resize a buffer; its contents are undefined until uploaded again
+struct ReserveUniformsCmd {
+  u32 size;
+  UniformBuffer buffer = UniformBuffer::Draw;
+};
+// Write `size` bytes of the list payload at `payload` to `offset`
+struct UploadUniformsCmd {
+  u32 offset;
+  u32 size;
+  u32 payload;
+  UniformBuffer buffer = UniformBuffer::Draw;
+};
+// Bind bytes [offset, offset + size) of a buffer to a block binding
+struct BindUniformsCmd {
+  u32 binding;
+  u32 offset;
+  u32 size;
+  UniformBuffer buffer = UniformBuffer::Draw;
+};
+
+// Triangles of the bound vertex array, by u32 indices. Instances are told
+// apart by the shader (gl_InstanceID).
+struct DrawCmd {
+  u32 count;
+  u32 firstIndex;
+  u32 instances = 1;
+};
+// Leave no program or vertex array bound
+struct UnbindCmd {};
+
+using Command =
+    std::variant<SetMegaStateCmd, UseProgramCmd, BindVertexArrayCmd,
+                 BindTextureCmd, ReserveUniformsCmd, UploadUniformsCmd,
+                 BindUniformsCmd, DrawCmd, UnbindCmd>;
+
+class CommandList {
+public:
+  void push(const Command& command) { mCommands.push_back(command); }
+  // Copy `data` into the list, to be uploaded to `offset`
+  void uploadUniforms(u32 offset, std::span<const u8> data,
+                      UniformBuffer buffer = UniformBuffer::Draw);
+
+  std::span<const Command> getCommands() const { return mCommands; }
+  std::span<const u8> getPayload(u32 offset, u32 size) const {
+    return std::span<const u8>(mPayload).subspan(offset, size);
+  }
+  std::size_t size() const { return mCommands.size(); }
+
+  // Keeps the storage for the next frame
+  void clear() {
+    mCommands.clear();
+    mPayload.clear();
+  }
+
+private:
+  std::vector<Command> mCommands;
+  std::vector<u8> mPayload;
+};
+
+class CommandExecutor {
+public:
+  virtual ~CommandExecutor() = default;
+
+  virtual void execute(const CommandList& list) = 0;
+};
+
+// Executes nothing: tracks the state the commands would leave bound, to count
+// the commands that would not change anything.
+//
+// Bound state is forgotten between lists, as other users of the GPU may have
+// changed it in between.
+class NullCommandExecutor : public CommandExecutor {
+public:
+  void execute(const CommandList& list) override;
+
+  struct Stats {
+    u32 lists = 0;
+    u32 commands = 0;
+    u32 draws = 0;
+    u32 instances = 0;
+    u32 indices = 0;
+    u32 uniformBytes = 0;
+
+    u32 stateChanges = 0;
+    u32 programChanges = 0;
+    u32 vertexArrayChanges = 0;
+    u32 textureBinds = 0;
+    u32 uniformBinds = 0;
+
+    // Commands binding what was already bound
+    u32 redundantStates = 0;
+    u32 redundantPrograms = 0;
+    u32 redundantVertexArrays = 0;
+    u32 redundantTextures = 0;
+    u32 redundantUniformBinds = 0;
+
+    u32 getRedundant() const {
+      return redundantStates + redundantPrograms + redundantVertexArrays +
+             redundantTextures + redundantUniformBinds;
+    }
+  };
+  // Accumulated since construction or the last resetStats
+  const Stats& getStats() const { return mStats; }
+  void resetStats() { mStats = {}; }
+
+private:
+  Stats mStats;
+};
+
+} // namespace librii::gfx
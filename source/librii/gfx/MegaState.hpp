@@ -13,6 +13,8 @@ struct MegaState {
   u32 blendMode;
   u32 blendSrcFactor;
   u32 blendDstFactor;
+
+  bool operator==(const MegaState&) const = default;
 };
 
 } // namespace librii::gfx
@@ -87,6 +87,12 @@ layout(std140, row_major) uniform ub_MaterialParams {
          "layout(std140, row_major) uniform ub_PacketParams {\n"
          "    mat4x3 u_PosMtx[10];\n" // 4x3
          "};\n"
+         "// Placements of the instances of a draw.\n"
+         "layout(std140, row_major) uniform ub_InstanceParams {\n"
+         "    mat4x3 u_InstanceMtx[" +
+         std::to_string(MaxInstances) +
+         "];\n" // 4x3
+         "};\n"
          "uniform sampler2D u_Texture[8];\n";
 #else
   return std::string(R"(
@@ -122,6 +128,12 @@ layout(std140, row_major, binding=1) uniform ub_MaterialParams {
          "layout(std140, row_major, binding=2) uniform ub_PacketParams {\n"
          "    mat4x3 u_PosMtx[10];\n" // 4x3
          "};\n"
+         "// Placements of the instances of a draw.\n"
+         "layout(std140, row_major, binding=3) uniform ub_InstanceParams {\n"
+         "    mat4x3 u_InstanceMtx[" +
+         std::to_string(MaxInstances) +
+         "];\n" // 4x3
+         "};\n"
          "uniform sampler2D u_Texture[8];\n";
 #endif
 }
@@ -1371,14 +1383,28 @@ float ApplyAttenuation(vec3 t_Coeff, float t_Value) {
     vert += "    vec3 t_Position = ";
     if (auto err = generateMulPos(vert); err)
       return std::move(err);
-    vert += ";\n";
+    vert += ";\n"
+            "    t_Position = u_InstanceMtx[gl_InstanceID] * "
+            "vec4(t_Position, 1.0);\n";
 
     vert += "    v_Position = t_Position;\n";
 
     vert += "    vec3 t_Normal = ";
     if (auto err = generateMulNrm(vert); err)
       return std::move(err);
-    vert += ";\n";
+    // Normals take the inverse transpose of the placement, which may be scaled
+    // unevenly. Its cofactor matrix is that times the determinant: cheaper,
+    // and only the sign of the determinant survives renormalizing.
+    vert += ";\n"
+            "    mat3 t_InstanceMtx = mat3(u_InstanceMtx[gl_InstanceID]);\n"
+            "    mat3 t_InstanceCof = mat3(\n"
+            "        cross(t_InstanceMtx[1], t_InstanceMtx[2]),\n"
+            "        cross(t_InstanceMtx[2], t_InstanceMtx[0]),\n"
+            "        cross(t_InstanceMtx[0], t_InstanceMtx[1]));\n"
+            "    float t_InstanceDet = dot(t_InstanceMtx[0], t_InstanceCof[0]);"
+            "\n"
+            "    t_Normal = normalize(t_InstanceCof * t_Normal) * "
+            "sign(t_InstanceDet);\n";
 
     vert += "    vec4 t_LightAccum;\n"
             "    vec3 t_LightDelta, t_LightDeltaDir;\n"
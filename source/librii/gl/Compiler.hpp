@@ -72,6 +72,14 @@ struct PacketParams {
   glm::mat3x4 posMtx[10];
 };
 
+// Instances of one draw, at most
+constexpr u32 MaxInstances = 256;
+// ROW_MAJOR. Unlike the other blocks, bound at a separate range per instanced
+// draw rather than per draw; plain draws bind a single identity matrix.
+struct InstanceParams {
+  glm::mat3x4 instanceMtx[MaxInstances];
+};
+
 template <typename T> inline glm::vec4 colorConvert(T clr) {
   const auto f32c = (gx::ColorF32)clr;
   return {f32c.r, f32c.g, f32c.b, f32c.a};
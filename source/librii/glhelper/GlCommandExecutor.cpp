@@ -0,0 +1,102 @@
+#include "GlCommandExecutor.hpp"
+#include <core/3d/gl.hpp>
+#include <librii/gl/EnumConverter.hpp>
+#include <librii/glhelper/ShaderProgram.hpp>
+#include <librii/glhelper/TextureState.hpp>
+#include <type_traits>
+
+namespace librii::glhelper {
+
+GlCommandExecutor::~GlCommandExecutor() {
+  for (u32& buffer : mUniformBuffers) {
+    if (buffer != 0)
+      glDeleteBuffers(1, &buffer);
+  }
+}
+
+void GlCommandExecutor::configureProgram(u32 program) {
+  // WebGL doesn't support binding=n in the shader
+#ifdef __EMSCRIPTEN__
+  glUniformBlockBinding(program,
+                        glGetUniformBlockIndex(program, "ub_SceneParams"), 0);
+  glUniformBlockBinding(
+      program, glGetUniformBlockIndex(program, "ub_MaterialParams"), 1);
+  glUniformBlockBinding(program,
+                        glGetUniformBlockIndex(program, "ub_PacketParams"), 2);
+  glUniformBlockBinding(
+      program, glGetUniformBlockIndex(program, "ub_InstanceParams"), 3);
+#endif // __EMSCRIPTEN__
+
+  const s32 samplerIds[] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+  glUseProgram(program);
+  u32 uTexLoc = glGetUniformLocation(program, "u_Texture");
+  glUniform1iv(uTexLoc, 8, samplerIds);
+}
+
+void GlCommandExecutor::execute(const gfx::CommandList& list) {
+  // The UI binds textures between our frames
+  TextureState::invalidateBindings();
+
+  for (const auto& command : list.getCommands()) {
+    std::visit(
+        [&](const auto& cmd) {
+          using T = std::decay_t<decltype(cmd)>;
+          if constexpr (std::is_same_v<T, gfx::SetMegaStateCmd>) {
+            librii::gl::setGlState(cmd.state);
+          } else if constexpr (std::is_same_v<T, gfx::UseProgramCmd>) {
+            auto* reflection = ShaderProgram::getReflection(cmd.program);
+            if (reflection == nullptr) {
+              // Not ours to cache: configure on every use
+              configureProgram(cmd.program);
+            } else if (!reflection->configured) {
+              configureProgram(cmd.program);
+              reflection->configured = true;
+            }
+            glUseProgram(cmd.program);
+          } else if constexpr (std::is_same_v<T, gfx::BindVertexArrayCmd>) {
+            glBindVertexArray(cmd.vertexArray);
+          } else if constexpr (std::is_same_v<T, gfx::BindTextureCmd>) {
+            TextureState::bind(cmd.unit, cmd.texture);
+            // Parameters belong to the texture object, not the unit: textures
+            // shared by materials sampling them differently are set on every
+            // switch, otherwise only once.
+            TextureState::setParams(cmd.texture,
+                                    {.minFilter = cmd.minFilter,
+                                     .magFilter = cmd.magFilter,
+                                     .wrapS = cmd.wrapS,
+                                     .wrapT = cmd.wrapT});
+          } else if constexpr (std::is_same_v<T, gfx::ReserveUniformsCmd>) {
+            u32& buffer = mUniformBuffers[static_cast<u32>(cmd.buffer)];
+            if (buffer == 0)
+              glGenBuffers(1, &buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, cmd.size, NULL, GL_DYNAMIC_DRAW);
+          } else if constexpr (std::is_same_v<T, gfx::UploadUniformsCmd>) {
+            glBindBuffer(GL_UNIFORM_BUFFER,
+                         mUniformBuffers[static_cast<u32>(cmd.buffer)]);
+            glBufferSubData(GL_UNIFORM_BUFFER, cmd.offset, cmd.size,
+                            list.getPayload(cmd.payload, cmd.size).data());
+          } else if constexpr (std::is_same_v<T, gfx::BindUniformsCmd>) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, cmd.binding,
+                              mUniformBuffers[static_cast<u32>(cmd.buffer)],
+                              cmd.offset, cmd.size);
+          } else if constexpr (std::is_same_v<T, gfx::DrawCmd>) {
+            const auto* first = reinterpret_cast<void*>(
+                static_cast<std::size_t>(cmd.firstIndex) * 4);
+            if (cmd.instances == 1) {
+              glDrawElements(GL_TRIANGLES, cmd.count, GL_UNSIGNED_INT, first);
+            } else {
+              glDrawElementsInstanced(GL_TRIANGLES, cmd.count,
+                                      GL_UNSIGNED_INT, first, cmd.instances);
+            }
+          } else if constexpr (std::is_same_v<T, gfx::UnbindCmd>) {
+            glBindVertexArray(0);
+            glUseProgram(0);
+          }
+        },
+        command);
+  }
+}
+
+} // namespace librii::glhelper
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <librii/gfx/Commands.hpp>
+
+namespace librii::glhelper {
+
+// Plays command lists back with OpenGL. Requires a current context.
+//
+// Owns the uniform buffers of its command stream: use one executor per stream.
+class GlCommandExecutor : public gfx::CommandExecutor {
+public:
+  GlCommandExecutor() = default;
+  ~GlCommandExecutor();
+
+  void execute(const gfx::CommandList& list) override;
+
+private:
+  // By gfx::UniformBuffer
+  std::array<u32, 2> mUniformBuffers{};
+
+  // Program state that does not change between uses: sampler units, and block
+  // bindings where the shader cannot declare them
+  static void configureProgram(u32 program);
+};
+
+} // namespace librii::glhelper
@@ -1,9 +1,40 @@
 #include "ShaderProgram.hpp"
+#include <algorithm>
 #include <core/3d/gl.hpp>
 #include <iostream>
 
 namespace librii::glhelper {
 
+std::map<u32, ProgramReflection> ShaderProgram::sReflections;
+
+s32 ProgramReflection::getUniformLocation(u32 program,
+                                          const std::string& name) {
+  const auto found = mUniformLocations.find(name);
+  if (found != mUniformLocations.end())
+    return found->second;
+  const s32 location = glGetUniformLocation(program, name.c_str());
+  mUniformLocations.emplace(name, location);
+  return location;
+}
+
+ProgramReflection* ShaderProgram::getReflection(u32 program_id) {
+  const auto found = sReflections.find(program_id);
+  return found != sReflections.end() ? &found->second : nullptr;
+}
+
+static ProgramReflection reflect(u32 program) {
+  ProgramReflection result;
+
+  s32 num_blocks = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &num_blocks);
+  result.blockSizes.resize(std::max(num_blocks, 0));
+  for (s32 i = 0; i < num_blocks; ++i)
+    glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE,
+                              &result.blockSizes[i]);
+
+  return result;
+}
+
 bool checkShaderErrors(u32 id, std::string& error) {
   s32 success;
   char infoLog[512];
@@ -41,12 +72,25 @@ ShaderProgram::ShaderProgram(const char* vtx, const char* frag) {
 
   glDeleteShader(vertexShader);
   glDeleteShader(fragmentShader);
+
+  sReflections[mShaderProgram] = reflect(mShaderProgram);
 }
 ShaderProgram::ShaderProgram(const std::string& vtx, const std::string& frag)
     : ShaderProgram(vtx.c_str(), frag.c_str()) {}
+ShaderProgram ShaderProgram::makeHeadless(const ProgramReflection& reflection) {
+  static u32 sNextHeadlessId = 0x8000'0000;
+
+  ShaderProgram result;
+  result.mShaderProgram = sNextHeadlessId++;
+  result.bHeadless = true;
+  sReflections[result.mShaderProgram] = reflection;
+  return result;
+}
 ShaderProgram::~ShaderProgram() {
-#ifndef RII_PLATFORM_EMSCRIPTEN
   if (mShaderProgram != ~0)
+    sReflections.erase(mShaderProgram);
+#ifndef RII_PLATFORM_EMSCRIPTEN
+  if (mShaderProgram != ~0 && !bHeadless)
     glDeleteProgram(mShaderProgram);
 #endif
 }
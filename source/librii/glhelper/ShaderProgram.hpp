@@ -1,16 +1,39 @@
 #pragma once
 
 #include <core/common.h>
+#include <map>
 #include <string>
+#include <vector>
 
 namespace librii::glhelper {
 
+//! Program metadata queried once, when the program is linked, rather than on
+//! every use.
+struct ProgramReflection {
+  //! Data size of each active uniform block, by block index.
+  std::vector<s32> blockSizes;
+
+  s32 getBlockSize(u32 index) const {
+    return index < blockSizes.size() ? blockSizes[index] : 0;
+  }
+
+  //! Location of a uniform; queried on first use.
+  s32 getUniformLocation(u32 program, const std::string& name);
+
+  //! Set by the user once it has assigned per-program uniforms that do not
+  //! change, such as sampler units. Program state persists between uses.
+  bool configured = false;
+
+private:
+  std::map<std::string, s32> mUniformLocations;
+};
+
 struct ShaderProgram {
   explicit ShaderProgram(const char* vtx, const char* frag);
   explicit ShaderProgram(const std::string& vtx, const std::string& frag);
   ShaderProgram(ShaderProgram&& rhs)
       : mErrorDesc(rhs.mErrorDesc), mShaderProgram(rhs.mShaderProgram),
-        bError(rhs.bError) {
+        bError(rhs.bError), bHeadless(rhs.bHeadless) {
     rhs.mShaderProgram = ~0;
   }
   ShaderProgram(const ShaderProgram&) = delete;
@@ -20,18 +43,34 @@ struct ShaderProgram {
     mErrorDesc = rhs.mErrorDesc;
     mShaderProgram = rhs.mShaderProgram;
     bError = rhs.bError;
+    bHeadless = rhs.bHeadless;
     rhs.mShaderProgram = ~0;
     return *this;
   }
 
+  //! A program that is never compiled, for recording commands without a
+  //! context: a unique ID, outside the range GL hands out, with the given
+  //! reflection.
+  static ShaderProgram makeHeadless(const ProgramReflection& reflection);
+
   u32 getId() const { return mShaderProgram; }
   bool getError() const { return bError; }
   std::string getErrorDesc() const { return mErrorDesc; }
 
+  //! The reflection of a live program, by ID. Null if the program was not
+  //! created by a ShaderProgram.
+  static ProgramReflection* getReflection(u32 program_id);
+
 private:
+  ShaderProgram() = default;
+
   std::string mErrorDesc;
   u32 mShaderProgram;
   bool bError = false;
+  bool bHeadless = false;
+
+  // By program ID, so moving a ShaderProgram does not invalidate it
+  static std::map<u32, ProgramReflection> sReflections;
 };
 
 } // namespace librii::glhelper
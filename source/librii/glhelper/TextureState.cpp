@@ -0,0 +1,73 @@
+#include "TextureState.hpp"
+#include <cassert>
+#include <core/3d/gl.hpp>
+
+namespace librii::glhelper {
+
+u32 TextureState::sActiveUnit = TextureState::Unknown;
+u32 TextureState::sSelectedUnit = TextureState::Unknown;
+std::vector<u32> TextureState::sBindings;
+std::unordered_map<u32, TextureParams> TextureState::sParams;
+TextureState::Stats TextureState::sStats;
+
+void TextureState::activate(u32 unit) {
+  if (sActiveUnit == unit)
+    return;
+  glActiveTexture(GL_TEXTURE0 + unit);
+  sActiveUnit = unit;
+  ++sStats.issued;
+}
+
+void TextureState::bind(u32 unit, u32 texture) {
+  if (unit >= sBindings.size())
+    sBindings.resize(unit + 1, Unknown);
+
+  sSelectedUnit = unit;
+  if (sBindings[unit] == texture) {
+    ++sStats.skipped;
+    return;
+  }
+  activate(unit);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  sBindings[unit] = texture;
+  ++sStats.issued;
+}
+
+void TextureState::setParams(u32 texture, const TextureParams& params) {
+  assert(sSelectedUnit < sBindings.size() &&
+         sBindings[sSelectedUnit] == texture);
+  auto [it, inserted] = sParams.try_emplace(texture, params);
+  auto& shadow = it->second;
+
+  const auto set = [&](u32 pname, u32 value, u32& shadow_value) {
+    if (!inserted && shadow_value == value) {
+      ++sStats.skipped;
+      return;
+    }
+    // glTexParameteri applies to the texture of the active unit
+    activate(sSelectedUnit);
+    glTexParameteri(GL_TEXTURE_2D, pname, value);
+    shadow_value = value;
+    ++sStats.issued;
+  };
+  set(GL_TEXTURE_MIN_FILTER, params.minFilter, shadow.minFilter);
+  set(GL_TEXTURE_MAG_FILTER, params.magFilter, shadow.magFilter);
+  set(GL_TEXTURE_WRAP_S, params.wrapS, shadow.wrapS);
+  set(GL_TEXTURE_WRAP_T, params.wrapT, shadow.wrapT);
+}
+
+void TextureState::invalidateBindings() {
+  sActiveUnit = Unknown;
+  sSelectedUnit = Unknown;
+  sBindings.clear();
+}
+
+void TextureState::forget(u32 texture) {
+  sParams.erase(texture);
+  for (auto& binding : sBindings) {
+    if (binding == texture)
+      binding = Unknown;
+  }
+}
+
+} // namespace librii::glhelper
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <core/common.h>
+#include <unordered_map>
+#include <vector>
+
+namespace librii::glhelper {
+
+struct TextureParams {
+  u32 minFilter = 0;
+  u32 magFilter = 0;
+  u32 wrapS = 0;
+  u32 wrapT = 0;
+
+  bool operator==(const TextureParams&) const = default;
+};
+
+//! Shadows the texture state set through it, skipping GL calls that would not
+//! change anything. 2D textures only.
+//!
+//! Parameters are state of the texture object, so they are kept until the
+//! texture is forgotten. Unit bindings are changed by anyone drawing (e.g. the
+//! UI), so they must be invalidated whenever that may have happened.
+//!
+struct TextureState {
+  //! Bind a texture to a texture unit, and select the unit for setParams.
+  static void bind(u32 unit, u32 texture);
+  //! Set the parameters of the texture bound to the selected unit.
+  static void setParams(u32 texture, const TextureParams& params);
+
+  //! Texture units may have been rebound behind our back.
+  static void invalidateBindings();
+  //! A texture was created or deleted, or its parameters set behind our back.
+  static void forget(u32 texture);
+
+  struct Stats {
+    u32 issued = 0;
+    u32 skipped = 0;
+  };
+  static Stats& getStats() { return sStats; }
+
+private:
+  static constexpr u32 Unknown = ~0u;
+
+  //! Make a unit active, if it is not already.
+  static void activate(u32 unit);
+
+  static u32 sActiveUnit;
+  //! By bind, even when it skips the bind: made active only if needed
+  static u32 sSelectedUnit;
+  static std::vector<u32> sBindings;
+  static std::unordered_map<u32, TextureParams> sParams;
+  static Stats sStats;
+};
+
+} // namespace librii::glhelper
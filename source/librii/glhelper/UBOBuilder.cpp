@@ -1,7 +1,6 @@
 #include "UBOBuilder.hpp"
 #include <algorithm>
-#include <core/3d/gl.hpp>
-#include <cstdio>
+#include <cstring>
 
 namespace librii::glhelper {
 
@@ -9,99 +8,146 @@ namespace librii::glhelper {
 // Basic UBOBuilder
 //
 UBOBuilder::UBOBuilder() {
+  // Fixed rather than queried, so that uniforms can be laid out without a
+  // context.
 #if !defined(_WIN32)
   uniformStride = 1024; // TODO: This is really for emscripten, perhaps there is
                         // a fixed value or proper way to query this.
 #else
-  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformStride);
-  printf("UBOBuilder: Buffer offset alignment: %i\n", uniformStride);
+  // The coarsest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT in practice: 256 on Nvidia
+  // hardware, usually finer on Intel. This also allows for GPU-agnostic dump
+  // analysis: captures using the Intel minimum are unplayable on a Nvidia GPU.
+  uniformStride = 256;
 #endif
-
-#ifdef DEBUG
-  // This allows for GPU-agnostic dump analysis.
-  //
-  // While the alignment on Nvidia hardware is 256, on Intel hardware it is
-  // usually finer. Using the hardware minimum renders Intel captures unplayable
-  // on a Nvidia GPU.
-  uniformStride = std::max(uniformStride, 256);
-#endif
-
-  glGenBuffers(1, &UBO);
 }
 
-UBOBuilder::~UBOBuilder() { glDeleteBuffers(1, &UBO); }
-
 //
 // Advanced UBOBuilder
 //
 
-void DelegatedUBOBuilder::submit() {
-  const auto blob_size = calcBlobSize();
-  mCoalesced.resize(blob_size);
-  mCoalescedOffsets.clear();
+void DelegatedUBOBuilder::submit(gfx::CommandList& commands) {
+  mStats = {};
 
+  // Each binding point is one contiguous region
   u32 cursor = 0;
-  for (const auto& binding_point_collection : mData) {
-    // If there is no data, add a null entry
-    if (binding_point_collection.empty()) {
-      mCoalescedOffsets.push_back({.offset = cursor, .stride = 0});
-      continue;
+  const bool layout_changed = [&] {
+    bool changed = mRegions.size() != mBindingPoints.size();
+    mRegions.resize(mBindingPoints.size());
+    for (std::size_t i = 0; i < mBindingPoints.size(); ++i) {
+      const auto& binding_point = mBindingPoints[i];
+      const Region region{.offset = cursor,
+                          .stride = binding_point.stride,
+                          .count = binding_point.count};
+      changed |= !(region == mRegions[i]);
+      mRegions[i] = region;
+      cursor += region.stride * region.count;
     }
+    return changed;
+  }();
+  const u32 size = cursor;
+  mStats.bytesTotal = size;
+
+  if (size > mCapacity) {
+    // Grow with headroom, so that a growing scene does not reallocate every
+    // frame
+    mCapacity = roundUniformUp(size + size / 2);
+    commands.push(gfx::ReserveUniformsCmd{.size = mCapacity});
+    mUploaded.clear();
+  }
 
-    // This assumes the size of each binding point entry is the same
-    const std::size_t entry_size = binding_point_collection[0].size();
-    const auto entry_stride = static_cast<u32>(roundUniformUp(entry_size));
-
-    mCoalescedOffsets.push_back(
-        {.offset = cursor, .stride = static_cast<u32>(entry_stride)});
-
-    for (const auto& binding_point_entry : binding_point_collection) {
-      assert(binding_point_entry.size() == entry_size &&
-             "Uniforms differ in size across the binding point");
-
-      mCoalesced.insert_bytes(cursor, binding_point_entry.data(),
-                              binding_point_entry.size());
-      cursor += entry_stride;
+  if (layout_changed || mUploaded.size() != size) {
+    mUploaded.resize(size);
+    for (std::size_t i = 0; i < mBindingPoints.size(); ++i) {
+      const auto& region = mRegions[i];
+      const u32 region_size = region.stride * region.count;
+      if (region_size == 0)
+        continue;
+      upload(commands, region.offset, mBindingPoints[i].staging.data(),
+             region_size);
     }
+    return;
   }
 
-  assert(cursor == blob_size && cursor == mCoalesced.size());
+  // Send runs of changed entries
+  for (std::size_t i = 0; i < mBindingPoints.size(); ++i) {
+    const auto& region = mRegions[i];
+    const u8* staging = mBindingPoints[i].staging.data();
+    const u8* uploaded = mUploaded.data() + region.offset;
+
+    u32 run_begin = 0;
+    u32 run_size = 0;
+    for (u32 entry = 0; entry < region.count; ++entry) {
+      const u32 at = entry * region.stride;
+      if (memcmp(staging + at, uploaded + at, region.stride) != 0) {
+        if (run_size == 0)
+          run_begin = at;
+        run_size += region.stride;
+        continue;
+      }
+      if (run_size != 0)
+        upload(commands, region.offset + run_begin, staging + run_begin,
+               run_size);
+      run_size = 0;
+    }
+    if (run_size != 0)
+      upload(commands, region.offset + run_begin, staging + run_begin,
+             run_size);
+  }
+}
 
-  glBindBuffer(GL_UNIFORM_BUFFER, getUboId());
-  glBufferData(GL_UNIFORM_BUFFER, blob_size, NULL, GL_STATIC_DRAW);
-  glBufferSubData(GL_UNIFORM_BUFFER, 0, blob_size, mCoalesced.data());
+void DelegatedUBOBuilder::upload(gfx::CommandList& commands, u32 offset,
+                                 const u8* data, u32 size) {
+  commands.uploadUniforms(offset, {data, size});
+  memcpy(mUploaded.data() + offset, data, size);
+  mStats.bytesUploaded += size;
+  ++mStats.uploads;
 }
 
 // Use the data at each binding point
-void DelegatedUBOBuilder::use(u32 idx) const {
-  for (int i = 0; i < mData.size(); ++i) {
-    const auto& ofs = mCoalescedOffsets[i];
-
-    const auto range_offset = ofs.offset + ofs.stride * idx;
-    const auto range_size = ofs.stride * (mData[i].size() - idx);
-
-    assert(range_offset % getUniformAlignment() == 0);
-    if (range_size == 0)
+void DelegatedUBOBuilder::use(u32 idx, gfx::CommandList& commands) const {
+  for (int i = 0; i < mRegions.size(); ++i) {
+    const auto& region = mRegions[i];
+    if (idx >= region.count)
       continue;
 
-    assert(range_offset < mCoalesced.size());
-    glBindBufferRange(GL_UNIFORM_BUFFER, i, getUboId(), range_offset,
-                      range_size);
+    const auto range_offset = region.offset + region.stride * idx;
+    assert(range_offset % getUniformAlignment() == 0);
+    commands.push(gfx::BindUniformsCmd{.binding = static_cast<u32>(i),
+                                       .offset = range_offset,
+                                       .size = region.stride});
   }
 }
 
-void DelegatedUBOBuilder::push(u32 binding_point, const std::vector<u8>& data) {
-  auto& bound_data = getTempData(binding_point).emplace_back(data);
+void DelegatedUBOBuilder::push(u32 binding_point, std::span<const u8> data) {
+  if (binding_point >= mBindingPoints.size())
+    mBindingPoints.resize(binding_point + 1);
+  auto& bound = mBindingPoints[binding_point];
 
   assert(mMinSizes.size() > binding_point);
   if (mMinSizes[binding_point] > 1024 * 1024 * 1024) {
     assert(!"Invalid minimum size. Likely a shader compilation error earlier.");
     abort();
   }
-  if (bound_data.size() < mMinSizes[binding_point])
-    bound_data.resize(mMinSizes[binding_point]);
+  const u32 stride = roundUniformUp(
+      std::max(static_cast<u32>(data.size()), mMinSizes[binding_point]));
+  if (bound.count == 0)
+    bound.stride = stride;
+  assert(bound.stride == stride &&
+         "Uniforms differ in size across the binding point");
+
+  // Growing zero-fills the padding, so equal uniforms compare equal
+  const std::size_t at = bound.staging.size();
+  bound.staging.resize(at + bound.stride);
+  memcpy(bound.staging.data() + at, data.data(), data.size());
+  ++bound.count;
+}
+void DelegatedUBOBuilder::clear() {
+  // Keep the storage for the next frame
+  for (auto& binding_point : mBindingPoints) {
+    binding_point.staging.clear();
+    binding_point.count = 0;
+  }
 }
-void DelegatedUBOBuilder::clear() { mData.clear(); }
 
 void DelegatedUBOBuilder::setBlockMin(u32 binding_point, u32 min) {
   if (binding_point >= mMinSizes.size()) {
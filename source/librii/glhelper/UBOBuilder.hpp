@@ -1,16 +1,19 @@
 #pragma once
 
 #include <core/common.h>
+#include <librii/gfx/Commands.hpp>
 #include <map>
 #include <memory>
+#include <span>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace librii::glhelper {
 
 struct UBOBuilder {
   UBOBuilder();
-  ~UBOBuilder();
+  ~UBOBuilder() = default;
 
   u32 roundUniformUp(u32 ofs) const {
     auto res = roundUp(ofs, uniformStride);
@@ -25,103 +28,79 @@ struct UBOBuilder {
     return res;
   }
   int getUniformAlignment() const { return uniformStride; }
-  u32 getUboId() const { return UBO; }
 
 private:
   int uniformStride = 0;
-  u32 UBO;
 };
 
-// A write-only binary object.
-class Blob {
-public:
-  Blob() = default;
-  Blob(std::vector<u8>&& data) : mData(std::move(data)) {}
-  Blob(const std::vector<u8>& data) : mData(data) {}
-  Blob(Blob&& blob) : Blob(std::move(blob.mData)) {}
-
-  std::size_t size() const { return mData.size(); }
-  void resize(std::size_t size) { mData.resize(size); }
-  void clear() { mData.clear(); }
-
-  const u8* data() const { return mData.data(); }
-
-  void insert_bytes(std::size_t begin, const u8* bytes,
-                    std::size_t byte_count) {
-    if (begin + byte_count > mData.size()) {
-      assert(!"insert_bytes: range is out of bounds");
-      return;
-    }
-
-    memcpy(mData.data() + begin, bytes, byte_count);
-  }
-
-private:
-  std::vector<u8> mData;
-};
-
-// Prototype -- we can do this much more efficiently
+// Uniform data for the draws of a frame: one fixed-size entry per draw at each
+// binding point.
+//
+// Entries are written in place into staging memory kept across frames, so
+// building uniforms does not allocate once the first frame has. On submit, the
+// buffer keeps the previous frame's layout when it can; entries are compared
+// against what was last uploaded and only runs of changed entries are sent.
+//
+// Uploads and bindings are recorded as commands; the buffer itself belongs to
+// the executor of the command stream.
 class DelegatedUBOBuilder : public UBOBuilder {
 public:
   DelegatedUBOBuilder() = default;
   ~DelegatedUBOBuilder() = default;
 
-  void submit();
+  void submit(gfx::CommandList& commands);
 
   // Use the data at each binding point
-  void use(u32 idx) const;
+  void use(u32 idx, gfx::CommandList& commands) const;
 
-  void push(u32 binding_point, const std::vector<u8>& data);
+  void push(u32 binding_point, std::span<const u8> data);
 
   template <typename T> void tpush(u32 binding_point, const T& data) {
-    std::vector<u8> tmp(sizeof(T));
-    *reinterpret_cast<T*>(tmp.data()) = data;
-    push(binding_point, tmp);
-  }
-  void reset(u32 binding_point) {
-    // Check if the binding point has been set
-    if (mData.size() > binding_point)
-      return;
-
-    if (!mData[binding_point].empty()) {
-      mData[binding_point][mData[binding_point].size() - 1].clear();
-    }
+    static_assert(std::is_trivially_copyable_v<T>);
+    push(binding_point, {reinterpret_cast<const u8*>(&data), sizeof(T)});
   }
 
   void setBlockMin(u32 binding_point, u32 min);
 
   void clear();
 
+  struct Stats {
+    u32 bytesTotal = 0;
+    u32 bytesUploaded = 0;
+    u32 uploads = 0;
+  };
+  // Of the last submit
+  const Stats& getStats() const { return mStats; }
+
 private:
+  struct BindingPoint {
+    // `count` entries of `stride` bytes
+    std::vector<u8> staging;
+    u32 stride = 0;
+    u32 count = 0;
+  };
   // Indices as binding ids
-  std::vector<std::vector<Blob>> mData;
+  std::vector<BindingPoint> mBindingPoints;
 
   std::vector<u32> mMinSizes;
 
-  // Recomputed each submit
-  Blob mCoalesced;
-  struct CoalescedEntry {
+  // Where each binding point lives in the buffer, as last uploaded
+  struct Region {
     u32 offset = 0;
     u32 stride = 0;
-  };
-  std::vector<CoalescedEntry> mCoalescedOffsets;
+    u32 count = 0;
 
-  std::vector<Blob>& getTempData(u32 binding_point) {
-    if (binding_point >= mData.size())
-      return mData.emplace_back();
+    bool operator==(const Region&) const = default;
+  };
+  std::vector<Region> mRegions;
+  // The buffer contents, as last uploaded
+  std::vector<u8> mUploaded;
+  u32 mCapacity = 0;
 
-    return mData[binding_point];
-  }
+  Stats mStats;
 
-  std::size_t calcBlobSize() const {
-    std::size_t size = 0;
-    for (const auto& binding_point_collection : mData) {
-      for (const auto& binding_point_entry : binding_point_collection)
-        size += roundUniformUp(binding_point_entry.size());
-    }
-    // printf("DelegatedUBOBuilder: Final size: %u\n", static_cast<u32>(size));
-    return size;
-  }
+  void upload(gfx::CommandList& commands, u32 offset, const u8* data,
+              u32 size);
 };
 
 } // namespace librii::glhelper
@@ -1,73 +1,339 @@
 #include "VBOBuilder.hpp"
 #include <algorithm>
+#include <cmath>
 #include <core/3d/gl.hpp>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include <llvm/Support/xxhash.h>
 
 namespace librii::glhelper {
 
-VBOBuilder::VBOBuilder() {
+u32 GetVertexFormatSize(VertexFormat format) {
+  switch (format) {
+  case VertexFormat::F32:
+    return 4;
+  case VertexFormat::F16:
+  case VertexFormat::SNorm16:
+    return 2;
+  case VertexFormat::UNorm8:
+  case VertexFormat::U8:
+    return 1;
+  }
+  return 4;
+}
+
+static u32 GetVertexFormatGlType(VertexFormat format) {
+  switch (format) {
+  case VertexFormat::F32:
+    return GL_FLOAT;
+  case VertexFormat::F16:
+    return GL_HALF_FLOAT;
+  case VertexFormat::UNorm8:
+  case VertexFormat::U8:
+    return GL_UNSIGNED_BYTE;
+  case VertexFormat::SNorm16:
+    return GL_SHORT;
+  }
+  return GL_FLOAT;
+}
+
+const VertexLayout::Attribute* VertexLayout::find(u32 location) const {
+  for (const auto& attr : attributes) {
+    if (attr.location == location)
+      return &attr;
+  }
+  return nullptr;
+}
+
+VBOBuilder::VBOBuilder(bool headless) : mHeadless(headless) {
+  if (mHeadless)
+    return;
   glGenBuffers(1, &mPositionBuf);
   glGenBuffers(1, &mIndexBuf);
 
   glGenVertexArrays(1, &VAO);
 }
 VBOBuilder::~VBOBuilder() {
+  if (mHeadless)
+    return;
   glDeleteBuffers(1, &mPositionBuf);
   glDeleteBuffers(1, &mIndexBuf);
 
   glDeleteVertexArrays(1, &VAO);
 }
-void VBOBuilder::build() {
-  std::vector<std::pair<VAOEntry, u32>> mAttribStack; // desc : offset
 
-  for (const auto& bind : mPropogating) {
-    mAttribStack.emplace_back(bind.second.descriptor, mData.size());
+void VBOBuilder::declareAttribute(u32 location, const char* name,
+                                  u32 components, VertexFormat format) {
+  if (mLayoutFixed) {
+    // Floats hold every format
+    const auto* attr = mLayout.find(location);
+    if (attr == nullptr || attr->components < components ||
+        (attr->format != format && attr->format != VertexFormat::F32))
+      mLayoutMismatch = true;
+    return;
+  }
+  auto it = std::find_if(mDeclared.begin(), mDeclared.end(),
+                         [&](auto& attr) { return attr.location == location; });
+  if (it == mDeclared.end()) {
+    mDeclared.push_back({.location = location,
+                         .name = name,
+                         .components = components,
+                         .format = format,
+                         .offset = 0});
+    return;
+  }
+  it->components = std::max(it->components, components);
+  if (it->format != format)
+    it->format = VertexFormat::F32;
+}
+
+void VBOBuilder::fixLayout() {
+  mLayoutFixed = true;
+
+  std::sort(mDeclared.begin(), mDeclared.end(),
+            [](auto& lhs, auto& rhs) { return lhs.location < rhs.location; });
+  mLayout.attributes = mDeclared;
+  u32 offset = 0;
+  for (auto& attr : mLayout.attributes) {
+    const u32 size = GetVertexFormatSize(attr.format);
+    attr.offset = roundUp(offset, size);
+    offset = attr.offset + size * attr.components;
+  }
+  mLayout.stride = std::max(roundUp(offset, 4), 4u);
+
+  mVertex.resize(mLayout.stride);
+  mData.reserve(mData.size() +
+                static_cast<std::size_t>(mReservedVertices) * mLayout.stride);
+  mIndices.reserve(mIndices.size() + mReservedIndices);
+  mHashes.reserve(mHashes.size() + mReservedVertices);
+}
+
+void VBOBuilder::beginRange() {
+  if (!mLayoutFixed)
+    fixLayout();
+  mUnique.clear();
+  mRangeVertex = getNumVertices();
+  mRangeIndex = static_cast<u32>(mIndices.size());
+}
+
+VBOBuilder::Range VBOBuilder::endRange() const {
+  const u32 vtx_size = getNumVertices() - mRangeVertex;
+  const u32 idx_size = static_cast<u32>(mIndices.size()) - mRangeIndex;
+  return {.vtx_ofs = mRangeVertex,
+          .vtx_size = vtx_size,
+          .vtx_capacity = vtx_size,
+          .idx_ofs = mRangeIndex,
+          .idx_size = idx_size,
+          .idx_capacity = idx_size};
+}
+
+void VBOBuilder::replaceRange(Range& range, const Range& written) {
+  assert(written.vtx_ofs + written.vtx_size == getNumVertices() &&
+         written.idx_ofs + written.idx_size == mIndices.size() &&
+         "Only the last range written can replace another");
+  const u32 stride = mLayout.stride;
 
-    for (const u8 e : bind.second.data)
-      push(e);
+  if (written.vtx_size > range.vtx_capacity ||
+      written.idx_size > range.idx_capacity) {
+    mWastedBytes += std::size_t(range.vtx_capacity) * stride +
+                    std::size_t(range.idx_capacity) * 4;
+    range = written;
+    markDirty(mDirtyData, std::size_t(written.vtx_ofs) * stride, mData.size());
+    markDirty(mDirtyIndices, std::size_t(written.idx_ofs) * 4,
+              mIndices.size() * 4);
+    return;
   }
 
+  // Fits: move it into place and drop it from the end
+  memmove(mData.data() + std::size_t(range.vtx_ofs) * stride,
+          mData.data() + std::size_t(written.vtx_ofs) * stride,
+          std::size_t(written.vtx_size) * stride);
+  for (u32 i = 0; i < written.idx_size; ++i) {
+    mIndices[range.idx_ofs + i] =
+        mIndices[written.idx_ofs + i] - written.vtx_ofs + range.vtx_ofs;
+  }
+  mData.resize(std::size_t(written.vtx_ofs) * stride);
+  mHashes.resize(written.vtx_ofs);
+  mIndices.resize(written.idx_ofs);
+
+  range.vtx_size = written.vtx_size;
+  range.idx_size = written.idx_size;
+  markDirty(mDirtyData, std::size_t(range.vtx_ofs) * stride,
+            std::size_t(range.vtx_ofs + range.vtx_size) * stride);
+  markDirty(mDirtyIndices, std::size_t(range.idx_ofs) * 4,
+            std::size_t(range.idx_ofs + range.idx_size) * 4);
+}
+
+void VBOBuilder::markDirty(std::vector<Span>& spans, std::size_t begin,
+                           std::size_t end) {
+  if (begin >= end)
+    return;
+  // Ranges are usually rewritten in order: extend the last span if they touch
+  if (!spans.empty() && spans.back().second >= begin &&
+      spans.back().first <= end) {
+    spans.back().first = std::min(spans.back().first, begin);
+    spans.back().second = std::max(spans.back().second, end);
+    return;
+  }
+  spans.emplace_back(begin, end);
+}
+
+void VBOBuilder::setAttribute(u32 location, const glm::vec4& value) {
+  const auto* attr = mLayout.find(location);
+  if (attr == nullptr)
+    return;
+
+  u8* out = mVertex.data() + attr->offset;
+  for (u32 i = 0; i < attr->components; ++i) {
+    const f32 v = value[i];
+    switch (attr->format) {
+    case VertexFormat::F32:
+      memcpy(out + i * 4, &v, 4);
+      break;
+    case VertexFormat::F16: {
+      const u16 half = glm::packHalf1x16(v);
+      memcpy(out + i * 2, &half, 2);
+      break;
+    }
+    case VertexFormat::UNorm8:
+      out[i] = static_cast<u8>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+      break;
+    case VertexFormat::SNorm16: {
+      const s16 snorm =
+          static_cast<s16>(std::round(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+      memcpy(out + i * 2, &snorm, 2);
+      break;
+    }
+    case VertexFormat::U8:
+      out[i] = static_cast<u8>(std::clamp(v, 0.0f, 255.0f));
+      break;
+    }
+  }
+}
+
+bool VBOBuilder::VertexEqual::operator()(u32 lhs, u32 rhs) const {
+  const u32 stride = builder->mLayout.stride;
+  return memcmp(builder->mData.data() + lhs * stride,
+                builder->mData.data() + rhs * stride, stride) == 0;
+}
+
+void VBOBuilder::pushVertex() {
+  assert(mLayoutFixed && "Vertices are written within a range");
+
+  // Append the vertex, then take it back if it is a duplicate
+  const u32 vertex = getNumVertices();
+  mData.insert(mData.end(), mVertex.begin(), mVertex.end());
+  mHashes.push_back(
+      llvm::xxHash64(llvm::ArrayRef<uint8_t>(mVertex.data(), mVertex.size())));
+
+  const auto [it, inserted] = mUnique.insert(vertex);
+  if (!inserted) {
+    mData.resize(mData.size() - mLayout.stride);
+    mHashes.pop_back();
+    ++mNumMerged;
+  }
+  mIndices.push_back(*it);
+
+  std::fill(mVertex.begin(), mVertex.end(), 0);
+}
+
+void VBOBuilder::build() {
+  if (!mLayoutFixed)
+    fixLayout();
+
+  mUnique.clear();
+  mDirtyData.clear();
+  mDirtyIndices.clear();
+  if (mHeadless)
+    return;
+
   glBindVertexArray(VAO);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuf);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * 4, mIndices.data(),
                GL_STATIC_DRAW);
+  mIndexCapacity = mIndices.size() * 4;
 
   glBindBuffer(GL_ARRAY_BUFFER, mPositionBuf);
   glBufferData(GL_ARRAY_BUFFER, mData.size(), mData.data(), GL_STATIC_DRAW);
-  glBindVertexArray(VAO);
-
-  auto vertexAttribPointer = [&](GLuint index, GLint size, GLenum type,
-                                 GLboolean normalized, GLsizei stride,
-                                 const void* pointer) {
-    DebugReport("Index: %u, size: %i, stride: %i, ofs: %u\n", index, size,
-                stride, (u32)pointer);
+  mDataCapacity = mData.size();
 
-    assert(stride != 0);
+  // From a previous layout
+  for (const u32 location : mEnabled)
+    glDisableVertexAttribArray(location);
+  mEnabled.clear();
 
-    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+  for (const auto& attr : mLayout.attributes) {
+    DebugReport("Index: %u, size: %u, stride: %u, ofs: %u\n", attr.location,
+                attr.components, mLayout.stride, attr.offset);
 
+    const bool normalized = attr.format == VertexFormat::UNorm8 ||
+                            attr.format == VertexFormat::SNorm16;
+    glVertexAttribPointer(attr.location, attr.components,
+                          GetVertexFormatGlType(attr.format),
+                          normalized ? GL_TRUE : GL_FALSE, mLayout.stride,
+                          reinterpret_cast<void*>(attr.offset));
     assert(glGetError() == GL_NO_ERROR);
-    if (glGetError() != GL_NO_ERROR)
-      exit(1);
-  };
+    glEnableVertexAttribArray(attr.location);
+    mEnabled.push_back(attr.location);
+  }
+
+  glBindVertexArray(0);
+}
 
-  for (const auto& attrib : mAttribStack) {
-    // TODO: Hack
-    if (attrib.first.name == nullptr)
-      continue;
-    assert(attrib.first.format == GL_FLOAT);
-    vertexAttribPointer(attrib.first.binding_point, attrib.first.size / 4,
-                        GL_FLOAT, GL_FALSE, attrib.first.size,
-                        reinterpret_cast<void*>(attrib.second));
-    // glVertexAttribPointer(attrib.first.binding_point, attrib.first.size,
-    // attrib.first.format, GL_FALSE, attrib.first.size, (void*)attrib.second);
-    glEnableVertexAttribArray(attrib.first.binding_point);
+void VBOBuilder::upload() {
+  if (mHeadless) {
+    mDirtyData.clear();
+    mDirtyIndices.clear();
   }
+  if (mDirtyData.empty() && mDirtyIndices.empty())
+    return;
 
-  mPropogating.clear();
+  // The element buffer binding is part of the VAO
+  glBindVertexArray(VAO);
+  const auto send = [](u32 target, std::vector<Span>& spans,
+                       std::size_t& capacity, const u8* data,
+                       std::size_t size) {
+    if (size > capacity) {
+      // Grown past the buffer: reallocate with headroom for further edits
+      capacity = size + size / 4;
+      glBufferData(target, capacity, nullptr, GL_STATIC_DRAW);
+      glBufferSubData(target, 0, size, data);
+    } else {
+      for (const auto& [begin, end] : spans)
+        glBufferSubData(target, begin, end - begin, data + begin);
+    }
+    spans.clear();
+  };
+  glBindBuffer(GL_ARRAY_BUFFER, mPositionBuf);
+  send(GL_ARRAY_BUFFER, mDirtyData, mDataCapacity, mData.data(), mData.size());
+  send(GL_ELEMENT_ARRAY_BUFFER, mDirtyIndices, mIndexCapacity,
+       reinterpret_cast<const u8*>(mIndices.data()), mIndices.size() * 4);
   glBindVertexArray(0);
 }
 
-void VBOBuilder::bind() { glBindVertexArray(VAO); }
-void VBOBuilder::unbind() { glBindVertexArray(0); }
+void VBOBuilder::clear() {
+  mData.clear();
+  mIndices.clear();
+  mHashes.clear();
+  mUnique.clear();
+  mDeclared.clear();
+  mLayout = {};
+  mLayoutFixed = false;
+  mLayoutMismatch = false;
+  mReservedVertices = 0;
+  mReservedIndices = 0;
+  mWastedBytes = 0;
+  mDirtyData.clear();
+  mDirtyIndices.clear();
+}
+
+void VBOBuilder::bind() {
+  if (!mHeadless)
+    glBindVertexArray(VAO);
+}
+void VBOBuilder::unbind() {
+  if (!mHeadless)
+    glBindVertexArray(0);
+}
 
 } // namespace librii::glhelper
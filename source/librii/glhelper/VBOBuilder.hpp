@@ -1,62 +1,175 @@
 #pragma once
 
 #include <core/common.h>
-#include <map>
+#include <glm/vec4.hpp>
 #include <memory>
 #include <tuple>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace librii::glhelper {
 
 //----------------------------------
 // Vertex attribute generation
-struct VAOEntry {
-  u32 binding_point;
-  const char* name;
 
-  u32 format; // (gl)
-  u32 size;   // (of element / stride)
+// How an attribute is stored. Every format is read as float by the shader.
+enum class VertexFormat : u8 {
+  F32,
+  F16,
+  UNorm8,  // [0, 1]
+  SNorm16, // [-1, 1]
+  U8,      // Integers, read as their value
 };
 
-// WIP..
+// Bytes per component
+u32 GetVertexFormatSize(VertexFormat format);
+
+struct VertexLayout {
+  struct Attribute {
+    u32 location;
+    const char* name;
+    u32 components;
+    VertexFormat format;
+    u32 offset;
+  };
+  // By location
+  std::vector<Attribute> attributes;
+  u32 stride = 0;
+
+  const Attribute* find(u32 location) const;
+};
+
+// Builds one interleaved vertex buffer and an index buffer.
+//
+// Meshes first declare the attributes they write, with the most compact format
+// their source data allows. The layout is fixed when the first range begins:
+// an attribute declared with differing formats falls back to F32.
+//
+// Vertices are then written one at a time. Identical vertices within a range
+// are stored once and referenced by index.
+//
+// Once built, a range may be rewritten: only the bytes it changed are sent by
+// the next upload.
+//
+// A headless builder keeps its data on the CPU and creates no GL objects, for
+// recording commands without a context.
 struct VBOBuilder {
-  VBOBuilder();
+  explicit VBOBuilder(bool headless = false);
   ~VBOBuilder();
 
   std::vector<u8> mData;
   std::vector<u32> mIndices;
 
-  struct VertexArray {
-    VAOEntry descriptor;
-    std::vector<u8> data;
+  // Once the layout is fixed, declarations only check that it can hold the
+  // attribute: see isLayoutCompatible.
+  void declareAttribute(u32 location, const char* name, u32 components,
+                        VertexFormat format);
+  // Every declaration since the layout was fixed fits it
+  bool isLayoutCompatible() const { return !mLayoutMismatch; }
+  // Space for the ranges to come, so that writing does not reallocate
+  void reserve(u32 vertices, u32 indices) {
+    mReservedVertices += vertices;
+    mReservedIndices += indices;
+  }
+
+  // A run of vertices and the indices referencing them
+  struct Range {
+    u32 vtx_ofs = 0;
+    u32 vtx_size = 0;
+    u32 vtx_capacity = 0;
+    u32 idx_ofs = 0;
+    u32 idx_size = 0;
+    u32 idx_capacity = 0;
   };
 
-  // binding_point : data
-  std::map<u32, VertexArray> mPropogating;
+  // Vertices are not shared across ranges
+  void beginRange();
+  // The range written since beginRange
+  Range endRange() const;
+  // Replace `range` by `written`, the range just written. It is moved into the
+  // place of `range` if it fits; otherwise `range` is left unused and moves to
+  // the end.
+  void replaceRange(Range& range, const Range& written);
+  // Bytes of vertices and indices left unused by ranges that moved to the end
+  std::size_t getWastedBytes() const { return mWastedBytes; }
+  // Over half of the data is unused: building anew would reclaim it
+  bool isFragmented() const {
+    return mWastedBytes * 2 > mData.size() + mIndices.size() * 4;
+  }
 
-  void build();
+  // Set an attribute of the vertex being built. Undeclared attributes are
+  // ignored; unset attributes are zero.
+  void setAttribute(u32 location, const glm::vec4& value);
+  // Emit the vertex being built
+  void pushVertex();
 
-  template <typename T> void pushData(u32 binding_point, const T& data) {
-    auto& attrib_buf = mPropogating[binding_point];
-    const std::size_t begin = attrib_buf.data.size();
-    attrib_buf.data.resize(attrib_buf.data.size() + sizeof(T));
-    *reinterpret_cast<T*>(attrib_buf.data.data() + begin) = data;
+  const VertexLayout& getLayout() const { return mLayout; }
+  u32 getNumVertices() const {
+    return mLayout.stride == 0 ? 0 : mData.size() / mLayout.stride;
   }
+  // Vertices merged with an identical vertex
+  u32 getNumMerged() const { return mNumMerged; }
+
+  void build();
+  // Send what changed since build or the last upload
+  void upload();
+  // Discard every vertex and the layout, to declare and build anew
+  void clear();
 
   void bind();
   void unbind();
   u32 getGlId() const { return VAO; }
 
 private:
-  u32 VAO;
-  u32 mPositionBuf, mIndexBuf;
+  bool mHeadless = false;
+  u32 VAO = 0;
+  u32 mPositionBuf = 0, mIndexBuf = 0;
 
-private:
-  template <typename T> void push(const T& data) {
-    const std::size_t begin = mData.size();
-    mData.resize(mData.size() + sizeof(T));
-    *reinterpret_cast<T*>(mData.data() + begin) = data;
-  }
+  // Declared attributes: by location, until the layout is fixed
+  std::vector<VertexLayout::Attribute> mDeclared;
+  VertexLayout mLayout;
+  bool mLayoutFixed = false;
+  bool mLayoutMismatch = false;
+  void fixLayout();
+
+  // Attribute arrays enabled on the VAO
+  std::vector<u32> mEnabled;
+
+  u32 mRangeVertex = 0;
+  u32 mRangeIndex = 0;
+  std::size_t mWastedBytes = 0;
+
+  // Byte spans [begin, end) to send
+  using Span = std::pair<std::size_t, std::size_t>;
+  std::vector<Span> mDirtyData;
+  std::vector<Span> mDirtyIndices;
+  static void markDirty(std::vector<Span>& spans, std::size_t begin,
+                        std::size_t end);
+  std::size_t mDataCapacity = 0;
+  std::size_t mIndexCapacity = 0;
+
+  u32 mReservedVertices = 0;
+  u32 mReservedIndices = 0;
+
+  // The vertex being built
+  std::vector<u8> mVertex;
+
+  // Vertices of the current range, by their bytes
+  struct VertexHash {
+    const VBOBuilder* builder;
+    std::size_t operator()(u32 vertex) const {
+      return builder->mHashes[vertex];
+    }
+  };
+  struct VertexEqual {
+    const VBOBuilder* builder;
+    bool operator()(u32 lhs, u32 rhs) const;
+  };
+  std::vector<u64> mHashes;
+  std::unordered_set<u32, VertexHash, VertexEqual> mUnique{
+      0, VertexHash{this}, VertexEqual{this}};
+  u32 mNumMerged = 0;
 };
 
 } // namespace librii::glhelper
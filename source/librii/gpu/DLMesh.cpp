@@ -1,57 +1,466 @@
 #include "DLMesh.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <optional>
+
 namespace librii::gpu {
 
 // This is always BE
 constexpr oishii::EndianSelect CmdProcEndian = oishii::EndianSelect::Big;
 
-static llvm::Expected<u16> ProcessAttr(
-    oishii::BinaryReader& reader,
-    const std::map<gx::VertexAttribute, gx::VertexAttributeType>& attribstypes,
-    gx::VertexAttribute a, u32 vi) {
-  u16 val = 0;
+static bool IsMatrixIndex(gx::VertexAttribute attr) {
+  return static_cast<u32>(attr) <=
+         static_cast<u32>(gx::VertexAttribute::Texture7MatrixIndex);
+}
+
+static std::optional<gx::VertexBufferKind>
+GetBufferKind(gx::VertexAttribute attr) {
+  using VA = gx::VertexAttribute;
+  switch (attr) {
+  case VA::Position:
+    return gx::VertexBufferKind::position;
+  case VA::Normal:
+    return gx::VertexBufferKind::normal;
+  case VA::Color0:
+  case VA::Color1:
+    return gx::VertexBufferKind::color;
+  case VA::TexCoord0:
+  case VA::TexCoord1:
+  case VA::TexCoord2:
+  case VA::TexCoord3:
+  case VA::TexCoord4:
+  case VA::TexCoord5:
+  case VA::TexCoord6:
+  case VA::TexCoord7:
+    return gx::VertexBufferKind::textureCoordinate;
+  default:
+    return std::nullopt;
+  }
+}
+
+static u32 GetGenericSize(gx::VertexBufferType::Generic type) {
+  switch (type) {
+  case gx::VertexBufferType::Generic::u8:
+  case gx::VertexBufferType::Generic::s8:
+    return 1;
+  case gx::VertexBufferType::Generic::u16:
+  case gx::VertexBufferType::Generic::s16:
+    return 2;
+  case gx::VertexBufferType::Generic::f32:
+    return 4;
+  default:
+    return 0;
+  }
+}
 
-  switch (attribstypes.at(a)) {
-  case gx::VertexAttributeType::None:
+u32 GetDirectValueSize(gx::VertexAttribute attr,
+                       const gx::VQuantization& format) {
+  const auto kind = GetBufferKind(attr);
+  if (!kind)
+    return 0;
+  if (*kind == gx::VertexBufferKind::color)
+    return gx::computeColorSize(format.type.color);
+  if (*kind == gx::VertexBufferKind::normal &&
+      format.comp.normal != gx::VertexComponentCount::Normal::xyz)
+    return 0;
+  return static_cast<u32>(gx::computeComponentCount(*kind, format.comp)) *
+         GetGenericSize(format.type.generic);
+}
+
+llvm::Expected<VertexLayout>
+CompileVertexLayout(const gx::VertexDescriptor& descriptor,
+                    const VertexFormats* formats) {
+  VertexLayout layout;
+  bool uniform = true;
+
+  for (int a = 0; a < (int)gx::VertexAttribute::Max; ++a) {
+    if (!(descriptor.mBitfield & (1 << a)))
+      continue;
+    const auto attr = static_cast<gx::VertexAttribute>(a);
+    const auto found = descriptor.mAttributes.find(attr);
+    if (found == descriptor.mAttributes.end()) {
+      return llvm::createStringError(std::errc::executable_format_error,
+                                     "Unknown vertex attribute format.");
+    }
+
+    u8 width = 0;
+    bool direct = false;
+    switch (found->second) {
+    case gx::VertexAttributeType::None:
+      continue;
+    case gx::VertexAttributeType::Byte:
+      width = 1;
+      break;
+    case gx::VertexAttributeType::Short:
+      width = 2;
+      break;
+    case gx::VertexAttributeType::Direct:
+      if (IsMatrixIndex(attr)) {
+        // As PNM indices are always direct, we
+        // still use them in an all-indexed vertex
+        width = 1;
+        break;
+      }
+      direct = true;
+      if (formats == nullptr) {
+        layout.sized = false;
+        break;
+      }
+      width = static_cast<u8>(GetDirectValueSize(attr, (*formats)[a]));
+      if (width == 0) {
+        return llvm::createStringError(
+            std::errc::executable_format_error,
+            "Direct vertex data of this format is unsupported.");
+      }
+      layout.formats[a] = (*formats)[a];
+      break;
+    default:
+      return llvm::createStringError(std::errc::executable_format_error,
+                                     "Unknown vertex attribute format.");
+    }
+
+    if (direct || (layout.numFields != 0 && layout.fields[0].width != width))
+      uniform = false;
+    layout.fields[layout.numFields++] = {.offset = layout.stride,
+                                         .width = width,
+                                         .attribute = static_cast<u8>(a),
+                                         .direct = direct};
+    layout.stride += width;
+    layout.mask |= 1u << a;
+    if (direct)
+      layout.directMask |= 1u << a;
+  }
+
+  if (uniform && layout.numFields != 0)
+    layout.uniformWidth = layout.fields[0].width;
+  return layout;
+}
+
+template <u8 Width> static inline u16 LoadIndex(const u8* p) {
+  if constexpr (Width == 1)
+    return p[0];
+  else
+    return static_cast<u16>((p[0] << 8) | p[1]);
+}
+
+// Every field has the same width: offsets are implied and the inner loop has
+// no per-field branch. Covers the common all-Short and all-Byte meshes.
+//
+// The list is packed in layout order, one column per field, so decoding is a
+// straight copy of the index stream.
+template <u8 Width>
+static void DecodeUniform(const VertexLayout& layout, const u8* data,
+                          std::span<u16> out, std::span<u16> maxima) {
+  const std::size_t numFields = layout.numFields;
+  for (std::size_t i = 0; i < out.size(); i += numFields) {
+    for (std::size_t f = 0; f < numFields; ++f) {
+      const u16 val = LoadIndex<Width>(data);
+      data += Width;
+      out[i + f] = val;
+      maxima[f] = std::max(maxima[f], val);
+    }
+  }
+}
+
+static void DecodeMixed(const VertexLayout& layout, const u8* data,
+                        std::span<u16> out, std::span<u16> maxima) {
+  const auto fields = layout.getFields();
+  for (std::size_t i = 0; i < out.size(); i += fields.size()) {
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      if (fields[f].direct) {
+        out[i + f] = 0;
+        continue;
+      }
+      const u8* p = data + fields[f].offset;
+      const u16 val = fields[f].width == 1 ? LoadIndex<1>(p) : LoadIndex<2>(p);
+      out[i + f] = val;
+      maxima[f] = std::max(maxima[f], val);
+    }
+    data += layout.stride;
+  }
+}
+
+void DecodeVertices(const VertexLayout& layout, const u8* data,
+                    gx::IndexedVertexList& out, std::span<u16> maxima) {
+  assert(maxima.size() >= layout.numFields);
+  out.setMask(layout.mask);
+  assert(out.getStride() == layout.numFields);
+  switch (layout.uniformWidth) {
+  case 1:
+    DecodeUniform<1>(layout, data, out.getPacked(), maxima);
     break;
-  case gx::VertexAttributeType::Byte:
-    val = reader.read<u8, CmdProcEndian, true>();
-    assert(val != 0xff);
+  case 2:
+    DecodeUniform<2>(layout, data, out.getPacked(), maxima);
     break;
-  case gx::VertexAttributeType::Short:
-    val = reader.read<u16, CmdProcEndian, true>();
-    if (val == 0xffff) {
-      printf("Index: %u, Attribute: %x\n", vi, (u32)a);
-      reader.warnAt("Disabled vertex", reader.tell() - 2, reader.tell());
-    }
-    assert(val != 0xffff);
+  default:
+    DecodeMixed(layout, data, out.getPacked(), maxima);
     break;
-  case gx::VertexAttributeType::Direct:
-    if (a != gx::VertexAttribute::PositionNormalMatrixIndex &&
-        a != gx::VertexAttribute::Texture0MatrixIndex &&
-        a != gx::VertexAttribute::Texture1MatrixIndex) {
+  }
+}
 
-      return llvm::createStringError(std::errc::executable_format_error,
-                                     "Direct vertex data is unsupported.");
+static u16 LoadU16(const u8* p) { return static_cast<u16>((p[0] << 8) | p[1]); }
+static u32 LoadU32(const u8* p) {
+  return (static_cast<u32>(p[0]) << 24) | (static_cast<u32>(p[1]) << 16) |
+         (static_cast<u32>(p[2]) << 8) | static_cast<u32>(p[3]);
+}
+
+static f32 DecodeGeneric(const u8* p, gx::VertexBufferType::Generic type,
+                         u32 divisor) {
+  const f32 scale = 1.0f / static_cast<f32>(1 << divisor);
+  switch (type) {
+  case gx::VertexBufferType::Generic::u8:
+    return static_cast<f32>(p[0]) * scale;
+  case gx::VertexBufferType::Generic::s8:
+    return static_cast<f32>(static_cast<s8>(p[0])) * scale;
+  case gx::VertexBufferType::Generic::u16:
+    return static_cast<f32>(LoadU16(p)) * scale;
+  case gx::VertexBufferType::Generic::s16:
+    return static_cast<f32>(static_cast<s16>(LoadU16(p))) * scale;
+  case gx::VertexBufferType::Generic::f32:
+    return std::bit_cast<f32>(LoadU32(p));
+  default:
+    return 0.0f;
+  }
+}
+
+static glm::vec4 DecodeDirectValue(const u8* p, gx::VertexAttribute attr,
+                                   const gx::VQuantization& format) {
+  const auto kind = *GetBufferKind(attr);
+  if (kind == gx::VertexBufferKind::color) {
+    const gx::ColorF32 c = gx::decodeColorComponents(p, format.type.color);
+    return {c.r, c.g, c.b, c.a};
+  }
+  glm::vec4 result{0.0f};
+  const auto count = gx::computeComponentCount(kind, format.comp);
+  const u32 size = GetGenericSize(format.type.generic);
+  for (std::size_t i = 0; i < count; ++i, p += size)
+    result[i] = DecodeGeneric(p, format.type.generic, format.divisor);
+  return result;
+}
+
+void DecodeDirectVertices(const VertexLayout& layout, const u8* data,
+                          gx::IndexedVertexList& out, IDirectVertexSink& sink,
+                          std::span<u16> maxima) {
+  assert(layout.sized);
+  assert(out.getMask() == layout.mask);
+  if (layout.directMask == 0)
+    return;
+  const auto fields = layout.getFields();
+  const auto packed = out.getPacked();
+  for (std::size_t v = 0; v < out.size(); ++v) {
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      if (!fields[f].direct)
+        continue;
+      const auto attr = static_cast<gx::VertexAttribute>(fields[f].attribute);
+      const u16 index = sink.addDirect(
+          attr, DecodeDirectValue(data + fields[f].offset, attr,
+                                  layout.formats[fields[f].attribute]));
+      packed[v * fields.size() + f] = index;
+      maxima[f] = std::max(maxima[f], index);
     }
-    // As PNM indices are always direct, we
-    // still use them in an all-indexed vertex
-    val = reader.read<u8, CmdProcEndian, true>();
-    assert(val != 0xff);
+    data += layout.stride;
+  }
+}
+
+static void StoreU16(u8* p, u16 val) {
+  p[0] = static_cast<u8>(val >> 8);
+  p[1] = static_cast<u8>(val);
+}
+static void StoreU32(u8* p, u32 val) {
+  StoreU16(p, static_cast<u16>(val >> 16));
+  StoreU16(p + 2, static_cast<u16>(val));
+}
+
+template <typename T> static T Quantize(f32 v, u32 divisor) {
+  const f32 scaled = roundf(v * static_cast<f32>(1 << divisor));
+  return static_cast<T>(
+      std::clamp(scaled, static_cast<f32>(std::numeric_limits<T>::min()),
+                 static_cast<f32>(std::numeric_limits<T>::max())));
+}
+
+static void EncodeGeneric(u8* p, f32 v, gx::VertexBufferType::Generic type,
+                          u32 divisor) {
+  switch (type) {
+  case gx::VertexBufferType::Generic::u8:
+    p[0] = Quantize<u8>(v, divisor);
+    break;
+  case gx::VertexBufferType::Generic::s8:
+    p[0] = static_cast<u8>(Quantize<s8>(v, divisor));
+    break;
+  case gx::VertexBufferType::Generic::u16:
+    StoreU16(p, Quantize<u16>(v, divisor));
+    break;
+  case gx::VertexBufferType::Generic::s16:
+    StoreU16(p, static_cast<u16>(Quantize<s16>(v, divisor)));
+    break;
+  case gx::VertexBufferType::Generic::f32:
+    StoreU32(p, std::bit_cast<u32>(v));
     break;
   default:
-    return llvm::createStringError(std::errc::executable_format_error,
-                                   "Unknown vertex attribute format.");
+    break;
   }
+}
+
+static void EncodeDirectValue(u8* p, gx::VertexAttribute attr,
+                              const gx::VQuantization& format,
+                              const glm::vec4& value) {
+  const auto kind = *GetBufferKind(attr);
+  if (kind == gx::VertexBufferKind::color) {
+    const gx::ColorF32 c{std::clamp(value.r, 0.0f, 1.0f),
+                         std::clamp(value.g, 0.0f, 1.0f),
+                         std::clamp(value.b, 0.0f, 1.0f),
+                         std::clamp(value.a, 0.0f, 1.0f)};
+    gx::encodeColorComponents(p, c, format.type.color);
+    return;
+  }
+  const auto count = gx::computeComponentCount(kind, format.comp);
+  const u32 size = GetGenericSize(format.type.generic);
+  for (std::size_t i = 0; i < count; ++i, p += size)
+    EncodeGeneric(p, value[i], format.type.generic, format.divisor);
+}
+
+template <u8 Width> static inline void StoreIndex(u8* p, u16 val) {
+  if constexpr (Width == 1) {
+    p[0] = static_cast<u8>(val);
+  } else {
+    p[0] = static_cast<u8>(val >> 8);
+    p[1] = static_cast<u8>(val);
+  }
+}
 
-  return val;
+// Column of each layout field in the list's packed stream; -1 encodes zero
+static std::array<s32, (u64)gx::VertexAttribute::Max>
+GetColumns(const VertexLayout& layout, const gx::IndexedVertexList& verts) {
+  std::array<s32, (u64)gx::VertexAttribute::Max> columns;
+  for (u32 f = 0; f < layout.numFields; ++f)
+    columns[f] = verts.getColumn(
+        static_cast<gx::VertexAttribute>(layout.fields[f].attribute));
+  return columns;
+}
+
+template <u8 Width>
+static u8* EncodeUniform(u8* dst, const VertexLayout& layout,
+                         const gx::IndexedVertexList& verts) {
+  const auto packed = verts.getPacked();
+  // Stored exactly as laid out: a straight copy
+  if (verts.getMask() == layout.mask) {
+    for (const u16 val : packed) {
+      StoreIndex<Width>(dst, val);
+      dst += Width;
+    }
+    return dst;
+  }
+
+  const auto columns = GetColumns(layout, verts);
+  const u32 stride = verts.getStride();
+  for (std::size_t v = 0; v < verts.size(); ++v) {
+    for (u32 f = 0; f < layout.numFields; ++f) {
+      StoreIndex<Width>(dst,
+                        columns[f] < 0 ? 0 : packed[v * stride + columns[f]]);
+      dst += Width;
+    }
+  }
+  return dst;
+}
+
+static u8* EncodeMixed(u8* dst, const VertexLayout& layout,
+                       const gx::IndexedVertexList& verts,
+                       const IDirectVertexSource* direct) {
+  const auto fields = layout.getFields();
+  const auto packed = verts.getPacked();
+  const auto columns = GetColumns(layout, verts);
+  const u32 stride = verts.getStride();
+  for (std::size_t v = 0; v < verts.size(); ++v) {
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      const u16 val = columns[f] < 0 ? 0 : packed[v * stride + columns[f]];
+      if (fields[f].direct) {
+        const auto attr = static_cast<gx::VertexAttribute>(fields[f].attribute);
+        EncodeDirectValue(dst + fields[f].offset, attr,
+                          layout.formats[fields[f].attribute],
+                          direct->getDirect(attr, val));
+      } else if (fields[f].width == 1)
+        StoreIndex<1>(dst + fields[f].offset, val);
+      else
+        StoreIndex<2>(dst + fields[f].offset, val);
+    }
+    dst += layout.stride;
+  }
+  return dst;
+}
+
+u32 GetMeshDisplayListSize(const VertexLayout& layout,
+                           std::span<const gx::IndexedPrimitive> prims) {
+  u32 size = 0;
+  for (const auto& prim : prims)
+    size += 3 + static_cast<u32>(prim.mVertices.size()) * layout.stride;
+  return size;
+}
+
+u32 EncodeMeshDisplayList(u8* dst, const VertexLayout& layout,
+                          std::span<const gx::IndexedPrimitive> prims,
+                          const IDirectVertexSource* direct) {
+  assert(layout.sized);
+  assert(layout.directMask == 0 || direct != nullptr);
+  u8* const begin = dst;
+  for (const auto& prim : prims) {
+    assert(prim.mVertices.size() <= 0xffff);
+    *dst++ = static_cast<u8>(gx::EncodeDrawPrimitiveCommand(prim.mType));
+    StoreIndex<2>(dst, static_cast<u16>(prim.mVertices.size()));
+    dst += 2;
+
+    switch (layout.uniformWidth) {
+    case 1:
+      dst = EncodeUniform<1>(dst, layout, prim.mVertices);
+      break;
+    case 2:
+      dst = EncodeUniform<2>(dst, layout, prim.mVertices);
+      break;
+    default:
+      dst = EncodeMixed(dst, layout, prim.mVertices, direct);
+      break;
+    }
+  }
+  return static_cast<u32>(dst - begin);
+}
+
+void EncodeMeshDisplayList(oishii::Writer& writer, const VertexLayout& layout,
+                           std::span<const gx::IndexedPrimitive> prims,
+                           const IDirectVertexSource* direct) {
+  const u32 size = GetMeshDisplayListSize(layout, prims);
+  const u32 start = writer.tell();
+  if (start + size > writer.getBufSize())
+    writer.resize(start + size);
+
+  [[maybe_unused]] const u32 written =
+      EncodeMeshDisplayList(writer.getDataBlockStart() + start, layout, prims,
+                            direct);
+  assert(written == size);
+  writer.seekSet(start + size);
 }
 
 llvm::Error
 DecodeMeshDisplayList(oishii::BinaryReader& reader, u32 start, u32 size,
                       IMeshDLDelegate& delegate,
                       const librii::gx::VertexDescriptor& descriptor,
-                      std::map<gx::VertexBufferAttribute, u32>* optUsageMap) {
+                      std::map<gx::VertexBufferAttribute, u32>* optUsageMap,
+                      const VertexFormats* formats, IDirectVertexSink* direct) {
+  auto layoutOrErr = CompileVertexLayout(descriptor, formats);
+  if (auto e = layoutOrErr.takeError())
+    return e;
+  const VertexLayout& layout = *layoutOrErr;
+  if (!layout.sized || (layout.directMask != 0 && direct == nullptr)) {
+    return llvm::createStringError(std::errc::executable_format_error,
+                                   "Direct vertex data is unsupported here.");
+  }
+  const auto fields = layout.getFields();
+
+  // Maximum index of each field, across the entire display list
+  std::array<u16, (u64)gx::VertexAttribute::Max> maxima{};
+  bool anyVertices = false;
+
   oishii::Jump<oishii::Whence::Set> g(reader, start);
 
   const u32 end = reader.tell() + size;
@@ -72,24 +481,40 @@ DecodeMeshDisplayList(oishii::BinaryReader& reader, u32 start, u32 size,
     auto& prim = delegate.addIndexedPrimitive(
         gx::DecodeDrawPrimitiveCommand(tag), nVerts);
 
-    for (u16 vi = 0; vi < nVerts; ++vi) {
-      for (int a = 0; a < (int)gx::VertexAttribute::Max; ++a) {
-        if (descriptor.mBitfield & (1 << a)) {
-          const auto attr = static_cast<gx::VertexAttribute>(a);
-          const auto attr_buf = static_cast<gx::VertexBufferAttribute>(a);
-
-          auto valOrErr = ProcessAttr(reader, descriptor.mAttributes, attr, vi);
-          if (auto e = valOrErr.takeError())
-            return e;
-
-          const u16 val = *valOrErr;
+    const u32 primStart = reader.tell();
+    const u32 primSize = static_cast<u32>(nVerts) * layout.stride;
+    if (primStart + primSize > reader.endpos()) {
+      return llvm::createStringError(std::errc::executable_format_error,
+                                     "Mesh display list is truncated.");
+    }
 
-          prim.mVertices[vi][attr] = val;
+    std::array<u16, (u64)gx::VertexAttribute::Max> primMaxima{};
+    assert(prim.mVertices.size() == nVerts);
+    DecodeVertices(layout, reader.getStreamStart() + primStart,
+                   prim.mVertices, primMaxima);
+    if (direct != nullptr)
+      DecodeDirectVertices(layout, reader.getStreamStart() + primStart,
+                           prim.mVertices, *direct, primMaxima);
+    reader.seekSet(primStart + primSize);
 
-          if (optUsageMap && (*optUsageMap)[attr_buf] <= val)
-            (*optUsageMap)[attr_buf] = val;
-        }
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      // A primitive using the all-ones index has its maximum equal to it
+      const u16 disabled = fields[f].width == 1 ? 0xff : 0xffff;
+      if (!fields[f].direct && primMaxima[f] == disabled) {
+        printf("Attribute: %x\n", (u32)fields[f].attribute);
+        reader.warnAt("Disabled vertex", primStart, primStart + primSize);
+        assert(!"Disabled vertex");
       }
+      maxima[f] = std::max(maxima[f], primMaxima[f]);
+    }
+    anyVertices |= nVerts != 0;
+  }
+
+  if (optUsageMap && anyVertices) {
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      auto& usage = (*optUsageMap)[static_cast<gx::VertexBufferAttribute>(
+          fields[f].attribute)];
+      usage = std::max<u32>(usage, maxima[f]);
     }
   }
 
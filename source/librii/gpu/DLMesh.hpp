@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
 #include <librii/gx.h>
 #include <llvm/Support/Error.h>
+#include <glm/vec4.hpp>
 #include <map>
 #include <oishii/reader/binary_reader.hxx>
+#include <oishii/writer/binary_writer.hxx>
+#include <span>
 
 namespace librii::gpu {
 
@@ -12,10 +16,137 @@ struct IMeshDLDelegate {
                                                     u16 nVerts) = 0;
 };
 
+//! @brief Values of attributes sent directly in a display list.
+//!
+//! A mesh stores an index for every attribute, direct or not. For direct
+//! attributes the index refers to a value held here, and the value is written
+//! inline in place of the index.
+//!
+//! Positions, normals and texture coordinates are in model units (unused
+//! components are zero); colors are RGBA in [0, 1].
+//!
+struct IDirectVertexSource {
+  virtual ~IDirectVertexSource() = default;
+  virtual glm::vec4 getDirect(gx::VertexAttribute attr, u16 index) const = 0;
+};
+//! Stores values decoded from direct attributes; see IDirectVertexSource.
+struct IDirectVertexSink {
+  virtual ~IDirectVertexSink() = default;
+  //! @return The index now referring to `value`.
+  virtual u16 addDirect(gx::VertexAttribute attr, const glm::vec4& value) = 0;
+};
+
+//! Format (VAT entry) of each attribute. Only direct data depends on it.
+using VertexFormats =
+    std::array<gx::VQuantization, (u64)gx::VertexAttribute::Max>;
+
+//! @brief Size in bytes of a value of `attr` sent directly, or 0 if the
+//! format cannot be sent directly (normal-binormal-tangent triplets).
+u32 GetDirectValueSize(gx::VertexAttribute attr,
+                       const gx::VQuantization& format);
+
+//! @brief A VertexDescriptor flattened into the byte layout of a single
+//! vertex in a display list.
+//!
+//! Compiled once per mesh so that decoding does not consult the descriptor's
+//! attribute map for every vertex.
+//!
+struct VertexLayout {
+  struct Field {
+    u8 offset;    //!< Byte offset within the vertex.
+    u8 width;     //!< Size of the index in bytes: 1 or 2. For direct data,
+                  //!< the size of the value.
+    u8 attribute; //!< Destination gx::VertexAttribute slot.
+    bool direct = false; //!< Sent as a value; see IDirectVertexSource.
+  };
+  std::array<Field, (u64)gx::VertexAttribute::Max> fields{};
+  u8 numFields = 0;
+  //! Size of one vertex in bytes.
+  u8 stride = 0;
+  //! Width shared by every field, or 0 if the widths are mixed.
+  u8 uniformWidth = 0;
+  //! Attributes present, as `1 << VertexAttribute` bits. Fields are in
+  //! attribute order, so this also fixes gx::IndexedVertexList's packing.
+  u32 mask = 0;
+  //! Fields sent as values, as `1 << VertexAttribute` bits. Direct matrix
+  //! indices are plain indices and not included.
+  u32 directMask = 0;
+  //! False if direct fields were compiled without their formats. Such a
+  //! layout still identifies vertices, but cannot code display lists.
+  bool sized = true;
+  //! Formats of the direct fields.
+  VertexFormats formats{};
+
+  std::span<const Field> getFields() const { return {fields.data(), numFields}; }
+};
+
+//! @brief Compile a vertex descriptor into a flat per-vertex layout.
+//!
+//! @param[in] formats Formats of the vertex attributes, to size direct data.
+//!                    If null, direct fields are given no width and the layout
+//!                    is not `sized`.
+//!
+llvm::Expected<VertexLayout>
+CompileVertexLayout(const gx::VertexDescriptor& descriptor,
+                    const VertexFormats* formats = nullptr);
+
+//! @brief Decode a run of vertices laid out contiguously in memory.
+//!
+//! @param[in] layout     Compiled vertex layout.
+//! @param[in] data       Pointer to the first vertex. Must hold
+//!                       `out.size() * layout.stride` bytes.
+//! @param[out] out       Vertices to fill. Its mask is set to the layout's, so
+//!                       attributes absent from the layout are dropped.
+//! @param[in,out] maxima Running maximum index of each layout field.
+//!
+//! Direct fields are left zero, and their maxima untouched; fill them in with
+//! DecodeDirectVertices.
+//!
+void DecodeVertices(const VertexLayout& layout, const u8* data,
+                    gx::IndexedVertexList& out, std::span<u16> maxima);
+
+//! @brief Decode the direct fields of vertices read by DecodeVertices, handing
+//! their values to `sink` and storing the indices it returns.
+//!
+void DecodeDirectVertices(const VertexLayout& layout, const u8* data,
+                          gx::IndexedVertexList& out, IDirectVertexSink& sink,
+                          std::span<u16> maxima);
+
+//! @brief Size in bytes of the draw commands encoding a set of primitives
+//! (without padding).
+//!
+u32 GetMeshDisplayListSize(const VertexLayout& layout,
+                           std::span<const gx::IndexedPrimitive> prims);
+
+//! @brief Encode draw commands for a set of primitives into a buffer.
+//!
+//! @param[out] dst    Destination; must hold GetMeshDisplayListSize() bytes.
+//! @param[in]  direct Values of direct fields. Required if the layout has any.
+//!
+//! @return The number of bytes written.
+//!
+u32 EncodeMeshDisplayList(u8* dst, const VertexLayout& layout,
+                          std::span<const gx::IndexedPrimitive> prims,
+                          const IDirectVertexSource* direct = nullptr);
+
+//! @brief Encode draw commands for a set of primitives at the writer's
+//! current position, growing its buffer once up front.
+//!
+void EncodeMeshDisplayList(oishii::Writer& writer, const VertexLayout& layout,
+                           std::span<const gx::IndexedPrimitive> prims,
+                           const IDirectVertexSource* direct = nullptr);
+
+//! @brief Decode a mesh display list.
+//!
+//! Direct data other than matrix indices needs `formats` and `direct`. The
+//! indices `direct` returns are counted in `optUsageMap`.
+//!
 llvm::Error
 DecodeMeshDisplayList(oishii::BinaryReader& reader, u32 start, u32 size,
                       IMeshDLDelegate& delegate,
                       const gx::VertexDescriptor& descriptor,
-                      std::map<gx::VertexBufferAttribute, u32>* optUsageMap);
+                      std::map<gx::VertexBufferAttribute, u32>* optUsageMap,
+                      const VertexFormats* formats = nullptr,
+                      IDirectVertexSink* direct = nullptr);
 
 } // namespace librii::gpu
@@ -385,10 +385,93 @@ void QDisplayListVertexSetupHandler::onCommandCP(const QCPCommand& token) {
   case 0x60:
     mGpuMesh.VCD.Hex |= (token.val << 17);
     break;
+  case 0x70:
+    mGpuMesh.VAT0.Hex = token.val;
+    break;
+  case 0x80:
+    mGpuMesh.VAT1.Hex = token.val;
+    break;
+  case 0x90:
+    mGpuMesh.VAT2.Hex = token.val;
+    break;
   default:
     break;
   }
 }
 void QDisplayListVertexSetupHandler::onStreamEnd() {}
 
+gx::VQuantization GetVertexFormat(const GPUMesh& mesh,
+                                  gx::VertexAttribute attr) {
+  using namespace gx;
+  const auto& g0 = mesh.VAT0;
+  const auto& g1 = mesh.VAT1;
+  const auto& g2 = mesh.VAT2;
+
+  VQuantization q;
+  q.stride = 0;
+  auto texcoord = [&](u32 elements, u32 format, u32 frac) {
+    q.comp = VertexComponentCount(
+        static_cast<VertexComponentCount::TextureCoordinate>(elements));
+    q.type = VertexBufferType(static_cast<VertexBufferType::Generic>(format));
+    q.divisor = static_cast<u8>(frac);
+  };
+  switch (attr) {
+  case VertexAttribute::Position:
+    q.comp = VertexComponentCount(
+        static_cast<VertexComponentCount::Position>(g0.PosElements));
+    q.type =
+        VertexBufferType(static_cast<VertexBufferType::Generic>(g0.PosFormat));
+    q.divisor = static_cast<u8>(g0.PosFrac);
+    break;
+  case VertexAttribute::Normal:
+  case VertexAttribute::NormalBinormalTangent:
+    q.comp = VertexComponentCount(
+        g0.NormalElements == 0 ? VertexComponentCount::Normal::xyz
+        : g0.NormalIndex3      ? VertexComponentCount::Normal::nbt3
+                               : VertexComponentCount::Normal::nbt);
+    q.type = VertexBufferType(
+        static_cast<VertexBufferType::Generic>(g0.NormalFormat));
+    break;
+  case VertexAttribute::Color0:
+    q.comp = VertexComponentCount(
+        static_cast<VertexComponentCount::Color>(g0.Color0Elements));
+    q.type =
+        VertexBufferType(static_cast<VertexBufferType::Color>(g0.Color0Comp));
+    break;
+  case VertexAttribute::Color1:
+    q.comp = VertexComponentCount(
+        static_cast<VertexComponentCount::Color>(g0.Color1Elements));
+    q.type =
+        VertexBufferType(static_cast<VertexBufferType::Color>(g0.Color1Comp));
+    break;
+  case VertexAttribute::TexCoord0:
+    texcoord(g0.Tex0CoordElements, g0.Tex0CoordFormat, g0.Tex0Frac);
+    break;
+  case VertexAttribute::TexCoord1:
+    texcoord(g1.Tex1CoordElements, g1.Tex1CoordFormat, g1.Tex1Frac);
+    break;
+  case VertexAttribute::TexCoord2:
+    texcoord(g1.Tex2CoordElements, g1.Tex2CoordFormat, g1.Tex2Frac);
+    break;
+  case VertexAttribute::TexCoord3:
+    texcoord(g1.Tex3CoordElements, g1.Tex3CoordFormat, g1.Tex3Frac);
+    break;
+  case VertexAttribute::TexCoord4:
+    texcoord(g1.Tex4CoordElements, g1.Tex4CoordFormat, g2.Tex4Frac);
+    break;
+  case VertexAttribute::TexCoord5:
+    texcoord(g2.Tex5CoordElements, g2.Tex5CoordFormat, g2.Tex5Frac);
+    break;
+  case VertexAttribute::TexCoord6:
+    texcoord(g2.Tex6CoordElements, g2.Tex6CoordFormat, g2.Tex6Frac);
+    break;
+  case VertexAttribute::TexCoord7:
+    texcoord(g2.Tex7CoordElements, g2.Tex7CoordFormat, g2.Tex7Frac);
+    break;
+  default:
+    break;
+  }
+  return q;
+}
+
 } // namespace librii::gpu
@@ -99,4 +99,9 @@ public:
   GPUMesh mGpuMesh;
 };
 
+//! Format of `attr` in the vertex format set up by a mesh's display list.
+//! The stride is left zero; it only applies to vertex buffers.
+gx::VQuantization GetVertexFormat(const GPUMesh& mesh,
+                                  gx::VertexAttribute attr);
+
 } // namespace librii::gpu
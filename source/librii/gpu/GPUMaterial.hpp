@@ -706,6 +706,10 @@ union GenMode {
 };
 struct GPUMesh {
   TVtxDesc VCD;
+  // Vertex format 0, the only one G3D uses
+  UVAT_group0 VAT0;
+  UVAT_group1 VAT1;
+  UVAT_group2 VAT2;
 };
 #pragma pack()
 
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <array>
+#include <cassert>
+#include <iterator>
 #include <librii/gx/Vertex.hpp>
 #include <map>
+#include <span>
+#include <type_traits>
 #include <vector>
 
 namespace librii::gx {
@@ -52,12 +56,339 @@ struct IndexedVertex {
   bool operator==(const IndexedVertex& rhs) const = default;
 
 private:
-  std::array<u16, (u64)VertexAttribute::Max> indices;
+  std::array<u16, (u64)VertexAttribute::Max> indices{};
+};
+
+//! @brief Vertices of a primitive, storing only the attributes in use.
+//!
+//! Each vertex is a run of getStride() indices: one per set bit of getMask(),
+//! in attribute order. A position + normal + UV mesh takes 6 bytes per vertex
+//! instead of sizeof(IndexedVertex), and getPacked() exposes that stream to
+//! the hot loops directly.
+//!
+//! Elements are accessed through Ref/ConstRef proxies that behave like an
+//! IndexedVertex. Loops over a single attribute should use getAttribute(), a
+//! strided view of one column of the stream.
+//!
+//! The mask is the polygon's vertex descriptor, set with setMask() before
+//! vertices are written. Attributes not in the mask read as zero; writing one
+//! is an error.
+//!
+//! The stream stays interleaved rather than one array per attribute: that is
+//! the display list layout, so decoding and encoding are flat copies.
+//!
+class IndexedVertexList {
+  template <bool Const> class BasicRef {
+    using List =
+        std::conditional_t<Const, const IndexedVertexList, IndexedVertexList>;
+
+  public:
+    BasicRef(List& list, std::size_t index) : mList(&list), mIndex(index) {}
+    // Element semantics: assigning copies the vertex, not the reference
+    BasicRef& operator=(const BasicRef& rhs)
+      requires(!Const)
+    {
+      return *this = static_cast<IndexedVertex>(rhs);
+    }
+    BasicRef& operator=(const IndexedVertex& rhs)
+      requires(!Const)
+    {
+      mList->set(mIndex, rhs);
+      return *this;
+    }
+
+    u16 operator[](VertexAttribute attr) const {
+      return mList->get(mIndex, attr);
+    }
+    u16& operator[](VertexAttribute attr)
+      requires(!Const)
+    {
+      return mList->at(mIndex, attr);
+    }
+    operator IndexedVertex() const { return mList->get(mIndex); }
+    bool operator==(const IndexedVertex& rhs) const {
+      return static_cast<IndexedVertex>(*this) == rhs;
+    }
+
+  private:
+    friend class BasicRef<true>;
+    List* mList;
+    std::size_t mIndex;
+  };
+
+  template <bool Const> class BasicIterator {
+    using List =
+        std::conditional_t<Const, const IndexedVertexList, IndexedVertexList>;
+
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = IndexedVertex;
+    using difference_type = std::ptrdiff_t;
+    using reference = BasicRef<Const>;
+    using pointer = void;
+
+    BasicIterator() = default;
+    BasicIterator(List& list, std::size_t index)
+        : mList(&list), mIndex(index) {}
+
+    reference operator*() const { return {*mList, mIndex}; }
+    reference operator[](difference_type n) const {
+      return {*mList, mIndex + n};
+    }
+    BasicIterator& operator++() {
+      ++mIndex;
+      return *this;
+    }
+    BasicIterator operator++(int) { return {*mList, mIndex++}; }
+    BasicIterator& operator--() {
+      --mIndex;
+      return *this;
+    }
+    BasicIterator operator--(int) { return {*mList, mIndex--}; }
+    BasicIterator& operator+=(difference_type n) {
+      mIndex += n;
+      return *this;
+    }
+    BasicIterator& operator-=(difference_type n) {
+      mIndex -= n;
+      return *this;
+    }
+    BasicIterator operator+(difference_type n) const {
+      return {*mList, mIndex + n};
+    }
+    BasicIterator operator-(difference_type n) const {
+      return {*mList, mIndex - n};
+    }
+    difference_type operator-(const BasicIterator& rhs) const {
+      return static_cast<difference_type>(mIndex) -
+             static_cast<difference_type>(rhs.mIndex);
+    }
+    bool operator==(const BasicIterator& rhs) const {
+      return mIndex == rhs.mIndex;
+    }
+    auto operator<=>(const BasicIterator& rhs) const {
+      return mIndex <=> rhs.mIndex;
+    }
+
+  private:
+    List* mList = nullptr;
+    std::size_t mIndex = 0;
+  };
+
+  template <bool Const> class BasicAttributeView {
+    using Pointer = std::conditional_t<Const, const u16*, u16*>;
+    using Reference = std::conditional_t<Const, const u16&, u16&>;
+
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = u16;
+      using difference_type = std::ptrdiff_t;
+      using reference = Reference;
+      using pointer = Pointer;
+
+      iterator() = default;
+      iterator(Pointer data, u32 stride, std::size_t index)
+          : mData(data), mStride(stride), mIndex(index) {}
+
+      reference operator*() const { return mData[mIndex * mStride]; }
+      iterator& operator++() {
+        ++mIndex;
+        return *this;
+      }
+      iterator operator++(int) { return {mData, mStride, mIndex++}; }
+      bool operator==(const iterator& rhs) const {
+        return mIndex == rhs.mIndex;
+      }
+
+    private:
+      Pointer mData = nullptr;
+      u32 mStride = 0;
+      std::size_t mIndex = 0;
+    };
+
+    BasicAttributeView() = default;
+    BasicAttributeView(Pointer data, u32 stride, std::size_t size)
+        : mData(data), mStride(stride), mSize(size) {}
+
+    std::size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    Reference operator[](std::size_t i) const {
+      assert(i < mSize);
+      return mData[i * mStride];
+    }
+    iterator begin() const { return {mData, mStride, 0}; }
+    iterator end() const { return {mData, mStride, mSize}; }
+
+  private:
+    Pointer mData = nullptr;
+    u32 mStride = 0;
+    std::size_t mSize = 0;
+  };
+
+public:
+  using Ref = BasicRef<false>;
+  using ConstRef = BasicRef<true>;
+  using iterator = BasicIterator<false>;
+  using const_iterator = BasicIterator<true>;
+  using AttributeView = BasicAttributeView<false>;
+  using ConstAttributeView = BasicAttributeView<true>;
+
+  IndexedVertexList() { mColumns.fill(-1); }
+  explicit IndexedVertexList(std::size_t size) : IndexedVertexList() {
+    resize(size);
+  }
+
+  std::size_t size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+  void resize(std::size_t size) {
+    mSize = size;
+    mData.resize(mSize * mStride);
+  }
+  void reserve(std::size_t size) { mData.reserve(size * mStride); }
+  //! Removes all vertices; the mask is kept.
+  void clear() {
+    mSize = 0;
+    mData.clear();
+  }
+
+  void push_back(const IndexedVertex& v) {
+    resize(mSize + 1);
+    set(mSize - 1, v);
+  }
+  Ref emplace_back() {
+    resize(mSize + 1);
+    return (*this)[mSize - 1];
+  }
+
+  Ref operator[](std::size_t i) { return {*this, i}; }
+  ConstRef operator[](std::size_t i) const { return {*this, i}; }
+  Ref front() { return (*this)[0]; }
+  ConstRef front() const { return (*this)[0]; }
+  Ref back() { return (*this)[mSize - 1]; }
+  ConstRef back() const { return (*this)[mSize - 1]; }
+
+  iterator begin() { return {*this, 0}; }
+  iterator end() { return {*this, mSize}; }
+  const_iterator begin() const { return {*this, 0}; }
+  const_iterator end() const { return {*this, mSize}; }
+
+  //! Index of attribute `attr` of vertex `i`; zero if not stored.
+  u16 get(std::size_t i, VertexAttribute attr) const {
+    assert(i < mSize && (u64)attr < (u64)VertexAttribute::Max);
+    const s8 column = mColumns[(u64)attr];
+    return column < 0 ? 0 : mData[i * mStride + column];
+  }
+  //! Writable index of attribute `attr` of vertex `i`, which must be in the
+  //! mask. Invalidated by the next call that changes the mask.
+  u16& at(std::size_t i, VertexAttribute attr) {
+    assert(i < mSize && (u64)attr < (u64)VertexAttribute::Max);
+    assert(mColumns[(u64)attr] >= 0 && "Attribute not in the mask");
+    return mData[i * mStride + mColumns[(u64)attr]];
+  }
+  IndexedVertex get(std::size_t i) const {
+    IndexedVertex v;
+    forEachColumn([&](VertexAttribute attr, u32 column) {
+      v[attr] = mData[i * mStride + column];
+    });
+    return v;
+  }
+  //! Attributes of `v` outside the mask must be zero.
+  void set(std::size_t i, const IndexedVertex& v) {
+    assert(i < mSize);
+    assert((maskOf(v) & ~mMask) == 0 && "Attribute not in the mask");
+    forEachColumn([&](VertexAttribute attr, u32 column) {
+      mData[i * mStride + column] = v[attr];
+    });
+  }
+
+  //! Attributes stored, as `1 << VertexAttribute` bits.
+  u32 getMask() const { return mMask; }
+  //! Indices per vertex in the packed stream.
+  u32 getStride() const { return mStride; }
+  //! Column of `attr` within each vertex of the packed stream, or -1.
+  s32 getColumn(VertexAttribute attr) const { return mColumns[(u64)attr]; }
+  std::span<u16> getPacked() { return mData; }
+  std::span<const u16> getPacked() const { return mData; }
+
+  //! Index of `attr` for every vertex; empty if `attr` is not in the mask.
+  AttributeView getAttribute(VertexAttribute attr) {
+    const s8 column = mColumns[(u64)attr];
+    if (column < 0)
+      return {};
+    return {mData.data() + column, mStride, mSize};
+  }
+  ConstAttributeView getAttribute(VertexAttribute attr) const {
+    const s8 column = mColumns[(u64)attr];
+    if (column < 0)
+      return {};
+    return {mData.data() + column, mStride, mSize};
+  }
+
+  //! @brief Change the set of stored attributes.
+  //!
+  //! Attributes that are dropped are lost; new ones read as zero.
+  //!
+  void setMask(const VertexDescriptor& vcd) { setMask(vcd.mBitfield); }
+  void setMask(u32 mask) {
+    if (mask == mMask)
+      return;
+    const auto oldColumns = mColumns;
+    const u32 oldStride = mStride;
+    mMask = mask;
+    mStride = 0;
+    mColumns.fill(-1);
+    for (u32 a = 0; a < (u32)VertexAttribute::Max; ++a)
+      if (mask & (1u << a))
+        mColumns[a] = static_cast<s8>(mStride++);
+
+    std::vector<u16> data(mSize * mStride);
+    for (u32 a = 0; a < (u32)VertexAttribute::Max; ++a) {
+      if (mColumns[a] < 0 || oldColumns[a] < 0)
+        continue;
+      for (std::size_t i = 0; i < mSize; ++i)
+        data[i * mStride + mColumns[a]] = mData[i * oldStride + oldColumns[a]];
+    }
+    mData = std::move(data);
+  }
+
+  //! Compares vertex values; the masks may differ.
+  bool operator==(const IndexedVertexList& rhs) const {
+    if (mSize != rhs.mSize)
+      return false;
+    if (mMask == rhs.mMask)
+      return mData == rhs.mData;
+    for (std::size_t i = 0; i < mSize; ++i)
+      if (get(i) != rhs.get(i))
+        return false;
+    return true;
+  }
+
+private:
+  static u32 maskOf(const IndexedVertex& v) {
+    u32 mask = 0;
+    for (u32 a = 0; a < (u32)VertexAttribute::Max; ++a)
+      if (v[static_cast<VertexAttribute>(a)] != 0)
+        mask |= 1u << a;
+    return mask;
+  }
+  template <typename F> void forEachColumn(F&& f) const {
+    for (u32 a = 0; a < (u32)VertexAttribute::Max; ++a)
+      if (mColumns[a] >= 0)
+        f(static_cast<VertexAttribute>(a), static_cast<u32>(mColumns[a]));
+  }
+
+  u32 mMask = 0;
+  u32 mStride = 0;
+  std::size_t mSize = 0;
+  std::array<s8, (u64)VertexAttribute::Max> mColumns;
+  std::vector<u16> mData;
 };
 
 struct IndexedPrimitive {
   PrimitiveType mType;
-  std::vector<IndexedVertex> mVertices;
+  IndexedVertexList mVertices;
 
   IndexedPrimitive() = default;
   IndexedPrimitive(PrimitiveType type, u64 size)
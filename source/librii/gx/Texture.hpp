@@ -19,7 +19,7 @@ enum class TextureFormat {
   RGB5A3,
   RGBA8,
 
-  C4,
+  C4 = 8,
   C8,
   C14X2,
   CMPR = 0xE,
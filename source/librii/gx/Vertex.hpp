@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <core/common.h>
 #include <oishii/reader/binary_reader.hxx>
 #include <oishii/writer/binary_writer.hxx>
@@ -184,31 +185,44 @@ inline f32 readGenericComponentSingle(oishii::BinaryReader& reader,
     return 0.0f;
   }
 }
-inline gx::Color readColorComponents(oishii::BinaryReader& reader,
-                                     gx::VertexBufferType::Color type) {
+// Bytes taken by one color of the given format
+inline u32 computeColorSize(gx::VertexBufferType::Color type) {
+  switch (type) {
+  case gx::VertexBufferType::Color::rgb565:
+  case gx::VertexBufferType::Color::rgba4:
+    return 2;
+  case gx::VertexBufferType::Color::rgb8:
+  case gx::VertexBufferType::Color::rgba6:
+    return 3;
+  case gx::VertexBufferType::Color::rgbx8:
+  case gx::VertexBufferType::Color::rgba8:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+// Decode one color of computeColorSize(type) bytes at `p`
+inline gx::Color decodeColorComponents(const u8* p,
+                                       gx::VertexBufferType::Color type) {
   gx::Color result; // TODO: Default color
 
   switch (type) {
   case gx::VertexBufferType::Color::rgb565: {
-    const u16 c = reader.read<u16>();
+    const u16 c = (p[0] << 8) | p[1];
     result.r = static_cast<float>((c & 0xF800) >> 11) * (255.0f / 31.0f);
     result.g = static_cast<float>((c & 0x07E0) >> 5) * (255.0f / 63.0f);
     result.b = static_cast<float>(c & 0x001F) * (255.0f / 31.0f);
     break;
   }
   case gx::VertexBufferType::Color::rgb8:
-    result.r = reader.read<u8>();
-    result.g = reader.read<u8>();
-    result.b = reader.read<u8>();
-    break;
   case gx::VertexBufferType::Color::rgbx8:
-    result.r = reader.read<u8>();
-    result.g = reader.read<u8>();
-    result.b = reader.read<u8>();
-    reader.skip(1);
+    result.r = p[0];
+    result.g = p[1];
+    result.b = p[2];
     break;
   case gx::VertexBufferType::Color::rgba4: {
-    const u16 c = reader.read<u16>();
+    const u16 c = (p[0] << 8) | p[1];
     result.r = ((c & 0xF000) >> 12) * 17;
     result.g = ((c & 0x0F00) >> 8) * 17;
     result.b = ((c & 0x00F0) >> 4) * 17;
@@ -216,10 +230,7 @@ inline gx::Color readColorComponents(oishii::BinaryReader& reader,
     break;
   }
   case gx::VertexBufferType::Color::rgba6: {
-    u32 c = 0;
-    c |= reader.read<u8>() << 16;
-    c |= reader.read<u8>() << 8;
-    c |= reader.read<u8>();
+    const u32 c = (p[0] << 16) | (p[1] << 8) | p[2];
     result.r = static_cast<float>((c & 0xFC0000) >> 18) * (255.0f / 63.0f);
     result.g = static_cast<float>((c & 0x03F000) >> 12) * (255.0f / 63.0f);
     result.b = static_cast<float>((c & 0x000FC0) >> 6) * (255.0f / 63.0f);
@@ -227,16 +238,24 @@ inline gx::Color readColorComponents(oishii::BinaryReader& reader,
     break;
   }
   case gx::VertexBufferType::Color::rgba8:
-    result.r = reader.read<u8>();
-    result.g = reader.read<u8>();
-    result.b = reader.read<u8>();
-    result.a = reader.read<u8>();
+    result.r = p[0];
+    result.g = p[1];
+    result.b = p[2];
+    result.a = p[3];
     break;
   };
 
   return result;
 }
 
+inline gx::Color readColorComponents(oishii::BinaryReader& reader,
+                                     gx::VertexBufferType::Color type) {
+  std::array<u8, 4> bytes{};
+  for (u32 i = 0; i < computeColorSize(type); ++i)
+    bytes[i] = reader.read<u8>();
+  return decodeColorComponents(bytes.data(), type);
+}
+
 template <typename T>
 inline T readGenericComponents(oishii::BinaryReader& reader,
                                gx::VertexBufferType::Generic type,
@@ -264,42 +283,48 @@ inline gx::Color readComponents<gx::Color>(oishii::BinaryReader& reader,
   return readColorComponents(reader, type.color);
 }
 
-inline void writeColorComponents(oishii::Writer& writer,
-                                 const librii::gx::Color& c,
-                                 VertexBufferType::Color colort) {
+// Encode one color as computeColorSize(colort) bytes at `p`
+inline void encodeColorComponents(u8* p, const librii::gx::Color& c,
+                                  VertexBufferType::Color colort) {
   switch (colort) {
-  case librii::gx::VertexBufferType::Color::rgb565:
-    writer.write<u16>(((c.r & 0xf8) << 8) | ((c.g & 0xfc) << 3) |
-                      ((c.b & 0xf8) >> 3));
+  case librii::gx::VertexBufferType::Color::rgb565: {
+    const u16 v =
+        ((c.r & 0xf8) << 8) | ((c.g & 0xfc) << 3) | ((c.b & 0xf8) >> 3);
+    p[0] = static_cast<u8>(v >> 8);
+    p[1] = static_cast<u8>(v);
     break;
+  }
   case librii::gx::VertexBufferType::Color::rgb8:
-    writer.write<u8>(c.r);
-    writer.write<u8>(c.g);
-    writer.write<u8>(c.b);
+    p[0] = c.r;
+    p[1] = c.g;
+    p[2] = c.b;
     break;
   case librii::gx::VertexBufferType::Color::rgbx8:
-    writer.write<u8>(c.r);
-    writer.write<u8>(c.g);
-    writer.write<u8>(c.b);
-    writer.write<u8>(0);
+    p[0] = c.r;
+    p[1] = c.g;
+    p[2] = c.b;
+    p[3] = 0;
     break;
-  case librii::gx::VertexBufferType::Color::rgba4:
-    writer.write<u16>(((c.r & 0xf0) << 8) | ((c.g & 0xf0) << 4) | (c.b & 0xf0) |
-                      ((c.a & 0xf0) >> 4));
+  case librii::gx::VertexBufferType::Color::rgba4: {
+    const u16 v = ((c.r & 0xf0) << 8) | ((c.g & 0xf0) << 4) | (c.b & 0xf0) |
+                  ((c.a & 0xf0) >> 4);
+    p[0] = static_cast<u8>(v >> 8);
+    p[1] = static_cast<u8>(v);
     break;
+  }
   case librii::gx::VertexBufferType::Color::rgba6: {
     const u32 v = ((c.r & 0xfc) << 16) | ((c.g & 0xfc) << 10) |
                   ((c.b & 0xfc) << 4) | ((c.a & 0xfc) >> 2);
-    writer.write<u8>((v & 0x00ff0000) >> 16);
-    writer.write<u8>((v & 0x0000ff00) >> 8);
-    writer.write<u8>((v & 0x000000ff));
+    p[0] = static_cast<u8>(v >> 16);
+    p[1] = static_cast<u8>(v >> 8);
+    p[2] = static_cast<u8>(v);
     break;
   }
   case librii::gx::VertexBufferType::Color::rgba8:
-    writer.write<u8>(c.r);
-    writer.write<u8>(c.g);
-    writer.write<u8>(c.b);
-    writer.write<u8>(c.a);
+    p[0] = c.r;
+    p[1] = c.g;
+    p[2] = c.b;
+    p[3] = c.a;
     break;
   default:
     assert(!"Invalid buffer type!");
@@ -307,6 +332,15 @@ inline void writeColorComponents(oishii::Writer& writer,
   };
 }
 
+inline void writeColorComponents(oishii::Writer& writer,
+                                 const librii::gx::Color& c,
+                                 VertexBufferType::Color colort) {
+  std::array<u8, 4> bytes{};
+  encodeColorComponents(bytes.data(), c, colort);
+  for (u32 i = 0; i < computeColorSize(colort); ++i)
+    writer.write<u8>(bytes[i]);
+}
+
 template <int n, typename T, glm::qualifier q>
 inline void writeGenericComponents(oishii::Writer& writer,
                                    const glm::vec<n, T, q>& v,
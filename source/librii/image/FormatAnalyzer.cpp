@@ -0,0 +1,151 @@
+#include "FormatAnalyzer.hpp"
+
+#include "ImagePlatform.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <llvm/Support/Parallel.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIBRII_IMAGE_SSE2
+#endif
+
+namespace librii::image {
+
+// Pixels are read as little-endian u32s: 0xAABBGGRR
+static void analyzeScalar(const u8* rgba, u32 pixelCount, u32& grayBits,
+                          bool& opaque, bool& binaryAlpha) {
+  for (u32 i = 0; i < pixelCount; ++i) {
+    u32 px;
+    memcpy(&px, rgba + i * 4, 4);
+    grayBits |= (px ^ (px >> 8)) & 0xFFFF;
+    const u32 a = px >> 24;
+    opaque &= a == 0xFF;
+    binaryAlpha &= a == 0xFF || a == 0;
+  }
+}
+
+ImageTraits analyzeImage(const u8* rgba, u32 pixelCount) {
+  u32 grayBits = 0;
+  bool opaque = true;
+  bool binaryAlpha = true;
+  u32 i = 0;
+
+#ifdef LIBRII_IMAGE_SSE2
+  const __m128i rgMask = _mm_set1_epi32(0x0000FFFF);
+  const __m128i aMask = _mm_set1_epi32(0xFF000000);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i gray = zero;
+  // Lanes remain all-ones while the property holds
+  __m128i allOpaque = _mm_set1_epi32(-1);
+  __m128i allBinary = _mm_set1_epi32(-1);
+  for (; i + 4 <= pixelCount; i += 4) {
+    const __m128i px =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+    // R ^ G, G ^ B in the low 16 bits of each lane
+    gray = _mm_or_si128(
+        gray, _mm_and_si128(_mm_xor_si128(px, _mm_srli_epi32(px, 8)), rgMask));
+    const __m128i a = _mm_and_si128(px, aMask);
+    const __m128i isFF = _mm_cmpeq_epi32(a, aMask);
+    allOpaque = _mm_and_si128(allOpaque, isFF);
+    allBinary =
+        _mm_and_si128(allBinary, _mm_or_si128(isFF, _mm_cmpeq_epi32(a, zero)));
+  }
+  grayBits |= _mm_movemask_epi8(_mm_cmpeq_epi32(gray, zero)) != 0xFFFF;
+  opaque &= _mm_movemask_epi8(allOpaque) == 0xFFFF;
+  binaryAlpha &= _mm_movemask_epi8(allBinary) == 0xFFFF;
+#endif
+
+  analyzeScalar(rgba + i * 4, pixelCount - i, grayBits, opaque, binaryAlpha);
+
+  return {.grayscale = grayBits == 0,
+          .opaque = opaque,
+          .binaryAlpha = binaryAlpha};
+}
+
+float computePsnr(const u8* a, const u8* b, u32 pixelCount,
+                  bool compareAlpha) {
+  u64 sse = 0;
+  const u32 channels = compareAlpha ? 4 : 3;
+  for (u32 i = 0; i < pixelCount * 4; ++i) {
+    if (!compareAlpha && i % 4 == 3)
+      continue;
+    const int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+    sse += d * d;
+  }
+  if (sse == 0)
+    return std::numeric_limits<float>::infinity();
+  const double mse = static_cast<double>(sse) / (pixelCount * channels);
+  return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / mse));
+}
+
+bool hasAlpha(gx::TextureFormat format) {
+  switch (format) {
+  case gx::TextureFormat::I4:
+  case gx::TextureFormat::I8:
+  case gx::TextureFormat::RGB565:
+    return false;
+  default:
+    return true;
+  }
+}
+
+static bool isViable(gx::TextureFormat format, const ImageTraits& traits) {
+  switch (format) {
+  // Alpha is the intensity
+  case gx::TextureFormat::I4:
+  case gx::TextureFormat::I8:
+    return traits.grayscale && traits.opaque;
+  case gx::TextureFormat::IA4:
+  case gx::TextureFormat::IA8:
+    return traits.grayscale;
+  case gx::TextureFormat::CMPR:
+    return traits.binaryAlpha;
+  case gx::TextureFormat::RGB565:
+    return traits.opaque;
+  case gx::TextureFormat::RGB5A3:
+  case gx::TextureFormat::RGBA8:
+    return true;
+  // We have no palette encoder
+  default:
+    return false;
+  }
+}
+
+FormatSelection selectTextureFormat(const u8* rgba, u32 width, u32 height,
+                                    const FormatSelectionSettings& settings) {
+  const ImageTraits traits = analyzeImage(rgba, width * height);
+
+  // Encoders operate on whole 8x8 blocks
+  if (width == 0 || height == 0 || (width % 8) != 0 || (height % 8) != 0 ||
+      settings.candidates.empty())
+    return {.format = settings.fallback, .psnr = 0.0f, .traits = traits};
+
+  std::vector<gx::TextureFormat> viable;
+  for (auto format : settings.candidates)
+    if (isViable(format, traits))
+      viable.push_back(format);
+  if (viable.empty())
+    viable.push_back(settings.candidates.back());
+
+  std::vector<float> scores(viable.size());
+  llvm::parallelForEachN(0, viable.size(), [&](std::size_t i) {
+    // Trial buffers are kept per worker thread across calls
+    static thread_local std::vector<u8> encoded, decoded;
+    encoded.resize(getEncodedSize(width, height, viable[i]));
+    decoded.resize(width * height * 4);
+    encode(encoded.data(), rgba, width, height, viable[i]);
+    decode(decoded.data(), encoded.data(), width, height, viable[i]);
+    scores[i] = computePsnr(rgba, decoded.data(), width * height,
+                            hasAlpha(viable[i]));
+  });
+
+  for (std::size_t i = 0; i < viable.size(); ++i) {
+    if (scores[i] >= settings.minPsnr)
+      return {.format = viable[i], .psnr = scores[i], .traits = traits};
+  }
+  return {.format = viable.back(), .psnr = scores.back(), .traits = traits};
+}
+
+} // namespace librii::image
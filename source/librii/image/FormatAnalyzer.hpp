@@ -0,0 +1,84 @@
+#pragma once
+
+#include <core/common.h>
+
+#include <vector>
+
+#include <librii/gx.h>
+
+namespace librii::image {
+
+//! @brief Properties of an RGBA image relevant to choosing a GX format.
+//!
+struct ImageTraits {
+  //! Every pixel has R == G == B.
+  bool grayscale = true;
+  //! Every pixel has A == 0xFF.
+  bool opaque = true;
+  //! Every pixel has A == 0x00 or A == 0xFF.
+  bool binaryAlpha = true;
+};
+
+//! @brief Scan a raw, 8-bit RGBA buffer for its traits.
+//!
+//! @param[in] rgba       Pointer to the pixel data.
+//! @param[in] pixelCount Number of pixels (not bytes) to scan.
+//!
+ImageTraits analyzeImage(const u8* rgba, u32 pixelCount);
+
+//! @brief Compute the peak signal-to-noise ratio between two RGBA buffers.
+//!
+//! The color channels, and alpha if `compareAlpha`, contribute to the error.
+//! Identical images yield +inf.
+//!
+float computePsnr(const u8* a, const u8* b, u32 pixelCount,
+                  bool compareAlpha = true);
+
+//! @brief Whether a format stores alpha. I4 and I8 read alpha from intensity,
+//! which is not a separate channel.
+bool hasAlpha(gx::TextureFormat format);
+
+struct FormatSelectionSettings {
+  //! Minimum acceptable quality in decibels. ~30dB is visibly lossy; past
+  //! ~40dB differences are hard to spot.
+  float minPsnr = 34.0f;
+
+  //! Candidates to consider, smallest first. The first to meet the threshold
+  //! wins; the last is used if none do.
+  std::vector<gx::TextureFormat> candidates = {
+      gx::TextureFormat::I4,     gx::TextureFormat::CMPR,
+      gx::TextureFormat::I8,     gx::TextureFormat::IA4,
+      gx::TextureFormat::IA8,    gx::TextureFormat::RGB565,
+      gx::TextureFormat::RGB5A3, gx::TextureFormat::RGBA8};
+
+  //! Used when the image cannot be analyzed (e.g. dimensions not a multiple
+  //! of the block size).
+  gx::TextureFormat fallback = gx::TextureFormat::CMPR;
+};
+
+struct FormatSelection {
+  gx::TextureFormat format;
+  //! Quality of the chosen format, in decibels.
+  float psnr = 0.0f;
+  ImageTraits traits;
+};
+
+//! @brief Find the smallest format representing an image within an error
+//! budget.
+//!
+//! Candidates that cannot possibly represent the image (a color format for a
+//! grayscale-only encoder, RGB565 for a translucent image...) are pruned
+//! using the image traits; the rest are encoded in parallel and scored.
+//! Formats without alpha are only tried for opaque images, and scored on color
+//! alone.
+//!
+//! @param[in] rgba     Raw, 8-bit RGBA base level of the image.
+//! @param[in] width    Width of the image in pixels.
+//! @param[in] height   Height of the image in pixels.
+//! @param[in] settings Error budget and candidates.
+//!
+FormatSelection
+selectTextureFormat(const u8* rgba, u32 width, u32 height,
+                    const FormatSelectionSettings& settings = {});
+
+} // namespace librii::image
@@ -11,10 +11,12 @@ namespace librii::image {
 
 std::pair<u32, u32> getBlockedDimensions(u32 width, u32 height,
                                          gx::TextureFormat format) {
-  const u32 blocksize = format == gx::TextureFormat::RGBA8 ? 64 : 32;
+  const auto info = gx::getFormatInfo(static_cast<u32>(format));
+  const u32 blockWidth = 1 << info.xshift;
+  const u32 blockHeight = 1 << info.yshift;
 
-  return {(width + blocksize - 1) & ~(blocksize - 1),
-          (height + blocksize - 1) & ~(blocksize - 1)};
+  return {(width + blockWidth - 1) & ~(blockWidth - 1),
+          (height + blockHeight - 1) & ~(blockHeight - 1)};
 }
 
 int getEncodedSize(int width, int height, gx::TextureFormat format,
@@ -41,9 +43,10 @@ struct rgba {
 };
 
 constexpr u8 luminosity(const rgba& rgba) {
+  // Rounded: gray stays gray
   return static_cast<float>(rgba.r) * 0.299 +
          static_cast<float>(rgba.g) * 0.587 +
-         static_cast<float>(rgba.b) * 0.144;
+         static_cast<float>(rgba.b) * 0.114 + 0.5;
 }
 
 void encodeI4(u8* dst, const u32* src, u32 width, u32 height) {
@@ -97,7 +100,8 @@ void encodeIA4(u8* dst, const u32* src, u32 width, u32 height) {
       for (int row = 0; row < 4; ++row) {
         for (int column = 0; column < 8; ++column) {
           rgba _rgba = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column] = (luminosity(_rgba) & 0b11'11'00'00) | (_rgba.a >> 4);
+          // Alpha in the high nibble
+          dst[column] = (_rgba.a & 0b11'11'00'00) | (luminosity(_rgba) >> 4);
         }
         dst += 8;
       }
@@ -111,8 +115,9 @@ void encodeIA8(u8* dst, const u32* src, u32 width, u32 height) {
       for (int row = 0; row < 4; ++row) {
         for (int column = 0; column < 4; ++column) {
           rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column * 2] = luminosity(c) << 8;
-          dst[column * 2 + 1] = c.a;
+          // Alpha first
+          dst[column * 2] = c.a;
+          dst[column * 2 + 1] = luminosity(c);
         }
         dst += 8;
       }
@@ -259,20 +264,22 @@ void encode(u8* dst, const u8* src, int width, int height,
   // No palette support
   assert(false);
 }
+static bool overlaps(const u8* a, std::size_t asize, const u8* b,
+                     std::size_t bsize) {
+  return a < b + bsize && b < a + asize;
+}
+
 // Change format, no resizing
 void reencode(u8* dst, const u8* src, int width, int height,
-              gx::TextureFormat oldFormat, gx::TextureFormat newFormat) {
-  std::vector<u8> tmp(width * height * 4);
+              gx::TextureFormat oldFormat, gx::TextureFormat newFormat,
+              ScratchArena& scratch) {
+  auto tmp = scratch.decoded(width * height * 4);
   decode(tmp.data(), src, width, height, oldFormat);
   encode(dst, tmp.data(), width, height, newFormat);
 }
 
 void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
-            ResizingAlgorithm type) {
-  bool dstSrcTmp = dst == src;
-  u8* realDst = nullptr;
-  std::vector<u8> tmp(0);
-
+            ResizingAlgorithm type, ScratchArena& scratch) {
   assert(dst != nullptr);
   if (dst == nullptr) {
     return;
@@ -280,90 +287,80 @@ void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
     src = dst;
   }
 
-  if (dstSrcTmp) {
-    tmp.resize(dx * dy * 4);
-    realDst = dst;
-    dst = tmp.data();
-  }
-  if (type == ResizingAlgorithm::AVIR) {
+  const bool dstSrcTmp =
+      overlaps(dst, dx * dy * 4, src, static_cast<std::size_t>(sx) * sy * 4);
+  u8* realDst = dst;
+  if (dstSrcTmp)
+    dst = scratch.resized(dx * dy * 4).data();
 
+  if (type == ResizingAlgorithm::AVIR) {
     avir::CImageResizer<> Avir8BitImageResizer(8);
     // TODO: Allow more customization (args, k)
     Avir8BitImageResizer.resizeImage(src, sx, sy, 0, dst, dx, dy, 4, 0);
-    // assert((sx == dx && sy == dy) || memcmp(src, dst, sx * sy * 4));
   } else {
     avir::CLancIR AvirLanczos;
     AvirLanczos.resizeImage(src, sx, sy, 0, dst, dx, dy, 4, 0);
   }
 
-  if (dstSrcTmp) {
-    assert(realDst);
-    memcpy(realDst, dst, tmp.size());
-  }
+  if (dstSrcTmp)
+    memcpy(realDst, dst, dx * dy * 4);
 }
 
-struct RGBA32ImageSource {
-  RGBA32ImageSource(const u8* buf, int w, int h, gx::TextureFormat fmt)
-      : mBuf(buf), mW(w), mH(h), mFmt(fmt) {
-    if (mFmt == gx::TextureFormat::Extension_RawRGBA32) {
-      mDecoded = buf;
-    } else {
-      mTmp.resize(w * h * 4);
-      decode(mTmp.data(), mBuf, w, h, mFmt);
-      mDecoded = mTmp.data();
-    }
-  }
+void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
+            ResizingAlgorithm type) {
+  ScratchArena scratch;
+  resize(dst, dx, dy, src, sx, sy, type, scratch);
+}
 
-  std::span<const u8> get() const { return {mDecoded, size()}; }
-  u32 size() const { return mW * mH * 4; }
-  int width() const { return mW; }
-  int height() const { return mH; }
-
-private:
-  std::vector<u8> mTmp;
-  const u8* mDecoded = nullptr;
-  const u8* mBuf;
-  int mW;
-  int mH;
-  gx::TextureFormat mFmt;
-};
-struct RGBA32ImageTarget {
-  RGBA32ImageTarget(int w, int h) : mW(w), mH(h) {
-    mTmp.resize(roundUp(w, 32) * roundUp(h, 32) * 4);
-  }
-  void copyTo(u8* dst, gx::TextureFormat fmt) {
-    if (fmt == gx::TextureFormat::Extension_RawRGBA32) {
-      memcpy(dst, mTmp.data(), mTmp.size());
-    } else {
-      encode(dst, mTmp.data(), mW, mH, fmt);
-    }
+// Transform a single level. The source and destination may alias.
+static void transformLevel(u8* dst, int dwidth, int dheight,
+                           gx::TextureFormat oldformat,
+                           gx::TextureFormat newformat, const u8* src,
+                           int swidth, int sheight,
+                           ResizingAlgorithm algorithm,
+                           ScratchArena& scratch) {
+  constexpr auto Raw = gx::TextureFormat::Extension_RawRGBA32;
+  const std::size_t dsize = getEncodedSize(dwidth, dheight, newformat);
+  const std::size_t ssize = getEncodedSize(swidth, sheight, oldformat);
+
+  // Source as RGBA
+  const u8* rgba = src;
+  if (oldformat != Raw) {
+    auto decoded = scratch.decoded(swidth * sheight * 4);
+    decode(decoded.data(), src, swidth, sheight, oldformat);
+    rgba = decoded.data();
+  } else if (newformat != Raw && overlaps(dst, dsize, src, ssize)) {
+    // Encoders require distinct buffers
+    auto copy = scratch.decoded(ssize);
+    memcpy(copy.data(), src, ssize);
+    rgba = copy.data();
   }
-  void fromOtherSized(std::span<const u8> src, u32 ow, u32 oh,
-                      ResizingAlgorithm al) {
-    mTmp.resize(mW * mH * 4);
-    // assert(src.size() >= mTmp.size());
-    if (ow == mW && oh == mH) {
-      memcpy(mTmp.data(), src.data(), mTmp.size());
-    } else {
-      resize(mTmp.data(), mW, mH, src.data(), ow, oh, al);
+
+  if (swidth != dwidth || sheight != dheight) {
+    if (newformat == Raw &&
+        !overlaps(dst, dsize, rgba, static_cast<std::size_t>(swidth) *
+                                        sheight * 4)) {
+      resize(dst, dwidth, dheight, rgba, swidth, sheight, algorithm, scratch);
+      return;
     }
+    auto resized = scratch.resized(dwidth * dheight * 4);
+    resize(resized.data(), dwidth, dheight, rgba, swidth, sheight, algorithm,
+           scratch);
+    rgba = resized.data();
   }
-  void fromOtherSized(const RGBA32ImageSource& source, ResizingAlgorithm al) {
-    fromOtherSized(source.get(), source.width(), source.height(), al);
+
+  if (newformat == Raw) {
+    if (rgba != dst)
+      memmove(dst, rgba, dsize);
+    return;
   }
-  std::span<u8> get() { return {mTmp.data(), mTmp.size()}; }
-  std::span<const u8> get() const { return {mTmp.data(), mTmp.size()}; }
-  u32 size() const { return mW * mH * 4; }
-
-private:
-  std::vector<u8> mTmp;
-  int mW;
-  int mH;
-};
+  encode(dst, rgba, dwidth, dheight, newformat);
+}
+
 void transform(u8* dst, int dwidth, int dheight, gx::TextureFormat oldformat,
                std::optional<gx::TextureFormat> newformat, const u8* src,
                int swidth, int sheight, u32 mipMapCount,
-               ResizingAlgorithm algorithm) {
+               ResizingAlgorithm algorithm, ScratchArena& scratch) {
   printf(
       "Transform: Dest={%p, w:%i, h:%i}, Source={%p, w:%i, h:%i}, NumMip=%u\n",
       dst, dwidth, dheight, src, swidth, sheight, mipMapCount);
@@ -380,18 +377,32 @@ void transform(u8* dst, int dwidth, int dheight, gx::TextureFormat oldformat,
 
   // Determine whether to decode this sublevel as an image or many sublvels.
   if (mipMapCount >= 1) {
-    std::vector<u8> srcBuf(0);
-    const u8* pSrc = nullptr;
-    if (dst == src) {
-      srcBuf.resize(getEncodedSize(swidth, sheight, oldformat, mipMapCount));
-      memcpy(srcBuf.data(), src, srcBuf.size());
-      pSrc = srcBuf.data();
-    } else {
-      pSrc = src;
+    // Levels are processed in order, each fully read before it is written.
+    // Working in place is thus safe as long as no destination level spills
+    // into a source level not yet read.
+    const u8* pSrc = src;
+    if (overlaps(dst,
+                 getEncodedSize(dwidth, dheight, newformat.value(),
+                                mipMapCount),
+                 src,
+                 getEncodedSize(swidth, sheight, oldformat, mipMapCount))) {
+      bool inPlace = dst == src;
+      for (u32 i = 0; inPlace && i < mipMapCount; ++i) {
+        const auto dst_end =
+            getEncodedSize(dwidth, dheight, newformat.value(), i);
+        const auto src_next = getEncodedSize(swidth, sheight, oldformat, i);
+        inPlace = dst_end <= src_next;
+      }
+      if (!inPlace) {
+        auto copy = scratch.source(
+            getEncodedSize(swidth, sheight, oldformat, mipMapCount));
+        memcpy(copy.data(), src, copy.size());
+        pSrc = copy.data();
+      }
     }
     assert(pSrc);
     transform(dst, dwidth, dheight, oldformat, newformat, pSrc, swidth, sheight,
-              0, algorithm);
+              0, algorithm, scratch);
     for (u32 i = 1; i <= mipMapCount; ++i) {
       const auto src_lod_ofs =
           getEncodedSize(swidth, sheight, oldformat, i - 1);
@@ -410,21 +421,21 @@ void transform(u8* dst, int dwidth, int dheight, gx::TextureFormat oldformat,
       }
       transform(dst + dst_lod_ofs, dst_lod_x, dst_lod_y, oldformat,
                 newformat.value(), pSrc + src_lod_ofs, src_lod_x, src_lod_y, 0,
-                algorithm);
+                algorithm, scratch);
     }
-  } else if (swidth >= 32 && sheight >= 32){
-    RGBA32ImageSource source(src, swidth, sheight, oldformat);
-    assert(source.get().data());
-
-    // TODO: We don't always need to allocate this
-    RGBA32ImageTarget target(dwidth, dheight);
-    assert(target.get().data());
-
-    target.fromOtherSized(source, algorithm);
-
-    // TODO: A copy here can be prevented
-    target.copyTo(dst, newformat.value());
+  } else if (swidth >= 32 && sheight >= 32) {
+    transformLevel(dst, dwidth, dheight, oldformat, newformat.value(), src,
+                   swidth, sheight, algorithm, scratch);
   }
 }
 
+void transform(u8* dst, int dwidth, int dheight, gx::TextureFormat oldformat,
+               std::optional<gx::TextureFormat> newformat, const u8* src,
+               int swidth, int sheight, u32 mipMapCount,
+               ResizingAlgorithm algorithm) {
+  ScratchArena scratch;
+  transform(dst, dwidth, dheight, oldformat, newformat, src, swidth, sheight,
+            mipMapCount, algorithm, scratch);
+}
+
 } // namespace librii::image
@@ -3,7 +3,9 @@
 #include <core/common.h>
 
 #include <optional>
+#include <span>
 #include <tuple>
+#include <vector>
 
 #include <librii/gx.h>
 
@@ -13,10 +15,9 @@ namespace librii::image {
 //!
 //! @param[in] width  Width of the image.
 //! @param[in] height Height of the image.
-//! @param[in] format Format of the image. All formats except RGBA8 have 32 byte
-//! blocks, the exception being twice that.
+//! @param[in] format Format of the image. Blocks span 4x4 to 8x8 texels.
 //!
-//! @return Dimensions rounded up blocked size.
+//! @return Dimensions rounded up to whole blocks.
 //!
 std::pair<u32, u32> getBlockedDimensions(u32 width, u32 height,
                                          gx::TextureFormat format);
@@ -67,6 +68,53 @@ void decode(u8* dst, const u8* src, int width, int height,
 void encode(u8* dst, const u8* src, int width, int height,
             gx::TextureFormat texformat);
 
+//! @brief Caller-owned temporary storage for image operations.
+//!
+//! Buffers only ever grow: reusing one arena across many images performs no
+//! heap allocation once it has reached the size of the largest image. An arena
+//! must not be shared between threads.
+//!
+class ScratchArena {
+public:
+  //! Holds a decoded (RGBA) copy of the source image.
+  std::span<u8> decoded(std::size_t size) { return grow(mDecoded, size); }
+  //! Holds a resized (RGBA) copy of the source image.
+  std::span<u8> resized(std::size_t size) { return grow(mResized, size); }
+  //! Holds a copy of the source data when it would be overwritten.
+  std::span<u8> source(std::size_t size) { return grow(mSource, size); }
+
+  //! Total bytes reserved by the arena.
+  std::size_t capacity() const {
+    return mDecoded.size() + mResized.size() + mSource.size();
+  }
+
+private:
+  static std::span<u8> grow(std::vector<u8>& buf, std::size_t size) {
+    if (buf.size() < size)
+      buf.resize(size);
+    return {buf.data(), size};
+  }
+
+  std::vector<u8> mDecoded;
+  std::vector<u8> mResized;
+  std::vector<u8> mSource;
+};
+
+//! @brief Change the format of an image, without resizing.
+//!
+//! @param[in] dst       The destination pointer. May equal the source pointer
+//! if the encoded image does not grow.
+//! @param[in] src       The source pointer.
+//! @param[in] width     Width of the image in pixels.
+//! @param[in] height    Height of the image in pixels.
+//! @param[in] oldFormat Format of the source data.
+//! @param[in] newFormat Format of the target data.
+//! @param[in] scratch   Temporary storage.
+//!
+void reencode(u8* dst, const u8* src, int width, int height,
+              gx::TextureFormat oldFormat, gx::TextureFormat newFormat,
+              ScratchArena& scratch);
+
 //! @brief Specifies an algorithm for downscaling/upscaling an image.
 //!
 enum ResizingAlgorithm { AVIR, Lanczos };
@@ -86,6 +134,12 @@ enum ResizingAlgorithm { AVIR, Lanczos };
 void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
             ResizingAlgorithm type = ResizingAlgorithm::AVIR);
 
+//! @brief Resize a raw, 8-bit RGBA buffer using caller-owned temporary
+//! storage (used only when dst == src).
+//!
+void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
+            ResizingAlgorithm type, ScratchArena& scratch);
+
 //! @brief Perform a composite transformation on image data, with mipmap
 //! support.
 //!
@@ -116,4 +170,17 @@ void transform(
     const u8* src = nullptr, int sx = -1, int sy = -1, u32 mipMapCount = 0,
     ResizingAlgorithm algorithm = ResizingAlgorithm::AVIR);
 
+//! @brief Perform a composite transformation on image data, with mipmap
+//! support, using caller-owned temporary storage.
+//!
+//! When dst == src, the transformation happens in place if no level of the
+//! result overlaps a source level that has yet to be read (e.g. converting to
+//! a format with an equal or smaller footprint); otherwise the source is
+//! first copied to the arena.
+//!
+void transform(u8* dst, int dx, int dy, gx::TextureFormat oldformat,
+               std::optional<gx::TextureFormat> newformat, const u8* src,
+               int sx, int sy, u32 mipMapCount, ResizingAlgorithm algorithm,
+               ScratchArena& scratch);
+
 } // namespace librii::image
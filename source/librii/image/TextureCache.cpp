@@ -0,0 +1,131 @@
+#include "TextureCache.hpp"
+
+#include "ImagePlatform.hpp"
+#include <llvm/Support/xxhash.h>
+
+namespace librii::image {
+
+ImageKey computeImageKey(std::span<const u8> data, gx::TextureFormat format,
+                         u32 width, u32 height, u32 mipMapCount) {
+  return {.hash = llvm::xxHash64(
+              llvm::ArrayRef<uint8_t>(data.data(), data.size())),
+          .format = format,
+          .width = width,
+          .height = height,
+          .mipMapCount = mipMapCount};
+}
+
+// Per-thread intermediates for transform(); reused across cache misses.
+static thread_local ScratchArena sScratch;
+
+TextureCache& TextureCache::get() {
+  static TextureCache sCache;
+  return sCache;
+}
+
+TextureCache::Buffer TextureCache::decode(const u8* src, u32 width, u32 height,
+                                          gx::TextureFormat format,
+                                          u32 mipMapCount) {
+  const u32 src_size = getEncodedSize(width, height, format, mipMapCount);
+  const Key key{.image = computeImageKey({src, src_size}, format, width,
+                                         height, mipMapCount),
+                .direction = Direction::Decode,
+                .target = gx::TextureFormat::Extension_RawRGBA32};
+  if (auto found = find(key))
+    return found;
+
+  // Decode outside of the lock; a racing thread may do the same work, but
+  // neither blocks the other.
+  auto decoded = std::make_shared<std::vector<u8>>(getEncodedSize(
+      width, height, gx::TextureFormat::Extension_RawRGBA32, mipMapCount));
+  transform(decoded->data(), width, height, format,
+            gx::TextureFormat::Extension_RawRGBA32, src, width, height,
+            mipMapCount, ResizingAlgorithm::AVIR, sScratch);
+
+  insert(key, decoded);
+  return decoded;
+}
+
+TextureCache::Buffer TextureCache::encode(const u8* rgba, u32 width,
+                                          u32 height, gx::TextureFormat format,
+                                          u32 mipMapCount) {
+  const u32 src_size = getEncodedSize(
+      width, height, gx::TextureFormat::Extension_RawRGBA32, mipMapCount);
+  const Key key{.image = computeImageKey(
+                    {rgba, src_size}, gx::TextureFormat::Extension_RawRGBA32,
+                    width, height, mipMapCount),
+                .direction = Direction::Encode,
+                .target = format};
+  if (auto found = find(key))
+    return found;
+
+  auto encoded = std::make_shared<std::vector<u8>>(
+      getEncodedSize(width, height, format, mipMapCount));
+  transform(encoded->data(), width, height,
+            gx::TextureFormat::Extension_RawRGBA32, format, rgba, width, height,
+            mipMapCount, ResizingAlgorithm::AVIR, sScratch);
+
+  insert(key, encoded);
+  return encoded;
+}
+
+void TextureCache::setBudget(std::size_t bytes) {
+  std::scoped_lock g(mMutex);
+  mBudget = bytes;
+  evict();
+}
+
+void TextureCache::clear() {
+  std::scoped_lock g(mMutex);
+  mEntries.clear();
+  mLookup.clear();
+  mStats.bytes = 0;
+  mStats.entries = 0;
+}
+
+TextureCache::Stats TextureCache::getStats() const {
+  std::scoped_lock g(mMutex);
+  return mStats;
+}
+
+TextureCache::Buffer TextureCache::find(const Key& key) {
+  std::scoped_lock g(mMutex);
+  auto it = mLookup.find(key);
+  if (it == mLookup.end()) {
+    ++mStats.misses;
+    return nullptr;
+  }
+  ++mStats.hits;
+  // Move to the front of the LRU list
+  mEntries.splice(mEntries.begin(), mEntries, it->second);
+  return it->second->data;
+}
+
+void TextureCache::insert(const Key& key, Buffer data) {
+  std::scoped_lock g(mMutex);
+  // Another thread may have beaten us to it
+  if (mLookup.contains(key))
+    return;
+  // Never retain a single entry larger than the whole budget
+  if (data->size() > mBudget)
+    return;
+
+  mStats.bytes += data->size();
+  ++mStats.entries;
+  mEntries.push_front({key, std::move(data)});
+  mLookup.emplace(key, mEntries.begin());
+  evict();
+}
+
+void TextureCache::evict() {
+  while (mStats.bytes > mBudget && !mEntries.empty()) {
+    const Entry& last = mEntries.back();
+    mStats.bytes -= last.data->size();
+    --mStats.entries;
+    ++mStats.evictions;
+    mLookup.erase(last.key);
+    mEntries.pop_back();
+  }
+}
+
+} // namespace librii::image
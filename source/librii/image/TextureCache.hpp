@@ -0,0 +1,146 @@
+#pragma once
+
+#include <core/common.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <librii/gx.h>
+
+namespace librii::image {
+
+//! @brief Identifies a block of image data by its content.
+//!
+//! Two images with equal keys are assumed to be identical. The hash is a
+//! 64-bit xxHash of the bytes; the remaining fields disambiguate buffers that
+//! happen to share a byte representation.
+//!
+struct ImageKey {
+  u64 hash = 0;
+  gx::TextureFormat format = gx::TextureFormat::Extension_RawRGBA32;
+  u32 width = 0;
+  u32 height = 0;
+  u32 mipMapCount = 0;
+
+  bool operator==(const ImageKey&) const = default;
+};
+
+//! @brief Compute the key of an image.
+//!
+//! @param[in] data        Image data, sized exactly as getEncodedSize.
+//! @param[in] format      Format of the image.
+//! @param[in] width       Width of the image in pixels.
+//! @param[in] height      Height of the image in pixels.
+//! @param[in] mipMapCount Number of additional levels of detail.
+//!
+ImageKey computeImageKey(std::span<const u8> data, gx::TextureFormat format,
+                         u32 width, u32 height, u32 mipMapCount = 0);
+
+struct ImageKeyHash {
+  std::size_t operator()(const ImageKey& key) const {
+    u64 h = key.hash;
+    h ^= (static_cast<u64>(key.format) << 56) ^
+         (static_cast<u64>(key.mipMapCount) << 48) ^
+         (static_cast<u64>(key.width) << 24) ^ key.height;
+    return static_cast<std::size_t>(h);
+  }
+};
+
+//! @brief Process-wide, content-addressed cache of decoded and encoded images.
+//!
+//! Maps encoded data to decoded RGBA (for previews, GL uploads, exporters) and
+//! source RGBA plus target format to encoded data (for importers). Entries are
+//! evicted in least-recently-used order once the memory budget is exceeded.
+//!
+//! Results are shared, immutable buffers: an entry evicted while a caller
+//! still holds it remains valid for that caller.
+//!
+class TextureCache {
+public:
+  using Buffer = std::shared_ptr<const std::vector<u8>>;
+
+  static TextureCache& get();
+
+  //! @brief Decode an image (and its mip chain) to raw 8-bit RGBA.
+  //!
+  //! @param[in] src         Encoded image data.
+  //! @param[in] width       Width of the image in pixels.
+  //! @param[in] height      Height of the image in pixels.
+  //! @param[in] format      Format of the source data.
+  //! @param[in] mipMapCount Number of additional levels of detail to decode.
+  //!
+  //! @return The decoded image. Levels are tightly packed, largest first.
+  //!
+  Buffer decode(const u8* src, u32 width, u32 height, gx::TextureFormat format,
+                u32 mipMapCount = 0);
+
+  //! @brief Encode raw 8-bit RGBA (and its mip chain) to a GPU texture.
+  //!
+  //! @param[in] rgba        Source RGBA data, including all mip levels.
+  //! @param[in] width       Width of the image in pixels.
+  //! @param[in] height      Height of the image in pixels.
+  //! @param[in] format      Format of the target data.
+  //! @param[in] mipMapCount Number of additional levels of detail to encode.
+  //!
+  Buffer encode(const u8* rgba, u32 width, u32 height, gx::TextureFormat format,
+                u32 mipMapCount = 0);
+
+  //! @brief Set the maximum number of bytes retained by the cache.
+  //!
+  void setBudget(std::size_t bytes);
+  std::size_t getBudget() const { return mBudget; }
+
+  //! @brief Drop all cached entries.
+  //!
+  void clear();
+
+  struct Stats {
+    u64 hits = 0;
+    u64 misses = 0;
+    u64 evictions = 0;
+    std::size_t bytes = 0;
+    std::size_t entries = 0;
+  };
+  Stats getStats() const;
+
+private:
+  enum class Direction : u8 { Decode, Encode };
+  struct Key {
+    ImageKey image;
+    Direction direction;
+    // Target format for encodes
+    gx::TextureFormat target;
+
+    bool operator==(const Key&) const = default;
+  };
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const {
+      return ImageKeyHash{}(key.image) ^
+             (static_cast<std::size_t>(key.direction) << 8) ^
+             (static_cast<std::size_t>(key.target) << 12);
+    }
+  };
+  struct Entry {
+    Key key;
+    Buffer data;
+  };
+
+  Buffer find(const Key& key);
+  void insert(const Key& key, Buffer data);
+  void evict();
+
+  static constexpr std::size_t DefaultBudget = 256 * 1024 * 1024;
+
+  mutable std::mutex mMutex;
+  // Most recently used at the front
+  std::list<Entry> mEntries;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> mLookup;
+  std::size_t mBudget = DefaultBudget;
+  Stats mStats;
+};
+
+} // namespace librii::image
@@ -1 +1,39 @@
 #include "CourseMap.hpp"
+#include <cmath>
+#include <glm/trigonometric.hpp>
+#include <vector>
+
+namespace librii::kmp {
+
+void ComputeGeoObjMatrices(std::span<const GeoObj> objs,
+                           std::span<glm::mat4> out) {
+  assert(out.size() >= objs.size());
+
+  // The sines and cosines dominate: take them over contiguous arrays first, so
+  // the loop has no dependencies between objects
+  const std::size_t n = objs.size();
+  std::vector<glm::vec3> sines(n), cosines(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const glm::vec3 angles = glm::radians(objs[i].rotation);
+    sines[i] = glm::sin(angles);
+    cosines[i] = glm::cos(angles);
+  }
+
+  // Scale, then rotate (Rz * Ry * Rx), then translate. See Bone::calcSrtMtx.
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto& obj = objs[i];
+    const glm::vec3 s = sines[i], c = cosines[i];
+    auto& dst = out[i];
+
+    dst[0] = glm::vec4{c.y * c.z, s.z * c.y, -s.y, 0.0f} * obj.scale.x;
+    dst[1] = glm::vec4{s.x * c.z * s.y - c.x * s.z,
+                       s.x * s.z * s.y + c.x * c.z, s.x * c.y, 0.0f} *
+             obj.scale.y;
+    dst[2] = glm::vec4{c.x * c.z * s.y + s.x * s.z,
+                       c.x * s.z * s.y - s.x * c.z, c.y * c.x, 0.0f} *
+             obj.scale.z;
+    dst[3] = glm::vec4{obj.position, 1.0f};
+  }
+}
+
+} // namespace librii::kmp
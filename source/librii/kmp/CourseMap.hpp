@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/common.h>
+#include <glm/mat4x4.hpp>
 #include <librii/kmp/data/MapArea.hpp>
 #include <librii/kmp/data/MapCamera.hpp>
 #include <librii/kmp/data/MapCannon.hpp>
@@ -11,6 +12,7 @@
 #include <librii/kmp/data/MapStage.hpp>
 #include <librii/kmp/data/MapStart.hpp>
 #include <llvm/ADT/SmallVector.h>
+#include <span>
 
 namespace librii::kmp {
 
@@ -49,4 +51,11 @@ public:
   llvm::SmallVector<MissionPoint, 1> mMissionPoints;
 };
 
+//! Model matrices of placed objects, in one pass over their SRTs. Rotations are
+//! in degrees, applied about X, then Y, then Z, as for bones.
+//!
+//! \param out As many matrices as objects.
+void ComputeGeoObjMatrices(std::span<const GeoObj> objs,
+                           std::span<glm::mat4> out);
+
 } // namespace librii::kmp
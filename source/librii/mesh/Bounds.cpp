@@ -0,0 +1,187 @@
+#include "Bounds.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <llvm/Support/xxhash.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIBRII_MESH_SSE2
+#endif
+
+namespace librii::mesh {
+
+static_assert(sizeof(glm::vec3) == 12, "Points are read as packed floats");
+
+static void expandScalar(std::span<const glm::vec3> points, glm::vec3& min,
+                         glm::vec3& max) {
+  for (const auto& p : points) {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+}
+
+static void computeBox(std::span<const glm::vec3> points, glm::vec3& min,
+                       glm::vec3& max) {
+  std::size_t i = 0;
+#ifdef LIBRII_MESH_SSE2
+  // Four points are three registers: (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3).
+  // Each lane keeps to one axis, so the lanes are only sorted out at the end.
+  if (points.size() >= 4) {
+    const f32* data = &points[0].x;
+    __m128 minA = _mm_loadu_ps(data), maxA = minA;
+    __m128 minB = _mm_loadu_ps(data + 4), maxB = minB;
+    __m128 minC = _mm_loadu_ps(data + 8), maxC = minC;
+    for (i = 4; i + 4 <= points.size(); i += 4) {
+      const f32* p = data + i * 3;
+      const __m128 a = _mm_loadu_ps(p);
+      const __m128 b = _mm_loadu_ps(p + 4);
+      const __m128 c = _mm_loadu_ps(p + 8);
+      minA = _mm_min_ps(minA, a);
+      maxA = _mm_max_ps(maxA, a);
+      minB = _mm_min_ps(minB, b);
+      maxB = _mm_max_ps(maxB, b);
+      minC = _mm_min_ps(minC, c);
+      maxC = _mm_max_ps(maxC, c);
+    }
+    alignas(16) std::array<f32, 4> a, b, c;
+    _mm_store_ps(a.data(), minA);
+    _mm_store_ps(b.data(), minB);
+    _mm_store_ps(c.data(), minC);
+    min = glm::min(min, glm::vec3{std::min({a[0], a[3], b[2], c[1]}),
+                                  std::min({a[1], b[0], b[3], c[2]}),
+                                  std::min({a[2], b[1], c[0], c[3]})});
+    _mm_store_ps(a.data(), maxA);
+    _mm_store_ps(b.data(), maxB);
+    _mm_store_ps(c.data(), maxC);
+    max = glm::max(max, glm::vec3{std::max({a[0], a[3], b[2], c[1]}),
+                                  std::max({a[1], b[0], b[3], c[2]}),
+                                  std::max({a[2], b[1], c[0], c[3]})});
+  }
+#endif
+  expandScalar(points.subspan(i), min, max);
+}
+
+static f32 distance2(const glm::vec3& a, const glm::vec3& b) {
+  const glm::vec3 d = a - b;
+  return glm::dot(d, d);
+}
+
+BoundingVolume ComputeBoundingVolume(std::span<const glm::vec3> points) {
+  BoundingVolume result;
+  if (points.empty())
+    return result;
+
+  computeBox(points, result.min, result.max);
+
+  // Ritter: start from the widest pair of axis-extremal points
+  std::array<std::size_t, 3> lo{}, hi{};
+  for (std::size_t i = 1; i < points.size(); ++i) {
+    for (int axis = 0; axis < 3; ++axis) {
+      if (points[i][axis] < points[lo[axis]][axis])
+        lo[axis] = i;
+      if (points[i][axis] > points[hi[axis]][axis])
+        hi[axis] = i;
+    }
+  }
+  int widest = 0;
+  for (int axis = 1; axis < 3; ++axis) {
+    if (distance2(points[lo[axis]], points[hi[axis]]) >
+        distance2(points[lo[widest]], points[hi[widest]]))
+      widest = axis;
+  }
+  glm::vec3 center = (points[lo[widest]] + points[hi[widest]]) * 0.5f;
+  f32 radius = std::sqrt(distance2(points[hi[widest]], center));
+
+  for (const auto& p : points) {
+    const f32 d2 = distance2(p, center);
+    if (d2 <= radius * radius)
+      continue;
+    const f32 d = std::sqrt(d2);
+    const f32 grown = (radius + d) * 0.5f;
+    center += (p - center) * ((grown - radius) / d);
+    radius = grown;
+  }
+
+  // The updates above round; measure the final radii exactly
+  const glm::vec3 boxCenter = result.getBoxCenter();
+  f32 ritter2 = 0.0f, box2 = 0.0f, origin2 = 0.0f;
+  for (const auto& p : points) {
+    ritter2 = std::max(ritter2, distance2(p, center));
+    box2 = std::max(box2, distance2(p, boxCenter));
+    origin2 = std::max(origin2, glm::dot(p, p));
+  }
+  result.originRadius = std::sqrt(origin2);
+  if (box2 < ritter2) {
+    result.center = boxCenter;
+    result.radius = std::sqrt(box2);
+  } else {
+    result.center = center;
+    result.radius = std::sqrt(ritter2);
+  }
+  return result;
+}
+
+void GatherPositions(const gx::MatrixPrimitive& mp,
+                     std::span<const glm::vec3> positions,
+                     std::vector<bool>& seen, std::vector<glm::vec3>& out) {
+  assert(seen.size() >= positions.size());
+  std::vector<u16> indices;
+  for (const auto& prim : mp.mPrimitives) {
+    for (const u16 index :
+         prim.mVertices.getAttribute(gx::VertexAttribute::Position)) {
+      if (index >= positions.size() || seen[index])
+        continue;
+      seen[index] = true;
+      indices.push_back(index);
+      out.push_back(positions[index]);
+    }
+  }
+  for (const u16 index : indices)
+    seen[index] = false;
+}
+
+MeshBounds ComputeMeshBounds(const gx::MeshData& mesh,
+                             std::span<const glm::vec3> positions) {
+  MeshBounds result;
+  result.matrixPrimitives.reserve(mesh.mMatrixPrimitives.size());
+
+  std::vector<bool> seen(positions.size(), false);
+  // Matrix primitives may share positions; duplicates do not affect the
+  // mesh volume
+  std::vector<glm::vec3> all;
+  for (const auto& mp : mesh.mMatrixPrimitives) {
+    const std::size_t first = all.size();
+    GatherPositions(mp, positions, seen, all);
+    result.matrixPrimitives.push_back(ComputeBoundingVolume(
+        std::span<const glm::vec3>(all).subspan(first)));
+  }
+  result.mesh = ComputeBoundingVolume(all);
+  return result;
+}
+
+static u64 combine(u64 seed, u64 value) {
+  return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
+
+u64 HashMeshIndices(const gx::MeshData& mesh) {
+  u64 hash = mesh.mMatrixPrimitives.size();
+  for (const auto& mp : mesh.mMatrixPrimitives) {
+    hash = combine(hash, mp.mPrimitives.size());
+    for (const auto& prim : mp.mPrimitives) {
+      const auto packed = prim.mVertices.getPacked();
+      hash = combine(hash, static_cast<u64>(prim.mType));
+      hash = combine(hash, prim.mVertices.getMask());
+      hash = combine(hash, prim.mVertices.size());
+      hash = combine(hash, llvm::xxHash64(llvm::ArrayRef<uint8_t>(
+                               reinterpret_cast<const u8*>(packed.data()),
+                               packed.size_bytes())));
+    }
+  }
+  return hash;
+}
+
+} // namespace librii::mesh
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <core/common.h>
+#include <glm/vec3.hpp>
+#include <librii/gx.h>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace librii::mesh {
+
+//! Box and sphere enclosing a set of points.
+struct BoundingVolume {
+  glm::vec3 min{std::numeric_limits<f32>::max()};
+  glm::vec3 max{std::numeric_limits<f32>::lowest()};
+  //! Near-minimal enclosing sphere (Ritter).
+  glm::vec3 center{0.0f};
+  f32 radius = 0.0f;
+  //! Radius of the sphere about the origin enclosing every point, as J3D
+  //! stores alongside the box.
+  f32 originRadius = 0.0f;
+
+  bool empty() const { return min.x > max.x; }
+  glm::vec3 getBoxCenter() const { return (min + max) * 0.5f; }
+
+  bool operator==(const BoundingVolume&) const = default;
+};
+
+struct MeshBounds {
+  BoundingVolume mesh;
+  //! Per matrix primitive, in order.
+  std::vector<BoundingVolume> matrixPrimitives;
+};
+
+//! @brief Compute the box and sphere of a set of points.
+//!
+//! The box is a SIMD min/max pass. The sphere is Ritter's: grown from the
+//! widest of the extremal pairs to cover every point. It is within a few
+//! percent of the minimal sphere in practice; if the sphere about the box
+//! center is smaller, that is used instead.
+//!
+BoundingVolume ComputeBoundingVolume(std::span<const glm::vec3> points);
+
+//! @brief Append the positions a matrix primitive references, each once.
+//!
+//! @param[in]     positions Position buffer the mesh indexes.
+//! @param[in,out] seen      Scratch space, one entry per position; all false
+//!                          on entry and on return.
+//!
+void GatherPositions(const gx::MatrixPrimitive& mp,
+                     std::span<const glm::vec3> positions,
+                     std::vector<bool>& seen, std::vector<glm::vec3>& out);
+
+//! @brief Compute bounds of a mesh and of each of its matrix primitives from
+//! the positions they reference. Out-of-range indices are ignored.
+MeshBounds ComputeMeshBounds(const gx::MeshData& mesh,
+                             std::span<const glm::vec3> positions);
+
+//! @brief Hash of the index streams of a mesh, to tell when bounds computed
+//! from them are stale.
+u64 HashMeshIndices(const gx::MeshData& mesh);
+
+} // namespace librii::mesh
@@ -0,0 +1,161 @@
+#include "MatrixPalette.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+
+namespace librii::mesh {
+
+namespace {
+
+struct InfluenceSet {
+  // Sorted, unique
+  std::vector<u16> matrices;
+  std::vector<u32> triangles;
+  bool placed = false;
+};
+
+// Matrices of `set` not already in `palette`, sorted
+std::vector<u16> FindMissing(const std::vector<u16>& palette,
+                             const InfluenceSet& set) {
+  std::vector<u16> missing;
+  for (u16 m : set.matrices)
+    if (std::find(palette.begin(), palette.end(), m) == palette.end())
+      missing.push_back(m);
+  return missing;
+}
+
+struct Candidate {
+  InfluenceSet* set;
+  std::vector<u16> missing;
+};
+
+} // namespace
+
+std::vector<PaletteGroup>
+PartitionMatrixPalettes(std::span<const std::array<u16, 3>> triangleMatrices,
+                        u32 paletteSize) {
+  assert(paletteSize >= 3);
+
+  std::vector<InfluenceSet> sets;
+  {
+    std::map<std::vector<u16>, u32> lookup;
+    for (u32 t = 0; t < triangleMatrices.size(); ++t) {
+      std::vector<u16> key(triangleMatrices[t].begin(),
+                           triangleMatrices[t].end());
+      std::sort(key.begin(), key.end());
+      key.erase(std::unique(key.begin(), key.end()), key.end());
+
+      auto [it, inserted] = lookup.emplace(key, static_cast<u32>(sets.size()));
+      if (inserted)
+        sets.push_back(
+            {.matrices = std::move(key), .triangles = {}, .placed = false});
+      sets[it->second].triangles.push_back(t);
+    }
+  }
+
+  std::vector<PaletteGroup> groups;
+  std::size_t remaining = sets.size();
+  // Slot contents of the previous palette; 0xffff when unused
+  std::vector<u16> prevSlots;
+
+  while (remaining != 0) {
+    // Seed: the set hardest to place later on
+    InfluenceSet* seed = nullptr;
+    for (auto& set : sets) {
+      if (set.placed)
+        continue;
+      if (seed == nullptr || set.matrices.size() > seed->matrices.size() ||
+          (set.matrices.size() == seed->matrices.size() &&
+           set.triangles.size() > seed->triangles.size()))
+        seed = &set;
+    }
+
+    std::vector<u16> palette = seed->matrices;
+    std::vector<InfluenceSet*> members{seed};
+    seed->placed = true;
+    --remaining;
+
+    while (remaining != 0 && palette.size() < paletteSize) {
+      std::vector<Candidate> candidates;
+      std::size_t fewest = paletteSize;
+      for (auto& set : sets) {
+        if (set.placed)
+          continue;
+        auto missing = FindMissing(palette, set);
+        if (palette.size() + missing.size() > paletteSize)
+          continue;
+        fewest = std::min(fewest, missing.size());
+        candidates.push_back({&set, std::move(missing)});
+      }
+      if (candidates.empty())
+        break;
+
+      // Lookahead: of the sets needing the fewest new matrices, take the one
+      // whose matrices also complete the most other triangles
+      const Candidate* best = nullptr;
+      std::size_t bestGain = 0;
+      for (const auto& c : candidates) {
+        if (c.missing.size() != fewest)
+          continue;
+        std::size_t gain = c.set->triangles.size();
+        for (const auto& other : candidates) {
+          if (&other != &c && !other.missing.empty() &&
+              std::includes(c.missing.begin(), c.missing.end(),
+                            other.missing.begin(), other.missing.end()))
+            gain += other.set->triangles.size();
+        }
+        if (best == nullptr || gain > bestGain) {
+          best = &c;
+          bestGain = gain;
+        }
+      }
+
+      palette.insert(palette.end(), best->missing.begin(), best->missing.end());
+      members.push_back(best->set);
+      best->set->placed = true;
+      --remaining;
+    }
+
+    // Sets that are already covered cost nothing: sweep them in too
+    for (auto& set : sets) {
+      if (!set.placed && FindMissing(palette, set).empty()) {
+        members.push_back(&set);
+        set.placed = true;
+        --remaining;
+      }
+    }
+
+    // Keep matrices in the slot they had in the previous palette
+    std::vector<u16> slots(palette.size(), 0xffff);
+    std::vector<bool> assigned(palette.size(), false);
+    for (std::size_t s = 0; s < std::min(slots.size(), prevSlots.size()); ++s) {
+      const auto it = std::find(palette.begin(), palette.end(), prevSlots[s]);
+      if (it == palette.end())
+        continue;
+      slots[s] = *it;
+      assigned[it - palette.begin()] = true;
+    }
+    std::size_t free = 0;
+    for (std::size_t i = 0; i < palette.size(); ++i) {
+      if (assigned[i])
+        continue;
+      while (slots[free] != 0xffff)
+        ++free;
+      slots[free] = palette[i];
+    }
+
+    auto& group = groups.emplace_back();
+    group.matrices = slots;
+    for (const auto* set : members)
+      group.triangles.insert(group.triangles.end(), set->triangles.begin(),
+                             set->triangles.end());
+    // Preserve source order within the group; it is usually spatially coherent
+    std::sort(group.triangles.begin(), group.triangles.end());
+    prevSlots = std::move(slots);
+  }
+
+  return groups;
+}
+
+} // namespace librii::mesh
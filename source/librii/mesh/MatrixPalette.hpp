@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <span>
+#include <vector>
+
+namespace librii::mesh {
+
+struct PaletteGroup {
+  //! Palette slot -> model draw matrix.
+  std::vector<u16> matrices;
+  //! Indices of the triangles drawn with this palette.
+  std::vector<u32> triangles;
+};
+
+//! @brief Split skinned triangles into groups sharing one matrix palette.
+//!
+//! Triangles with the same set of influences are kept together. Each palette is
+//! seeded with the largest remaining influence set, then filled with whichever
+//! set needs the fewest new matrices until nothing else fits. Ties look one step
+//! ahead: the set whose new matrices also complete the most triangles of other
+//! sets wins. This packs into far fewer groups than a sequential sweep.
+//!
+//! Matrices shared with the previous group keep their slot, so a writer that
+//! skips reloading unchanged slots sends fewer matrices.
+//!
+//! @param[in] triangleMatrices Draw matrix of each vertex of each triangle.
+//! @param[in] paletteSize      Matrices per palette (at least 3).
+//!
+std::vector<PaletteGroup>
+PartitionMatrixPalettes(std::span<const std::array<u16, 3>> triangleMatrices,
+                        u32 paletteSize = 10);
+
+} // namespace librii::mesh
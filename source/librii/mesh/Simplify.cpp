@@ -0,0 +1,370 @@
+#include "Simplify.hpp"
+#include "VertexKey.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <librii/gpu/DLMesh.hpp>
+#include <queue>
+#include <unordered_map>
+
+namespace librii::mesh {
+
+namespace {
+
+// Symmetric 4x4 matrix: the squared distance to a set of planes
+struct Quadric {
+  f64 a2 = 0, ab = 0, ac = 0, ad = 0;
+  f64 b2 = 0, bc = 0, bd = 0;
+  f64 c2 = 0, cd = 0;
+  f64 d2 = 0;
+
+  static Quadric fromPlane(const glm::dvec3& n, f64 d, f64 weight) {
+    Quadric q;
+    q.a2 = n.x * n.x * weight;
+    q.ab = n.x * n.y * weight;
+    q.ac = n.x * n.z * weight;
+    q.ad = n.x * d * weight;
+    q.b2 = n.y * n.y * weight;
+    q.bc = n.y * n.z * weight;
+    q.bd = n.y * d * weight;
+    q.c2 = n.z * n.z * weight;
+    q.cd = n.z * d * weight;
+    q.d2 = d * d * weight;
+    return q;
+  }
+
+  Quadric& operator+=(const Quadric& rhs) {
+    a2 += rhs.a2, ab += rhs.ab, ac += rhs.ac, ad += rhs.ad;
+    b2 += rhs.b2, bc += rhs.bc, bd += rhs.bd;
+    c2 += rhs.c2, cd += rhs.cd;
+    d2 += rhs.d2;
+    return *this;
+  }
+  Quadric operator+(const Quadric& rhs) const {
+    Quadric q = *this;
+    return q += rhs;
+  }
+
+  f64 eval(const glm::vec3& p) const {
+    const f64 x = p.x, y = p.y, z = p.z;
+    return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+           b2 * y * y + 2 * bc * y * z + 2 * bd * y + c2 * z * z +
+           2 * cd * z + d2;
+  }
+};
+
+struct Collapse {
+  f32 cost;
+  u32 from, to;
+  u32 fromVersion, toVersion;
+
+  // Min-heap on cost
+  bool operator<(const Collapse& rhs) const { return cost > rhs.cost; }
+};
+
+class Simplifier {
+public:
+  Simplifier(std::span<const u32> indices,
+             std::span<const glm::vec3> positions,
+             const std::vector<bool>& locked)
+      : mTris(indices.begin(), indices.end()), mPositions(positions),
+        mNumLive(static_cast<u32>(indices.size() / 3)),
+        mDeadTri(indices.size() / 3, false),
+        mDeadVert(positions.size(), false),
+        mLocked(positions.size(), false), mVersion(positions.size(), 0),
+        mQuadrics(positions.size()), mVertTris(positions.size()) {
+    const u32 numTris = static_cast<u32>(mTris.size() / 3);
+    for (u32 t = 0; t < numTris; ++t) {
+      const glm::dvec3 p0 = getPos(t, 0), p1 = getPos(t, 1),
+                       p2 = getPos(t, 2);
+      const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+      const f64 len = glm::length(cross);
+      // Weight by area so that slivers do not dominate
+      if (len > 0.0) {
+        const glm::dvec3 n = cross / len;
+        const auto q = Quadric::fromPlane(n, -glm::dot(n, p0), len * 0.5);
+        for (int i = 0; i < 3; ++i)
+          mQuadrics[mTris[t * 3 + i]] += q;
+      }
+      for (int i = 0; i < 3; ++i)
+        mVertTris[mTris[t * 3 + i]].push_back(t);
+    }
+
+    for (std::size_t v = 0; v < locked.size() && v < mLocked.size(); ++v)
+      mLocked[v] = locked[v];
+
+    // Open edges: a directed edge without its opposite
+    std::unordered_map<u64, u32> edges;
+    edges.reserve(mTris.size());
+    for (u32 t = 0; t < numTris; ++t)
+      for (int i = 0; i < 3; ++i)
+        ++edges[edgeKey(mTris[t * 3 + i], mTris[t * 3 + (i + 1) % 3])];
+    for (u32 t = 0; t < numTris; ++t) {
+      for (int i = 0; i < 3; ++i) {
+        const u32 a = mTris[t * 3 + i], b = mTris[t * 3 + (i + 1) % 3];
+        if (!edges.contains(edgeKey(b, a)))
+          mLocked[a] = mLocked[b] = true;
+      }
+    }
+
+    for (u32 t = 0; t < numTris; ++t)
+      for (int i = 0; i < 3; ++i)
+        pushEdge(mTris[t * 3 + i], mTris[t * 3 + (i + 1) % 3]);
+  }
+
+  void run(u32 targetTriangles, f32 maxError) {
+    while (mNumLive > targetTriangles && !mHeap.empty()) {
+      const Collapse c = mHeap.top();
+      mHeap.pop();
+      if (mDeadVert[c.from] || mDeadVert[c.to] ||
+          mVersion[c.from] != c.fromVersion || mVersion[c.to] != c.toVersion)
+        continue;
+      if (c.cost > maxError)
+        break;
+      if (!canCollapse(c.from, c.to))
+        continue;
+      collapse(c.from, c.to);
+    }
+  }
+
+  std::vector<u32> result() const {
+    std::vector<u32> out;
+    out.reserve(mNumLive * 3);
+    for (u32 t = 0; t < mDeadTri.size(); ++t)
+      if (!mDeadTri[t])
+        out.insert(out.end(), mTris.begin() + t * 3, mTris.begin() + t * 3 + 3);
+    return out;
+  }
+
+private:
+  static u64 edgeKey(u32 a, u32 b) { return (static_cast<u64>(a) << 32) | b; }
+
+  glm::vec3 getPos(u32 t, int i) const { return mPositions[mTris[t * 3 + i]]; }
+
+  bool contains(u32 t, u32 v) const {
+    return mTris[t * 3] == v || mTris[t * 3 + 1] == v || mTris[t * 3 + 2] == v;
+  }
+
+  // Push both directions of an edge, where allowed
+  void pushEdge(u32 a, u32 b) {
+    const Quadric q = mQuadrics[a] + mQuadrics[b];
+    if (!mLocked[a])
+      mHeap.push({static_cast<f32>(std::max(q.eval(mPositions[b]), 0.0)), a,
+                  b, mVersion[a], mVersion[b]});
+    if (!mLocked[b])
+      mHeap.push({static_cast<f32>(std::max(q.eval(mPositions[a]), 0.0)), b,
+                  a, mVersion[b], mVersion[a]});
+  }
+
+  // Vertices sharing a live triangle with `v`
+  void getNeighbors(u32 v, std::vector<u32>& out) const {
+    out.clear();
+    for (const u32 t : mVertTris[v]) {
+      if (mDeadTri[t])
+        continue;
+      for (int i = 0; i < 3; ++i)
+        if (mTris[t * 3 + i] != v)
+          out.push_back(mTris[t * 3 + i]);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+  }
+
+  bool canCollapse(u32 from, u32 to) {
+    u32 shared = 0;
+    for (const u32 t : mVertTris[from]) {
+      if (mDeadTri[t])
+        continue;
+      if (contains(t, to)) {
+        ++shared;
+        continue;
+      }
+      // Moving `from` onto `to` must not flip or flatten the triangle
+      std::array<glm::vec3, 3> p;
+      for (int i = 0; i < 3; ++i)
+        p[i] = getPos(t, i);
+      const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+      for (int i = 0; i < 3; ++i)
+        if (mTris[t * 3 + i] == from)
+          p[i] = mPositions[to];
+      const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+      if (glm::dot(before, after) <= 0.0f)
+        return false;
+    }
+    if (shared == 0)
+      return false;
+
+    // Link condition: the only vertices adjacent to both are the apexes of the
+    // triangles on the edge. Otherwise the collapse pinches the surface.
+    getNeighbors(from, mScratchA);
+    getNeighbors(to, mScratchB);
+    u32 common = 0;
+    for (auto a = mScratchA.begin(), b = mScratchB.begin();
+         a != mScratchA.end() && b != mScratchB.end();) {
+      if (*a < *b) {
+        ++a;
+      } else if (*b < *a) {
+        ++b;
+      } else {
+        ++common, ++a, ++b;
+      }
+    }
+    return common == shared;
+  }
+
+  void collapse(u32 from, u32 to) {
+    for (const u32 t : mVertTris[from]) {
+      if (mDeadTri[t])
+        continue;
+      if (contains(t, to)) {
+        mDeadTri[t] = true;
+        --mNumLive;
+        continue;
+      }
+      for (int i = 0; i < 3; ++i)
+        if (mTris[t * 3 + i] == from)
+          mTris[t * 3 + i] = to;
+      mVertTris[to].push_back(t);
+    }
+    mVertTris[from].clear();
+    mDeadVert[from] = true;
+    mQuadrics[to] += mQuadrics[from];
+    ++mVersion[to];
+
+    auto& tris = mVertTris[to];
+    tris.erase(std::remove_if(tris.begin(), tris.end(),
+                              [&](u32 t) { return mDeadTri[t]; }),
+               tris.end());
+
+    // Every edge touching `to` changed cost
+    getNeighbors(to, mScratchA);
+    for (const u32 n : mScratchA)
+      pushEdge(to, n);
+  }
+
+  std::vector<u32> mTris;
+  std::span<const glm::vec3> mPositions;
+  u32 mNumLive;
+  std::vector<bool> mDeadTri;
+  std::vector<bool> mDeadVert;
+  std::vector<bool> mLocked;
+  std::vector<u32> mVersion;
+  std::vector<Quadric> mQuadrics;
+  std::vector<std::vector<u32>> mVertTris;
+  std::priority_queue<Collapse> mHeap;
+  std::vector<u32> mScratchA, mScratchB;
+};
+
+constexpr u32 MaxListVertices = 0xffff / 3 * 3;
+
+} // namespace
+
+std::vector<u32> SimplifyTriangles(std::span<const u32> indices,
+                                   std::span<const glm::vec3> positions,
+                                   const std::vector<bool>& locked,
+                                   u32 targetTriangles, f32 maxError) {
+  assert(indices.size() % 3 == 0);
+  Simplifier simplifier(indices, positions, locked);
+  simplifier.run(targetTriangles, maxError);
+  return simplifier.result();
+}
+
+SimplifyStats SimplifyMesh(gx::MeshData& mesh,
+                           std::span<const glm::vec3> positions,
+                           const SimplifySettings& settings,
+                           const std::vector<bool>* lockedPositions) {
+  SimplifyStats stats;
+
+  auto layout = gpu::CompileVertexLayout(mesh.mVertexDescriptor);
+  if (!layout) {
+    llvm::consumeError(layout.takeError());
+    return stats;
+  }
+  const VertexKey key{&*layout};
+
+  for (auto& mp : mesh.mMatrixPrimitives) {
+    std::unordered_map<gx::IndexedVertex, u32, VertexKey, VertexKey> lookup(
+        0, key, key);
+    std::vector<gx::IndexedVertex> unique;
+    std::vector<u32> tris;
+    bool supported = true;
+
+    for (const auto& prim : mp.mPrimitives) {
+      std::vector<u32> ids;
+      ids.reserve(prim.mVertices.size());
+      for (const gx::IndexedVertex v : prim.mVertices) {
+        auto [it, inserted] =
+            lookup.emplace(v, static_cast<u32>(unique.size()));
+        if (inserted)
+          unique.push_back(v);
+        ids.push_back(it->second);
+      }
+
+      const std::size_t n = ids.size();
+      const auto push = [&](u32 a, u32 b, u32 c) {
+        if (a != b && b != c && a != c)
+          tris.insert(tris.end(), {a, b, c});
+      };
+      switch (prim.mType) {
+      case gx::PrimitiveType::Triangles:
+        for (std::size_t i = 0; i + 2 < n; i += 3)
+          push(ids[i], ids[i + 1], ids[i + 2]);
+        break;
+      case gx::PrimitiveType::TriangleStrip:
+        for (std::size_t i = 0; i + 2 < n; ++i) {
+          if (i % 2 == 0)
+            push(ids[i], ids[i + 1], ids[i + 2]);
+          else
+            push(ids[i + 1], ids[i], ids[i + 2]);
+        }
+        break;
+      case gx::PrimitiveType::TriangleFan:
+        for (std::size_t i = 1; i + 1 < n; ++i)
+          push(ids[0], ids[i], ids[i + 1]);
+        break;
+      default:
+        supported = false;
+        break;
+      }
+    }
+    if (!supported || tris.empty())
+      continue;
+
+    std::vector<glm::vec3> vertexPositions(unique.size());
+    std::vector<bool> locked(unique.size(), false);
+    for (std::size_t v = 0; v < unique.size(); ++v) {
+      const u16 pos = unique[v][gx::VertexAttribute::Position];
+      if (pos >= positions.size()) {
+        locked[v] = true;
+        continue;
+      }
+      vertexPositions[v] = positions[pos];
+      if (lockedPositions != nullptr && pos < lockedPositions->size())
+        locked[v] = (*lockedPositions)[pos];
+    }
+
+    const u32 before = static_cast<u32>(tris.size() / 3);
+    const u32 target = static_cast<u32>(std::ceil(before * settings.targetRatio));
+    const auto reduced = SimplifyTriangles(tris, vertexPositions, locked,
+                                           target, settings.maxError);
+    stats.trianglesBefore += before;
+    stats.trianglesAfter += static_cast<u32>(reduced.size() / 3);
+
+    const u32 mask = mp.mPrimitives.front().mVertices.getMask();
+    mp.mPrimitives.clear();
+    for (std::size_t i = 0; i < reduced.size(); i += MaxListVertices) {
+      const std::size_t n =
+          std::min<std::size_t>(MaxListVertices, reduced.size() - i);
+      auto& prim = mp.mPrimitives.emplace_back(gx::PrimitiveType::Triangles, n);
+      prim.mVertices.setMask(mask);
+      for (std::size_t j = 0; j < n; ++j)
+        prim.mVertices[j] = unique[reduced[i + j]];
+    }
+  }
+
+  return stats;
+}
+
+} // namespace librii::mesh
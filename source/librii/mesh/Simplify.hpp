@@ -0,0 +1,72 @@
+#pragma once
+
+#include <core/common.h>
+#include <glm/vec3.hpp>
+#include <librii/gx.h>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace librii::mesh {
+
+struct SimplifySettings {
+  //! Fraction of the triangles of each matrix primitive to keep.
+  f32 targetRatio = 0.5f;
+  //! Stop early once the cheapest collapse costs more than this (sum of
+  //! squared distances to the original planes, weighted by area).
+  f32 maxError = std::numeric_limits<f32>::max();
+};
+
+struct SimplifyStats {
+  u32 trianglesBefore = 0;
+  u32 trianglesAfter = 0;
+
+  SimplifyStats& operator+=(const SimplifyStats& rhs) {
+    trianglesBefore += rhs.trianglesBefore;
+    trianglesAfter += rhs.trianglesAfter;
+    return *this;
+  }
+};
+
+//! @brief Reduce a triangle list by quadric-error edge collapses.
+//!
+//! Garland-Heckbert quadrics with half-edge collapses: a vertex is merged into
+//! one of its neighbors, so the result only references existing vertices.
+//! Collapses are taken cheapest first from a heap; stale entries are skipped
+//! lazily. Collapses that would flip a triangle or make the surface
+//! non-manifold are rejected.
+//!
+//! Vertices on an open edge never move. As vertices are compared by id, this
+//! also keeps any seam where the ids on either side differ.
+//!
+//! @param[in] indices         Triangle list; three vertex ids per triangle.
+//! @param[in] positions       Position of each vertex id.
+//! @param[in] locked          Optional, per vertex id: vertices that must not
+//!                            move. May be empty.
+//! @param[in] targetTriangles Stop once this many triangles are left.
+//! @param[in] maxError        Stop once the cheapest collapse costs more.
+//!
+//! @return The remaining triangles, in their original order.
+//!
+std::vector<u32> SimplifyTriangles(std::span<const u32> indices,
+                                   std::span<const glm::vec3> positions,
+                                   const std::vector<bool>& locked,
+                                   u32 targetTriangles, f32 maxError);
+
+//! @brief Simplify each matrix primitive of a mesh.
+//!
+//! Vertices are identified by their full attribute tuple, so UV, color and
+//! normal seams (where a position is shared by differing vertices) are kept,
+//! as are the boundaries between matrix primitives. Each matrix primitive is
+//! rebuilt as triangle lists; strip the result afterwards if desired.
+//!
+//! @param[in] positions       Position buffer the mesh indexes.
+//! @param[in] lockedPositions Optional, per position index: positions that must
+//!                            not move, e.g. because other meshes use them.
+//!
+SimplifyStats SimplifyMesh(gx::MeshData& mesh,
+                           std::span<const glm::vec3> positions,
+                           const SimplifySettings& settings = {},
+                           const std::vector<bool>* lockedPositions = nullptr);
+
+} // namespace librii::mesh
@@ -0,0 +1,341 @@
+#include "TriangleStripper.hpp"
+#include "VertexKey.hpp"
+
+#include <algorithm>
+#include <array>
+#include <librii/gpu/DLMesh.hpp>
+#include <unordered_map>
+
+namespace librii::mesh {
+
+namespace {
+
+using Triangle = std::array<u32, 3>;
+
+constexpr u32 MaxPrimitiveVertices = 0xffff;
+
+constexpr u64 EdgeKey(u32 a, u32 b) { return (static_cast<u64>(a) << 32) | b; }
+
+class Stripper {
+public:
+  Stripper(std::vector<Triangle>&& tris, u32 numVerts)
+      : mTris(std::move(tris)), mVisited(mTris.size(), false),
+        mTrial(mTris.size(), 0), mDegree(mTris.size(), 0),
+        mVertTris(numVerts) {
+    mEdges.reserve(mTris.size() * 3);
+    for (u32 t = 0; t < mTris.size(); ++t) {
+      for (int i = 0; i < 3; ++i) {
+        mEdges.emplace_back(EdgeKey(mTris[t][i], mTris[t][(i + 1) % 3]), t);
+        mVertTris[mTris[t][i]].push_back(t);
+      }
+    }
+    std::sort(mEdges.begin(), mEdges.end());
+
+    for (u32 t = 0; t < mTris.size(); ++t) {
+      mDegree[t] = static_cast<u8>(std::min<std::size_t>(countNeighbors(t), 3));
+      mBuckets[mDegree[t]].push_back(t);
+    }
+  }
+
+  enum class Kind { Strip, Fan };
+  struct Run {
+    Kind kind;
+    std::vector<u32> verts;
+    std::vector<u32> tris;
+    u32 numTris;
+  };
+
+  bool next(Run& out, bool allowFans) {
+    const u32 start = pickStart();
+    if (start == ~0u)
+      return false;
+
+    Run best{Kind::Strip, {}, {}, 0};
+    for (int r = 0; r < 3; ++r) {
+      Run run = grow(start, r, Kind::Strip);
+      if (run.numTris > best.numTris)
+        best = std::move(run);
+    }
+    if (allowFans) {
+      for (int r = 0; r < 3; ++r) {
+        Run run = grow(start, r, Kind::Fan);
+        if (run.numTris > best.numTris)
+          best = std::move(run);
+      }
+    }
+
+    // Commit the chosen run
+    commit(best);
+    mTail = {best.verts[best.verts.size() - 2], best.verts.back()};
+    out = std::move(best);
+    return true;
+  }
+
+private:
+  // Triangles sharing an edge in the opposite direction, which a strip or fan
+  // can continue into without flipping the winding.
+  template <typename F> void forEachNeighbor(u32 t, F&& f) const {
+    for (int i = 0; i < 3; ++i) {
+      const u64 key = EdgeKey(mTris[t][(i + 1) % 3], mTris[t][i]);
+      auto it = std::lower_bound(mEdges.begin(), mEdges.end(),
+                                 std::pair<u64, u32>{key, 0});
+      for (; it != mEdges.end() && it->first == key; ++it)
+        f(it->second);
+    }
+  }
+  std::size_t countNeighbors(u32 t) const {
+    std::size_t n = 0;
+    forEachNeighbor(t, [&](u32) { ++n; });
+    return n;
+  }
+
+  // Find an available triangle containing the directed edge a->b. Returns its
+  // index and the vertex opposite that edge.
+  std::pair<u32, u32> find(u32 a, u32 b) const {
+    const u64 key = EdgeKey(a, b);
+    auto it = std::lower_bound(mEdges.begin(), mEdges.end(),
+                               std::pair<u64, u32>{key, 0});
+    for (; it != mEdges.end() && it->first == key; ++it) {
+      const u32 t = it->second;
+      if (mVisited[t] || mTrial[t] == mStamp)
+        continue;
+      for (int i = 0; i < 3; ++i)
+        if (mTris[t][i] == a)
+          return {t, mTris[t][(i + 2) % 3]};
+    }
+    return {~0u, 0};
+  }
+
+  Run grow(u32 start, int rotation, Kind kind) {
+    ++mStamp;
+    const auto& tri = mTris[start];
+    Run run{kind,
+            {tri[rotation], tri[(rotation + 1) % 3], tri[(rotation + 2) % 3]},
+            {start},
+            1};
+    mTrial[start] = mStamp;
+
+    while (run.verts.size() < MaxPrimitiveVertices) {
+      const std::size_t n = run.verts.size();
+      u32 a, b;
+      if (kind == Kind::Fan) {
+        a = run.verts[0];
+        b = run.verts[n - 1];
+      } else if (run.numTris % 2 == 0) {
+        a = run.verts[n - 2];
+        b = run.verts[n - 1];
+      } else {
+        a = run.verts[n - 1];
+        b = run.verts[n - 2];
+      }
+      const auto [t, w] = find(a, b);
+      if (t == ~0u)
+        break;
+      mTrial[t] = mStamp;
+      run.verts.push_back(w);
+      run.tris.push_back(t);
+      ++run.numTris;
+    }
+
+    // Fans are symmetric: also grow around the pivot in the other direction
+    while (kind == Kind::Fan && run.verts.size() < MaxPrimitiveVertices) {
+      const auto [t, w] = find(run.verts[1], run.verts[0]);
+      if (t == ~0u)
+        break;
+      mTrial[t] = mStamp;
+      run.verts.insert(run.verts.begin() + 1, w);
+      run.tris.push_back(t);
+      ++run.numTris;
+    }
+    return run;
+  }
+
+  void commit(const Run& run) {
+    for (u32 t : run.tris) {
+      mVisited[t] = true;
+      forEachNeighbor(t, [&](u32 n) {
+        if (mVisited[n] || mDegree[n] == 0)
+          return;
+        mBuckets[--mDegree[n]].push_back(n);
+      });
+    }
+  }
+
+  u32 pickStart() {
+    // Prefer continuing next to the previous run: its last vertices are still
+    // in the post-transform cache.
+    u32 best = ~0u;
+    for (u32 v : mTail) {
+      if (v == ~0u)
+        continue;
+      for (u32 t : mVertTris[v]) {
+        if (!mVisited[t] && (best == ~0u || mDegree[t] < mDegree[best]))
+          best = t;
+      }
+    }
+    if (best != ~0u)
+      return best;
+
+    // Otherwise, the least connected triangle: it has the fewest chances of
+    // joining a strip later on.
+    for (auto& bucket : mBuckets) {
+      while (!bucket.empty()) {
+        const u32 t = bucket.back();
+        if (!mVisited[t] && &mBuckets[mDegree[t]] == &bucket)
+          return t;
+        bucket.pop_back();
+      }
+    }
+    return ~0u;
+  }
+
+  std::vector<Triangle> mTris;
+  std::vector<std::pair<u64, u32>> mEdges; // Directed edge -> triangle
+  std::vector<bool> mVisited;
+  std::vector<u32> mTrial;
+  u32 mStamp = 0;
+  std::vector<u8> mDegree;
+  std::array<std::vector<u32>, 4> mBuckets;
+  std::vector<std::vector<u32>> mVertTris;
+  std::array<u32, 2> mTail{~0u, ~0u};
+};
+
+// Expand a primitive into triangles, in drawing order and original winding
+bool Triangulate(const gx::IndexedPrimitive& prim, const std::vector<u32>& ids,
+                 std::vector<Triangle>& out) {
+  auto push = [&](u32 a, u32 b, u32 c) {
+    // Degenerate triangles are dropped: they exist only to join strips
+    if (a != b && b != c && c != a)
+      out.push_back({a, b, c});
+  };
+  const std::size_t n = ids.size();
+  switch (prim.mType) {
+  case gx::PrimitiveType::Triangles:
+    for (std::size_t i = 0; i + 2 < n; i += 3)
+      push(ids[i], ids[i + 1], ids[i + 2]);
+    return true;
+  case gx::PrimitiveType::TriangleStrip:
+    for (std::size_t i = 0; i + 2 < n; ++i) {
+      if (i % 2 == 0)
+        push(ids[i], ids[i + 1], ids[i + 2]);
+      else
+        push(ids[i + 1], ids[i], ids[i + 2]);
+    }
+    return true;
+  case gx::PrimitiveType::TriangleFan:
+    for (std::size_t i = 1; i + 1 < n; ++i)
+      push(ids[0], ids[i], ids[i + 1]);
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+bool StripifyMatrixPrimitive(gx::MatrixPrimitive& mp,
+                             const gx::VertexDescriptor& vcd,
+                             const StripifySettings& settings,
+                             StripifyStats* stats) {
+  auto layout = gpu::CompileVertexLayout(vcd);
+  if (!layout) {
+    llvm::consumeError(layout.takeError());
+    return false;
+  }
+  const u32 stride = std::max<u32>(layout->stride, 1);
+
+  const VertexKey key{&*layout};
+  std::unordered_map<gx::IndexedVertex, u32, VertexKey, VertexKey> lookup(
+      0, key, key);
+  std::vector<gx::IndexedVertex> unique;
+  std::vector<Triangle> tris;
+  u32 verticesBefore = 0;
+
+  std::vector<u32> ids;
+  for (const auto& prim : mp.mPrimitives) {
+    ids.clear();
+    for (const gx::IndexedVertex v : prim.mVertices) {
+      auto [it, inserted] = lookup.emplace(v, static_cast<u32>(unique.size()));
+      if (inserted)
+        unique.push_back(v);
+      ids.push_back(it->second);
+    }
+    if (!Triangulate(prim, ids, tris))
+      return false;
+    verticesBefore += static_cast<u32>(prim.mVertices.size());
+  }
+  if (tris.empty())
+    return false;
+
+  const u32 numTris = static_cast<u32>(tris.size());
+  Stripper stripper(std::move(tris), static_cast<u32>(unique.size()));
+
+  StripifyStats local;
+  local.numTriangles = numTris;
+  local.verticesBefore = verticesBefore;
+
+  std::vector<gx::IndexedPrimitive> result;
+  std::vector<u32> loose;
+  Stripper::Run run;
+  while (stripper.next(run, settings.allowFans)) {
+    // A run pays a 3-byte draw command, but saves two vertices per triangle
+    // after the first.
+    const u32 asRun = 3 + static_cast<u32>(run.verts.size()) * stride;
+    const u32 asList = 3 * run.numTris * stride;
+    if (asRun >= asList) {
+      for (u32 i = 0; i < run.numTris; ++i) {
+        if (run.kind == Stripper::Kind::Fan) {
+          loose.insert(loose.end(),
+                       {run.verts[0], run.verts[i + 1], run.verts[i + 2]});
+        } else if (i % 2 == 0) {
+          loose.insert(loose.end(),
+                       {run.verts[i], run.verts[i + 1], run.verts[i + 2]});
+        } else {
+          loose.insert(loose.end(),
+                       {run.verts[i + 1], run.verts[i], run.verts[i + 2]});
+        }
+      }
+      local.numLooseTriangles += run.numTris;
+      continue;
+    }
+
+    const bool fan = run.kind == Stripper::Kind::Fan;
+    auto& prim = result.emplace_back(fan ? gx::PrimitiveType::TriangleFan
+                                         : gx::PrimitiveType::TriangleStrip,
+                                     run.verts.size());
+    prim.mVertices.setMask(layout->mask);
+    for (std::size_t i = 0; i < run.verts.size(); ++i)
+      prim.mVertices[i] = unique[run.verts[i]];
+    ++(fan ? local.numFans : local.numStrips);
+  }
+
+  constexpr u32 MaxListVertices = MaxPrimitiveVertices / 3 * 3;
+  for (std::size_t i = 0; i < loose.size(); i += MaxListVertices) {
+    const std::size_t n = std::min<std::size_t>(MaxListVertices, loose.size() - i);
+    auto& prim = result.emplace_back(gx::PrimitiveType::Triangles, n);
+    prim.mVertices.setMask(layout->mask);
+    for (std::size_t j = 0; j < n; ++j)
+      prim.mVertices[j] = unique[loose[i + j]];
+  }
+
+  if (gpu::GetMeshDisplayListSize(*layout, result) >=
+      gpu::GetMeshDisplayListSize(*layout, mp.mPrimitives))
+    return false;
+
+  for (const auto& prim : result)
+    local.verticesAfter += static_cast<u32>(prim.mVertices.size());
+  mp.mPrimitives = std::move(result);
+  if (stats != nullptr)
+    *stats += local;
+  return true;
+}
+
+StripifyStats StripifyMesh(gx::MeshData& mesh,
+                           const StripifySettings& settings) {
+  StripifyStats stats;
+  for (auto& mp : mesh.mMatrixPrimitives)
+    StripifyMatrixPrimitive(mp, mesh.mVertexDescriptor, settings, &stats);
+  return stats;
+}
+
+} // namespace librii::mesh
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gx.h>
+
+namespace librii::mesh {
+
+struct StripifySettings {
+  //! Emit a triangle fan when it covers more triangles than any strip from the
+  //! same starting triangle.
+  bool allowFans = true;
+};
+
+struct StripifyStats {
+  u32 numTriangles = 0;
+  u32 numStrips = 0;
+  u32 numFans = 0;
+  //! Triangles left in a plain triangle list.
+  u32 numLooseTriangles = 0;
+  u32 verticesBefore = 0;
+  u32 verticesAfter = 0;
+
+  StripifyStats& operator+=(const StripifyStats& rhs) {
+    numTriangles += rhs.numTriangles;
+    numStrips += rhs.numStrips;
+    numFans += rhs.numFans;
+    numLooseTriangles += rhs.numLooseTriangles;
+    verticesBefore += rhs.verticesBefore;
+    verticesAfter += rhs.verticesAfter;
+    return *this;
+  }
+};
+
+//! @brief Rebuild the primitives of a matrix primitive as triangle strips,
+//! fans and a single list of leftover triangles.
+//!
+//! Vertices are considered shared when every attribute of the descriptor
+//! matches. Strips are grown greedily (lowest-connectivity triangles first)
+//! and each new strip starts next to the last one so that recently
+//! transformed vertices are reused. Winding order is preserved.
+//!
+//! Primitives are never merged across matrix primitives, so the matrix
+//! palette of each stays valid.
+//!
+//! @param[in,out] mp  Matrix primitive to rewrite.
+//! @param[in] vcd     Vertex descriptor of the owning mesh.
+//! @param[out] stats  Optional statistics, accumulated into.
+//!
+//! @return Whether the primitives were replaced. They are left untouched if
+//! they contain anything other than triangles, strips and fans, or if the
+//! result would not be smaller.
+//!
+bool StripifyMatrixPrimitive(gx::MatrixPrimitive& mp,
+                             const gx::VertexDescriptor& vcd,
+                             const StripifySettings& settings = {},
+                             StripifyStats* stats = nullptr);
+
+//! @brief Stripify every matrix primitive of a mesh.
+//!
+StripifyStats StripifyMesh(gx::MeshData& mesh,
+                           const StripifySettings& settings = {});
+
+} // namespace librii::mesh
@@ -0,0 +1,268 @@
+#include "VertexCacheOptimizer.hpp"
+#include "VertexKey.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <librii/gpu/DLMesh.hpp>
+#include <optional>
+#include <unordered_map>
+
+namespace librii::mesh {
+
+namespace {
+
+// Forsyth's tuning constants
+constexpr f32 CacheDecayPower = 1.5f;
+constexpr f32 LastTriangleScore = 0.75f;
+constexpr f32 ValenceBoostScale = 2.0f;
+constexpr f32 ValenceBoostPower = 0.5f;
+
+f32 ScoreVertex(s32 cachePos, u32 remaining, u32 cacheSize) {
+  // Nothing left to draw with this vertex
+  if (remaining == 0)
+    return -1.0f;
+
+  f32 score = 0.0f;
+  if (cachePos >= 0) {
+    // The last triangle's vertices are scored flat so that the next triangle
+    // does not simply reuse its newest edge
+    if (cachePos < 3) {
+      score = LastTriangleScore;
+    } else {
+      const f32 scale = 1.0f / static_cast<f32>(cacheSize - 3);
+      score = std::pow(1.0f - static_cast<f32>(cachePos - 3) * scale,
+                       CacheDecayPower);
+    }
+  }
+  // Finish off vertices with few triangles left, rather than leave them
+  // stranded to be transformed again later
+  score += ValenceBoostScale *
+           std::pow(static_cast<f32>(remaining), -ValenceBoostPower);
+  return score;
+}
+
+// Triangles drawn by a primitive, or nullopt if it is not made of triangles
+std::optional<u32> CountTriangles(const gx::IndexedPrimitive& prim) {
+  const u32 n = static_cast<u32>(prim.mVertices.size());
+  switch (prim.mType) {
+  case gx::PrimitiveType::Triangles:
+    if (n % 3 != 0)
+      return std::nullopt;
+    return n / 3;
+  case gx::PrimitiveType::TriangleStrip:
+  case gx::PrimitiveType::TriangleFan:
+    return n < 3 ? 0 : n - 2;
+  default:
+    return std::nullopt;
+  }
+}
+
+u32 CountMisses(const std::vector<std::vector<u32>>& ids, u32 cacheSize) {
+  std::vector<u32> stream;
+  for (const auto& prim : ids)
+    stream.insert(stream.end(), prim.begin(), prim.end());
+  return CountVertexCacheMisses(stream, cacheSize);
+}
+
+} // namespace
+
+u32 CountVertexCacheMisses(std::span<const u32> vertices, u32 cacheSize) {
+  assert(cacheSize > 0);
+  std::vector<u32> fifo(cacheSize, ~0u);
+  u32 head = 0;
+  u32 misses = 0;
+  for (const u32 v : vertices) {
+    if (std::find(fifo.begin(), fifo.end(), v) != fifo.end())
+      continue;
+    fifo[head] = v;
+    head = (head + 1) % cacheSize;
+    ++misses;
+  }
+  return misses;
+}
+
+std::vector<u32> OptimizeTriangleOrder(std::span<const u32> indices,
+                                       u32 numVertices, u32 cacheSize) {
+  assert(indices.size() % 3 == 0);
+  assert(cacheSize > 3);
+  const u32 numTris = static_cast<u32>(indices.size() / 3);
+
+  std::vector<u32> result;
+  result.reserve(indices.size());
+  if (numTris == 0)
+    return result;
+
+  // Triangles using each vertex. The first remaining[v] entries of a vertex's
+  // range are the ones not yet emitted.
+  std::vector<u32> remaining(numVertices, 0);
+  for (const u32 v : indices) {
+    assert(v < numVertices);
+    ++remaining[v];
+  }
+  std::vector<u32> offsets(numVertices + 1, 0);
+  for (u32 v = 0; v < numVertices; ++v)
+    offsets[v + 1] = offsets[v] + remaining[v];
+  std::vector<u32> adjacency(indices.size());
+  {
+    std::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+    for (u32 t = 0; t < numTris; ++t)
+      for (int i = 0; i < 3; ++i)
+        adjacency[cursor[indices[t * 3 + i]]++] = t;
+  }
+
+  std::vector<s32> cachePos(numVertices, -1);
+  std::vector<f32> vertexScore(numVertices);
+  for (u32 v = 0; v < numVertices; ++v)
+    vertexScore[v] = ScoreVertex(-1, remaining[v], cacheSize);
+
+  const auto scoreTriangle = [&](u32 t) {
+    return vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+           vertexScore[indices[t * 3 + 2]];
+  };
+
+  std::vector<bool> emitted(numTris, false);
+  u32 best = 0;
+  {
+    f32 bestScore = scoreTriangle(0);
+    for (u32 t = 1; t < numTris; ++t) {
+      const f32 score = scoreTriangle(t);
+      if (score > bestScore) {
+        best = t;
+        bestScore = score;
+      }
+    }
+  }
+
+  // LRU order; holds up to three entries past the cache while updating
+  std::vector<u32> cache, nextCache;
+  cache.reserve(cacheSize + 3);
+  nextCache.reserve(cacheSize + 3);
+  u32 scan = 0;
+
+  for (u32 n = 0; n < numTris; ++n) {
+    if (best == ~0u) {
+      // Dead end: nothing in the cache has triangles left. Resume in input
+      // order, which tends to be spatially coherent.
+      while (emitted[scan])
+        ++scan;
+      best = scan;
+    }
+    const u32 t = best;
+    emitted[t] = true;
+
+    nextCache.clear();
+    for (int i = 0; i < 3; ++i) {
+      const u32 v = indices[t * 3 + i];
+      result.push_back(v);
+
+      u32* begin = adjacency.data() + offsets[v];
+      u32* end = begin + remaining[v];
+      *std::find(begin, end, t) = end[-1];
+      --remaining[v];
+
+      if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+        nextCache.push_back(v);
+    }
+    for (const u32 v : cache)
+      if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+        nextCache.push_back(v);
+
+    for (std::size_t i = 0; i < nextCache.size(); ++i) {
+      const u32 v = nextCache[i];
+      cachePos[v] = i < cacheSize ? static_cast<s32>(i) : -1;
+      vertexScore[v] = ScoreVertex(cachePos[v], remaining[v], cacheSize);
+    }
+
+    // Only triangles touching the cache changed score; the best of them is
+    // drawn next
+    best = ~0u;
+    f32 bestScore = 0.0f;
+    for (const u32 v : nextCache) {
+      for (u32 i = 0; i < remaining[v]; ++i) {
+        const u32 candidate = adjacency[offsets[v] + i];
+        const f32 score = scoreTriangle(candidate);
+        if (best == ~0u || score > bestScore) {
+          best = candidate;
+          bestScore = score;
+        }
+      }
+    }
+
+    if (nextCache.size() > cacheSize)
+      nextCache.resize(cacheSize);
+    std::swap(cache, nextCache);
+  }
+
+  return result;
+}
+
+bool OptimizeVertexCache(gx::MatrixPrimitive& mp,
+                         const gx::VertexDescriptor& vcd,
+                         const VertexCacheSettings& settings,
+                         VertexCacheStats* stats) {
+  auto layout = gpu::CompileVertexLayout(vcd);
+  if (!layout) {
+    llvm::consumeError(layout.takeError());
+    return false;
+  }
+
+  const VertexKey key{&*layout};
+  std::unordered_map<gx::IndexedVertex, u32, VertexKey, VertexKey> lookup(
+      0, key, key);
+  std::vector<gx::IndexedVertex> unique;
+  // Vertex ids of each primitive, in draw order
+  std::vector<std::vector<u32>> ids(mp.mPrimitives.size());
+
+  VertexCacheStats local;
+  for (std::size_t p = 0; p < mp.mPrimitives.size(); ++p) {
+    const auto& prim = mp.mPrimitives[p];
+    const auto numTris = CountTriangles(prim);
+    if (!numTris)
+      return false;
+    local.numTriangles += *numTris;
+
+    ids[p].reserve(prim.mVertices.size());
+    for (const gx::IndexedVertex v : prim.mVertices) {
+      auto [it, inserted] = lookup.emplace(v, static_cast<u32>(unique.size()));
+      if (inserted)
+        unique.push_back(v);
+      ids[p].push_back(it->second);
+    }
+  }
+  local.missesBefore = CountMisses(ids, settings.cacheSize);
+
+  for (std::size_t p = 0; p < mp.mPrimitives.size(); ++p) {
+    if (mp.mPrimitives[p].mType == gx::PrimitiveType::Triangles) {
+      ids[p] = OptimizeTriangleOrder(ids[p], static_cast<u32>(unique.size()),
+                                     settings.cacheSize);
+    }
+  }
+  local.missesAfter = CountMisses(ids, settings.cacheSize);
+
+  const bool better = local.missesAfter < local.missesBefore;
+  if (better) {
+    for (std::size_t p = 0; p < mp.mPrimitives.size(); ++p) {
+      auto& prim = mp.mPrimitives[p];
+      if (prim.mType != gx::PrimitiveType::Triangles)
+        continue;
+      for (std::size_t i = 0; i < ids[p].size(); ++i)
+        prim.mVertices[i] = unique[ids[p][i]];
+    }
+  } else {
+    local.missesAfter = local.missesBefore;
+  }
+
+  if (stats != nullptr)
+    *stats += local;
+  return better;
+}
+
+VertexCacheStats OptimizeVertexCache(gx::MeshData& mesh,
+                                     const VertexCacheSettings& settings) {
+  VertexCacheStats stats;
+  for (auto& mp : mesh.mMatrixPrimitives)
+    OptimizeVertexCache(mp, mesh.mVertexDescriptor, settings, &stats);
+  return stats;
+}
+
+} // namespace librii::mesh
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gx.h>
+#include <span>
+#include <vector>
+
+namespace librii::mesh {
+
+struct VertexCacheSettings {
+  //! Entries of the simulated post-transform vertex cache.
+  u32 cacheSize = 16;
+};
+
+struct VertexCacheStats {
+  u32 numTriangles = 0;
+  //! Vertices transformed when drawing the primitives in order.
+  u32 missesBefore = 0;
+  u32 missesAfter = 0;
+
+  //! Average cache miss ratio: transformed vertices per triangle.
+  f32 getACMRBefore() const {
+    return numTriangles ? static_cast<f32>(missesBefore) / numTriangles : 0.0f;
+  }
+  f32 getACMRAfter() const {
+    return numTriangles ? static_cast<f32>(missesAfter) / numTriangles : 0.0f;
+  }
+
+  VertexCacheStats& operator+=(const VertexCacheStats& rhs) {
+    numTriangles += rhs.numTriangles;
+    missesBefore += rhs.missesBefore;
+    missesAfter += rhs.missesAfter;
+    return *this;
+  }
+};
+
+//! @brief Count the vertices a FIFO cache of `cacheSize` entries misses when
+//! fed `vertices` in order.
+//!
+u32 CountVertexCacheMisses(std::span<const u32> vertices, u32 cacheSize);
+
+//! @brief Reorder a triangle list for post-transform cache reuse.
+//!
+//! Tom Forsyth's linear-speed algorithm: each vertex is scored by its position
+//! in a simulated LRU cache and by how few triangles still use it, and the
+//! triangle with the highest total is emitted next. Winding is preserved.
+//!
+//! @param[in] indices     Triangle list; three vertex ids per triangle.
+//! @param[in] numVertices One more than the largest vertex id.
+//! @param[in] cacheSize   Entries of the cache to optimize for.
+//!
+//! @return The reordered triangle list.
+//!
+std::vector<u32> OptimizeTriangleOrder(std::span<const u32> indices,
+                                       u32 numVertices, u32 cacheSize);
+
+//! @brief Reorder the triangles of each triangle-list primitive of a matrix
+//! primitive.
+//!
+//! Strips and fans keep their order; they are already cache-coherent and are
+//! included in the statistics. Vertices are shared when every attribute of the
+//! descriptor matches. The primitives are left untouched if the cache would not
+//! miss less.
+//!
+//! @param[out] stats Optional statistics, accumulated into.
+//!
+//! @return Whether the primitives were changed.
+//!
+bool OptimizeVertexCache(gx::MatrixPrimitive& mp,
+                         const gx::VertexDescriptor& vcd,
+                         const VertexCacheSettings& settings = {},
+                         VertexCacheStats* stats = nullptr);
+
+//! @brief Optimize every matrix primitive of a mesh for the vertex cache.
+//!
+VertexCacheStats OptimizeVertexCache(gx::MeshData& mesh,
+                                     const VertexCacheSettings& settings = {});
+
+} // namespace librii::mesh
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gpu/DLMesh.hpp>
+#include <librii/gx.h>
+
+namespace librii::mesh {
+
+//! @brief Hash and equality of vertices over the attributes a layout emits.
+//!
+//! Two vertices equal under this key produce the same display list bytes, so
+//! passes may freely share or reorder them.
+//!
+struct VertexKey {
+  const gpu::VertexLayout* layout;
+
+  std::size_t operator()(const gx::IndexedVertex& v) const {
+    u64 h = 0xcbf29ce484222325;
+    for (const auto& field : layout->getFields()) {
+      h ^= v[static_cast<gx::VertexAttribute>(field.attribute)];
+      h *= 0x100000001b3;
+    }
+    return h;
+  }
+  bool operator()(const gx::IndexedVertex& a,
+                  const gx::IndexedVertex& b) const {
+    for (const auto& field : layout->getFields()) {
+      const auto attr = static_cast<gx::VertexAttribute>(field.attribute);
+      if (a[attr] != b[attr])
+        return false;
+    }
+    return true;
+  }
+};
+
+} // namespace librii::mesh
@@ -5,9 +5,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
 #include <librii/image/CheckerBoard.hpp>
+#include <librii/image/FormatAnalyzer.hpp>
+#include <librii/mesh/MatrixPalette.hpp>
+#include <librii/mesh/TriangleStripper.hpp>
 #include <llvm/ADT/BitVector.h>
 #include <map>
 #include <plugins/g3d/model.hpp>
+#include <plugins/gc/Export/VertexWeld.hpp>
 #include <unordered_map>
 #include <vendor/stb_image.h>
 
@@ -69,7 +73,10 @@ void AssImporter::ProcessMeshTrianglesStatic(
   // We will do triangle-stripping in a post-process
   auto& tris = mp.mPrimitives.emplace_back();
   tris.mType = librii::gx::PrimitiveType::Triangles;
-  tris.mVertices = std::move(vertices);
+  tris.mVertices.setMask(poly_data.getVcd());
+  tris.mVertices.reserve(vertices.size());
+  for (const auto& vtx : vertices)
+    tris.mVertices.push_back(vtx);
 
   const int boneId = get_bone_id(singleInfluence);
   assert(boneId >= 0);
@@ -81,102 +88,37 @@ void AssImporter::ProcessMeshTrianglesStatic(
 void AssImporter::ProcessMeshTrianglesWeighted(
     libcube::IndexedPolygon& poly_data,
     std::vector<librii::gx::IndexedVertex>&& vertices) {
-
-  // At this point, the mtx index of vertices is global.
-  // We need to convert it to a local palette index.
-  // Tolerence should be implemented here, eventually.
-
-  std::vector<u16> matrix_indices;
-
-  for (auto& v : vertices) {
-    const auto mtx_idx = v[PNM];
-
-    // Hack: We will come across data as such (assume 3-wide sweep)
-    // (A B B) (C A D)
-    // To prevent this transforming into
-    // (A B C) (D)
-    // Where references to A in the second sweep will fail,
-    // we simply don't compress across sweeps:
-    // (A B B) (C A D)
-    // (A B C) (A D)
-    // It's far from optimal, but the current choice:
-    const std::size_t sweep_id = matrix_indices.size() / 10;
-    const std::size_t sweep_begin = sweep_id * 10;
-    const std::size_t sweep_end =
-        std::min(matrix_indices.size(), (sweep_id + 1) * 10);
-    const auto found = std::find(matrix_indices.begin() + sweep_begin,
-                                 matrix_indices.begin() + sweep_end, mtx_idx);
-
-    if (found == matrix_indices.end()) {
-      matrix_indices.push_back(mtx_idx);
-    }
-  }
-
-  auto vertex_sweep_index = [&](int v, int sweep) -> int {
-    const auto found = std::find(
-        matrix_indices.begin() + sweep * 10,
-        matrix_indices.begin() +
-            std::min(static_cast<int>(matrix_indices.size()), (sweep + 1) * 10),
-        vertices[v][PNM]);
-
-    if (found == matrix_indices.end())
-      return -1;
-    const auto idx = std::distance(matrix_indices.begin(), found);
-    // Old code not based on sweep-specific search
-    // if (idx >= sweep * 10 && idx < (sweep + 1) * 10) {
-    //   // We're inside the sweep;
-    //   return idx - sweep * 10;
-    // }
-    // We're outside the sweep:
-    // return -1;
-    return idx;
-  };
+  // At this point, the mtx index of vertices is global (draw matrix * 3).
+  // Pack triangles into as few 10-matrix palettes as possible, then convert
+  // each vertex to a slot of its palette.
   assert(vertices.size() % 3 == 0);
-  int sweep_wave = 0;
-  bool reversed = false;
-  int last_sweep_vtx = 0;
-  for (int f = 0; f < vertices.size() / 3; ++f) {
-    const int v0 = f * 3 + 0;
-    const int v1 = f * 3 + 1;
-    const int v2 = f * 3 + 2;
-
-    const int s0 = vertex_sweep_index(v0, sweep_wave);
-    const int s1 = vertex_sweep_index(v1, sweep_wave);
-    const int s2 = vertex_sweep_index(v2, sweep_wave);
-
-    if (s0 < 0 || s1 < 0 || s2 < 0) {
-      assert(s0 != -2 && s1 != -2 && s2 != -2 &&
-             "matrix_indices has not been properly filled");
-
-      // But submit what we have so far, first:
-      auto& mp = poly_data.getMeshData().mMatrixPrimitives.emplace_back();
-      auto& tris = mp.mPrimitives.emplace_back();
-      tris.mType = librii::gx::PrimitiveType::Triangles;
-      std::copy(vertices.begin() + last_sweep_vtx, vertices.begin() + v0,
-                std::back_inserter(tris.mVertices));
-      last_sweep_vtx = v0;
-      mp.mCurrentMatrix = -1;
-      const auto sweep_begin = sweep_wave * 10;
-      const auto sweep_end = std::min((sweep_wave + 1) * 10,
-                                      static_cast<int>(matrix_indices.size()));
-
-      std::copy(matrix_indices.begin() + sweep_begin,
-                matrix_indices.begin() + sweep_end,
-                std::back_inserter(mp.mDrawMatrixIndices));
-
-      // Reverse one step, but in the next wave:
-      assert(!reversed && "matrix_indices is unsorted");
-      --f;
-      ++sweep_wave;
-      reversed = true;
+  std::vector<std::array<u16, 3>> tri_matrices(vertices.size() / 3);
+  for (std::size_t f = 0; f < tri_matrices.size(); ++f) {
+    for (int i = 0; i < 3; ++i)
+      tri_matrices[f][i] = vertices[f * 3 + i][PNM] / 3;
+  }
 
-      continue;
+  const auto groups = librii::mesh::PartitionMatrixPalettes(tri_matrices);
+  for (const auto& group : groups) {
+    auto& mp = poly_data.getMeshData().mMatrixPrimitives.emplace_back();
+    mp.mCurrentMatrix = -1;
+    for (u16 mtx : group.matrices)
+      mp.mDrawMatrixIndices.push_back(static_cast<s16>(mtx));
+
+    auto& tris = mp.mPrimitives.emplace_back();
+    tris.mType = librii::gx::PrimitiveType::Triangles;
+    tris.mVertices.setMask(poly_data.getVcd());
+    tris.mVertices.reserve(group.triangles.size() * 3);
+    for (u32 f : group.triangles) {
+      for (int i = 0; i < 3; ++i) {
+        auto vtx = vertices[f * 3 + i];
+        const auto slot = std::find(group.matrices.begin(),
+                                    group.matrices.end(), vtx[PNM] / 3);
+        assert(slot != group.matrices.end());
+        vtx[PNM] = static_cast<u16>((slot - group.matrices.begin()) * 3);
+        tris.mVertices.push_back(vtx);
+      }
     }
-
-    reversed = false;
-    vertices[v0][PNM] = s0;
-    vertices[v0][PNM] = s1;
-    vertices[v0][PNM] = s2;
   }
 }
 
@@ -316,6 +258,7 @@ bool AssImporter::ImportMesh(const aiMesh* pMesh, const aiNode* pNode,
   }
 
   ProcessMeshTriangles(poly, pMesh, pNode, std::move(vertices));
+  librii::mesh::StripifyMesh(poly.getMeshData());
   return true;
 }
 
@@ -335,7 +278,11 @@ static bool importTexture(libcube::Texture& data, u8* image,
            (height >> (num_mip + 1)) >= min_dim)
       ++num_mip;
   }
-  data.setTextureFormat((int)librii::gx::TextureFormat::CMPR);
+  const auto selection =
+      librii::image::selectTextureFormat(image, width, height);
+  printf("Selected texture format %u (PSNR: %f dB)\n",
+         static_cast<unsigned>(selection.format), selection.psnr);
+  data.setTextureFormat(static_cast<int>(selection.format));
   data.setWidth(width);
   data.setHeight(height);
   data.setMipmapCount(num_mip);
@@ -773,7 +720,11 @@ void AssImporter::ImportAss(
     }
   }
 
-  ImportNode(root, tint);
+  {
+    // Vertex buffer dedupe is hashed for the whole node tree
+    libcube::VertexWeldSession weld;
+    ImportNode(root, tint);
+  }
 
   if (auto* gmdl = dynamic_cast<g3d::Model*>(out_model); gmdl != nullptr)
     gmdl->aabb = gmdl->getBones()[0].getAABB();
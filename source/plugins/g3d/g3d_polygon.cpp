@@ -1,5 +1,7 @@
 #include "model.hpp"
 #include "polygon.hpp"
+#include <plugins/gc/Export/VertexCache.hpp>
+#include <plugins/gc/Export/VertexWeld.hpp>
 
 namespace riistudio::g3d {
 
@@ -40,16 +42,11 @@ glm::vec3 Polygon::getNrm(const libcube::Model& mdl, u64 id) const {
 
 template <typename X, typename Y>
 auto add_to_buffer(const X& entry, Y& buf) -> u16 {
-  const auto found = std::find(buf.mEntries.begin(), buf.mEntries.end(), entry);
-  if (found != buf.mEntries.end()) {
-    return found - buf.mEntries.begin();
-  }
-
-  buf.mEntries.push_back(entry);
-  return buf.mEntries.size() - 1;
+  return libcube::AddBufferEntry(buf.mEntries, entry);
 };
 
 u64 Polygon::addPos(libcube::Model& mdl, const glm::vec3& v) {
+  invalidateMeshBounds();
   auto* buf =
       reinterpret_cast<Model&>(mdl).getBuf_Pos().findByName(mPositionBuffer);
   assert(buf);
@@ -81,6 +78,80 @@ u64 Polygon::addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) {
   return add_to_buffer(v, *buf);
 }
 
+// Calls `f` with the buffer `attr` indexes, if it exists
+template <typename M, typename F>
+static void forBuffer(M& mdl, const Polygon& poly,
+                      librii::gx::VertexAttribute attr, F&& f) {
+  using VA = librii::gx::VertexAttribute;
+  const auto call = [&](auto* buf) {
+    if (buf != nullptr)
+      f(*buf);
+  };
+  if (attr == VA::Position) {
+    call(mdl.getBuf_Pos().findByName(poly.mPositionBuffer));
+  } else if (attr == VA::Normal) {
+    call(mdl.getBuf_Nrm().findByName(poly.mNormalBuffer));
+  } else if (attr == VA::Color0 || attr == VA::Color1) {
+    const auto chan = static_cast<u32>(attr) - static_cast<u32>(VA::Color0);
+    call(mdl.getBuf_Clr().findByName(poly.mColorBuffer[chan]));
+  } else if (static_cast<u32>(attr) >= static_cast<u32>(VA::TexCoord0) &&
+             static_cast<u32>(attr) <= static_cast<u32>(VA::TexCoord7)) {
+    const auto chan = static_cast<u32>(attr) - static_cast<u32>(VA::TexCoord0);
+    call(mdl.getBuf_Uv().findByName(poly.mTexCoordBuffer[chan]));
+  }
+}
+
+libcube::IndexedPolygon::VertexBufferRef
+Polygon::getVertexBuffer(const libcube::Model& mdl,
+                         librii::gx::VertexAttribute attr) const {
+  VertexBufferRef ref;
+  forBuffer(reinterpret_cast<const Model&>(mdl), *this, attr,
+            [&](const auto& buf) {
+              ref.key = &buf;
+              ref.size = static_cast<u32>(buf.mEntries.size());
+              ref.format.comp = buf.mQuantize.mComp;
+              ref.format.type = buf.mQuantize.mType;
+              ref.format.divisor = buf.mQuantize.divisor;
+              ref.format.stride = buf.mQuantize.stride;
+            });
+  return ref;
+}
+u64 Polygon::hashVertexBuffer(const libcube::Model& mdl,
+                              librii::gx::VertexAttribute attr) const {
+  u64 hash = 0;
+  forBuffer(reinterpret_cast<const Model&>(mdl), *this, attr,
+            [&](const auto& buf) {
+              librii::gx::VQuantization format;
+              format.comp = buf.mQuantize.mComp;
+              format.type = buf.mQuantize.mType;
+              format.divisor = buf.mQuantize.divisor;
+              format.stride = buf.mQuantize.stride;
+              hash = libcube::HashBufferEntries(buf.mEntries, format);
+            });
+  return hash;
+}
+void Polygon::permuteVertexBuffer(libcube::Model& mdl,
+                                  librii::gx::VertexAttribute attr,
+                                  std::span<const u32> order) {
+  invalidateMeshBounds();
+  forBuffer(reinterpret_cast<Model&>(mdl), *this, attr, [&](auto& buf) {
+    libcube::PermuteBufferEntries(buf.mEntries, order);
+  });
+}
+std::span<const glm::vec3>
+Polygon::getPositions(const libcube::Model& mdl) const {
+  const auto* buf = reinterpret_cast<const Model&>(mdl).getBuf_Pos().findByName(
+      mPositionBuffer);
+  if (buf == nullptr)
+    return {};
+  return buf->mEntries;
+}
+void Polygon::storeMeshBounds(const libcube::Model& mdl) {
+  const auto& mesh = getMeshBounds(mdl).mesh;
+  if (!mesh.empty())
+    bounds = {mesh.min, mesh.max};
+}
+
 glm::mat4 computeMdlMtx(const lib3d::SRT3& srt) {
   glm::mat4 dst(1.0f);
 
@@ -133,6 +204,7 @@ std::vector<glm::mat4> Polygon::getPosMtx(const libcube::Model& mdl,
   const auto& mp = mMatrixPrimitives[mpid];
 
   const g3d::Model& mdl_ac = reinterpret_cast<const Model&>(mdl);
+  const auto& pose = libcube::GetSkeletonPose(mdl);
 
   const auto handle_drw = [&](const libcube::DrawMatrix& drw) {
     glm::mat4x4 curMtx(1.0f);
@@ -140,8 +212,7 @@ std::vector<glm::mat4> Polygon::getPosMtx(const libcube::Model& mdl,
     // Rigid -- bone space
     if (drw.mWeights.size() == 1) {
       u32 boneID = drw.mWeights[0].boneId;
-      curMtx = const_cast<Bone&>(mdl_ac.getBones()[boneID])
-                   .calcSrtMtx(mdl_ac.getBones());
+      curMtx = pose.getWorld(boneID);
     } else {
       // already world space
     }
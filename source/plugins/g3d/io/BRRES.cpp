@@ -5,9 +5,11 @@
 #include <oishii/writer/binary_writer.hxx>
 
 #include <plugins/g3d/collection.hpp>
+#include <plugins/gc/Export/ExportSettings.hpp>
 #include <plugins/g3d/util/Dictionary.hpp>
 #include <plugins/g3d/util/NameTable.hpp>
 
+#include <list>
 #include <set>
 #include <string>
 
@@ -108,6 +110,11 @@ public:
     assert(dynamic_cast<Collection*>(&node) != nullptr);
     Collection& collection = *dynamic_cast<Collection*>(&node);
 
+    // Undone when the file is written
+    std::list<libcube::ScopedExportSettings> exportPasses;
+    for (auto& mdl : collection.getModels())
+      exportPasses.emplace_back(mdl);
+
     RelocWriter linker(writer);
     NameTable names;
 
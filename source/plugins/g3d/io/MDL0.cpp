@@ -4,10 +4,12 @@
 
 #include "Common.hpp"
 #include <librii/gpu/DLBuilder.hpp>
+#include <librii/gpu/DLMesh.hpp>
 #include <librii/gpu/DLPixShader.hpp>
 #include <librii/gpu/GPUMaterial.hpp>
 #include <librii/gx.h>
 #include <plugins/g3d/util/Dictionary.hpp>
+#include <plugins/gc/Export/DirectVertex.hpp>
 
 namespace riistudio::g3d {
 
@@ -257,41 +259,10 @@ struct DlHandle {
   void setBufSize(std::size_t c) { buf_size = c; }
   void setBufAddr(s32 addr) { ofs_buf = addr - tag_start; }
 };
-void writeVertexDataDL(const libcube::IndexedPolygon& poly,
-                       const MatrixPrimitive& mp, oishii::Writer& writer) {
-  using VATAttrib = librii::gx::VertexAttribute;
-  using VATType = librii::gx::VertexAttributeType;
-
-  for (auto& prim : mp.mPrimitives) {
-    writer.write<u8>(librii::gx::EncodeDrawPrimitiveCommand(prim.mType));
-    writer.write<u16>(prim.mVertices.size());
-    for (const auto& v : prim.mVertices) {
-      for (int a = 0; a < (int)VATAttrib::Max; ++a) {
-        if (poly.getVcd()[(VATAttrib)a]) {
-          switch (poly.getVcd().mAttributes.at((VATAttrib)a)) {
-          case VATType::None:
-            break;
-          case VATType::Byte:
-            writer.write<u8>(v[(VATAttrib)a]);
-            break;
-          case VATType::Short:
-            writer.write<u16>(v[(VATAttrib)a]);
-            break;
-          case VATType::Direct:
-            if (((VATAttrib)a) != VATAttrib::PositionNormalMatrixIndex) {
-              assert(!"Direct vertex data is unsupported.");
-              abort();
-            }
-            writer.write<u8>(v[(VATAttrib)a]);
-            break;
-          default:
-            assert("!Unknown vertex attribute format.");
-            abort();
-          }
-        }
-      }
-    }
-  }
+void writeVertexDataDL(const librii::gpu::VertexLayout& layout,
+                       const MatrixPrimitive& mp, oishii::Writer& writer,
+                       const librii::gpu::IDirectVertexSource* direct) {
+  librii::gpu::EncodeMeshDisplayList(writer, layout, mp.mPrimitives, direct);
   // DL pad
   while (writer.tell() % 32)
     writer.write<u8>(0);
@@ -1092,8 +1063,18 @@ void writeModel(const Model& mdl, oishii::Writer& writer, RelocWriter& linker,
         data.setBufAddr(writer.tell());
         const auto data_start = writer.tell();
         {
+          // Direct data uses the format of the buffer the polygon references,
+          // as does the VAT above
+          const auto formats = libcube::GetVertexFormats(mesh, mdl);
+          auto layout =
+              librii::gpu::CompileVertexLayout(mesh.getVcd(), &formats);
+          if (!layout) {
+            assert(!"Unsupported vertex format.");
+            abort();
+          }
+          const libcube::DirectVertexSource direct(mesh, mdl);
           for (auto& mp : mesh.mMatrixPrimitives)
-            writeVertexDataDL(mesh, mp, writer);
+            writeVertexDataDL(*layout, mp, writer, &direct);
         }
         data.setCmdSize(writer.tell() - data_start);
         writer.alignTo(32);
@@ -1586,6 +1567,61 @@ void readModel(Model& mdl, oishii::BinaryReader& reader,
             att;
       }
     }
+    // Indexed attributes need a buffer. Direct ones often have none, in
+    // which case their values go to a new buffer of the format the setup
+    // display list gives them.
+    bool missingBuffer = false;
+    for (auto& [attr, type] : poly.mVertexDescriptor.mAttributes) {
+      if (!poly.mVertexDescriptor[attr] ||
+          attr < librii::gx::VertexAttribute::Position ||
+          poly.getVertexBuffer(mdl, attr).key != nullptr)
+        continue;
+      if (type != librii::gx::VertexAttributeType::Direct) {
+        missingBuffer = true;
+        continue;
+      }
+      const auto format =
+          librii::gpu::GetVertexFormat(vcdHandler.mGpuMesh, attr);
+      const auto addBuffer = [&](auto&& bufs, const char* prefix) {
+        const auto id = bufs.size();
+        auto name = prefix + std::to_string(id);
+        while (bufs.findByName(name) != nullptr)
+          name += "_";
+        auto& buf = bufs.add();
+        buf.mId = static_cast<u32>(id);
+        buf.mName = name;
+        buf.mQuantize.mComp = format.comp;
+        buf.mQuantize.mType = format.type;
+        buf.mQuantize.divisor = format.divisor;
+        buf.mQuantize.stride =
+            static_cast<u8>(librii::gpu::GetDirectValueSize(attr, format));
+        return buf.mName;
+      };
+      using VA = librii::gx::VertexAttribute;
+      const auto a = static_cast<u32>(attr);
+      if (attr == VA::Position) {
+        poly.mPositionBuffer = addBuffer(mdl.getBuf_Pos(), "Pos");
+      } else if (attr == VA::Normal) {
+        poly.mNormalBuffer = addBuffer(mdl.getBuf_Nrm(), "Nrm");
+      } else if (attr == VA::Color0 || attr == VA::Color1) {
+        poly.mColorBuffer[a - static_cast<u32>(VA::Color0)] =
+            addBuffer(mdl.getBuf_Clr(), "Clr");
+      } else if (a >= static_cast<u32>(VA::TexCoord0) &&
+                 a <= static_cast<u32>(VA::TexCoord7)) {
+        poly.mTexCoordBuffer[a - static_cast<u32>(VA::TexCoord0)] =
+            addBuffer(mdl.getBuf_Uv(), "Uv");
+      } else {
+        // Normal-binormal-tangent triplets
+        missingBuffer = true;
+      }
+    }
+    if (missingBuffer) {
+      transaction.callback(kpi::IOMessageClass::Warning, transaction_path,
+                           "Mesh references a vertex buffer that is missing.");
+      transaction.state = kpi::TransactionState::Failure;
+      return;
+    }
+
     struct QDisplayListMeshHandler final
         : public librii::gpu::QDisplayListHandler {
       void onCommandDraw(oishii::BinaryReader& reader,
@@ -1593,38 +1629,45 @@ void readModel(Model& mdl, oishii::BinaryReader& reader,
         if (mErr)
           return;
 
+        const u32 size = static_cast<u32>(nverts) * mLayout.stride;
+        if (reader.tell() + size > reader.endpos()) {
+          mErr = true;
+          return;
+        }
+
         if (mPoly.mMatrixPrimitives.empty())
           mPoly.mMatrixPrimitives.push_back(MatrixPrimitive{});
         auto& prim = mPoly.mMatrixPrimitives.back().mPrimitives.emplace_back(
             librii::gx::IndexedPrimitive{});
         prim.mType = type;
         prim.mVertices.resize(nverts);
-        for (auto& vert : prim.mVertices) {
-          for (u32 i = 0;
-               i < static_cast<u32>(librii::gx::VertexAttribute::Max); ++i) {
-            if (mPoly.mVertexDescriptor.mBitfield & (1 << i)) {
-              const auto attr = static_cast<librii::gx::VertexAttribute>(i);
-              switch (mPoly.mVertexDescriptor.mAttributes[attr]) {
-              case librii::gx::VertexAttributeType::Direct:
-                mErr = true;
-                return;
-              case librii::gx::VertexAttributeType::None:
-                break;
-              case librii::gx::VertexAttributeType::Byte:
-                vert[attr] = reader.readUnaligned<u8>();
-                break;
-              case librii::gx::VertexAttributeType::Short:
-                vert[attr] = reader.readUnaligned<u16>();
-                break;
-              }
-            }
-          }
+        const u8* data = reader.getStreamStart() + reader.tell();
+        librii::gpu::DecodeVertices(mLayout, data, prim.mVertices, mMaxima);
+        if (mLayout.directMask != 0)
+          librii::gpu::DecodeDirectVertices(mLayout, data, prim.mVertices,
+                                            mDirect, mMaxima);
+        reader.skip(size);
+      }
+      QDisplayListMeshHandler(Polygon& poly, Model& mdl)
+          : mPoly(poly), mDirect(poly, mdl) {
+        // Direct values are stored in the buffers the polygon references,
+        // which also give their format
+        const auto formats = libcube::GetVertexFormats(poly, mdl);
+        auto layout =
+            librii::gpu::CompileVertexLayout(poly.mVertexDescriptor, &formats);
+        if (!layout) {
+          llvm::consumeError(layout.takeError());
+          mErr = true;
+          return;
         }
+        mLayout = *layout;
       }
-      QDisplayListMeshHandler(Polygon& poly) : mPoly(poly) {}
       bool mErr = false;
       Polygon& mPoly;
-    } meshHandler(poly);
+      libcube::DirectVertexSink mDirect;
+      librii::gpu::VertexLayout mLayout;
+      std::array<u16, (u64)librii::gx::VertexAttribute::Max> mMaxima{};
+    } meshHandler(poly, mdl);
     primitiveData.seekTo(reader);
     librii::gpu::RunDisplayList(reader, meshHandler, primitiveData.buf_size);
     if (meshHandler.mErr) {
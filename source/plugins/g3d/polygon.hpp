@@ -50,6 +50,15 @@ struct Polygon : public PolygonData,
   u64 addNrm(libcube::Model& mdl, const glm::vec3& v) override;
   u64 addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) override;
   u64 addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) override;
+  VertexBufferRef getVertexBuffer(const libcube::Model& mdl,
+                                  librii::gx::VertexAttribute attr) const override;
+  u64 hashVertexBuffer(const libcube::Model& mdl,
+                       librii::gx::VertexAttribute attr) const override;
+  void permuteVertexBuffer(libcube::Model& mdl, librii::gx::VertexAttribute attr,
+                           std::span<const u32> order) override;
+  std::span<const glm::vec3>
+  getPositions(const libcube::Model& mdl) const override;
+  void storeMeshBounds(const libcube::Model& mdl) override;
 
   void init(bool skinned, riistudio::lib3d::AABB* boundingBox) override {
     // TODO: Handle skinning...
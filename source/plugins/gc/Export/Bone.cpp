@@ -0,0 +1,17 @@
+#include "Bone.hpp"
+#include "Scene.hpp"
+
+namespace libcube {
+
+void UpdateSkeletonPose(const Model& mdl) {
+  const auto& base = static_cast<const riistudio::lib3d::Model&>(mdl);
+  mdl.mPose.update(base.getBones());
+}
+
+const riistudio::lib3d::SkeletonPose& GetSkeletonPose(const Model& mdl) {
+  if (mdl.mPose.size() != mdl.getBones().size())
+    UpdateSkeletonPose(mdl);
+  return mdl.mPose;
+}
+
+} // namespace libcube
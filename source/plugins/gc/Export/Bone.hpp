@@ -1,5 +1,6 @@
 #pragma once
 
+#include <core/3d/SkeletonPose.hpp>
 #include <core/3d/i3dmodel.hpp>
 #include <core/common.h>
 
@@ -29,6 +30,8 @@ struct DrawMatrix {
 };
 struct ModelData {
   std::vector<DrawMatrix> mDrawMatrices;
+  //! World matrices of the bones. See GetSkeletonPose.
+  mutable riistudio::lib3d::SkeletonPose mPose;
 
   bool operator==(const ModelData& rhs) const {
     return mDrawMatrices == rhs.mDrawMatrices;
@@ -99,4 +102,17 @@ struct IBoneDelegate : public riistudio::lib3d::Bone {
   }
 };
 
+class Model;
+
+//! @brief Bring the cached world matrices of the bones of a model up to date.
+//!
+//! The renderer does this once per frame; only bones edited since are
+//! recomputed.
+//!
+void UpdateSkeletonPose(const Model& mdl);
+
+//! @brief The world matrices of the bones of a model, as of the last
+//! UpdateSkeletonPose. Updated first if the bones were added or removed since.
+const riistudio::lib3d::SkeletonPose& GetSkeletonPose(const Model& mdl);
+
 } // namespace libcube
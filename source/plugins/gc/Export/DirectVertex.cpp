@@ -0,0 +1,129 @@
+#include "DirectVertex.hpp"
+#include "Scene.hpp"
+
+#include <array>
+#include <unordered_set>
+
+namespace libcube {
+
+namespace gx = librii::gx;
+
+namespace {
+
+// Attributes that may be sent directly
+constexpr std::array<gx::VertexAttribute, 12> ValueAttributes{
+    gx::VertexAttribute::Position,  gx::VertexAttribute::Normal,
+    gx::VertexAttribute::Color0,    gx::VertexAttribute::Color1,
+    gx::VertexAttribute::TexCoord0, gx::VertexAttribute::TexCoord1,
+    gx::VertexAttribute::TexCoord2, gx::VertexAttribute::TexCoord3,
+    gx::VertexAttribute::TexCoord4, gx::VertexAttribute::TexCoord5,
+    gx::VertexAttribute::TexCoord6, gx::VertexAttribute::TexCoord7,
+};
+
+u64 GetChannel(gx::VertexAttribute attr, gx::VertexAttribute first) {
+  return static_cast<u64>(attr) - static_cast<u64>(first);
+}
+
+bool IsColor(gx::VertexAttribute attr) {
+  return attr == gx::VertexAttribute::Color0 ||
+         attr == gx::VertexAttribute::Color1;
+}
+
+} // namespace
+
+glm::vec4 DirectVertexSource::getDirect(gx::VertexAttribute attr,
+                                        u16 index) const {
+  if (attr == gx::VertexAttribute::Position)
+    return glm::vec4(mPoly.getPos(mMdl, index), 0.0f);
+  if (attr == gx::VertexAttribute::Normal)
+    return glm::vec4(mPoly.getNrm(mMdl, index), 0.0f);
+  if (IsColor(attr))
+    return mPoly.getClr(mMdl, GetChannel(attr, gx::VertexAttribute::Color0),
+                        index);
+  return glm::vec4(
+      mPoly.getUv(mMdl, GetChannel(attr, gx::VertexAttribute::TexCoord0),
+                  index),
+      0.0f, 0.0f);
+}
+
+u16 DirectVertexSink::addDirect(gx::VertexAttribute attr,
+                                const glm::vec4& value) {
+  if (attr == gx::VertexAttribute::Position)
+    return static_cast<u16>(mPoly.addPos(mMdl, glm::vec3(value)));
+  if (attr == gx::VertexAttribute::Normal)
+    return static_cast<u16>(mPoly.addNrm(mMdl, glm::vec3(value)));
+  if (IsColor(attr))
+    return static_cast<u16>(mPoly.addClr(
+        mMdl, GetChannel(attr, gx::VertexAttribute::Color0), value));
+  return static_cast<u16>(
+      mPoly.addUv(mMdl, GetChannel(attr, gx::VertexAttribute::TexCoord0),
+                  glm::vec2(value)));
+}
+
+librii::gpu::VertexFormats GetVertexFormats(const IndexedPolygon& poly,
+                                            const Model& mdl) {
+  librii::gpu::VertexFormats formats{};
+  for (const auto attr : ValueAttributes) {
+    const auto ref = poly.getVertexBuffer(mdl, attr);
+    if (ref.key != nullptr)
+      formats[static_cast<u64>(attr)] = ref.format;
+  }
+  return formats;
+}
+
+u32 ChooseDirectVertexData(Model& mdl, const DirectVertexSettings& settings) {
+  u32 numChanged = 0;
+
+  for (auto& poly : mdl.getMeshes()) {
+    const auto& mesh = poly.getMeshData();
+    u32 numVertices = 0;
+    for (const auto& mp : mesh.mMatrixPrimitives)
+      for (const auto& prim : mp.mPrimitives)
+        numVertices += static_cast<u32>(prim.mVertices.size());
+    if (numVertices == 0)
+      continue;
+
+    auto& vcd = poly.getVcd();
+    for (const auto attr : ValueAttributes) {
+      auto found = vcd.mAttributes.find(attr);
+      if (!vcd[attr] || found == vcd.mAttributes.end() ||
+          found->second == gx::VertexAttributeType::None)
+        continue;
+      const auto ref = poly.getVertexBuffer(mdl, attr);
+      if (ref.key == nullptr)
+        continue;
+
+      const auto current = found->second;
+      const auto indexType = current != gx::VertexAttributeType::Direct
+                                 ? current
+                             // All-ones is reserved for disabled vertices
+                             : ref.size < 0xff ? gx::VertexAttributeType::Byte
+                                               : gx::VertexAttributeType::Short;
+      const u32 indexWidth = indexType == gx::VertexAttributeType::Byte ? 1 : 2;
+      const u32 valueSize = librii::gpu::GetDirectValueSize(attr, ref.format);
+
+      bool direct = false;
+      if (valueSize != 0 && numVertices <= settings.maxVertices) {
+        std::unordered_set<u16> distinct;
+        for (const auto& mp : mesh.mMatrixPrimitives)
+          for (const auto& prim : mp.mPrimitives)
+            for (const u16 index : prim.mVertices.getAttribute(attr))
+              distinct.insert(index);
+        const f32 missRate = static_cast<f32>(distinct.size()) /
+                             static_cast<f32>(numVertices);
+        const f32 indexedCost = indexWidth + missRate * settings.fetchCost;
+        direct = static_cast<f32>(valueSize) < indexedCost;
+      }
+
+      const auto chosen = direct ? gx::VertexAttributeType::Direct : indexType;
+      if (chosen != current) {
+        found->second = chosen;
+        ++numChanged;
+      }
+    }
+  }
+
+  return numChanged;
+}
+
+} // namespace libcube
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "IndexedPolygon.hpp"
+#include <librii/gpu/DLMesh.hpp>
+
+namespace libcube {
+
+class Model;
+
+//! @brief Values of a polygon's direct attributes, read from the vertex
+//! buffers it indexes.
+class DirectVertexSource final : public librii::gpu::IDirectVertexSource {
+public:
+  DirectVertexSource(const IndexedPolygon& poly, const Model& mdl)
+      : mPoly(poly), mMdl(mdl) {}
+
+  glm::vec4 getDirect(librii::gx::VertexAttribute attr,
+                      u16 index) const override;
+
+private:
+  const IndexedPolygon& mPoly;
+  const Model& mMdl;
+};
+
+//! @brief Stores decoded direct values in the vertex buffers a polygon
+//! indexes, reusing matching entries.
+class DirectVertexSink final : public librii::gpu::IDirectVertexSink {
+public:
+  DirectVertexSink(IndexedPolygon& poly, Model& mdl)
+      : mPoly(poly), mMdl(mdl) {}
+
+  u16 addDirect(librii::gx::VertexAttribute attr,
+                const glm::vec4& value) override;
+
+private:
+  IndexedPolygon& mPoly;
+  Model& mMdl;
+};
+
+//! @brief Format of each attribute, taken from the vertex buffers a polygon
+//! indexes.
+librii::gpu::VertexFormats GetVertexFormats(const IndexedPolygon& poly,
+                                            const Model& mdl);
+
+struct DirectVertexSettings {
+  //! Larger meshes stay indexed: direct data grows the display list, which is
+  //! read again on every draw.
+  u32 maxVertices = 256;
+  //! Cost of fetching a buffer entry that is not in the vertex cache, in
+  //! display list bytes (roughly one 32-byte line).
+  f32 fetchCost = 32.0f;
+};
+
+//! @brief Choose, for each mesh and attribute, whether vertex data is sent
+//! directly or as indices.
+//!
+//! Per vertex, an index costs its width plus a buffer fetch for each distinct
+//! entry (the fetch is amortized over the vertices sharing it); a direct value
+//! costs its size. The cheaper is kept. Values stay in the vertex buffers
+//! either way, so this only changes how the display lists are encoded.
+//!
+//! @return The number of attributes changed.
+//!
+u32 ChooseDirectVertexData(Model& mdl, const DirectVertexSettings& settings = {});
+
+} // namespace libcube
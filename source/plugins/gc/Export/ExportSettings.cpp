@@ -0,0 +1,55 @@
+#include "ExportSettings.hpp"
+#include "Scene.hpp"
+
+#include <cstdio>
+
+namespace libcube {
+
+ExportSettings& GetExportSettings() {
+  static ExportSettings sSettings;
+  return sSettings;
+}
+
+ScopedExportSettings::ScopedExportSettings(Model& mdl) : mMdl(mdl) {
+  const auto& settings = GetExportSettings();
+  if (!settings.optimizeVertexCache && !settings.chooseDirectVertexData)
+    return;
+
+  for (auto& poly : mdl.getMeshes())
+    mMeshes.push_back(poly.getMeshData());
+
+  if (settings.optimizeVertexCache) {
+    auto result = OptimizeVertexCache(mdl, settings.vertexCache);
+    printf("Vertex cache: %u triangles, ACMR %.3f -> %.3f, %u buffers "
+           "reordered\n",
+           result.stats.numTriangles, result.stats.getACMRBefore(),
+           result.stats.getACMRAfter(),
+           static_cast<u32>(result.reorders.size()));
+    mReorders = std::move(result.reorders);
+  }
+
+  // After any pass that reorders buffers, as this counts distinct entries
+  if (settings.chooseDirectVertexData) {
+    const u32 numChanged = ChooseDirectVertexData(mdl, settings.directVertex);
+    printf("Direct vertex data: %u attributes changed\n", numChanged);
+  }
+}
+
+ScopedExportSettings::~ScopedExportSettings() {
+  for (auto it = mReorders.rbegin(); it != mReorders.rend(); ++it) {
+    std::vector<u32> inverse(it->order.size());
+    for (u32 i = 0; i < it->order.size(); ++i)
+      inverse[it->order[i]] = i;
+    it->owner->permuteVertexBuffer(mMdl, it->attr, inverse);
+  }
+
+  std::size_t i = 0;
+  for (auto& poly : mMdl.getMeshes()) {
+    if (i == mMeshes.size())
+      break;
+    poly.getMeshData() = std::move(mMeshes[i++]);
+    poly.invalidateMeshBounds();
+  }
+}
+
+} // namespace libcube
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "DirectVertex.hpp"
+#include "VertexCache.hpp"
+#include <librii/gx.h>
+#include <librii/mesh/VertexCacheOptimizer.hpp>
+#include <vector>
+
+namespace libcube {
+
+class Model;
+
+//! @brief Save-time options shared by the MDL0 and BMD writers.
+struct ExportSettings {
+  //! Reorder triangles and vertex buffers of each model (OptimizeVertexCache)
+  //! before writing it.
+  bool optimizeVertexCache = false;
+  librii::mesh::VertexCacheSettings vertexCache;
+  //! Send vertex data of small meshes directly where that is cheaper than
+  //! indexing it (ChooseDirectVertexData).
+  bool chooseDirectVertexData = false;
+  DirectVertexSettings directVertex;
+};
+
+//! The options used by every writer; edited from the frontend's settings.
+ExportSettings& GetExportSettings();
+
+//! @brief Run the passes enabled in GetExportSettings() on a model about to be
+//! written, for as long as the writer needs them.
+//!
+//! Saving must not edit the document: the passes are not in its history, so
+//! undo would no longer restore what the editor shows. On destruction the
+//! meshes, vertex descriptors and vertex buffers of the model are restored as
+//! they were.
+//!
+class ScopedExportSettings {
+public:
+  explicit ScopedExportSettings(Model& mdl);
+  ~ScopedExportSettings();
+
+  ScopedExportSettings(const ScopedExportSettings&) = delete;
+  ScopedExportSettings& operator=(const ScopedExportSettings&) = delete;
+
+private:
+  Model& mMdl;
+  //! Primitives and vertex descriptor of each mesh, before the passes
+  std::vector<librii::gx::MeshData> mMeshes;
+  //! Vertex buffers the passes reordered, in order
+  std::vector<VertexBufferReorder> mReorders;
+};
+
+} // namespace libcube
@@ -1,5 +1,7 @@
 #include "IndexedPolygon.hpp"
+#include "Scene.hpp"
 #include <librii/gl/Compiler.hpp>
+#include <llvm/Support/xxhash.h>
 
 namespace libcube {
 
@@ -75,36 +77,128 @@ void IndexedPolygon::setAttrib(SimpleAttrib attrib, bool v) {
     break;
   }
 }
+// Vertices a primitive expands to as a triangle list
+static u32 GetNumTriangleVertices(const gx::IndexedPrimitive& prim) {
+  const u32 n = static_cast<u32>(prim.mVertices.size());
+  switch (prim.mType) {
+  case gx::PrimitiveType::Triangles:
+    return n;
+  case gx::PrimitiveType::TriangleStrip:
+  case gx::PrimitiveType::TriangleFan:
+    return n < 3 ? 0 : (n - 2) * 3;
+  default:
+    return 0;
+  }
+}
+
+void IndexedPolygon::declare(const riistudio::lib3d::Model& mdl, u32 mp_id,
+                             librii::glhelper::VBOBuilder& out) const {
+  using librii::glhelper::VertexFormat;
+  const libcube::Model& gmdl = reinterpret_cast<const libcube::Model&>(mdl);
+  const auto& vcd = getVcd();
+  const auto& mp = getMeshData().mMatrixPrimitives[mp_id];
+
+  u32 num_vertices = 0;
+  for (const auto& prim : mp.mPrimitives)
+    num_vertices += GetNumTriangleVertices(prim);
+  // Deduplication only shrinks the vertex count
+  out.reserve(num_vertices, num_vertices);
+
+  const auto declare = [&](gx::VertexAttribute attr, VertexFormat format) {
+    const auto def = librii::gl::getVertexAttribGenDef(attr);
+    out.declareAttribute(static_cast<u32>(def.second), def.first.name,
+                         def.first.size, format);
+  };
+  const auto is_integer = [&](gx::VertexAttribute attr) {
+    const auto buf = getVertexBuffer(gmdl, attr);
+    return buf.key != nullptr &&
+           buf.format.type.generic != gx::VertexBufferType::Generic::f32;
+  };
+
+  // propagate always writes these; a default if absent
+  declare(gx::VertexAttribute::PositionNormalMatrixIndex, VertexFormat::U8);
+  declare(gx::VertexAttribute::Color0, VertexFormat::UNorm8);
+  for (int chan = 0; chan < 2; ++chan) {
+    const auto attr = gx::VertexAttribute::TexCoord0 + chan;
+    if (!vcd[attr])
+      declare(attr, VertexFormat::F16);
+  }
+  if (!vcd[gx::VertexAttribute::Normal])
+    declare(gx::VertexAttribute::Normal, VertexFormat::SNorm16);
+
+  for (u32 i = 0; i < (u32)gx::VertexAttribute::Max; ++i) {
+    const auto attr = static_cast<gx::VertexAttribute>(i);
+    if (!vcd[attr])
+      continue;
+
+    switch (attr) {
+    case gx::VertexAttribute::Position:
+      declare(attr, VertexFormat::F32);
+      break;
+    case gx::VertexAttribute::Color1:
+      // Colors are at most eight bits a channel
+      declare(attr, VertexFormat::UNorm8);
+      break;
+    case gx::VertexAttribute::TexCoord0:
+    case gx::VertexAttribute::TexCoord1:
+    case gx::VertexAttribute::TexCoord2:
+    case gx::VertexAttribute::TexCoord3:
+    case gx::VertexAttribute::TexCoord4:
+    case gx::VertexAttribute::TexCoord5:
+    case gx::VertexAttribute::TexCoord6:
+    case gx::VertexAttribute::TexCoord7: {
+      // Eight bits scaled by a power of two are exact as halves
+      const auto type = getVertexBuffer(gmdl, attr).format.type.generic;
+      const bool byte = is_integer(attr) &&
+                        (type == gx::VertexBufferType::Generic::u8 ||
+                         type == gx::VertexBufferType::Generic::s8);
+      declare(attr, byte ? VertexFormat::F16 : VertexFormat::F32);
+      break;
+    }
+    case gx::VertexAttribute::Normal: {
+      // Quantized normals fit sixteen bits, if they are in range
+      bool snorm = is_integer(attr);
+      for (const auto& prim : mp.mPrimitives) {
+        for (const u16 index :
+             prim.mVertices.getAttribute(gx::VertexAttribute::Normal)) {
+          if (!snorm)
+            break;
+          const glm::vec3 nrm = getNrm(gmdl, index);
+          snorm = std::abs(nrm.x) <= 1.0f && std::abs(nrm.y) <= 1.0f &&
+                  std::abs(nrm.z) <= 1.0f;
+        }
+      }
+      declare(attr, snorm ? VertexFormat::SNorm16 : VertexFormat::F32);
+      break;
+    }
+    // Texture matrix indices are not sent
+    default:
+      break;
+    }
+  }
+}
+
 void IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
                                librii::glhelper::VBOBuilder& out) const {
   const libcube::Model& gmdl = reinterpret_cast<const libcube::Model&>(mdl);
-  u32 final_bitfield = 0;
 
-  auto propVtx = [&](const librii::gx::IndexedVertex& vtx) {
+  out.beginRange();
+
+  auto propVtx = [&](librii::gx::IndexedVertexList::ConstRef vtx) {
     const auto& vcd = getVcd();
-    out.mIndices.push_back(static_cast<u32>(out.mIndices.size()));
-    assert(final_bitfield == 0 || final_bitfield == vcd.mBitfield);
-    final_bitfield |= vcd.mBitfield;
     // HACK:
-    if (!(vcd.mBitfield &
-          (1 << (u32)gx::VertexAttribute::PositionNormalMatrixIndex)))
-      out.pushData(1, (float)0);
-    if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::TexCoord0)))
-      out.pushData(7, glm::vec2{});
-    if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::TexCoord1)))
-      out.pushData(8, glm::vec2{});
-    if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::Normal)))
-      out.pushData(4, glm::vec3{});
     if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::Color0)))
-      out.pushData(5, glm::vec4{1.0f, 1.0f, 1.0f, 1.0f});
+      out.setAttribute(5, glm::vec4{1.0f, 1.0f, 1.0f, 1.0f});
     for (u32 i = 0; i < (u32)gx::VertexAttribute::Max; ++i) {
       if (!(vcd.mBitfield & (1 << i)))
         continue;
 
       switch (static_cast<gx::VertexAttribute>(i)) {
       case gx::VertexAttribute::PositionNormalMatrixIndex:
-        out.pushData(
-            1, (float)vtx[gx::VertexAttribute::PositionNormalMatrixIndex]);
+        out.setAttribute(
+            1, glm::vec4{
+                   (float)vtx[gx::VertexAttribute::PositionNormalMatrixIndex],
+                   0.0f, 0.0f, 0.0f});
         break;
       case gx::VertexAttribute::Texture0MatrixIndex:
       case gx::VertexAttribute::Texture1MatrixIndex:
@@ -116,13 +210,17 @@ void IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
       case gx::VertexAttribute::Texture7MatrixIndex:
         break;
       case gx::VertexAttribute::Position:
-        out.pushData(0, getPos(gmdl, vtx[gx::VertexAttribute::Position]));
+        out.setAttribute(
+            0, glm::vec4{getPos(gmdl, vtx[gx::VertexAttribute::Position]),
+                         1.0f});
         break;
       case gx::VertexAttribute::Color0:
-        out.pushData(5, getClr(gmdl, 0, vtx[gx::VertexAttribute::Color0]));
+        out.setAttribute(5,
+                         getClr(gmdl, 0, vtx[gx::VertexAttribute::Color0]));
         break;
       case gx::VertexAttribute::Color1:
-        out.pushData(6, getClr(gmdl, 1, vtx[gx::VertexAttribute::Color1]));
+        out.setAttribute(6,
+                         getClr(gmdl, 1, vtx[gx::VertexAttribute::Color1]));
         break;
       case gx::VertexAttribute::TexCoord0:
       case gx::VertexAttribute::TexCoord1:
@@ -135,11 +233,12 @@ void IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
         const auto chan = i - static_cast<int>(gx::VertexAttribute::TexCoord0);
         const auto attr = static_cast<gx::VertexAttribute>(i);
         const auto data = getUv(gmdl, chan, vtx[attr]);
-        out.pushData(7 + chan, data);
+        out.setAttribute(7 + chan, glm::vec4{data, 0.0f, 0.0f});
         break;
       }
       case gx::VertexAttribute::Normal:
-        out.pushData(4, getNrm(gmdl, vtx[gx::VertexAttribute::Normal]));
+        out.setAttribute(
+            4, glm::vec4{getNrm(gmdl, vtx[gx::VertexAttribute::Normal]), 0.0f});
         break;
       case gx::VertexAttribute::NormalBinormalTangent:
         break;
@@ -148,6 +247,7 @@ void IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
         break;
       }
     }
+    out.pushVertex();
   };
 
   auto propPrim = [&](const librii::gx::IndexedPrimitive& idx) {
@@ -191,22 +291,43 @@ void IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
   auto& mprims = getMeshData().mMatrixPrimitives;
   for (auto& idx : mprims[mp_id].mPrimitives)
     propPrim(idx);
+}
 
-  for (int i = 0; i < (int)gx::VertexAttribute::Max; ++i) {
-    if (!(final_bitfield & (1 << i)) &&
-        i != (int)gx::VertexAttribute::PositionNormalMatrixIndex)
-      continue;
-    // For now, we just skip it
-    if (i == (int)gx::VertexAttribute::NormalBinormalTangent)
-      continue;
+u64 HashBufferBytes(std::span<const u8> bytes,
+                    const librii::gx::VQuantization& format) {
+  u64 hash = llvm::xxHash64(llvm::ArrayRef<uint8_t>(bytes.data(), bytes.size()));
+  const u64 packed = static_cast<u64>(format.comp.position) |
+                     (static_cast<u64>(format.type.generic) << 8) |
+                     (static_cast<u64>(format.divisor) << 16) |
+                     (static_cast<u64>(format.stride) << 24);
+  return hash ^ (packed + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+}
+
+const librii::mesh::MeshBounds&
+IndexedPolygon::getMeshBounds(const Model& mdl) const {
+  if (!mBoundsCache.dirty)
+    return mBoundsCache.bounds;
 
-    const auto def = librii::gl::getVertexAttribGenDef((gx::VertexAttribute)i);
-    assert(def.first.name != nullptr);
-    out.mPropogating[def.second].descriptor =
-        librii::glhelper::VAOEntry{.binding_point = (u32)def.second,
-                                   .name = def.first.name,
-                                   .format = def.first.format,
-                                   .size = def.first.size * 4};
+  std::span<const glm::vec3> positions = getPositions(mdl);
+  std::vector<glm::vec3> read;
+  if (positions.empty() && getVcd()[gx::VertexAttribute::Position]) {
+    // Not exposed by the format: read every index in use
+    u32 numPositions = 0;
+    for (const auto& mp : getMeshData().mMatrixPrimitives)
+      for (const auto& prim : mp.mPrimitives)
+        for (const u16 pos :
+             prim.mVertices.getAttribute(gx::VertexAttribute::Position))
+          numPositions = std::max<u32>(numPositions, pos + 1);
+    read.resize(numPositions);
+    for (u32 i = 0; i < numPositions; ++i)
+      read[i] = getPos(mdl, i);
+    positions = read;
   }
+
+  mBoundsCache.bounds =
+      librii::mesh::ComputeMeshBounds(getMeshData(), positions);
+  mBoundsCache.dirty = false;
+  return mBoundsCache.bounds;
 }
+
 } // namespace libcube
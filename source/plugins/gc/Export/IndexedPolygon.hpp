@@ -3,6 +3,10 @@
 #include <core/3d/i3dmodel.hpp>
 #include <core/common.h>
 #include <librii/gx.h>
+#include <librii/mesh/Bounds.hpp>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 namespace libcube {
 
@@ -16,6 +20,8 @@ struct IndexedPolygon : public riistudio::lib3d::Polygon {
 
   bool hasAttrib(SimpleAttrib attrib) const override;
   void setAttrib(SimpleAttrib attrib, bool v) override;
+  void declare(const riistudio::lib3d::Model& mdl, u32 mp_id,
+               librii::glhelper::VBOBuilder& out) const override;
   void propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
                  librii::glhelper::VBOBuilder& out) const override;
   virtual glm::vec3 getPos(const Model& mdl, u64 id) const = 0;
@@ -28,8 +34,55 @@ struct IndexedPolygon : public riistudio::lib3d::Polygon {
   virtual u64 addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) = 0;
   virtual u64 addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) = 0;
 
+  //! A vertex buffer as seen by a polygon.
+  struct VertexBufferRef {
+    //! Identifies the buffer: polygons sharing it return the same key. Null
+    //! if the attribute does not index a buffer.
+    const void* key = nullptr;
+    u32 size = 0;
+    //! How entries are stored; also the format of the attribute when sent
+    //! directly.
+    librii::gx::VQuantization format;
+  };
+  virtual VertexBufferRef getVertexBuffer(const Model& mdl,
+                                          librii::gx::VertexAttribute attr) const {
+    return {};
+  }
+  //! @brief Hash of the entries and format of the buffer `attr` indexes, to
+  //! tell when vertex data built from them is stale. Zero if unknown.
+  virtual u64 hashVertexBuffer(const Model& mdl,
+                               librii::gx::VertexAttribute attr) const {
+    return 0;
+  }
+  //! @brief Reorder the buffer `attr` indexes: entry i becomes the previous
+  //! entry `order[i]`. `order` is a permutation of the whole buffer.
+  //!
+  //! Other polygons referencing the buffer must be remapped by the caller.
+  virtual void permuteVertexBuffer(Model& mdl, librii::gx::VertexAttribute attr,
+                                   std::span<const u32> order) {}
+
+  //! @brief The position buffer the mesh indexes, if the format holds it as
+  //! glm::vec3s. Otherwise empty, and positions are read with getPos.
+  virtual std::span<const glm::vec3> getPositions(const Model& mdl) const {
+    return {};
+  }
+
+  //! @brief Bounds of the mesh and of each matrix primitive, computed from the
+  //! positions they reference.
+  //!
+  //! Cached until invalidateMeshBounds(), which every edit of the positions or
+  //! indices of the mesh calls. Copies recompute them, so a polygon restored
+  //! from history never keeps the bounds of its later state.
+  const librii::mesh::MeshBounds& getMeshBounds(const Model& mdl) const;
+  void invalidateMeshBounds() { mBoundsCache.dirty = true; }
+
+  //! @brief Store the computed bounds in the fields the format writes. Called
+  //! after edits that move vertices; otherwise the values read are kept.
+  virtual void storeMeshBounds(const Model& mdl) {}
+
   void update() override {
     // Split up added primitives if necessary
+    invalidateMeshBounds();
   }
 
   virtual librii::gx::VertexDescriptor& getVcd() {
@@ -46,6 +99,33 @@ struct IndexedPolygon : public riistudio::lib3d::Polygon {
 
   virtual void init(bool skinned, riistudio::lib3d::AABB* boundingBox) = 0;
   virtual void initBufsFromVcd(riistudio::lib3d::Model&) {}
+
+private:
+  struct BoundsCache {
+    BoundsCache() = default;
+    BoundsCache(const BoundsCache&) {}
+    BoundsCache& operator=(const BoundsCache&) {
+      dirty = true;
+      return *this;
+    }
+
+    bool dirty = true;
+    librii::mesh::MeshBounds bounds;
+  };
+  mutable BoundsCache mBoundsCache;
 };
 
+u64 HashBufferBytes(std::span<const u8> bytes,
+                    const librii::gx::VQuantization& format);
+
+//! @brief Hash of buffer entries and the format they are stored in.
+template <typename T>
+u64 HashBufferEntries(const std::vector<T>& entries,
+                      const librii::gx::VQuantization& format) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  return HashBufferBytes({reinterpret_cast<const u8*>(entries.data()),
+                          entries.size() * sizeof(T)},
+                         format);
+}
+
 } // namespace libcube
@@ -111,7 +111,7 @@ struct IGCMaterial : public riistudio::lib3d::Material {
   virtual const Texture* getTexture(const libcube::Scene& scn,
                                     const std::string& id) const = 0;
   void
-  genSamplUniforms(u32 shaderId,
+  genSamplUniforms(librii::gfx::CommandList& commands,
                    const std::map<std::string, u32>& texIdMap) const override;
   void onSplice(librii::glhelper::DelegatedUBOBuilder& builder,
                 const riistudio::lib3d::Model& model,
@@ -0,0 +1,63 @@
+#include "Simplify.hpp"
+#include "Scene.hpp"
+
+#include <librii/mesh/TriangleStripper.hpp>
+
+namespace libcube {
+
+namespace gx = librii::gx;
+
+librii::mesh::SimplifyStats
+SimplifyPolygon(const IndexedPolygon& poly, const Model& mdl,
+                gx::MeshData& mesh,
+                const librii::mesh::SimplifySettings& settings) {
+  const auto buffer = poly.getVertexBuffer(mdl, gx::VertexAttribute::Position);
+
+  u32 numPositions = buffer.size;
+  if (buffer.key == nullptr) {
+    // Not exposed by the format: cover every index in use
+    for (const auto& mp : mesh.mMatrixPrimitives)
+      for (const auto& prim : mp.mPrimitives)
+        for (const u16 pos :
+             prim.mVertices.getAttribute(gx::VertexAttribute::Position))
+          numPositions = std::max<u32>(numPositions, pos + 1);
+  }
+  std::vector<glm::vec3> positions(numPositions);
+  for (u32 i = 0; i < numPositions; ++i)
+    positions[i] = poly.getPos(mdl, i);
+
+  std::vector<bool> locked(numPositions, false);
+  if (buffer.key != nullptr) {
+    for (const auto& other : mdl.getMeshes()) {
+      if (&other == &poly ||
+          other.getVertexBuffer(mdl, gx::VertexAttribute::Position).key !=
+              buffer.key)
+        continue;
+      for (const auto& mp : other.getMeshData().mMatrixPrimitives) {
+        for (const auto& prim : mp.mPrimitives) {
+          for (const u16 pos :
+               prim.mVertices.getAttribute(gx::VertexAttribute::Position)) {
+            if (pos < numPositions)
+              locked[pos] = true;
+          }
+        }
+      }
+    }
+  }
+
+  const auto stats =
+      librii::mesh::SimplifyMesh(mesh, positions, settings, &locked);
+  librii::mesh::StripifyMesh(mesh);
+  return stats;
+}
+
+librii::mesh::SimplifyStats
+SimplifyPolygon(IndexedPolygon& poly, const Model& mdl,
+                const librii::mesh::SimplifySettings& settings) {
+  const auto stats = SimplifyPolygon(poly, mdl, poly.getMeshData(), settings);
+  poly.invalidateMeshBounds();
+  poly.storeMeshBounds(mdl);
+  return stats;
+}
+
+} // namespace libcube
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gx.h>
+#include <librii/mesh/Simplify.hpp>
+
+namespace libcube {
+
+class Model;
+struct IndexedPolygon;
+
+//! @brief Reduce the triangle count of a polygon for a level of detail.
+//!
+//! Runs librii::mesh::SimplifyMesh over the positions of the model's buffer.
+//! Positions that other polygons also use are locked, so no cracks open
+//! between meshes. The result is stripped again.
+//!
+//! @param[in] poly     Polygon the mesh data belongs to.
+//! @param[in,out] mesh `poly`'s own mesh data, or a copy of it to make a
+//!                     reduced copy while leaving `poly` untouched.
+//!
+librii::mesh::SimplifyStats
+SimplifyPolygon(const IndexedPolygon& poly, const Model& mdl,
+                librii::gx::MeshData& mesh,
+                const librii::mesh::SimplifySettings& settings = {});
+
+//! @brief Simplify a polygon in place, and store its new bounds.
+librii::mesh::SimplifyStats
+SimplifyPolygon(IndexedPolygon& poly, const Model& mdl,
+                const librii::mesh::SimplifySettings& settings = {});
+
+} // namespace libcube
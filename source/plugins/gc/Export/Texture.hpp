@@ -4,6 +4,7 @@
 #include <core/3d/i3dmodel.hpp>
 #include <librii/gx/Texture.hpp>
 #include <librii/image/ImagePlatform.hpp>
+#include <librii/image/TextureCache.hpp>
 #include <vendor/dolemu/TextureDecoder/TextureDecoder.h>
 
 namespace libcube {
@@ -26,11 +27,12 @@ struct Texture : public riistudio::lib3d::Texture {
     if (out.size() < size) {
       out.resize(size);
     }
-    librii::image::transform(
-        out.data(), getWidth(), getHeight(),
+    const auto decoded = librii::image::TextureCache::get().decode(
+        getData(), getWidth(), getHeight(),
         static_cast<librii::gx::TextureFormat>(getTextureFormat()),
-        librii::gx::TextureFormat::Extension_RawRGBA32, getData(), getWidth(),
-        getHeight(), mip ? getMipmapCount() : 0);
+        mip ? getMipmapCount() : 0);
+    assert(decoded->size() <= out.size());
+    std::copy(decoded->begin(), decoded->end(), out.begin());
   }
 
   virtual u32 getTextureFormat() const = 0;
@@ -41,6 +43,11 @@ struct Texture : public riistudio::lib3d::Texture {
   virtual const u8* getPaletteData() const = 0;
   virtual u32 getPaletteFormat() const = 0;
 
+  //! @brief Whether the fields a format stores with the image, beyond its
+  //! format, dimensions and mipmap count, match those of `other`: if not, one
+  //! cannot stand in for the other.
+  virtual bool sameMetadata(const Texture& other) const { return true; }
+
   //! @brief Set the image encoder based on the expression profile. Pixels are
   //! not recomputed immediately.
   //!
@@ -67,11 +74,10 @@ struct Texture : public riistudio::lib3d::Texture {
   void encode(const u8* rawRGBA) override {
     resizeData();
 
-    librii::image::transform(getData(), getWidth(), getHeight(),
-                             gx::TextureFormat::Extension_RawRGBA32,
-                             static_cast<gx::TextureFormat>(getTextureFormat()),
-                             rawRGBA, getWidth(), getHeight(),
-                             getMipmapCount());
+    const auto encoded = librii::image::TextureCache::get().encode(
+        rawRGBA, getWidth(), getHeight(),
+        static_cast<gx::TextureFormat>(getTextureFormat()), getMipmapCount());
+    std::copy(encoded->begin(), encoded->end(), getData());
   }
 };
 
@@ -0,0 +1,74 @@
+#include "TextureDedup.hpp"
+
+#include "Scene.hpp"
+#include <algorithm>
+#include <cstring>
+#include <librii/image/TextureCache.hpp>
+#include <unordered_map>
+
+namespace libcube {
+
+static bool sameContent(const Texture& a, const Texture& b) {
+  const u32 size = a.getEncodedSize(true);
+  return size == b.getEncodedSize(true) && a.sameMetadata(b) &&
+         memcmp(a.getData(), b.getData(), size) == 0;
+}
+
+TextureDedupResult DeduplicateTextures(Scene& scene) {
+  TextureDedupResult result;
+  auto textures = scene.getTextures();
+
+  // Key -> indices of the canonical textures sharing it (more than one only on
+  // a hash collision)
+  std::unordered_map<librii::image::ImageKey, std::vector<std::size_t>,
+                     librii::image::ImageKeyHash>
+      canonical;
+  std::unordered_map<std::string, std::string> renames;
+  std::vector<std::size_t> removed;
+
+  for (std::size_t i = 0; i < textures.size(); ++i) {
+    const Texture& tex = textures[i];
+    const auto key = librii::image::computeImageKey(
+        {tex.getData(), tex.getEncodedSize(true)},
+        static_cast<librii::gx::TextureFormat>(tex.getTextureFormat()),
+        tex.getWidth(), tex.getHeight(), tex.getMipmapCount());
+
+    auto& bucket = canonical[key];
+    auto match = std::find_if(bucket.begin(), bucket.end(), [&](auto j) {
+      return sameContent(textures[j], tex);
+    });
+    if (match == bucket.end()) {
+      bucket.push_back(i);
+      continue;
+    }
+
+    renames.emplace(tex.getName(), textures[*match].getName());
+    removed.push_back(i);
+    result.bytesSaved += tex.getEncodedSize(true);
+  }
+
+  if (removed.empty())
+    return result;
+
+  for (auto& model : scene.getModels()) {
+    for (auto& mat : model.getMaterials()) {
+      auto& data = mat.getMaterialData();
+      for (int i = 0; i < data.samplers.size(); ++i) {
+        auto& sampler = data.samplers[i];
+        if (sampler == nullptr)
+          continue;
+        auto it = renames.find(sampler->mTexture);
+        if (it == renames.end())
+          continue;
+        sampler->mTexture = it->second;
+        ++result.numRemapped;
+      }
+    }
+  }
+
+  textures.erase(removed);
+  result.numRemoved = removed.size();
+  return result;
+}
+
+} // namespace libcube
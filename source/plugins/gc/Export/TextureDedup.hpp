@@ -0,0 +1,31 @@
+#pragma once
+
+#include <core/common.h>
+
+namespace libcube {
+
+class Scene;
+
+struct TextureDedupResult {
+  //! Number of textures merged into another texture.
+  u32 numRemoved = 0;
+  //! Number of sampler references rewritten.
+  u32 numRemapped = 0;
+  //! Encoded bytes no longer stored.
+  u64 bytesSaved = 0;
+};
+
+//! @brief Merge textures with identical content.
+//!
+//! Textures are considered identical when their encoded data, format,
+//! dimensions and mipmap count match, and so do the fields their format stores
+//! with them (Texture::sameMetadata; for J3D, transparency, palette and LOD
+//! range). The first texture of each group is kept; sampler references to the
+//! others (in every model of the scene) are rewritten to it and the duplicates
+//! are removed.
+//!
+//! Runs in time linear to the total size of the texture data.
+//!
+TextureDedupResult DeduplicateTextures(Scene& scene);
+
+} // namespace libcube
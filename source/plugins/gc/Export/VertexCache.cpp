@@ -0,0 +1,124 @@
+#include "VertexCache.hpp"
+#include "Scene.hpp"
+
+#include <array>
+#include <unordered_map>
+
+namespace libcube {
+
+namespace gx = librii::gx;
+
+namespace {
+
+// Attributes that index a vertex buffer
+constexpr std::array<gx::VertexAttribute, 12> BufferAttributes{
+    gx::VertexAttribute::Position,  gx::VertexAttribute::Normal,
+    gx::VertexAttribute::Color0,    gx::VertexAttribute::Color1,
+    gx::VertexAttribute::TexCoord0, gx::VertexAttribute::TexCoord1,
+    gx::VertexAttribute::TexCoord2, gx::VertexAttribute::TexCoord3,
+    gx::VertexAttribute::TexCoord4, gx::VertexAttribute::TexCoord5,
+    gx::VertexAttribute::TexCoord6, gx::VertexAttribute::TexCoord7,
+};
+
+struct BufferUse {
+  u32 size = 0;
+  //! Entries in order of first use
+  std::vector<u32> order;
+  std::vector<bool> used;
+  //! Every (polygon, attribute) indexing the buffer
+  std::vector<std::pair<IndexedPolygon*, gx::VertexAttribute>> users;
+};
+
+} // namespace
+
+VertexCacheResult
+OptimizeVertexCache(Model& mdl,
+                    const librii::mesh::VertexCacheSettings& settings) {
+  VertexCacheResult result;
+
+  for (auto& poly : mdl.getMeshes()) {
+    result.stats += librii::mesh::OptimizeVertexCache(poly.getMeshData(),
+                                                      settings);
+    poly.invalidateMeshBounds();
+  }
+
+  std::unordered_map<const void*, BufferUse> buffers;
+  // In order of first reference, so the pass is deterministic
+  std::vector<const void*> keys;
+  for (auto& poly : mdl.getMeshes()) {
+    for (const auto attr : BufferAttributes) {
+      if (!poly.getVcd()[attr])
+        continue;
+      const auto ref = poly.getVertexBuffer(mdl, attr);
+      if (ref.key == nullptr)
+        continue;
+
+      auto [it, inserted] = buffers.try_emplace(ref.key);
+      auto& use = it->second;
+      if (inserted) {
+        use.size = ref.size;
+        use.used.resize(ref.size, false);
+        keys.push_back(ref.key);
+      }
+      use.users.emplace_back(&poly, attr);
+    }
+  }
+
+  // First use, in draw order
+  for (auto& poly : mdl.getMeshes()) {
+    for (const auto attr : BufferAttributes) {
+      if (!poly.getVcd()[attr])
+        continue;
+      const auto ref = poly.getVertexBuffer(mdl, attr);
+      if (ref.key == nullptr)
+        continue;
+      auto& use = buffers[ref.key];
+      for (const auto& mp : poly.getMeshData().mMatrixPrimitives) {
+        for (const auto& prim : mp.mPrimitives) {
+          for (const u16 index : prim.mVertices.getAttribute(attr)) {
+            if (index < use.size && !use.used[index]) {
+              use.used[index] = true;
+              use.order.push_back(index);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  for (const void* key : keys) {
+    auto& use = buffers[key];
+    for (u32 i = 0; i < use.size; ++i)
+      if (!use.used[i])
+        use.order.push_back(i);
+
+    bool identity = true;
+    for (u32 i = 0; i < use.size; ++i)
+      identity &= use.order[i] == i;
+    if (identity)
+      continue;
+
+    std::vector<u16> remap(use.size);
+    for (u32 i = 0; i < use.size; ++i)
+      remap[use.order[i]] = static_cast<u16>(i);
+
+    auto [owner, ownerAttr] = use.users.front();
+    owner->permuteVertexBuffer(mdl, ownerAttr, use.order);
+    result.reorders.push_back({owner, ownerAttr, std::move(use.order)});
+    for (auto [poly, attr] : use.users) {
+      poly->invalidateMeshBounds();
+      for (auto& mp : poly->getMeshData().mMatrixPrimitives) {
+        for (auto& prim : mp.mPrimitives) {
+          for (u16& index : prim.mVertices.getAttribute(attr)) {
+            if (index < use.size)
+              index = remap[index];
+          }
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+} // namespace libcube
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cassert>
+#include <core/common.h>
+#include <librii/gx.h>
+#include <librii/mesh/VertexCacheOptimizer.hpp>
+#include <span>
+#include <vector>
+
+namespace libcube {
+
+class Model;
+struct IndexedPolygon;
+
+//! A vertex buffer whose entries were reordered, as passed to
+//! IndexedPolygon::permuteVertexBuffer.
+struct VertexBufferReorder {
+  IndexedPolygon* owner;
+  librii::gx::VertexAttribute attr;
+  std::vector<u32> order;
+};
+
+struct VertexCacheResult {
+  librii::mesh::VertexCacheStats stats;
+  //! Vertex buffers whose entries were reordered, in order.
+  std::vector<VertexBufferReorder> reorders;
+};
+
+//! @brief Optimize every mesh of a model for the vertex cache and fetch
+//! locality.
+//!
+//! Triangle lists are reordered with librii::mesh::OptimizeVertexCache. Then
+//! each vertex buffer is sorted by first use across all meshes, in draw order,
+//! so that indices walk memory forward; every mesh sharing the buffer is
+//! remapped. Unused entries are kept, after the used ones.
+//!
+VertexCacheResult
+OptimizeVertexCache(Model& mdl,
+                    const librii::mesh::VertexCacheSettings& settings = {});
+
+//! @brief Reorder buffer entries: entry i becomes the previous `order[i]`.
+//!
+//! The storage is replaced rather than permuted in place, so a live
+//! VertexWeldSession sees the change.
+//!
+template <typename T>
+void PermuteBufferEntries(std::vector<T>& entries, std::span<const u32> order) {
+  assert(order.size() == entries.size());
+  std::vector<T> permuted;
+  permuted.reserve(entries.size());
+  for (const u32 i : order)
+    permuted.push_back(entries[i]);
+  entries = std::move(permuted);
+}
+
+} // namespace libcube
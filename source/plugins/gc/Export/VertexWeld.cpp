@@ -0,0 +1,19 @@
+#include "VertexWeld.hpp"
+
+namespace libcube {
+
+static thread_local VertexWeldSession* sCurrentSession = nullptr;
+
+VertexWeldSession::VertexWeldSession(VertexWeldSettings settings)
+    : mSettings(settings), mPrev(sCurrentSession) {
+  sCurrentSession = this;
+}
+
+VertexWeldSession::~VertexWeldSession() {
+  assert(sCurrentSession == this);
+  sCurrentSession = mPrev;
+}
+
+VertexWeldSession* VertexWeldSession::current() { return sCurrentSession; }
+
+} // namespace libcube
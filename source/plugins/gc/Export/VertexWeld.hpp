@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <core/common.h>
+#include <core/util/dedup_index.hpp>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <librii/gx.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace libcube {
+
+struct VertexWeldSettings {
+  //! Grid size positions, normals and UVs are snapped to before comparison.
+  //! Zero welds only exactly equal values.
+  f32 epsilon = 0.0f;
+};
+
+//! @brief Hash indices backing IndexedPolygon::addPos/addNrm/addClr/addUv.
+//!
+//! Without a session, each add searches the whole vertex buffer. Keep one
+//! alive for the duration of an import to make that O(1) amortized. Sessions
+//! are per-thread and nest; the innermost is used.
+//!
+//! Entries must not be edited in place while a session is alive; appends and
+//! reallocations made elsewhere are detected.
+//!
+class VertexWeldSession {
+public:
+  explicit VertexWeldSession(VertexWeldSettings settings = {});
+  ~VertexWeldSession();
+  VertexWeldSession(const VertexWeldSession&) = delete;
+  VertexWeldSession& operator=(const VertexWeldSession&) = delete;
+
+  //! The innermost session on this thread, if any.
+  static VertexWeldSession* current();
+
+  //! Index of an entry matching `entry` in `buf`, appending it if absent.
+  template <typename T> std::size_t add(std::vector<T>& buf, const T& entry) {
+    auto& indices = getIndices<T>();
+    auto it = indices.find(&buf);
+    if (it == indices.end()) {
+      const Quantized q{mSettings.epsilon};
+      it = indices.emplace(&buf, Slot<T>{Index<T>{q, q}, nullptr}).first;
+    }
+    auto& slot = it->second;
+    // Buffers live inline in their collections and move when it grows. A
+    // different storage pointer means another (or a reallocated) buffer now
+    // lives at this address: rebuild.
+    if (slot.data != buf.data())
+      slot.index.clear();
+    const std::size_t index = slot.index.insert(buf, entry);
+    slot.data = buf.data();
+    return index;
+  }
+
+private:
+  // Snaps floating-point components to the epsilon grid; exact otherwise
+  struct Quantized {
+    f32 epsilon = 0.0f;
+
+    s64 key(f32 x) const {
+      if (epsilon > 0.0f)
+        return static_cast<s64>(std::floor(x / epsilon + 0.5f));
+      // +0.0f folds -0.0f, which compares equal
+      const f32 folded = x + 0.0f;
+      u32 bits;
+      memcpy(&bits, &folded, sizeof(bits));
+      return bits;
+    }
+
+    template <int N>
+    std::size_t operator()(const glm::vec<N, f32>& v) const {
+      std::size_t h = 0;
+      for (int i = 0; i < N; ++i)
+        h = h * 0x9E3779B97F4A7C15ull + static_cast<std::size_t>(key(v[i]));
+      return h;
+    }
+    template <int N>
+    bool operator()(const glm::vec<N, f32>& a,
+                    const glm::vec<N, f32>& b) const {
+      if (epsilon <= 0.0f)
+        return a == b;
+      for (int i = 0; i < N; ++i)
+        if (key(a[i]) != key(b[i]))
+          return false;
+      return true;
+    }
+
+    std::size_t operator()(const librii::gx::Color& c) const {
+      return (c.r << 24) | (c.g << 16) | (c.b << 8) | c.a;
+    }
+    bool operator()(const librii::gx::Color& a,
+                    const librii::gx::Color& b) const {
+      return a == b;
+    }
+  };
+
+  template <typename T>
+  using Index = riistudio::util::DedupIndex<T, Quantized, Quantized>;
+  template <typename T> struct Slot {
+    Index<T> index;
+    const T* data;
+  };
+  template <typename T>
+  using IndexMap = std::unordered_map<const void*, Slot<T>>;
+
+  template <typename T> IndexMap<T>& getIndices() {
+    if constexpr (std::is_same_v<T, glm::vec3>)
+      return mVec3;
+    else if constexpr (std::is_same_v<T, glm::vec2>)
+      return mVec2;
+    else
+      return mColor;
+  }
+
+  VertexWeldSettings mSettings;
+  VertexWeldSession* mPrev = nullptr;
+  IndexMap<glm::vec3> mVec3;
+  IndexMap<glm::vec2> mVec2;
+  IndexMap<librii::gx::Color> mColor;
+};
+
+//! @brief Add a vertex buffer entry, reusing an existing match.
+//!
+//! Uses the current VertexWeldSession if there is one, else a linear search.
+//!
+template <typename T> u16 AddBufferEntry(std::vector<T>& buf, const T& entry) {
+  if (auto* session = VertexWeldSession::current())
+    return static_cast<u16>(session->add(buf, entry));
+
+  const auto found = std::find(buf.begin(), buf.end(), entry);
+  if (found != buf.end())
+    return static_cast<u16>(found - buf.begin());
+  buf.push_back(entry);
+  return static_cast<u16>(buf.size() - 1);
+}
+
+} // namespace libcube
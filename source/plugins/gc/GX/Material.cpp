@@ -1,7 +1,9 @@
 #include <algorithm>
 #include <core/3d/gl.hpp>
+#include <librii/gfx/Commands.hpp>
 #include <librii/gl/Compiler.hpp>
 #include <librii/gl/EnumConverter.hpp>
+#include <librii/glhelper/ShaderProgram.hpp>
 #include <librii/glhelper/UBOBuilder.hpp>
 #include <librii/mtx/TexMtx.hpp>
 #include <plugins/gc/Export/IndexedPolygon.hpp>
@@ -34,30 +36,23 @@ void IGCMaterial::generateUniforms(
     const std::map<std::string, u32>& texIdMap,
     const riistudio::lib3d::Polygon& poly,
     const riistudio::lib3d::Scene& scn) const {
+  auto* reflection = librii::glhelper::ShaderProgram::getReflection(shaderId);
+  if (reflection == nullptr) {
+    // Not ours to cache: query everything
+    for (u32 i = 0; i < 3; ++i) {
+      int min;
+      glGetActiveUniformBlockiv(shaderId, i, GL_UNIFORM_BLOCK_DATA_SIZE, &min);
+      builder.setBlockMin(i, min);
+    }
+  } else {
+    for (u32 i = 0; i < 3; ++i)
+      builder.setBlockMin(i, reflection->getBlockSize(i));
+  }
 
-  // WebGL doesn't support binding=n in the shader
-#ifdef __EMSCRIPTEN__
-  glUniformBlockBinding(shaderId,
-                        glGetUniformBlockIndex(shaderId, "ub_SceneParams"), 0);
-  glUniformBlockBinding(
-      shaderId, glGetUniformBlockIndex(shaderId, "ub_MaterialParams"), 1);
-  glUniformBlockBinding(shaderId,
-                        glGetUniformBlockIndex(shaderId, "ub_PacketParams"), 2);
-#endif // __EMSCRIPTEN__
-
-  int min;
-  glGetActiveUniformBlockiv(shaderId, 0, GL_UNIFORM_BLOCK_DATA_SIZE, &min);
-  // printf("Min block size: %i\n", min);
-  builder.setBlockMin(0, min);
-  glGetActiveUniformBlockiv(shaderId, 1, GL_UNIFORM_BLOCK_DATA_SIZE, &min);
-  // printf("Min block size: %i\n", min);
-  builder.setBlockMin(1, min);
-  glGetActiveUniformBlockiv(shaderId, 2, GL_UNIFORM_BLOCK_DATA_SIZE, &min);
-  // printf("Min block size: %i\n", min);
-  builder.setBlockMin(2, min);
-
+  // The vertex shader places vertices by the instance matrix; M only reaches
+  // the texture matrices, of nodes drawn once per placement
   librii::gl::UniformSceneParams scene;
-  scene.projection = M * V * P;
+  scene.projection = V * P;
   scene.Misc0 = {};
 
   const auto& data = getMaterialData();
@@ -66,7 +61,7 @@ void IGCMaterial::generateUniforms(
   librii::gl::setUniformsFromMaterial(tmp, data);
 
   for (int i = 0; i < data.texMatrices.size(); ++i) {
-    tmp.TexMtx[i] = glm::transpose(data.texMatrices[i].compute(M, V * P));
+    tmp.TexMtx[i] = glm::transpose(data.texMatrices[i].compute(M, V * P * M));
   }
   for (int i = 0; i < data.samplers.size(); ++i) {
     if (data.samplers[i]->mTexture.empty())
@@ -84,16 +79,11 @@ void IGCMaterial::generateUniforms(
   builder.tpush(1, tmp);
   // builder.tpush(2, pack);
   // ^^ filled in onSplice
-
-  const s32 samplerIds[] = {0, 1, 2, 3, 4, 5, 6, 7};
-
-  glUseProgram(shaderId);
-  u32 uTexLoc = glGetUniformLocation(shaderId, "u_Texture");
-  glUniform1iv(uTexLoc, 8, samplerIds);
 }
 
 void IGCMaterial::genSamplUniforms(
-    u32 shaderId, const std::map<std::string, u32>& texIdMap) const {
+    librii::gfx::CommandList& commands,
+    const std::map<std::string, u32>& texIdMap) const {
   const auto& data = getMaterialData();
   for (int i = 0; i < data.samplers.size(); ++i) {
     const auto& sampler = *data.samplers[i];
@@ -110,21 +100,14 @@ void IGCMaterial::genSamplUniforms(
         continue;
       }
 
-      glActiveTexture(GL_TEXTURE0 + i);
-      glBindTexture(GL_TEXTURE_2D, found->second);
+      commands.push(librii::gfx::BindTextureCmd{
+          .unit = static_cast<u32>(i),
+          .texture = found->second,
+          .minFilter = librii::gl::gxFilterToGl(sampler.mMinFilter),
+          .magFilter = librii::gl::gxFilterToGl(sampler.mMagFilter),
+          .wrapS = librii::gl::gxTileToGl(sampler.mWrapU),
+          .wrapT = librii::gl::gxTileToGl(sampler.mWrapV)});
     }
-
-    // TODO: Can we cache these parameters?
-    // Is this even safe? Does glTexParameteri limit itself based on the
-    // glActiveTexture call, or does changing one change all?
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    librii::gl::gxFilterToGl(sampler.mMinFilter));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-                    librii::gl::gxFilterToGl(sampler.mMagFilter));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
-                    librii::gl::gxTileToGl(sampler.mWrapU));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
-                    librii::gl::gxTileToGl(sampler.mWrapV));
   }
 }
 void IGCMaterial::onSplice(librii::glhelper::DelegatedUBOBuilder& builder,
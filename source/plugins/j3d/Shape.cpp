@@ -3,6 +3,8 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
+#include <plugins/gc/Export/VertexCache.hpp>
+#include <plugins/gc/Export/VertexWeld.hpp>
 
 namespace riistudio::j3d {
 
@@ -34,16 +36,11 @@ glm::vec4 Shape::getClr(const libcube::Model& mdl, u64 chan, u64 idx) const {
 
 template <typename X, typename Y>
 auto add_to_buffer(const X& entry, Y& buf) -> u16 {
-  const auto found = std::find(buf.begin(), buf.end(), entry);
-  if (found != buf.end()) {
-    return found - buf.begin();
-  }
-
-  buf.push_back(entry);
-  return buf.size() - 1;
+  return libcube::AddBufferEntry(buf, entry);
 };
 
 u64 Shape::addPos(libcube::Model& mdl, const glm::vec3& v) {
+  invalidateMeshBounds();
   return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.pos.mData);
 }
 u64 Shape::addNrm(libcube::Model& mdl, const glm::vec3& v) {
@@ -63,6 +60,64 @@ u64 Shape::addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) {
   return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.uv[chan].mData);
 }
 
+// Calls `f` with the model buffer `attr` indexes
+template <typename B, typename F>
+static void forBuffer(B& bufs, librii::gx::VertexAttribute attr, F&& f) {
+  using VA = librii::gx::VertexAttribute;
+  if (attr == VA::Position) {
+    f(bufs.pos);
+  } else if (attr == VA::Normal) {
+    f(bufs.norm);
+  } else if (attr == VA::Color0 || attr == VA::Color1) {
+    f(bufs.color[static_cast<u32>(attr) - static_cast<u32>(VA::Color0)]);
+  } else if (static_cast<u32>(attr) >= static_cast<u32>(VA::TexCoord0) &&
+             static_cast<u32>(attr) <= static_cast<u32>(VA::TexCoord7)) {
+    f(bufs.uv[static_cast<u32>(attr) - static_cast<u32>(VA::TexCoord0)]);
+  }
+}
+
+libcube::IndexedPolygon::VertexBufferRef
+Shape::getVertexBuffer(const libcube::Model& mdl,
+                       librii::gx::VertexAttribute attr) const {
+  VertexBufferRef ref;
+  forBuffer(reinterpret_cast<const Model&>(mdl).mBufs, attr,
+            [&](const auto& buf) {
+              ref.key = &buf.mData;
+              ref.size = static_cast<u32>(buf.mData.size());
+              ref.format = buf.mQuant;
+            });
+  return ref;
+}
+u64 Shape::hashVertexBuffer(const libcube::Model& mdl,
+                            librii::gx::VertexAttribute attr) const {
+  u64 hash = 0;
+  forBuffer(reinterpret_cast<const Model&>(mdl).mBufs, attr,
+            [&](const auto& buf) {
+              hash = libcube::HashBufferEntries(buf.mData, buf.mQuant);
+            });
+  return hash;
+}
+void Shape::permuteVertexBuffer(libcube::Model& mdl,
+                                librii::gx::VertexAttribute attr,
+                                std::span<const u32> order) {
+  invalidateMeshBounds();
+  forBuffer(reinterpret_cast<Model&>(mdl).mBufs, attr, [&](auto& buf) {
+    libcube::PermuteBufferEntries(buf.mData, order);
+  });
+}
+std::span<const glm::vec3>
+Shape::getPositions(const libcube::Model& mdl) const {
+  return reinterpret_cast<const Model&>(mdl).mBufs.pos.mData;
+}
+void Shape::storeMeshBounds(const libcube::Model& mdl) {
+  const auto& bounds = getMeshBounds(mdl).mesh;
+  if (bounds.empty())
+    return;
+  bbox = {bounds.min, bounds.max};
+  // About the model origin, not the box
+  bsphere = bounds.originRadius;
+}
+
 glm::mat4 computeMdlMtx(const lib3d::SRT3& srt) {
   glm::mat4 dst(1.0f);
 
@@ -114,6 +169,7 @@ std::vector<glm::mat4> Shape::getPosMtx(const libcube::Model& _mdl,
   const auto& mp = mMatrixPrimitives[mpid];
 
   auto& mdl = reinterpret_cast<const Model&>(_mdl);
+  const auto& pose = libcube::GetSkeletonPose(_mdl);
   // if (!(getVcd().mBitfield &
   //       (1 << (int)librii::gx::VertexAttribute::PositionNormalMatrixIndex)))
   //       {
@@ -128,7 +184,7 @@ std::vector<glm::mat4> Shape::getPosMtx(const libcube::Model& _mdl,
     // Rigid -- bone space
     if (drw.mWeights.size() == 1) {
       u32 boneID = drw.mWeights[0].boneId;
-      curMtx = mdl.getBones()[boneID].calcSrtMtx(mdl.getBones().toConst());
+      curMtx = pose.getWorld(boneID);
     } else {
       // curMtx = glm::mat4{ 0.0f };
       // for (const auto& w : drw.mWeights) {
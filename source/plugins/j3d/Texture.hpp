@@ -53,6 +53,13 @@ struct Texture : public TextureData, public libcube::Texture {
 
   const u8* getPaletteData() const override { return nullptr; }
   u32 getPaletteFormat() const override { return 0; }
+  bool sameMetadata(const libcube::Texture& other) const override {
+    const auto* rhs = dynamic_cast<const Texture*>(&other);
+    return rhs != nullptr && bTransparent == rhs->bTransparent &&
+           mPaletteFormat == rhs->mPaletteFormat &&
+           nPalette == rhs->nPalette && mMinLod == rhs->mMinLod &&
+           mMaxLod == rhs->mMaxLod;
+  }
 
   u16 getWidth() const override { return mWidth; }
   void setWidth(u16 width) override { mWidth = width; }
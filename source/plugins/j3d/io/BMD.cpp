@@ -5,8 +5,10 @@
 #include <oishii/writer/binary_writer.hxx>
 #include <oishii/writer/linker.hxx>
 
+#include <list>
 #include <string>
 
+#include <plugins/gc/Export/ExportSettings.hpp>
 #include <plugins/j3d/Scene.hpp>
 
 #include "Sections.hpp"
@@ -160,6 +162,11 @@ public:
     linker.mUserPad = &BMD_Pad;
     writer.mUserPad = &BMD_Pad;
 
+    // Undone when the file is written
+    std::list<libcube::ScopedExportSettings> exportPasses;
+    for (auto& model : collection.getModels())
+      exportPasses.emplace_back(model);
+
     processCollectionForWrite(collection);
 
     // writer.add_bp(0x37b2c, 4);
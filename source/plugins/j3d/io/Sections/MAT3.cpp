@@ -1,4 +1,5 @@
 #include "MaterialData.hpp"
+#include <core/util/dedup_index.hpp>
 
 namespace riistudio::j3d {
 
@@ -533,23 +534,16 @@ public:
   }
 
   u32 append(const T& entry) {
-    const auto found = std::find(mEntries.begin(), mEntries.end(), entry);
-    if (found == mEntries.end() || !compress) {
+    if constexpr (compress) {
+      return mIndex.insert(mEntries, entry);
+    } else {
       mEntries.push_back(entry);
       return mEntries.size() - 1;
     }
-    return found - mEntries.begin();
   }
   int find(const T& entry) const {
-    int outIdx = -1;
-    for (int i = 0; i < mEntries.size(); ++i)
-      if (entry == mEntries[i]) {
-        outIdx = i;
-        break;
-      }
-    // Intentionally complete
-    // TODO: rfind
-    return outIdx;
+    const auto found = mIndex.find(mEntries, entry);
+    return found ? static_cast<int>(*found) : -1;
   }
   u32 getNumEntries() const { return mEntries.size(); }
   const T& getEntry(u32 idx) const {
@@ -563,6 +557,7 @@ public:
 
 public:
   std::vector<T> mEntries;
+  mutable riistudio::util::DedupIndex<T> mIndex;
 };
 struct MAT3Node;
 struct SerializableMaterial {
@@ -574,6 +569,8 @@ struct SerializableMaterial {
 
   bool operator==(const SerializableMaterial& rhs) const noexcept;
 };
+// Material equality includes the name, so it is enough to hash on
+std::size_t hash_value(const SerializableMaterial& smat);
 auto find = [](const auto& buf, const auto x) {
   auto found = std::find(buf.begin(), buf.end(), x);
   // if (found == buf.end()) {
@@ -777,6 +774,10 @@ bool SerializableMaterial::operator==(
   return mMAT3.mMdl.getMaterials()[mIdx] ==
          rhs.mMAT3.mMdl.getMaterials()[rhs.mIdx];
 }
+std::size_t hash_value(const SerializableMaterial& smat) {
+  return std::hash<std::string>{}(
+      smat.mMAT3.mMdl.getMaterials()[smat.mIdx].name);
+}
 void io_wrapper<SerializableMaterial>::onWrite(
     oishii::Writer& writer, const SerializableMaterial& smat) {
   const Material& m = smat.mMAT3.mMdl.getMaterials()[smat.mIdx];
@@ -1,6 +1,8 @@
 #include "../Sections.hpp"
+#include <core/util/dedup_index.hpp>
 #include <core/util/glm_io.hpp>
 #include <librii/gpu/DLMesh.hpp>
+#include <plugins/gc/Export/DirectVertex.hpp>
 
 namespace riistudio::j3d {
 
@@ -155,9 +157,14 @@ void readSHP1(BMDOutputContext& ctx) {
       private:
         MatrixPrimitive& mprim;
       } mprim_del(mprim);
-      auto err = DecodeMeshDisplayList(reader, g.start + ofsDL + dlOfs, dlSz,
-                                       mprim_del, shape.mVertexDescriptor,
-                                       &ctx.mVertexBufferMaxIndices);
+      // Direct values are stored in the model's buffers, which VTX1 has
+      // already filled and which give their format
+      const auto formats = GetVertexFormats(shape, ctx.mdl);
+      DirectVertexSink direct(shape, ctx.mdl);
+      auto err = DecodeMeshDisplayList(
+          reader, g.start + ofsDL + dlOfs, dlSz, mprim_del,
+          shape.mVertexDescriptor, &ctx.mVertexBufferMaxIndices, &formats,
+          &direct);
 
       if (err) {
         printf("Invalid mesh display list..\n");
@@ -211,14 +218,19 @@ public:
   }
 
   u32 append(const T& entry) {
-    const auto found = std::find(mEntries.begin(), mEntries.end(), entry);
-    if (found == mEntries.end() || !compress) {
+    if constexpr (compress) {
+      return mIndex.insert(mEntries, entry);
+    } else {
       mEntries.push_back(entry);
       return mEntries.size() - 1;
     }
-    return found - mEntries.begin();
   }
   int find(const T& entry) const {
+    if constexpr (compress) {
+      // Entries are unique: the first match is also the last
+      const auto found = mIndex.find(mEntries, entry);
+      return found ? static_cast<int>(*found) : -1;
+    }
     int outIdx = -1;
     for (int i = 0; i < mEntries.size(); ++i)
       if (entry == mEntries[i])
@@ -239,6 +251,7 @@ public:
 
 protected:
   std::vector<T> mEntries;
+  mutable riistudio::util::DedupIndex<T> mIndex;
 };
 struct WriteableVertexDescriptor : librii::gx::VertexDescriptor {
   WriteableVertexDescriptor(const VertexDescriptor& d) {
@@ -253,6 +266,12 @@ struct WriteableVertexDescriptor : librii::gx::VertexDescriptor {
     writer.write<u32>(0);
   }
 };
+inline std::size_t hash_value(const WriteableVertexDescriptor& vcd) {
+  std::size_t h = vcd.mAttributes.size();
+  for (auto& [attr, type] : vcd.mAttributes)
+    h = h * 31 + (static_cast<u32>(attr) << 2 | static_cast<u32>(type));
+  return h;
+}
 struct WriteableMatrixList : public std::vector<s16> {
   WriteableMatrixList(const std::vector<s16>& parent) {
     *(std::vector<s16>*)this = parent;
@@ -433,6 +452,8 @@ struct SHP1Node final : public oishii::Node {
           writer.write<u16>(mpi); // Matrix list index of this prim
           writer.write<u16>(mpi); // Matrix primitive index
           writer.write<u16>(0xffff);
+          // As read or edited; refreshed by edits that move vertices
+          // (Shape::storeMeshBounds)
           writer.write<f32>(shp.bsphere);
           shp.bbox.min >> writer;
           shp.bbox.max >> writer;
@@ -468,38 +489,17 @@ struct SHP1Node final : public oishii::Node {
         break; // MPrims write..
       case SubNodeID::_DLChildMPrim: {
         const auto& poly = mMdl.getMeshes()[mPolyId];
-        for (auto& prim : poly.mMatrixPrimitives[mMpId].mPrimitives) {
-          writer.write<u8>(gx::EncodeDrawPrimitiveCommand(prim.mType));
-          writer.write<u16>(prim.mVertices.size());
-          for (const auto& v : prim.mVertices) {
-            for (int a = 0; a < (int)gx::VertexAttribute::Max; ++a) {
-              if (poly.mVertexDescriptor[(gx::VertexAttribute)a]) {
-                switch (poly.mVertexDescriptor.mAttributes.at(
-                    (gx::VertexAttribute)a)) {
-                case gx::VertexAttributeType::None:
-                  break;
-                case gx::VertexAttributeType::Byte:
-                  writer.write<u8>(v[(gx::VertexAttribute)a]);
-                  break;
-                case gx::VertexAttributeType::Short:
-                  writer.write<u16>(v[(gx::VertexAttribute)a]);
-                  break;
-                case gx::VertexAttributeType::Direct:
-                  if (((gx::VertexAttribute)a) !=
-                      gx::VertexAttribute::PositionNormalMatrixIndex) {
-                    assert(!"Direct vertex data is unsupported.");
-                    abort();
-                  }
-                  writer.write<u8>(v[(gx::VertexAttribute)a]);
-                  break;
-                default:
-                  assert("!Unknown vertex attribute format.");
-                  abort();
-                }
-              }
-            }
-          }
+        const auto formats = GetVertexFormats(poly, mMdl);
+        auto layout =
+            librii::gpu::CompileVertexLayout(poly.mVertexDescriptor, &formats);
+        if (!layout) {
+          assert(!"Unsupported vertex format.");
+          abort();
         }
+        const DirectVertexSource direct(poly, mMdl);
+        librii::gpu::EncodeMeshDisplayList(
+            writer, *layout, poly.mMatrixPrimitives[mMpId].mPrimitives,
+            &direct);
         // DL pad
         while (writer.tell() % 32)
           writer.write<u8>(0);
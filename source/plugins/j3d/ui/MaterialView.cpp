@@ -160,12 +160,13 @@ void drawProperty(kpi::PropertyDelegate<Shape>& dl, ShapeJ3DSurface) {
   bool vis = shape.visible;
   ImGui::Checkbox("Visible", &vis);
   KPI_PROPERTY_EX(dl, visible, vis);
+  auto& mdl = *dynamic_cast<libcube::Model*>(shape.childOf);
+  libcube::UpdateSkeletonPose(mdl);
   int i = 0;
   for (auto& mp : shape.mMatrixPrimitives) {
     ImGui::Text("Matrix Primitive: %i", i);
 
-    const auto matrices =
-        shape.getPosMtx(*dynamic_cast<libcube::Model*>(shape.childOf), i);
+    const auto matrices = shape.getPosMtx(mdl, i);
     int j = 0;
     for (auto& elem : mp.mDrawMatrixIndices) {
       ImGui::Text("DRW %i: %i", j, elem);
@@ -3,9 +3,12 @@
 #include <filesystem>
 #include <librii/hx/CullMode.hpp>
 #include <librii/hx/PixMode.hpp>
+#include <librii/image/FormatAnalyzer.hpp>
+#include <librii/mesh/TriangleStripper.hpp>
 #include <librii/rhst/RHST.hpp>
 #include <oishii/reader/binary_reader.hxx>
 #include <plugins/gc/Export/Scene.hpp>
+#include <plugins/gc/Export/VertexWeld.hpp>
 #include <plugins/j3d/Material.hpp>
 #include <set>
 #include <stb_image.h>
@@ -184,9 +187,12 @@ void compilePrim(librii::gx::IndexedPrimitive& dst,
     break;
   }
 
+  dst.mVertices.setMask(poly.getMeshData().mVertexDescriptor);
   dst.mVertices.reserve(src.vertices.size());
   for (auto& vert : src.vertices) {
-    compileVert(dst.mVertices.emplace_back(), vert, poly, model);
+    librii::gx::IndexedVertex vtx;
+    compileVert(vtx, vert, poly, model);
+    dst.mVertices.push_back(vtx);
   }
 }
 
@@ -229,6 +235,8 @@ void compileMesh(libcube::IndexedPolygon& dst, const librii::rhst::Mesh& src,
     compileMatrixPrim(data.mMatrixPrimitives.emplace_back(), matrix_prim,
                       src.current_matrix, dst, model);
   }
+
+  librii::mesh::StripifyMesh(data);
 }
 
 struct RHSTReader {
@@ -274,7 +282,11 @@ static bool importTexture(libcube::Texture& data, u8* image,
            (height >> (num_mip + 1)) >= min_dim)
       ++num_mip;
   }
-  data.setTextureFormat((int)librii::gx::TextureFormat::CMPR);
+  const auto selection =
+      librii::image::selectTextureFormat(image, width, height);
+  printf("Selected texture format %u (PSNR: %f dB)\n",
+         static_cast<unsigned>(selection.format), selection.psnr);
+  data.setTextureFormat(static_cast<int>(selection.format));
   data.setWidth(width);
   data.setHeight(height);
   data.setMipmapCount(num_mip);
@@ -340,6 +352,7 @@ void RHSTReader::read(kpi::IOTransaction& transaction) {
     compileBone(mdl.getBones().add(), bone);
   }
   int i = 0;
+  libcube::VertexWeldSession weld;
   for (auto& mesh : result->meshes) {
     compileMesh(mdl.getMeshes().add(), mesh, i++, mdl);
   }
@@ -0,0 +1,243 @@
+// Headless scene renderer benchmark.
+//
+// Prepares each model for drawing without a GPU, then renders frames from a
+// camera orbiting it: the renderer culls, sorts, builds uniforms and records
+// commands as it would on screen, and a null executor plays them back. Reports
+// the CPU time per frame and the state changes the commands would make,
+// including those that would not change anything.
+//
+// With --instances, the model is placed that many times on a grid, as a course
+// places objects, and drawn instanced.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <core/3d/i3dmodel.hpp>
+#include <core/3d/renderer/SceneState.hpp>
+#include <core/api.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <librii/gfx/Commands.hpp>
+#include <librii/kmp/CourseMap.hpp>
+#include <oishii/reader/binary_reader.hxx>
+#include <vendor/llvm/Support/InitLLVM.h>
+
+namespace rendbench {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::vector<fs::path> inputs;
+  u32 frames = 1000;
+  u32 instances = 0;
+};
+
+static std::unique_ptr<kpi::INode> open(const fs::path& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file)
+    return nullptr;
+  std::vector<u8> vec(file.tellg());
+  file.seekg(0, std::ios::beg);
+  if (!file.read(reinterpret_cast<char*>(vec.data()), vec.size()))
+    return nullptr;
+
+  const auto path_string = path.string();
+  oishii::DataProvider provider(std::move(vec), path_string);
+  auto importer = SpawnImporter(path_string, provider.slice());
+  if (!importer.second)
+    return nullptr;
+  if (!IsConstructible(importer.first)) {
+    const auto children = GetChildrenOfType(importer.first);
+    if (children.empty() || !IsConstructible(children[0]))
+      return nullptr;
+    importer.first = children[0];
+  }
+
+  std::unique_ptr<kpi::INode> state{
+      dynamic_cast<kpi::INode*>(SpawnState(importer.first).release())};
+  if (!state)
+    return nullptr;
+  kpi::IOTransaction transaction{*state, provider.slice(), [](...) {}};
+  importer.second->read_(transaction);
+  return state;
+}
+
+// Placements on a square grid, spaced by `spacing`, rotated and scaled a little
+// differently each
+static std::vector<glm::mat4> placeOnGrid(u32 count, f32 spacing) {
+  std::vector<librii::kmp::GeoObj> objs(count);
+  const u32 side = static_cast<u32>(std::ceil(std::sqrt(f32(count))));
+  for (u32 i = 0; i < count; ++i) {
+    auto& obj = objs[i];
+    obj.position = {(i % side) * spacing, 0.0f, (i / side) * spacing};
+    obj.rotation = {0.0f, static_cast<f32>((i * 37) % 360), 0.0f};
+    obj.scale = glm::vec3{1.0f + (i % 5) * 0.1f};
+  }
+  std::vector<glm::mat4> matrices(count);
+  librii::kmp::ComputeGeoObjMatrices(objs, matrices);
+  return matrices;
+}
+
+static double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static bool run(const fs::path& path, const Options& opt) {
+  const auto name = path.filename().string();
+
+  auto root = open(path);
+  auto* drawable = dynamic_cast<riistudio::lib3d::IDrawable*>(root.get());
+  if (drawable == nullptr) {
+    printf("%s: FAIL (cannot open)\n", name.c_str());
+    return false;
+  }
+
+  riistudio::lib3d::SceneState state;
+  state.setHeadless(true);
+  auto start = Clock::now();
+  drawable->prepare(state, *root);
+  const double prepare_ms = millisecondsSince(start);
+
+  if (opt.instances != 0) {
+    const auto model = state.computeBounds();
+    const f32 size = std::max({model.max.x - model.min.x,
+                               model.max.z - model.min.z, 1.0f});
+    state.setInstances(placeOnGrid(opt.instances, size * 1.5f));
+  }
+
+  // Orbit the model from outside its bound, so that views differ and part of
+  // the model leaves the frustum
+  const auto bound = state.computeBounds();
+  const glm::vec3 center = (bound.min + bound.max) * 0.5f;
+  const f32 radius = std::max(glm::length(bound.max - bound.min) * 0.5f, 1.0f);
+  const glm::mat4 proj =
+      glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, radius * 0.01f,
+                       radius * 10.0f);
+
+  librii::gfx::NullCommandExecutor executor;
+  std::vector<double> frame_ms;
+  frame_ms.reserve(opt.frames);
+  u64 draws = 0, instances = 0, culled = 0, commands = 0;
+  u64 program_switches = 0, texture_switches = 0, state_switches = 0;
+  u64 uniform_bytes = 0;
+  for (u32 i = 0; i < opt.frames; ++i) {
+    const f32 angle = glm::radians(360.0f) * i / opt.frames;
+    const glm::vec3 eye =
+        center + glm::vec3{std::cos(angle), 0.35f, std::sin(angle)} * radius;
+    const glm::mat4 view = glm::lookAt(eye, center, {0.0f, 1.0f, 0.0f});
+
+    start = Clock::now();
+    drawable->update(state, *root);
+    state.buildUniformBuffers(proj, view);
+    state.draw(executor);
+    frame_ms.push_back(millisecondsSince(start));
+
+    const auto& stats = state.getStats();
+    draws += stats.draws;
+    instances += stats.instances;
+    culled += stats.culled;
+    program_switches += stats.programSwitches;
+    texture_switches += stats.textureSwitches;
+    state_switches += stats.stateSwitches;
+    commands += state.getCommands().size();
+    uniform_bytes += state.getUniformStats().bytesUploaded;
+  }
+  if (frame_ms.empty())
+    return true;
+
+  // The first frame uploads every uniform; later frames only what changed
+  const double first_ms = frame_ms.front();
+  std::sort(frame_ms.begin(), frame_ms.end());
+  double total_ms = 0.0;
+  for (const double ms : frame_ms)
+    total_ms += ms;
+  const double frames = static_cast<double>(opt.frames);
+  const auto per_frame = [&](u64 value) { return value / frames; };
+  const auto& exec = executor.getStats();
+
+  printf("%s\n", name.c_str());
+  printf("  Prepare:      %.3f ms\n", prepare_ms);
+  printf("  Frame (CPU):  %.4f ms mean, %.4f ms median, %.4f ms p99, "
+         "%.4f ms first\n",
+         total_ms / frames, frame_ms[frame_ms.size() / 2],
+         frame_ms[std::min(frame_ms.size() - 1, frame_ms.size() * 99 / 100)],
+         first_ms);
+  printf("  Per frame:    %.1f draws of %.1f instances, %.1f culled, %.1f "
+         "commands, %.0f uniform bytes sent\n",
+         per_frame(draws), per_frame(instances), per_frame(culled),
+         per_frame(commands), per_frame(uniform_bytes));
+  printf("  Switches:     %.1f program, %.1f texture set, %.1f render state\n",
+         per_frame(program_switches), per_frame(texture_switches),
+         per_frame(state_switches));
+  printf("  Redundant:    %u of %u commands (state %u, program %u, vertex "
+         "array %u, texture %u, uniform binding %u)\n",
+         exec.getRedundant(), exec.commands, exec.redundantStates,
+         exec.redundantPrograms, exec.redundantVertexArrays,
+         exec.redundantTextures, exec.redundantUniformBinds);
+  return true;
+}
+
+static bool isModel(const fs::path& path) {
+  auto ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](char c) { return static_cast<char>(std::tolower(c)); });
+  return ext == ".bmd" || ext == ".bdl" || ext == ".brres";
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: rendbench <model or directory>... [--frames N] "
+                  "[--instances N]\n");
+  fprintf(stderr, "  e.g. rendbench tests/samples\n");
+}
+
+} // namespace rendbench
+
+int main(int argc, const char** argv) {
+  using namespace rendbench;
+
+  llvm::InitLLVM init_llvm(argc, argv);
+
+  Options opt;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--frames" && i + 1 < argc) {
+      opt.frames = std::stoi(argv[++i]);
+      continue;
+    }
+    if (arg == "--instances" && i + 1 < argc) {
+      opt.instances = std::stoi(argv[++i]);
+      continue;
+    }
+    if (fs::is_directory(arg)) {
+      for (const auto& entry : fs::directory_iterator(arg)) {
+        if (entry.is_regular_file() && isModel(entry.path()))
+          opt.inputs.push_back(entry.path());
+      }
+      continue;
+    }
+    opt.inputs.push_back(arg);
+  }
+  if (opt.inputs.empty()) {
+    usage();
+    return 1;
+  }
+  std::sort(opt.inputs.begin(), opt.inputs.end());
+
+  InitAPI();
+  unsigned failed = 0;
+  for (const auto& path : opt.inputs)
+    failed += !run(path, opt);
+  DeinitAPI();
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Plays the same frame back twice through GlCommandExecutor, on a GL that only
+// counts calls (GlCalls.cpp).
+//
+// Texture parameters and program reflection belong to GL objects that outlive
+// a frame, so only the first frame may set or query them. Unit bindings are
+// invalidated between frames, so the second frame still binds.
+
+#include "GlCalls.hpp"
+#include <core/3d/gl.hpp>
+#include <cstdio>
+#include <librii/gfx/Commands.hpp>
+#include <librii/glhelper/GlCommandExecutor.hpp>
+#include <librii/glhelper/ShaderProgram.hpp>
+#include <librii/glhelper/TextureState.hpp>
+#include <tuple>
+#include <vector>
+
+namespace gfx = librii::gfx;
+using librii::glhelper::ShaderProgram;
+
+// Two materials over three textures. One texture is shared, sampled the same
+// way by both.
+static gfx::CommandList recordFrame(u32 program_a, u32 program_b) {
+  gfx::CommandList list;
+  const std::vector<u8> uniforms(GlCallsUniformBlockSize);
+  list.push(gfx::ReserveUniformsCmd{.size = 2 * GlCallsUniformBlockSize});
+
+  u32 offset = 0;
+  const auto material = [&](u32 program, u32 texture) {
+    list.push(gfx::SetMegaStateCmd{.state = {.cullMode = GL_BACK,
+                                             .depthWrite = GL_TRUE,
+                                             .depthCompare = GL_LEQUAL,
+                                             .frontFace = GL_CW,
+                                             .blendMode = GL_FUNC_ADD,
+                                             .blendSrcFactor = GL_ONE,
+                                             .blendDstFactor = GL_ZERO}});
+    list.push(gfx::UseProgramCmd{.program = program});
+    list.push(gfx::BindVertexArrayCmd{.vertexArray = 1});
+    list.push(gfx::BindTextureCmd{.unit = 0,
+                                  .texture = 100,
+                                  .minFilter = GL_LINEAR,
+                                  .magFilter = GL_LINEAR,
+                                  .wrapS = GL_REPEAT,
+                                  .wrapT = GL_REPEAT});
+    list.push(gfx::BindTextureCmd{.unit = 1,
+                                  .texture = texture,
+                                  .minFilter = GL_NEAREST,
+                                  .magFilter = GL_NEAREST,
+                                  .wrapS = GL_CLAMP_TO_EDGE,
+                                  .wrapT = GL_MIRRORED_REPEAT});
+    list.uploadUniforms(offset, uniforms);
+    list.push(gfx::BindUniformsCmd{
+        .binding = 1, .offset = offset, .size = GlCallsUniformBlockSize});
+    list.push(gfx::DrawCmd{.count = 36, .firstIndex = 0});
+    offset += GlCallsUniformBlockSize;
+  };
+  material(program_a, 101);
+  material(program_b, 102);
+  list.push(gfx::UnbindCmd{});
+  return list;
+}
+
+#define EXPECT(COND, ...)                                                      \
+  if (!(COND)) {                                                               \
+    printf("Error: " __VA_ARGS__);                                             \
+    printf("\n");                                                              \
+    ok = false;                                                                \
+  }
+
+int main() {
+  bool ok = true;
+
+  ShaderProgram program_a("", "");
+  ShaderProgram program_b("", "");
+  EXPECT(GetGlCalls("glGetActiveUniformBlockiv") ==
+             2 * GlCallsNumUniformBlocks,
+         "Reflection: %u block queries when linking, expected %u",
+         GetGlCalls("glGetActiveUniformBlockiv"),
+         2 * GlCallsNumUniformBlocks);
+  const auto* reflection = ShaderProgram::getReflection(program_a.getId());
+  EXPECT(reflection != nullptr &&
+             reflection->getBlockSize(0) == GlCallsUniformBlockSize,
+         "Reflection: block sizes not recorded");
+
+  const auto frame = recordFrame(program_a.getId(), program_b.getId());
+  librii::glhelper::GlCommandExecutor executor;
+
+  ResetGlCalls();
+  executor.execute(frame);
+  // Three textures, four parameters each
+  EXPECT(GetGlCalls("glTexParameteri") == 12,
+         "First frame: %u texture parameters set, expected 12",
+         GetGlCalls("glTexParameteri"));
+  EXPECT(GetGlCalls("glUniform1iv") == 2,
+         "First frame: %u sampler uniforms set, expected 2",
+         GetGlCalls("glUniform1iv"));
+  const u32 first_calls = GetAllGlCalls();
+
+  ResetGlCalls();
+  executor.execute(frame);
+  for (const char* name :
+       {"glTexParameteri", "glGetProgramiv", "glGetActiveUniformBlockiv",
+        "glGetUniformLocation", "glUniform1iv"}) {
+    EXPECT(GetGlCalls(name) == 0, "Second frame: %u redundant calls of %s",
+           GetGlCalls(name), name);
+  }
+  // Texture 100 stays bound to unit 0 for the second material
+  EXPECT(GetGlCalls("glBindTexture") == 3,
+         "Second frame: %u texture binds, expected 3",
+         GetGlCalls("glBindTexture"));
+  const u32 second_calls = GetAllGlCalls();
+
+  // Sampling a bound texture differently, after binding another unit, sets the
+  // parameters of that texture and not of the last one bound
+  gfx::CommandList resample;
+  for (const auto& [unit, texture, filter] :
+       {std::tuple{0u, 100u, GL_LINEAR}, std::tuple{1u, 101u, GL_LINEAR},
+        std::tuple{0u, 100u, GL_NEAREST}}) {
+    resample.push(gfx::BindTextureCmd{.unit = unit,
+                                      .texture = texture,
+                                      .minFilter = static_cast<u32>(filter),
+                                      .magFilter = GL_LINEAR,
+                                      .wrapS = GL_REPEAT,
+                                      .wrapT = GL_REPEAT});
+  }
+  ResetGlCalls();
+  executor.execute(resample);
+  const auto targets = GetGlTexParameterTargets();
+  EXPECT(!targets.empty() && targets.back() == 100,
+         "Resampling: parameters of texture 100 set on texture %u",
+         targets.empty() ? 0 : targets.back());
+
+  const auto& stats = librii::glhelper::TextureState::getStats();
+  printf("GL calls: %u first frame, %u second frame; texture state %u issued, "
+         "%u skipped\n",
+         first_calls, second_calls, stats.issued, stats.skipped);
+  return ok ? 0 : 1;
+}
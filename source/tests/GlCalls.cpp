@@ -0,0 +1,137 @@
+#include "GlCalls.hpp"
+#include <core/3d/gl.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+static std::map<std::string, u32, std::less<>> sCalls;
+static u32 sNextName = 1;
+static u32 sActiveUnit = 0;
+static std::map<u32, u32> sBoundTextures;
+static std::vector<u32> sTexParameterTargets;
+
+u32 GetGlCalls(std::string_view name) {
+  const auto found = sCalls.find(name);
+  return found != sCalls.end() ? found->second : 0;
+}
+u32 GetAllGlCalls() {
+  u32 total = 0;
+  for (const auto& [name, count] : sCalls)
+    total += count;
+  return total;
+}
+void ResetGlCalls() {
+  sCalls.clear();
+  sTexParameterTargets.clear();
+}
+std::span<const u32> GetGlTexParameterTargets() {
+  return sTexParameterTargets;
+}
+
+static void count(const char* name) { ++sCalls[name]; }
+
+extern "C" {
+
+// Textures
+void APIENTRY glActiveTexture(GLenum texture) {
+  count("glActiveTexture");
+  sActiveUnit = texture - GL_TEXTURE0;
+}
+void APIENTRY glBindTexture(GLenum, GLuint texture) {
+  count("glBindTexture");
+  sBoundTextures[sActiveUnit] = texture;
+}
+void APIENTRY glTexParameteri(GLenum, GLenum, GLint) {
+  count("glTexParameteri");
+  sTexParameterTargets.push_back(sBoundTextures[sActiveUnit]);
+}
+
+// Programs
+GLuint APIENTRY glCreateShader(GLenum) {
+  count("glCreateShader");
+  return sNextName++;
+}
+void APIENTRY glShaderSource(GLuint, GLsizei, const GLchar* const*,
+                             const GLint*) {
+  count("glShaderSource");
+}
+void APIENTRY glCompileShader(GLuint) { count("glCompileShader"); }
+void APIENTRY glGetShaderiv(GLuint, GLenum pname, GLint* params) {
+  count("glGetShaderiv");
+  *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+void APIENTRY glGetShaderInfoLog(GLuint, GLsizei bufSize, GLsizei* length,
+                                 GLchar* infoLog) {
+  count("glGetShaderInfoLog");
+  if (length != nullptr)
+    *length = 0;
+  if (bufSize > 0)
+    infoLog[0] = '\0';
+}
+void APIENTRY glDeleteShader(GLuint) { count("glDeleteShader"); }
+GLuint APIENTRY glCreateProgram() {
+  count("glCreateProgram");
+  return sNextName++;
+}
+void APIENTRY glAttachShader(GLuint, GLuint) { count("glAttachShader"); }
+void APIENTRY glLinkProgram(GLuint) { count("glLinkProgram"); }
+void APIENTRY glDeleteProgram(GLuint) { count("glDeleteProgram"); }
+void APIENTRY glUseProgram(GLuint) { count("glUseProgram"); }
+void APIENTRY glGetProgramiv(GLuint, GLenum pname, GLint* params) {
+  count("glGetProgramiv");
+  *params = pname == GL_ACTIVE_UNIFORM_BLOCKS ? GlCallsNumUniformBlocks : 0;
+}
+void APIENTRY glGetActiveUniformBlockiv(GLuint, GLuint, GLenum pname,
+                                        GLint* params) {
+  count("glGetActiveUniformBlockiv");
+  *params = pname == GL_UNIFORM_BLOCK_DATA_SIZE ? GlCallsUniformBlockSize : 0;
+}
+GLint APIENTRY glGetUniformLocation(GLuint, const GLchar*) {
+  count("glGetUniformLocation");
+  return 0;
+}
+void APIENTRY glUniform1iv(GLint, GLsizei, const GLint*) {
+  count("glUniform1iv");
+}
+
+// Buffers
+void APIENTRY glGenBuffers(GLsizei n, GLuint* buffers) {
+  count("glGenBuffers");
+  for (GLsizei i = 0; i < n; ++i)
+    buffers[i] = sNextName++;
+}
+void APIENTRY glDeleteBuffers(GLsizei, const GLuint*) {
+  count("glDeleteBuffers");
+}
+void APIENTRY glBindBuffer(GLenum, GLuint) { count("glBindBuffer"); }
+void APIENTRY glBufferData(GLenum, GLsizeiptr, const void*, GLenum) {
+  count("glBufferData");
+}
+void APIENTRY glBufferSubData(GLenum, GLintptr, GLsizeiptr, const void*) {
+  count("glBufferSubData");
+}
+void APIENTRY glBindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) {
+  count("glBindBufferRange");
+}
+
+// Render state
+void APIENTRY glEnable(GLenum) { count("glEnable"); }
+void APIENTRY glDisable(GLenum) { count("glDisable"); }
+void APIENTRY glBlendEquation(GLenum) { count("glBlendEquation"); }
+void APIENTRY glBlendFunc(GLenum, GLenum) { count("glBlendFunc"); }
+void APIENTRY glCullFace(GLenum) { count("glCullFace"); }
+void APIENTRY glFrontFace(GLenum) { count("glFrontFace"); }
+void APIENTRY glDepthFunc(GLenum) { count("glDepthFunc"); }
+void APIENTRY glDepthMask(GLboolean) { count("glDepthMask"); }
+
+// Drawing
+void APIENTRY glBindVertexArray(GLuint) { count("glBindVertexArray"); }
+void APIENTRY glDrawElements(GLenum, GLsizei, GLenum, const void*) {
+  count("glDrawElements");
+}
+void APIENTRY glDrawElementsInstanced(GLenum, GLsizei, GLenum, const void*,
+                                      GLsizei) {
+  count("glDrawElementsInstanced");
+}
+
+} // extern "C"
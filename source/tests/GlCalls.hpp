@@ -0,0 +1,22 @@
+#pragma once
+
+#include <core/common.h>
+#include <span>
+#include <string_view>
+
+// A GL without a GPU, for glcalltests: each entry point the renderer uses
+// counts its calls and does nothing else, except to hand out object names and
+// answer queries with plausible values.
+
+// Calls of a GL function by name, e.g. "glTexParameteri", since the last reset
+u32 GetGlCalls(std::string_view name);
+// Calls of every GL function since the last reset
+u32 GetAllGlCalls();
+void ResetGlCalls();
+// Texture each glTexParameteri call since the last reset applied to: the one
+// bound to the active unit
+std::span<const u32> GetGlTexParameterTargets();
+
+// What glGetProgramiv and glGetActiveUniformBlockiv report for every program
+constexpr s32 GlCallsNumUniformBlocks = 4;
+constexpr s32 GlCallsUniformBlockSize = 256;
@@ -0,0 +1,85 @@
+#include "ImageTests.hpp"
+
+#include <cstdio>
+#include <librii/image/FormatAnalyzer.hpp>
+#include <librii/image/ImagePlatform.hpp>
+#include <vector>
+
+namespace gx = librii::gx;
+
+namespace {
+
+constexpr u32 Width = 64;
+constexpr u32 Height = 64;
+
+// Gray ramp along x, stepping a little along y, so that blocks differ
+std::vector<u8> GrayGradient(bool translucent) {
+  std::vector<u8> rgba(Width * Height * 4);
+  for (u32 y = 0; y < Height; ++y) {
+    for (u32 x = 0; x < Width; ++x) {
+      u8* px = &rgba[(y * Width + x) * 4];
+      px[0] = px[1] = px[2] = static_cast<u8>(x * 4 + y / 16);
+      px[3] = translucent ? static_cast<u8>(255 - y * 4) : 0xFF;
+    }
+  }
+  return rgba;
+}
+
+#define EXPECT(COND, ...)                                                      \
+  if (!(COND)) {                                                               \
+    printf("Error: " __VA_ARGS__);                                             \
+    printf("\n");                                                              \
+    return false;                                                              \
+  }
+
+// Past what CMPR, I4 and IA4 reach on a smooth ramp: only an 8-bit intensity
+// format is exact
+constexpr float NearLossless = 45.0f;
+
+bool TestOpaqueGray() {
+  const auto rgba = GrayGradient(false);
+  const auto traits = librii::image::analyzeImage(rgba.data(), Width * Height);
+  EXPECT(traits.grayscale && traits.opaque, "Image: gradient not opaque gray");
+
+  const auto chosen = librii::image::selectTextureFormat(
+      rgba.data(), Width, Height, {.minPsnr = NearLossless});
+  EXPECT(chosen.format == gx::TextureFormat::I8,
+         "Image: opaque gray gradient chose format %u (%.2f dB), not I8",
+         static_cast<u32>(chosen.format), chosen.psnr);
+  printf("Image: opaque gray gradient -> I8 (%.2f dB)\n", chosen.psnr);
+  return true;
+}
+
+bool TestTranslucentGray() {
+  const auto rgba = GrayGradient(true);
+
+  // I8 would make alpha the intensity
+  const auto chosen = librii::image::selectTextureFormat(
+      rgba.data(), Width, Height, {.minPsnr = NearLossless});
+  EXPECT(chosen.format == gx::TextureFormat::IA8,
+         "Image: translucent gray gradient chose format %u (%.2f dB), not IA8",
+         static_cast<u32>(chosen.format), chosen.psnr);
+
+  // IA8 keeps both channels exactly
+  std::vector<u8> encoded(librii::image::getEncodedSize(
+      Width, Height, gx::TextureFormat::IA8, 0));
+  std::vector<u8> decoded(rgba.size());
+  librii::image::encode(encoded.data(), rgba.data(), Width, Height,
+                        gx::TextureFormat::IA8);
+  librii::image::decode(decoded.data(), encoded.data(), Width, Height,
+                        gx::TextureFormat::IA8);
+  EXPECT(decoded == rgba, "Image: IA8 does not roundtrip gray and alpha");
+  printf("Image: translucent gray gradient -> IA8 (%.2f dB)\n", chosen.psnr);
+  return true;
+}
+
+#undef EXPECT
+
+} // namespace
+
+bool RunImageTests() {
+  bool ok = true;
+  ok &= TestOpaqueGray();
+  ok &= TestTranslucentGray();
+  return ok;
+}
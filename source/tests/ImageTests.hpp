@@ -0,0 +1,5 @@
+#pragma once
+
+// Checks of librii::image format selection on generated images. Prints each
+// failure; returns whether all passed.
+bool RunImageTests();
@@ -0,0 +1,410 @@
+#include "MeshTests.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <librii/gpu/DLMesh.hpp>
+#include <librii/mesh/MatrixPalette.hpp>
+#include <librii/mesh/Simplify.hpp>
+#include <librii/mesh/TriangleStripper.hpp>
+#include <random>
+#include <vector>
+
+namespace gx = librii::gx;
+
+namespace {
+
+using Triangle = std::array<u16, 3>;
+
+// Positions on a torus, `rings` around by `sides` around the tube: a closed
+// surface with no open edges
+std::vector<glm::vec3> TorusPositions(u32 rings, u32 sides) {
+  std::vector<glm::vec3> positions;
+  for (u32 r = 0; r < rings; ++r) {
+    const f32 u = 6.2831853f * r / rings;
+    for (u32 s = 0; s < sides; ++s) {
+      const f32 v = 6.2831853f * s / sides;
+      const f32 w = 100.0f + 30.0f * std::cos(v);
+      positions.push_back(
+          {w * std::cos(u), 30.0f * std::sin(v), w * std::sin(u)});
+    }
+  }
+  return positions;
+}
+
+// Triangle list over TorusPositions, as position indices
+std::vector<u16> TorusIndices(u32 rings, u32 sides) {
+  std::vector<u16> indices;
+  const auto at = [&](u32 r, u32 s) {
+    return static_cast<u16>((r % rings) * sides + s % sides);
+  };
+  for (u32 r = 0; r < rings; ++r) {
+    for (u32 s = 0; s < sides; ++s) {
+      indices.insert(indices.end(), {at(r, s), at(r, s + 1), at(r + 1, s)});
+      indices.insert(indices.end(),
+                     {at(r + 1, s), at(r, s + 1), at(r + 1, s + 1)});
+    }
+  }
+  return indices;
+}
+
+gx::MeshData MakeMesh(std::span<const u16> indices) {
+  gx::MeshData mesh;
+  mesh.mVertexDescriptor.mAttributes[gx::VertexAttribute::Position] =
+      gx::VertexAttributeType::Short;
+  mesh.mVertexDescriptor.calcVertexDescriptorFromAttributeList();
+  auto& prim = mesh.mMatrixPrimitives.emplace_back().mPrimitives.emplace_back(
+      gx::PrimitiveType::Triangles, indices.size());
+  prim.mVertices.setMask(mesh.mVertexDescriptor);
+  for (std::size_t i = 0; i < indices.size(); ++i)
+    prim.mVertices[i][gx::VertexAttribute::Position] = indices[i];
+  return mesh;
+}
+
+// Triangles drawn by a mesh, by position, each rotated to start at its lowest
+// index so that winding is kept but the starting vertex does not matter.
+// Degenerate triangles are dropped. Sorted. Empty if a primitive is not made of
+// triangles.
+std::vector<Triangle> GetTriangles(const gx::MeshData& mesh) {
+  std::vector<Triangle> tris;
+  const auto push = [&](u16 a, u16 b, u16 c) {
+    if (a == b || b == c || c == a)
+      return;
+    Triangle t{a, b, c};
+    std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+    tris.push_back(t);
+  };
+  for (const auto& mp : mesh.mMatrixPrimitives) {
+    for (const auto& prim : mp.mPrimitives) {
+      std::vector<u16> ids;
+      for (const auto& v : prim.mVertices)
+        ids.push_back(v[gx::VertexAttribute::Position]);
+      const std::size_t n = ids.size();
+      switch (prim.mType) {
+      case gx::PrimitiveType::Triangles:
+        for (std::size_t i = 0; i + 2 < n; i += 3)
+          push(ids[i], ids[i + 1], ids[i + 2]);
+        break;
+      case gx::PrimitiveType::TriangleStrip:
+        for (std::size_t i = 0; i + 2 < n; ++i) {
+          if (i % 2 == 0)
+            push(ids[i], ids[i + 1], ids[i + 2]);
+          else
+            push(ids[i + 1], ids[i], ids[i + 2]);
+        }
+        break;
+      case gx::PrimitiveType::TriangleFan:
+        for (std::size_t i = 1; i + 1 < n; ++i)
+          push(ids[0], ids[i], ids[i + 1]);
+        break;
+      default:
+        return {};
+      }
+    }
+  }
+  std::sort(tris.begin(), tris.end());
+  return tris;
+}
+
+#define EXPECT(COND, ...)                                                      \
+  if (!(COND)) {                                                               \
+    printf("Error: " __VA_ARGS__);                                             \
+    printf("\n");                                                              \
+    return false;                                                              \
+  }
+
+bool TestVertexList() {
+  // Normals are all index 0, but in the descriptor: they must keep a column
+  const auto indices = TorusIndices(4, 4);
+  auto mesh = MakeMesh(indices);
+  mesh.mVertexDescriptor.mAttributes[gx::VertexAttribute::Normal] =
+      gx::VertexAttributeType::Byte;
+  mesh.mVertexDescriptor.calcVertexDescriptorFromAttributeList();
+  gx::IndexedVertexList list;
+  list.setMask(mesh.mVertexDescriptor);
+  for (const auto& v : mesh.mMatrixPrimitives[0].mPrimitives[0].mVertices)
+    list.push_back(v);
+  EXPECT(list.getStride() == 2, "VertexList: stride %u for two attributes",
+         list.getStride());
+
+  // Views are strided columns of the packed stream
+  auto normals = list.getAttribute(gx::VertexAttribute::Normal);
+  EXPECT(normals.size() == indices.size(), "VertexList: normal view size");
+  for (u16& n : normals)
+    n = 7;
+  std::size_t i = 0;
+  for (const u16 pos : list.getAttribute(gx::VertexAttribute::Position)) {
+    EXPECT(pos == indices[i] && list[i][gx::VertexAttribute::Normal] == 7,
+           "VertexList: vertex %u changed through another column",
+           static_cast<u32>(i));
+    ++i;
+  }
+  EXPECT(list.getAttribute(gx::VertexAttribute::Color0).empty(),
+         "VertexList: view of an attribute outside the mask");
+  return true;
+}
+
+bool TestStripify() {
+  const auto indices = TorusIndices(24, 16);
+  auto mesh = MakeMesh(indices);
+  const auto before = GetTriangles(mesh);
+
+  const auto stats = librii::mesh::StripifyMesh(mesh);
+  const auto after = GetTriangles(mesh);
+  EXPECT(before == after, "Stripify: triangles changed (%u in, %u out)",
+         static_cast<u32>(before.size()), static_cast<u32>(after.size()));
+  EXPECT(stats.numStrips + stats.numFans > 0, "Stripify: no strips built");
+  EXPECT(stats.verticesAfter < stats.verticesBefore,
+         "Stripify: %u vertices in, %u out", stats.verticesBefore,
+         stats.verticesAfter);
+
+  // Running again over its own strips keeps the triangles too
+  librii::mesh::StripifyMesh(mesh);
+  EXPECT(GetTriangles(mesh) == before, "Stripify: restripping changed mesh");
+
+  printf("Stripify: %u triangles, %u strips, %u fans, %u loose, %u -> %u "
+         "vertices\n",
+         stats.numTriangles, stats.numStrips, stats.numFans,
+         stats.numLooseTriangles, stats.verticesBefore, stats.verticesAfter);
+  return true;
+}
+
+bool TestMatrixPalette() {
+  // Skinned along a chain of bones: each triangle is weighted to a few
+  // neighbouring matrices
+  constexpr u32 NumTriangles = 5000;
+  constexpr u16 NumMatrices = 60;
+  std::mt19937 rng(1234);
+  std::vector<Triangle> tris(NumTriangles);
+  for (auto& t : tris) {
+    const u16 base = static_cast<u16>(rng() % (NumMatrices - 3));
+    for (auto& m : t)
+      m = base + static_cast<u16>(rng() % 4);
+  }
+
+  for (const u32 size : {3u, 10u}) {
+    const auto groups = librii::mesh::PartitionMatrixPalettes(tris, size);
+    std::vector<u32> drawn(NumTriangles, 0);
+    for (const auto& group : groups) {
+      EXPECT(group.matrices.size() <= size,
+             "Palette: %u matrices for a palette of %u",
+             static_cast<u32>(group.matrices.size()), size);
+      auto sorted = group.matrices;
+      std::sort(sorted.begin(), sorted.end());
+      EXPECT(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end(),
+             "Palette: matrix loaded twice into one palette");
+      for (const u32 tri : group.triangles) {
+        EXPECT(tri < NumTriangles, "Palette: triangle %u out of range", tri);
+        ++drawn[tri];
+        for (const u16 m : tris[tri]) {
+          EXPECT(std::binary_search(sorted.begin(), sorted.end(), m),
+                 "Palette: triangle %u uses matrix %u, not in its palette", tri,
+                 m);
+        }
+      }
+    }
+    EXPECT(std::all_of(drawn.begin(), drawn.end(),
+                       [](u32 n) { return n == 1; }),
+           "Palette: triangles dropped or drawn twice");
+    printf("Palette: %u triangles over %u matrices in %u palettes of %u\n",
+           NumTriangles, NumMatrices, static_cast<u32>(groups.size()), size);
+  }
+  return true;
+}
+
+bool TestMatrixPaletteLookahead() {
+  // After {A, B}, both {A, C} and {A, D} need one matrix. {A, C} has more
+  // triangles, but D also completes {B, D}; taking C strands {C, E} and
+  // {D, F} in palettes of their own.
+  enum : u16 { A, B, C, D, E, F };
+  const std::pair<Triangle, u32> sets[] = {
+      {{A, B, B}, 20}, {{A, C, C}, 10}, {{B, D, D}, 6},
+      {{A, D, D}, 6},  {{C, E, E}, 1},  {{D, F, F}, 1},
+  };
+  std::vector<Triangle> tris;
+  for (const auto& [tri, count] : sets)
+    tris.insert(tris.end(), count, tri);
+
+  const auto groups = librii::mesh::PartitionMatrixPalettes(tris, 3);
+  EXPECT(groups.size() == 3, "Palette: %u palettes of 3, expected 3",
+         static_cast<u32>(groups.size()));
+  return true;
+}
+
+bool TestSimplify() {
+  const auto positions = TorusPositions(32, 24);
+  const auto indices = TorusIndices(32, 24);
+  const u32 numTriangles = static_cast<u32>(indices.size() / 3);
+
+  // Keeping every triangle changes nothing
+  {
+    auto mesh = MakeMesh(indices);
+    const auto before = GetTriangles(mesh);
+    librii::mesh::SimplifyMesh(mesh, positions, {.targetRatio = 1.0f});
+    EXPECT(GetTriangles(mesh) == before, "Simplify: ratio 1 changed the mesh");
+  }
+
+  for (const f32 ratio : {0.5f, 0.25f}) {
+    auto mesh = MakeMesh(indices);
+    const auto stats =
+        librii::mesh::SimplifyMesh(mesh, positions, {.targetRatio = ratio});
+    const u32 budget = static_cast<u32>(std::ceil(numTriangles * ratio));
+    const auto after = GetTriangles(mesh);
+    EXPECT(stats.trianglesBefore == numTriangles &&
+               stats.trianglesAfter == after.size(),
+           "Simplify: reported %u -> %u, drew %u -> %u", stats.trianglesBefore,
+           stats.trianglesAfter, numTriangles, static_cast<u32>(after.size()));
+    EXPECT(after.size() <= budget && !after.empty(),
+           "Simplify: %u triangles left for a budget of %u",
+           static_cast<u32>(after.size()), budget);
+    EXPECT(std::adjacent_find(after.begin(), after.end()) == after.end(),
+           "Simplify: duplicate triangles");
+    // Still a closed surface: every edge is shared by exactly one triangle
+    // winding each way
+    std::vector<std::pair<u16, u16>> edges;
+    for (const auto& t : after)
+      for (u32 i = 0; i < 3; ++i)
+        edges.emplace_back(t[i], t[(i + 1) % 3]);
+    std::sort(edges.begin(), edges.end());
+    for (const auto& [a, b] : edges) {
+      EXPECT(std::binary_search(edges.begin(), edges.end(),
+                                std::pair<u16, u16>{b, a}),
+             "Simplify: edge %u-%u left open", a, b);
+    }
+    printf("Simplify: %u -> %u triangles (budget %u)\n", numTriangles,
+           static_cast<u32>(after.size()), budget);
+  }
+  return true;
+}
+
+// Direct values decoded from a display list, handed back when encoding
+struct DirectValues : librii::gpu::IDirectVertexSource,
+                      librii::gpu::IDirectVertexSink {
+  glm::vec4 getDirect(gx::VertexAttribute attr, u16 index) const override {
+    return values[static_cast<u32>(attr)][index];
+  }
+  u16 addDirect(gx::VertexAttribute attr, const glm::vec4& value) override {
+    auto& list = values[static_cast<u32>(attr)];
+    list.push_back(value);
+    return static_cast<u16>(list.size() - 1);
+  }
+  std::array<std::vector<glm::vec4>, (u64)gx::VertexAttribute::Max> values;
+};
+
+bool TestDisplayListRoundtrip() {
+  using Generic = gx::VertexBufferType::Generic;
+  using Color = gx::VertexBufferType::Color;
+  constexpr Generic generics[] = {Generic::u8, Generic::s8, Generic::u16,
+                                  Generic::s16, Generic::f32};
+  constexpr Color colors[] = {Color::rgb565, Color::rgb8,  Color::rgbx8,
+                              Color::rgba4,  Color::rgba6, Color::rgba8};
+  constexpr u32 NumVertices = 64;
+  std::mt19937 rng(5678);
+
+  // Each round sends a different component type directly, between indexed
+  // attributes of both widths
+  for (u32 round = 0; round < std::size(colors); ++round) {
+    gx::VertexDescriptor vcd;
+    auto& attribs = vcd.mAttributes;
+    attribs[gx::VertexAttribute::PositionNormalMatrixIndex] =
+        gx::VertexAttributeType::Direct;
+    attribs[gx::VertexAttribute::Position] = gx::VertexAttributeType::Direct;
+    attribs[gx::VertexAttribute::Normal] = gx::VertexAttributeType::Short;
+    attribs[gx::VertexAttribute::Color0] = gx::VertexAttributeType::Direct;
+    attribs[gx::VertexAttribute::Color1] = gx::VertexAttributeType::Byte;
+    attribs[gx::VertexAttribute::TexCoord0] = gx::VertexAttributeType::Direct;
+    attribs[gx::VertexAttribute::TexCoord1] = gx::VertexAttributeType::Short;
+    vcd.calcVertexDescriptorFromAttributeList();
+
+    librii::gpu::VertexFormats formats{};
+    auto& pos = formats[(u64)gx::VertexAttribute::Position];
+    pos.comp = gx::VertexComponentCount(gx::VertexComponentCount::Position::xyz);
+    pos.type = gx::VertexBufferType(generics[round % std::size(generics)]);
+    pos.divisor = 3;
+    auto& clr = formats[(u64)gx::VertexAttribute::Color0];
+    clr.comp = gx::VertexComponentCount(gx::VertexComponentCount::Color::rgba);
+    clr.type = gx::VertexBufferType(colors[round]);
+    auto& uv = formats[(u64)gx::VertexAttribute::TexCoord0];
+    uv.comp = gx::VertexComponentCount(
+        gx::VertexComponentCount::TextureCoordinate::st);
+    uv.type = gx::VertexBufferType(generics[(round + 2) % std::size(generics)]);
+    uv.divisor = 5;
+
+    auto layoutOrErr = librii::gpu::CompileVertexLayout(vcd, &formats);
+    EXPECT(static_cast<bool>(layoutOrErr), "DisplayList: layout rejected");
+    const auto& layout = *layoutOrErr;
+    EXPECT(layout.uniformWidth == 0, "DisplayList: layout not mixed");
+
+    // Random vertices, with values every format can represent
+    std::vector<u8> data(NumVertices * layout.stride);
+    for (u32 v = 0; v < NumVertices; ++v) {
+      for (const auto& field : layout.getFields()) {
+        u8* p = &data[v * layout.stride + field.offset];
+        const auto attr = static_cast<gx::VertexAttribute>(field.attribute);
+        const auto& format = formats[field.attribute];
+        EXPECT(!field.direct ||
+                   field.width == librii::gpu::GetDirectValueSize(attr, format),
+               "DisplayList: field %u is %u bytes, expected %u",
+               field.attribute, field.width,
+               librii::gpu::GetDirectValueSize(attr, format));
+        for (u32 i = 0; i < field.width; ++i)
+          p[i] = static_cast<u8>(rng());
+        if (field.direct && attr != gx::VertexAttribute::Color0 &&
+            format.type.generic == Generic::f32) {
+          for (u32 i = 0; i < field.width; i += 4) {
+            const f32 f = static_cast<f32>(static_cast<s32>(rng() % 2000)) / 8;
+            const u32 bits = std::bit_cast<u32>(f);
+            for (u32 b = 0; b < 4; ++b)
+              p[i + b] = static_cast<u8>(bits >> (24 - 8 * b));
+          }
+        }
+        if (field.direct && attr == gx::VertexAttribute::Color0 &&
+            format.type.color == Color::rgbx8)
+          p[3] = 0;
+      }
+    }
+
+    gx::IndexedPrimitive prim(gx::PrimitiveType::Triangles, NumVertices);
+    std::array<u16, (u64)gx::VertexAttribute::Max> maxima{};
+    DirectValues direct;
+    librii::gpu::DecodeVertices(layout, data.data(), prim.mVertices, maxima);
+    librii::gpu::DecodeDirectVertices(layout, data.data(), prim.mVertices,
+                                      direct, maxima);
+    EXPECT(prim.mVertices.getMask() == vcd.mBitfield,
+           "DisplayList: decoded mask differs from the descriptor");
+
+    std::vector<u8> encoded(
+        librii::gpu::GetMeshDisplayListSize(layout, {&prim, 1}));
+    const u32 written = librii::gpu::EncodeMeshDisplayList(
+        encoded.data(), layout, {&prim, 1}, &direct);
+    EXPECT(written == encoded.size() && written == 3 + data.size(),
+           "DisplayList: wrote %u bytes, expected %u", written,
+           static_cast<u32>(3 + data.size()));
+    for (std::size_t i = 0; i < data.size(); ++i) {
+      EXPECT(encoded[3 + i] == data[i],
+             "DisplayList: round %u: byte %u of vertex %u changed: %02x -> "
+             "%02x",
+             round, static_cast<u32>(i % layout.stride),
+             static_cast<u32>(i / layout.stride), data[i], encoded[3 + i]);
+    }
+  }
+  printf("DisplayList: direct/indexed roundtrip of every component type\n");
+  return true;
+}
+
+#undef EXPECT
+
+} // namespace
+
+bool RunMeshTests() {
+  bool ok = true;
+  ok &= TestVertexList();
+  ok &= TestStripify();
+  ok &= TestMatrixPalette();
+  ok &= TestMatrixPaletteLookahead();
+  ok &= TestSimplify();
+  ok &= TestDisplayListRoundtrip();
+  return ok;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Checks of the librii::mesh passes on generated meshes. Prints each failure;
+// returns whether all passed.
+bool RunMeshTests();
@@ -0,0 +1,157 @@
+#include "SceneTests.hpp"
+
+#include <algorithm>
+#include <core/3d/i3dmodel.hpp>
+#include <core/3d/renderer/SceneState.hpp>
+#include <core/kpi/Node2.hpp>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+#include <librii/gfx/Commands.hpp>
+#include <plugins/gc/Export/IndexedPolygon.hpp>
+#include <plugins/gc/Export/Scene.hpp>
+#include <vector>
+
+namespace lib3d = riistudio::lib3d;
+namespace gx = librii::gx;
+
+namespace {
+
+// Where a draw node's vertices end up: each is placed by the draw matrix its
+// matrix index selects
+struct DrawTruth {
+  std::string name;
+  u32 mprim = 0;
+  bool translucent = false;
+  lib3d::AABB bound{glm::vec3{1e30f}, glm::vec3{-1e30f}};
+  bool empty = true;
+};
+
+DrawTruth SkinnedBound(const libcube::Model& mdl,
+                       const libcube::IndexedPolygon& poly, u32 mp_id) {
+  DrawTruth truth;
+  const auto mtx = poly.getPosMtx(mdl, mp_id);
+  const auto& vcd = poly.getVcd();
+  const bool indexed = vcd[gx::VertexAttribute::PositionNormalMatrixIndex];
+  const auto& mp = poly.getMeshData().mMatrixPrimitives[mp_id];
+  for (const auto& prim : mp.mPrimitives) {
+    for (const auto& v : prim.mVertices) {
+      const u32 slot =
+          indexed ? v[gx::VertexAttribute::PositionNormalMatrixIndex] / 3 : 0;
+      const glm::mat4 m = slot < mtx.size() ? mtx[slot] : glm::mat4{1.0f};
+      const glm::vec3 pos = glm::vec3{
+          m * glm::vec4{poly.getPos(mdl, v[gx::VertexAttribute::Position]),
+                        1.0f}};
+      truth.bound.expandBound({pos, pos});
+      truth.empty = false;
+    }
+  }
+  return truth;
+}
+
+// In the order SceneImpl::gather pushes the draw nodes
+void GatherTruth(const libcube::Model& mdl, u64 bone_id,
+                 std::vector<DrawTruth>& opaque,
+                 std::vector<DrawTruth>& translucent) {
+  const auto bones = mdl.getBones();
+  const auto polys = mdl.getMeshes();
+  const auto mats = mdl.getMaterials();
+  const auto& bone = bones[bone_id];
+  for (u64 i = 0; i < bone.getNumDisplays(); ++i) {
+    const auto display = bone.getDisplay(i);
+    const auto& mat = mats[display.matId];
+    const auto& poly = reinterpret_cast<const libcube::IndexedPolygon&>(
+        polys[display.polyId]);
+    for (u32 mp = 0; mp < poly.getMeshData().mMatrixPrimitives.size(); ++mp) {
+      if (!poly.isVisible())
+        continue;
+      auto truth = SkinnedBound(mdl, poly, mp);
+      truth.name = poly.getName();
+      truth.mprim = mp;
+      truth.translucent = mat.isXluPass();
+      (truth.translucent ? translucent : opaque).push_back(std::move(truth));
+    }
+  }
+  for (u64 i = 0; i < bone.getNumChildren(); ++i)
+    GatherTruth(mdl, bone.getChild(i), opaque, translucent);
+}
+
+#define EXPECT(COND, ...)                                                      \
+  if (!(COND)) {                                                               \
+    printf("Error: " __VA_ARGS__);                                             \
+    printf("\n");                                                              \
+    return false;                                                              \
+  }
+
+// Look at each draw from close by, so that little else is in view: the node
+// must not be culled. Skinned meshes are placed by several draw matrices, not
+// only by the bone that draws them.
+bool TestNoVisibleNodeCulled(kpi::INode& root) {
+  auto* drawable = dynamic_cast<lib3d::IDrawable*>(&root);
+  const auto* scene = dynamic_cast<const lib3d::Scene*>(&root);
+  EXPECT(drawable != nullptr && scene != nullptr,
+         "Scene: the file is not a drawable scene");
+
+  std::vector<DrawTruth> opaque, translucent;
+  for (const auto& model : scene->getModels()) {
+    const auto* gc_model = dynamic_cast<const libcube::Model*>(&model);
+    if (gc_model == nullptr || model.getMaterials().empty() ||
+        model.getMeshes().empty() || model.getBones().empty())
+      continue;
+    GatherTruth(*gc_model, 0, opaque, translucent);
+  }
+
+  lib3d::SceneState state;
+  state.setHeadless(true);
+  drawable->prepare(state, root);
+
+  // Nodes are in gather order until the first draw sorts them
+  std::vector<std::pair<const lib3d::SceneNode*, const DrawTruth*>> draws;
+  const auto pair = [&](lib3d::DrawBuffer& buffer,
+                        const std::vector<DrawTruth>& truths) {
+    if (buffer.nodes.size() != truths.size())
+      return false;
+    for (std::size_t i = 0; i < truths.size(); ++i)
+      draws.emplace_back(buffer.nodes[i].get(), &truths[i]);
+    return true;
+  };
+  EXPECT(pair(state.getBuffers().opaque, opaque) &&
+             pair(state.getBuffers().translucent, translucent),
+         "Scene: prepared %zu+%zu draw nodes, expected %zu+%zu",
+         state.getBuffers().opaque.nodes.size(),
+         state.getBuffers().translucent.nodes.size(), opaque.size(),
+         translucent.size());
+
+  librii::gfx::NullCommandExecutor executor;
+  u32 checked = 0;
+  for (const auto& [node, truth] : draws) {
+    if (truth->empty)
+      continue;
+    const glm::vec3 center = (truth->bound.min + truth->bound.max) * 0.5f;
+    const f32 radius = std::max(
+        glm::length(truth->bound.max - truth->bound.min) * 0.5f, 1.0f);
+    // The bounding sphere spans 2 * asin(1 / 3) < 60 degrees from here
+    const glm::vec3 eye = center + glm::vec3{0.0f, 0.0f, 3.0f * radius};
+    const glm::mat4 view = glm::lookAt(eye, center, {0.0f, 1.0f, 0.0f});
+    const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 1.0f,
+                                            radius * 0.1f, radius * 10.0f);
+
+    drawable->update(state, root);
+    state.buildUniformBuffers(proj, view);
+    state.draw(executor);
+    EXPECT(!node->culled, "Scene: %s (matrix primitive %u) was culled in view",
+           truth->name.c_str(), truth->mprim);
+    ++checked;
+  }
+  printf("Scene: none of %u draws culled in view\n", checked);
+  return true;
+}
+
+#undef EXPECT
+
+} // namespace
+
+bool RunSceneTests(kpi::INode& root) {
+  bool ok = true;
+  ok &= TestNoVisibleNodeCulled(root);
+  return ok;
+}
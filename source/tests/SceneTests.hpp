@@ -0,0 +1,9 @@
+#pragma once
+
+namespace kpi {
+struct INode;
+}
+
+// Checks of the draw list prepared from a model, headless. Prints each
+// failure; returns whether all passed.
+bool RunSceneTests(kpi::INode& root);
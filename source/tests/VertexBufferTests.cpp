@@ -0,0 +1,183 @@
+#include "VertexBufferTests.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <librii/glhelper/VBOBuilder.hpp>
+#include <vector>
+
+using librii::glhelper::VBOBuilder;
+using librii::glhelper::VertexFormat;
+
+namespace {
+
+#define EXPECT(COND, ...)                                                      \
+  if (!(COND)) {                                                               \
+    printf("Error: " __VA_ARGS__);                                             \
+    printf("\n");                                                              \
+    return false;                                                              \
+  }
+
+// Positions only: one float per vertex, its value the vertex's identity
+void DeclarePositions(VBOBuilder& vbo) {
+  vbo.declareAttribute(0, "position", 1, VertexFormat::F32);
+}
+
+VBOBuilder::Range WriteRange(VBOBuilder& vbo, const std::vector<f32>& values) {
+  vbo.beginRange();
+  for (const f32 v : values) {
+    vbo.setAttribute(0, glm::vec4{v});
+    vbo.pushVertex();
+  }
+  return vbo.endRange();
+}
+
+f32 ValueAt(const VBOBuilder& vbo, u32 vertex) {
+  f32 v;
+  memcpy(&v, vbo.mData.data() + vertex * vbo.getLayout().stride, 4);
+  return v;
+}
+
+// Vertex `i` of the range's indices has the value `values[i]`
+bool RangeReads(const VBOBuilder& vbo, const VBOBuilder::Range& range,
+                const std::vector<f32>& values) {
+  if (range.idx_size != values.size())
+    return false;
+  for (u32 i = 0; i < range.idx_size; ++i) {
+    const u32 vertex = vbo.mIndices[range.idx_ofs + i];
+    if (vertex < range.vtx_ofs || vertex >= range.vtx_ofs + range.vtx_size ||
+        ValueAt(vbo, vertex) != values[i])
+      return false;
+  }
+  return true;
+}
+
+bool TestDedup() {
+  VBOBuilder vbo(true);
+  DeclarePositions(vbo);
+  const auto a = WriteRange(vbo, {1.0f, 2.0f, 1.0f, 1.0f, 3.0f});
+  EXPECT(a.vtx_size == 3 && a.idx_size == 5,
+         "VBO: a range of 5 indices to 3 values stored %u vertices",
+         a.vtx_size);
+  EXPECT(RangeReads(vbo, a, {1.0f, 2.0f, 1.0f, 1.0f, 3.0f}),
+         "VBO: merged vertices are not referenced by index");
+
+  // The same values again in a new range are stored again
+  const auto b = WriteRange(vbo, {1.0f, 2.0f});
+  EXPECT(b.vtx_ofs == 3 && b.vtx_size == 2,
+         "VBO: a second range shares vertices with the first");
+  EXPECT(RangeReads(vbo, b, {1.0f, 2.0f}),
+         "VBO: the second range references vertices outside it");
+  EXPECT(vbo.getNumMerged() == 2, "VBO: merged %u vertices, expected 2",
+         vbo.getNumMerged());
+  return true;
+}
+
+bool TestPacking() {
+  VBOBuilder vbo(true);
+  vbo.declareAttribute(0, "half", 4, VertexFormat::F16);
+  vbo.declareAttribute(1, "snorm", 4, VertexFormat::SNorm16);
+  vbo.declareAttribute(2, "unorm", 4, VertexFormat::UNorm8);
+  vbo.beginRange();
+  vbo.setAttribute(0, {1.0f, -2.0f, 65504.0f, 0.5f});
+  vbo.setAttribute(1, {1.0f, -1.0f, 2.0f, 0.5f});
+  vbo.setAttribute(2, {1.0f, 0.0f, -1.0f, 0.5f});
+  vbo.pushVertex();
+  vbo.endRange();
+
+  const auto& layout = vbo.getLayout();
+  EXPECT(layout.stride == 8 + 8 + 4, "VBO: packed stride is %u, expected 20",
+         layout.stride);
+  const u8* v = vbo.mData.data();
+
+  u16 half[4];
+  memcpy(half, v + layout.find(0)->offset, sizeof(half));
+  // 1, -2, the largest half and 0.5
+  EXPECT(half[0] == 0x3C00 && half[1] == 0xC000 && half[2] == 0x7BFF &&
+             half[3] == 0x3800,
+         "VBO: F16 packed %04x %04x %04x %04x", half[0], half[1], half[2],
+         half[3]);
+
+  s16 snorm[4];
+  memcpy(snorm, v + layout.find(1)->offset, sizeof(snorm));
+  // Both ends are exact; out of range clamps
+  EXPECT(snorm[0] == 32767 && snorm[1] == -32767 && snorm[2] == 32767 &&
+             snorm[3] == 16384,
+         "VBO: SNorm16 packed %d %d %d %d", snorm[0], snorm[1], snorm[2],
+         snorm[3]);
+
+  const u8* unorm = v + layout.find(2)->offset;
+  EXPECT(unorm[0] == 255 && unorm[1] == 0 && unorm[2] == 0 && unorm[3] == 128,
+         "VBO: UNorm8 packed %u %u %u %u", unorm[0], unorm[1], unorm[2],
+         unorm[3]);
+  return true;
+}
+
+bool TestReplaceInPlace() {
+  VBOBuilder vbo(true);
+  DeclarePositions(vbo);
+  auto a = WriteRange(vbo, {1.0f, 2.0f, 3.0f, 4.0f});
+  auto b = WriteRange(vbo, {5.0f, 6.0f, 7.0f});
+  vbo.build();
+
+  // Shorter: moved into the place of `a`, indices now relative to it
+  const auto written = WriteRange(vbo, {8.0f, 9.0f, 8.0f});
+  vbo.replaceRange(a, written);
+  EXPECT(a.vtx_ofs == 0 && a.vtx_size == 2 && a.vtx_capacity == 4 &&
+             a.idx_size == 3,
+         "VBO: in-place replacement took %u vertices at %u", a.vtx_size,
+         a.vtx_ofs);
+  EXPECT(RangeReads(vbo, a, {8.0f, 9.0f, 8.0f}),
+         "VBO: in-place replacement references the vertices it was written "
+         "at");
+  EXPECT(RangeReads(vbo, b, {5.0f, 6.0f, 7.0f}),
+         "VBO: in-place replacement changed another range");
+  EXPECT(vbo.getNumVertices() == 7 && vbo.mIndices.size() == 7,
+         "VBO: the replacement was not dropped from the end");
+  EXPECT(vbo.getWastedBytes() == 0, "VBO: in-place replacement wasted %zu",
+         vbo.getWastedBytes());
+  return true;
+}
+
+bool TestFragmentation() {
+  VBOBuilder vbo(true);
+  DeclarePositions(vbo);
+  auto a = WriteRange(vbo, {1.0f, 2.0f});
+  WriteRange(vbo, {3.0f, 4.0f});
+  vbo.build();
+
+  // Longer: moved to the end, leaving its place
+  auto written = WriteRange(vbo, {5.0f, 6.0f, 7.0f});
+  vbo.replaceRange(a, written);
+  const u32 stride = vbo.getLayout().stride;
+  EXPECT(a.vtx_ofs == 4 && RangeReads(vbo, a, {5.0f, 6.0f, 7.0f}),
+         "VBO: a grown range was not moved to the end");
+  EXPECT(vbo.getWastedBytes() == 2 * stride + 2 * 4,
+         "VBO: a grown range wasted %zu bytes", vbo.getWastedBytes());
+  EXPECT(!vbo.isFragmented(), "VBO: fragmented with 2 of 7 vertices unused");
+
+  // Growing twice more leaves 9 of 16 vertices unused
+  written = WriteRange(vbo, {8.0f, 9.0f, 10.0f, 11.0f});
+  vbo.replaceRange(a, written);
+  written = WriteRange(vbo, {12.0f, 13.0f, 14.0f, 15.0f, 16.0f});
+  vbo.replaceRange(a, written);
+  EXPECT(vbo.isFragmented(), "VBO: not fragmented with %zu of %zu bytes "
+                             "unused",
+         vbo.getWastedBytes(), vbo.mData.size() + vbo.mIndices.size() * 4);
+
+  vbo.clear();
+  EXPECT(vbo.getWastedBytes() == 0, "VBO: clearing kept the unused bytes");
+  return true;
+}
+
+#undef EXPECT
+
+} // namespace
+
+bool RunVertexBufferTests() {
+  bool ok = true;
+  ok &= TestDedup();
+  ok &= TestPacking();
+  ok &= TestReplaceInPlace();
+  ok &= TestFragmentation();
+  return ok;
+}
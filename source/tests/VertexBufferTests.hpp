@@ -0,0 +1,5 @@
+#pragma once
+
+// Checks of librii::glhelper::VBOBuilder, headless. Prints each failure;
+// returns whether all passed.
+bool RunVertexBufferTests();
@@ -0,0 +1,11 @@
+#pragma once
+
+// Stands in for the real <core/3d/gl.hpp> in glcalltests: declares the GL API,
+// which GlCalls.cpp defines to count calls rather than draw.
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#ifndef GLCOREARB_PROTOTYPES
+#define GLCOREARB_PROTOTYPES
+#endif
+#include <GL/glcorearb.h>
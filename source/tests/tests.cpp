@@ -1,9 +1,14 @@
+#include "ImageTests.hpp"
+#include "MeshTests.hpp"
+#include "SceneTests.hpp"
+#include "VertexBufferTests.hpp"
 #include <core/api.hpp>
 #include <fstream>
 #include <oishii/reader/binary_reader.hxx>
 #include <oishii/writer/binary_writer.hxx>
 #include <plate/Platform.hpp>
 #include <string>
+#include <string_view>
 #include <vendor/llvm/Support/InitLLVM.h>
 
 void save(const std::string_view path, kpi::INode& root) {
@@ -82,12 +87,27 @@ int main(int argc, const char** argv) {
   InitAPI();
 
   ANNOUNCE("Performing tasks");
-  if (argc < 3) {
-    fprintf(stderr, "Error: Too few arguments:\ntests.exe <from> <to>\n");
+  int result = 0;
+  if (argc == 2 && std::string_view(argv[1]) == "--mesh") {
+    result = RunMeshTests() ? 0 : 1;
+  } else if (argc == 2 && std::string_view(argv[1]) == "--image") {
+    result = RunImageTests() ? 0 : 1;
+  } else if (argc == 2 && std::string_view(argv[1]) == "--vbo") {
+    result = RunVertexBufferTests() ? 0 : 1;
+  } else if (argc == 3 && std::string_view(argv[1]) == "--scene") {
+    auto data = open(argv[2]);
+    result = data && RunSceneTests(*data) ? 0 : 1;
+  } else if (argc < 3) {
+    fprintf(stderr, "Error: Too few arguments:\ntests.exe <from> <to>\n"
+                    "       tests.exe --mesh\n"
+                    "       tests.exe --image\n"
+                    "       tests.exe --vbo\n"
+                    "       tests.exe --scene <model>\n");
   } else {
     rebuild(argv[1], argv[2]);
   }
 
   ANNOUNCE("Done!");
   DeinitAPI();
+  return result;
 }
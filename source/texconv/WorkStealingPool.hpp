@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace texconv {
+
+//! Fixed-size thread pool where each worker owns a deque of tasks.
+//!
+//! Workers pop from the back of their own deque and, when it runs dry, steal
+//! from the front of the others. Tasks are distributed round-robin on submit,
+//! so uneven task costs (a 1024x1024 CMPR encode next to a 32x32 I4 one) are
+//! rebalanced by stealing rather than by a single contended queue.
+//!
+class WorkStealingPool {
+public:
+  using Task = std::function<void(unsigned worker)>;
+
+  explicit WorkStealingPool(unsigned numWorkers) {
+    if (numWorkers == 0)
+      numWorkers = 1;
+    mQueues.resize(numWorkers);
+    for (auto& q : mQueues)
+      q = std::make_unique<Queue>();
+    for (unsigned i = 0; i < numWorkers; ++i)
+      mThreads.emplace_back([this, i] { run(i); });
+  }
+  ~WorkStealingPool() {
+    wait();
+    {
+      std::scoped_lock g(mSleepMutex);
+      mStop = true;
+    }
+    mWake.notify_all();
+    for (auto& t : mThreads)
+      t.join();
+  }
+
+  unsigned size() const { return static_cast<unsigned>(mQueues.size()); }
+
+  void submit(Task task) {
+    const unsigned target = mNext++ % size();
+    ++mPending;
+    {
+      std::scoped_lock g(mQueues[target]->mutex);
+      mQueues[target]->tasks.push_back(std::move(task));
+    }
+    mWake.notify_one();
+  }
+
+  //! Block until every submitted task has completed.
+  void wait() {
+    std::unique_lock g(mSleepMutex);
+    mIdle.wait(g, [&] { return mPending == 0; });
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool popLocal(unsigned self, Task& out) {
+    auto& q = *mQueues[self];
+    std::scoped_lock g(q.mutex);
+    if (q.tasks.empty())
+      return false;
+    out = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+  }
+  bool steal(unsigned self, Task& out) {
+    for (unsigned i = 1; i < size(); ++i) {
+      auto& q = *mQueues[(self + i) % size()];
+      std::scoped_lock g(q.mutex);
+      if (q.tasks.empty())
+        continue;
+      out = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+  void run(unsigned self) {
+    while (true) {
+      Task task;
+      if (popLocal(self, task) || steal(self, task)) {
+        task(self);
+        if (--mPending == 0) {
+          std::scoped_lock g(mSleepMutex);
+          mIdle.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock g(mSleepMutex);
+      if (mStop)
+        return;
+      // Re-checked on wake; a spurious wake-up costs one failed steal pass.
+      mWake.wait_for(g, std::chrono::milliseconds(10));
+      if (mStop)
+        return;
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> mQueues;
+  std::vector<std::thread> mThreads;
+  std::atomic<unsigned> mNext = 0;
+  std::atomic<unsigned> mPending = 0;
+
+  std::mutex mSleepMutex;
+  std::condition_variable mWake;
+  std::condition_variable mIdle;
+  bool mStop = false;
+};
+
+} // namespace texconv
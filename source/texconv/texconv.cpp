@@ -0,0 +1,436 @@
+// Headless batch texture converter.
+//
+// Converts a directory of PNG/BTI/TEX0 images to BTI files of any GX format,
+// regenerating mipmaps. Never touches GL or ImGui, so it may run on build
+// machines.
+
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <core/common.h>
+#include <librii/image/ImagePlatform.hpp>
+#include <vendor/stb_image.h>
+
+#ifdef _WIN32
+#include <windows.h>
+// Must follow windows.h
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace texconv {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+using librii::gx::TextureFormat;
+
+struct Options {
+  fs::path input;
+  fs::path output;
+  TextureFormat format = TextureFormat::CMPR;
+  u32 maxMip = 3;
+  u32 minDim = 32;
+  unsigned jobs = std::thread::hardware_concurrency();
+};
+
+struct FormatName {
+  const char* name;
+  TextureFormat format;
+};
+constexpr FormatName FormatNames[] = {
+    {"I4", TextureFormat::I4},         {"I8", TextureFormat::I8},
+    {"IA4", TextureFormat::IA4},       {"IA8", TextureFormat::IA8},
+    {"RGB565", TextureFormat::RGB565}, {"RGB5A3", TextureFormat::RGB5A3},
+    {"RGBA8", TextureFormat::RGBA8},   {"CMPR", TextureFormat::CMPR},
+};
+
+static std::optional<TextureFormat> parseFormat(std::string_view name) {
+  for (const auto& it : FormatNames)
+    if (name == it.name)
+      return it.format;
+  return std::nullopt;
+}
+
+static std::optional<u32> parseNumber(std::string_view text) {
+  u32 value = 0;
+  const auto* end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc{} || ptr != end)
+    return std::nullopt;
+  return value;
+}
+
+static std::size_t getPeakMemory() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+  return 0;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static std::vector<u8> readFile(const fs::path& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file)
+    return {};
+  std::vector<u8> data(file.tellg());
+  file.seekg(0, std::ios::beg);
+  if (!file.read(reinterpret_cast<char*>(data.data()), data.size()))
+    return {};
+  return data;
+}
+
+// A decoded base level
+struct SourceImage {
+  u32 width = 0;
+  u32 height = 0;
+  std::vector<u8> rgba;
+};
+
+static bool isPaletted(u32 format) {
+  return format == static_cast<u32>(TextureFormat::C4) ||
+         format == static_cast<u32>(TextureFormat::C8) ||
+         format == static_cast<u32>(TextureFormat::C14X2);
+}
+
+// A palette, as stored in the file, with room for every index of the format.
+struct Palette {
+  std::vector<u8> data;
+  librii::gx::PaletteFormat format = librii::gx::PaletteFormat::IA8;
+};
+
+// Shared by BTI and TEX0: decode the base level of an encoded image.
+static std::optional<SourceImage>
+decodeEncoded(std::span<const u8> file, u32 format, u32 width, u32 height,
+              u32 dataOfs, const Palette* palette = nullptr) {
+  if (isPaletted(format) && palette == nullptr)
+    return std::nullopt;
+  const u32 size = librii::gx::computeImageSize(width, height, format, 1);
+  if (width == 0 || height == 0 || dataOfs + size > file.size())
+    return std::nullopt;
+  SourceImage img{width, height, std::vector<u8>(width * height * 4)};
+  librii::image::decode(img.rgba.data(), file.data() + dataOfs, width, height,
+                        static_cast<TextureFormat>(format),
+                        palette ? palette->data.data() : nullptr,
+                        palette ? palette->format
+                                : librii::gx::PaletteFormat::IA8);
+  return img;
+}
+
+static u32 readBE(std::span<const u8> in, u32 ofs, u32 size) {
+  u32 value = 0;
+  for (u32 i = 0; i < size; ++i)
+    value = (value << 8) | in[ofs + i];
+  return value;
+}
+
+static std::optional<SourceImage> readTEX0(std::span<const u8> file) {
+  constexpr u32 TEX0Magic = 0x54455830; // "TEX0"
+  if (file.size() < 64 || readBE(file, 0, 4) != TEX0Magic)
+    return std::nullopt;
+  const u32 ofsTex = readBE(file, 0x10, 4);
+  const u32 width = readBE(file, 0x1C, 2);
+  const u32 height = readBE(file, 0x1E, 2);
+  const u32 format = readBE(file, 0x20, 4);
+  // The palette lives in a separate PLT0 we are not given
+  return decodeEncoded(file, format, width, height, ofsTex);
+}
+
+static std::optional<SourceImage> readBTI(std::span<const u8> file) {
+  if (file.size() < 32)
+    return std::nullopt;
+  const u32 format = readBE(file, 0x00, 1);
+  const u32 width = readBE(file, 0x02, 2);
+  const u32 height = readBE(file, 0x04, 2);
+  const u32 ofsTex = readBE(file, 0x1C, 4);
+  if (!isPaletted(format))
+    return decodeEncoded(file, format, width, height, ofsTex);
+
+  const u32 indexBits = format == static_cast<u32>(TextureFormat::C4)   ? 4
+                        : format == static_cast<u32>(TextureFormat::C8) ? 8
+                                                                        : 14;
+  const u32 numEntries = readBE(file, 0x0A, 2);
+  const u32 ofsPalette = readBE(file, 0x0C, 4);
+  if (readBE(file, 0x08, 1) == 0 || ofsPalette + numEntries * 2 > file.size())
+    return std::nullopt;
+  // Indices past the stored entries read black rather than out of bounds
+  Palette palette{
+      .data = std::vector<u8>((1u << indexBits) * 2),
+      .format = static_cast<librii::gx::PaletteFormat>(readBE(file, 0x09, 1))};
+  std::copy_n(file.begin() + ofsPalette,
+              std::min<std::size_t>(numEntries * 2, palette.data.size()),
+              palette.data.begin());
+  return decodeEncoded(file, format, width, height, ofsTex, &palette);
+}
+
+static std::optional<SourceImage> readImage(const fs::path& path) {
+  const auto file = readFile(path);
+  if (file.empty())
+    return std::nullopt;
+
+  const auto ext = path.extension().string();
+  if (ext == ".tex0" || ext == ".TEX0")
+    return readTEX0(file);
+  if (ext == ".bti" || ext == ".BTI")
+    return readBTI(file);
+
+  int width, height, channels;
+  u8* image = stbi_load_from_memory(file.data(), file.size(), &width, &height,
+                                    &channels, STBI_rgb_alpha);
+  if (image == nullptr)
+    return std::nullopt;
+  SourceImage img{static_cast<u32>(width), static_cast<u32>(height),
+                  std::vector<u8>(image, image + width * height * 4)};
+  stbi_image_free(image);
+  return img;
+}
+
+static void writeBE(std::vector<u8>& out, u32 ofs, u32 value, u32 size) {
+  for (u32 i = 0; i < size; ++i)
+    out[ofs + i] = static_cast<u8>(value >> (8 * (size - 1 - i)));
+}
+
+// Write a standalone BTI: 0x20 byte header, then the image.
+static bool writeBTI(const fs::path& path, const Options& opt, u32 width,
+                     u32 height, u32 numMip, std::span<const u8> encoded) {
+  std::vector<u8> header(0x20);
+  writeBE(header, 0x00, static_cast<u32>(opt.format), 1);
+  writeBE(header, 0x02, width, 2);
+  writeBE(header, 0x04, height, 2);
+  writeBE(header, 0x06, 1, 1); // Wrap S: Repeat
+  writeBE(header, 0x07, 1, 1); // Wrap T: Repeat
+  writeBE(header, 0x10, numMip > 0, 1);
+  writeBE(header, 0x14, numMip > 0 ? 5 : 1, 1); // Min filter
+  writeBE(header, 0x15, 1, 1);                  // Mag filter
+  writeBE(header, 0x17, numMip * 8, 1);         // Max LOD
+  writeBE(header, 0x18, numMip + 1, 1);
+  writeBE(header, 0x1C, 0x20, 4);
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+  return static_cast<bool>(file);
+}
+
+struct FileResult {
+  fs::path path;
+  bool ok = false;
+  double seconds = 0.0;
+  std::size_t srcPixels = 0;
+  std::size_t outBytes = 0;
+};
+
+// Copy an image onto whole blocks, repeating the last row and column.
+static std::vector<u8> padToBlocks(const SourceImage& src, u32 paddedWidth,
+                                   u32 paddedHeight) {
+  std::vector<u8> padded(paddedWidth * paddedHeight * 4);
+  for (u32 y = 0; y < paddedHeight; ++y) {
+    const u32 row = std::min(y, src.height - 1) * src.width;
+    for (u32 x = 0; x < paddedWidth; ++x) {
+      const u32 from = row + std::min(x, src.width - 1);
+      std::copy_n(&src.rgba[from * 4], 4, &padded[(y * paddedWidth + x) * 4]);
+    }
+  }
+  return padded;
+}
+
+static FileResult convert(const fs::path& path, const Options& opt) {
+  FileResult result{.path = path};
+  const auto start = Clock::now();
+
+  auto src = readImage(path);
+  if (!src.has_value()) {
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+  }
+  const u32 width = src->width;
+  const u32 height = src->height;
+  result.srcPixels = width * height;
+
+  // Encoders work on whole blocks. The header keeps the real size.
+  const auto [paddedWidth, paddedHeight] =
+      librii::image::getBlockedDimensions(width, height, opt.format);
+  const bool padded = paddedWidth != width || paddedHeight != height;
+
+  // A padded image is no power of two, or smaller than a block: no mipmaps
+  const auto power_of_2 = [](u32 x) { return (x & (x - 1)) == 0; };
+  u32 numMip = 0;
+  if (!padded && power_of_2(width) && power_of_2(height)) {
+    while ((numMip + 1) <= opt.maxMip && (width >> (numMip + 1)) >= opt.minDim &&
+           (height >> (numMip + 1)) >= opt.minDim)
+      ++numMip;
+  }
+
+  std::vector<u8> encoded(
+      librii::image::getEncodedSize(width, height, opt.format, numMip));
+  if (numMip == 0) {
+    // A lone base level needs no resampling: encode it directly
+    const auto blocks = padded ? padToBlocks(*src, paddedWidth, paddedHeight)
+                               : std::move(src->rgba);
+    src.reset();
+    librii::image::encode(encoded.data(), blocks.data(), paddedWidth,
+                          paddedHeight, opt.format);
+  } else {
+    // Build the RGBA mip chain, then encode it in one transform.
+    std::vector<u8> chain(librii::image::getEncodedSize(
+        width, height, TextureFormat::Extension_RawRGBA32, numMip));
+    u32 slide = 0;
+    for (u32 i = 0; i <= numMip; ++i) {
+      librii::image::resize(chain.data() + slide, width >> i, height >> i,
+                            src->rgba.data(), width, height,
+                            librii::image::Lanczos);
+      slide += (width >> i) * (height >> i) * 4;
+    }
+    src.reset();
+
+    // One arena per worker; intermediates are reused from file to file.
+    static thread_local librii::image::ScratchArena sScratch;
+    librii::image::transform(encoded.data(), width, height,
+                             TextureFormat::Extension_RawRGBA32, opt.format,
+                             chain.data(), width, height, numMip,
+                             librii::image::AVIR, sScratch);
+  }
+
+  auto outPath = opt.output / path.filename();
+  outPath.replace_extension(".bti");
+  result.ok = writeBTI(outPath, opt, width, height, numMip, encoded);
+  result.outBytes = encoded.size() + 0x20;
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+static int run(const Options& opt) {
+  std::vector<fs::path> inputs;
+  for (const auto& entry : fs::directory_iterator(opt.input)) {
+    if (!entry.is_regular_file())
+      continue;
+    const auto ext = entry.path().extension().string();
+    if (ext == ".png" || ext == ".PNG" || ext == ".bti" || ext == ".BTI" ||
+        ext == ".tex0" || ext == ".TEX0")
+      inputs.push_back(entry.path());
+  }
+  fs::create_directories(opt.output);
+
+  printf("Converting %u files with %u workers\n",
+         static_cast<unsigned>(inputs.size()), opt.jobs);
+
+  std::mutex printMutex;
+  std::size_t totalPixels = 0;
+  std::size_t totalBytes = 0;
+  unsigned numFailed = 0;
+
+  const auto start = Clock::now();
+  {
+    WorkStealingPool pool(opt.jobs);
+    for (const auto& path : inputs) {
+      pool.submit([&, path](unsigned worker) {
+        const auto r = convert(path, opt);
+        std::scoped_lock g(printMutex);
+        if (!r.ok) {
+          ++numFailed;
+          printf("[%2u] FAIL %s (%.3f ms)\n", worker,
+                 r.path.filename().string().c_str(), r.seconds * 1000.0);
+          return;
+        }
+        totalPixels += r.srcPixels;
+        totalBytes += r.outBytes;
+        printf("[%2u] %s: %.3f ms, %.2f MPix/s\n", worker,
+               r.path.filename().string().c_str(), r.seconds * 1000.0,
+               r.seconds > 0.0 ? r.srcPixels / r.seconds / 1.0e6 : 0.0);
+      });
+    }
+    pool.wait();
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  printf("------\n");
+  printf("Files:      %u converted, %u failed\n",
+         static_cast<unsigned>(inputs.size()) - numFailed, numFailed);
+  printf("Time:       %.3f s\n", seconds);
+  printf("Throughput: %.2f files/s, %.2f MPix/s, %.2f MiB/s written\n",
+         seconds > 0.0 ? inputs.size() / seconds : 0.0,
+         seconds > 0.0 ? totalPixels / seconds / 1.0e6 : 0.0,
+         seconds > 0.0 ? totalBytes / seconds / (1024.0 * 1024.0) : 0.0);
+  printf("Peak RSS:   %.2f MiB\n", getPeakMemory() / (1024.0 * 1024.0));
+  return numFailed == 0 ? 0 : 1;
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: texconv <input_dir> <output_dir> [--format FMT] "
+                  "[--mip N] [--min-dim N] [--jobs N]\n");
+  fprintf(stderr, "  FMT: I4 I8 IA4 IA8 RGB565 RGB5A3 RGBA8 CMPR\n");
+}
+
+} // namespace texconv
+
+int main(int argc, const char** argv) {
+  using namespace texconv;
+
+  if (argc < 3) {
+    usage();
+    return 1;
+  }
+  Options opt;
+  opt.input = argv[1];
+  opt.output = argv[2];
+  for (int i = 3; i < argc; i += 2) {
+    const std::string_view arg = argv[i];
+    if (i + 1 == argc) {
+      usage();
+      return 1;
+    }
+    if (arg == "--format") {
+      const auto fmt = parseFormat(argv[i + 1]);
+      if (!fmt) {
+        fprintf(stderr, "Error: Unknown format %s\n", argv[i + 1]);
+        return 1;
+      }
+      opt.format = *fmt;
+    } else if (arg == "--mip" || arg == "--min-dim" || arg == "--jobs") {
+      const auto value = parseNumber(argv[i + 1]);
+      if (!value || (arg == "--jobs" && *value == 0)) {
+        fprintf(stderr, "Error: Invalid value %s for %s\n", argv[i + 1],
+                argv[i]);
+        usage();
+        return 1;
+      }
+      if (arg == "--mip")
+        opt.maxMip = *value;
+      else if (arg == "--min-dim")
+        opt.minDim = *value;
+      else
+        opt.jobs = *value;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (!fs::is_directory(opt.input)) {
+    fprintf(stderr, "Error: %s is not a directory\n", argv[1]);
+    return 1;
+  }
+
+  return run(opt);
+}
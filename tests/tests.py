@@ -86,6 +86,22 @@ def run_test(test_exec, path, out_path):
 
 	# os.remove(rebuild_path)
 
+def run_checks(test_exec, flag, name, *args):
+	'''
+	Run the built-in checks selected by `flag` (e.g. --mesh).
+	'''
+	from subprocess import Popen, PIPE
+
+	process = Popen([test_exec, flag, *args], stdout=PIPE)
+	(output, err) = process.communicate()
+	exit_code = process.wait()
+
+	if exit_code:
+		print("Error: %s failed:" % name)
+		print(output.decode())
+	else:
+		print("%s: Success" % name)
+
 def run_tests(test_exec, data, out):
 	assert os.path.isdir(data)
 	assert not os.path.isfile(out)
@@ -107,6 +123,11 @@ if len(sys.argv) < 3:
 	sys.exit(1)
 
 try:
+	run_checks(sys.argv[1], "--mesh", "Mesh passes")
+	run_checks(sys.argv[1], "--image", "Image format selection")
+	run_checks(sys.argv[1], "--vbo", "Vertex buffer building")
+	run_checks(sys.argv[1], "--scene", "Culling of a skinned model",
+	           os.path.join(sys.argv[2], "Mario.bdl"))
 	run_tests(sys.argv[1], sys.argv[2], sys.argv[3])
 except:
 	print("Error: tests.py encountered a critical error")